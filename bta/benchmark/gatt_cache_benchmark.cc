@@ -0,0 +1,239 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gatt/database.h"
+#include "gatt/database_builder.h"
+#include "gatt/database_store.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+using bluetooth::Uuid;
+using gatt::Database;
+using gatt::DatabaseBuilder;
+using gatt::DatabaseStore;
+using gatt::StoredAttribute;
+using gatt::StoredAttributes;
+
+// Bonded servers that reconnect, e.g. a room of sensors or a car's key fobs.
+#define NUM_PEERS 50
+// Shape of each database: services, characteristics in each, and a CCCD per
+// characteristic; 72 attributes.
+#define NUM_SERVICES 8
+#define CHARS_PER_SERVICE 4
+
+namespace {
+
+// The format of the per server files of the cache before the store.
+#define LEGACY_CACHE_VERSION 5
+
+RawAddress peer_address(size_t i) {
+  RawAddress address;
+  for (size_t b = 0; b < RawAddress::kLength; b++)
+    address.address[b] = (i * 0x9e3779b9) >> (b * 4);
+  return address;
+}
+
+std::vector<StoredAttribute> make_attributes(size_t peer) {
+  DatabaseBuilder builder;
+  uint16_t handle = 1;
+  for (size_t s = 0; s < NUM_SERVICES; s++) {
+    uint16_t s_hdl = handle;
+    builder.AddService(s_hdl, s_hdl + 3 * CHARS_PER_SERVICE,
+                       Uuid::From16Bit(0x1800 + s + peer), true);
+    handle++;
+    for (size_t c = 0; c < CHARS_PER_SERVICE; c++) {
+      builder.AddCharacteristic(handle, handle + 1,
+                                Uuid::From16Bit(0x2a00 + c), 0x12);
+      builder.AddDescriptor(handle + 2, Uuid::From16Bit(0x2902));
+      handle += 3;
+    }
+  }
+  return builder.Build().Serialize();
+}
+
+class Fixture {
+ public:
+  Fixture() {
+#if defined(OS_GENERIC)
+    dir_ = "/tmp/btgcbXXXXXX";
+#else
+    dir_ = "/data/local/tmp/btgcbXXXXXX";
+#endif  // !defined(OS_GENERIC)
+    if (mkdtemp(&dir_[0]) == nullptr) abort();
+  }
+
+  ~Fixture() {
+    for (const std::string& file : files_) unlink(file.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  std::string Path(const std::string& name) {
+    files_.push_back(dir_ + "/" + name);
+    return files_.back();
+  }
+
+ private:
+  std::string dir_;
+  std::vector<std::string> files_;
+};
+
+// bta_gattc_cache_write and bta_gattc_cache_load as they were before the
+// store.
+bool legacy_write(const std::string& path,
+                  const std::vector<StoredAttribute>& attr) {
+  FILE* fd = fopen(path.c_str(), "wb");
+  if (!fd) return false;
+  uint16_t cache_ver = LEGACY_CACHE_VERSION;
+  uint16_t num_attr = attr.size();
+  bool ok = fwrite(&cache_ver, sizeof(uint16_t), 1, fd) == 1 &&
+            fwrite(&num_attr, sizeof(uint16_t), 1, fd) == 1 &&
+            fwrite(attr.data(), sizeof(StoredAttribute), num_attr, fd) ==
+                num_attr;
+  fclose(fd);
+  return ok;
+}
+
+bool legacy_load(const std::string& path, Database* p_db) {
+  FILE* fd = fopen(path.c_str(), "rb");
+  if (!fd) return false;
+  uint16_t cache_ver = 0;
+  uint16_t num_attr = 0;
+  bool success = false;
+  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) == 1 &&
+      cache_ver == LEGACY_CACHE_VERSION &&
+      fread(&num_attr, sizeof(uint16_t), 1, fd) == 1) {
+    std::vector<StoredAttribute> attr(num_attr);
+    if (fread(attr.data(), sizeof(StoredAttribute), num_attr, fd) == num_attr)
+      *p_db = Database::Deserialize(attr, &success);
+  }
+  fclose(fd);
+  return success;
+}
+
+// Loads the cache of every peer as they reconnect, and, if |kLookup|, looks
+// up their services the way the first GATT operation does.
+template <bool kLookup>
+void BM_ReconnectPerPeerFiles(State& state) {
+  Fixture fixture;
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < NUM_PEERS; i++) {
+    paths.push_back(fixture.Path("gatt_cache_" + std::to_string(i)));
+    legacy_write(paths.back(), make_attributes(i));
+  }
+
+  for (auto _ : state) {
+    for (const std::string& path : paths) {
+      Database db;
+      if (!legacy_load(path, &db)) state.SkipWithError("load failed");
+      if (kLookup) benchmark::DoNotOptimize(db.Services().data());
+      benchmark::DoNotOptimize(&db);
+    }
+  }
+  state.counters["time_per_peer"] = Counter(
+      state.iterations() * NUM_PEERS, Counter::kIsRate | Counter::kInvert);
+}
+
+template <bool kLookup>
+void BM_ReconnectStore(State& state) {
+  Fixture fixture;
+  std::string path = fixture.Path("gatt_cache");
+  {
+    DatabaseStore store(path);
+    for (size_t i = 0; i < NUM_PEERS; i++)
+      store.Put(peer_address(i), make_attributes(i));
+    store.Flush();
+  }
+  fixture.Path("gatt_cache.new");
+
+  DatabaseStore store(path);
+  if (!store.Open()) state.SkipWithError("open failed");
+  for (auto _ : state) {
+    for (size_t i = 0; i < NUM_PEERS; i++) {
+      StoredAttributes attr;
+      if (!store.Find(peer_address(i), &attr))
+        state.SkipWithError("find failed");
+      Database db = Database::FromStorage(std::move(attr));
+      if (kLookup) benchmark::DoNotOptimize(db.Services().data());
+      benchmark::DoNotOptimize(&db);
+    }
+  }
+  state.counters["time_per_peer"] = Counter(
+      state.iterations() * NUM_PEERS, Counter::kIsRate | Counter::kInvert);
+}
+
+// What saving a database after discovery costs the BTA thread.
+void BM_SavePerPeerFile(State& state) {
+  Fixture fixture;
+  std::string path = fixture.Path("gatt_cache_0");
+  std::vector<StoredAttribute> attr = make_attributes(0);
+  for (auto _ : state) {
+    legacy_write(path, attr);
+  }
+}
+
+void BM_SaveStore(State& state) {
+  Fixture fixture;
+  std::string path = fixture.Path("gatt_cache");
+  fixture.Path("gatt_cache.new");
+  DatabaseStore store(path);
+  for (size_t i = 0; i < NUM_PEERS; i++)
+    store.Put(peer_address(i), make_attributes(i));
+  store.Flush();
+
+  std::vector<StoredAttribute> attr = make_attributes(0);
+  size_t i = 0;
+  for (auto _ : state) {
+    // The flush runs on the I/O thread
+    store.Put(peer_address(i++ % NUM_PEERS), attr);
+    state.PauseTiming();
+    store.Flush();
+    state.ResumeTiming();
+  }
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_ReconnectPerPeerFiles, true)
+    ->Name("BM_Reconnect/per_peer_files")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ReconnectStore, true)
+    ->Name("BM_Reconnect/store")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ReconnectPerPeerFiles, false)
+    ->Name("BM_ReconnectNoLookup/per_peer_files")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ReconnectStore, false)
+    ->Name("BM_ReconnectNoLookup/store")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SavePerPeerFile)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SaveStore)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "gatt/database.h"
+#include "gatt/database_builder.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+using gatt::Characteristic;
+using gatt::Database;
+using gatt::DatabaseBuilder;
+using gatt::Descriptor;
+using gatt::Service;
+using gatt::StoredAttribute;
+
+// Shape of the database: services of characteristics with a CCCD each, so
+// with the service declarations it has 500 attributes.
+#define NUM_SERVICES 20
+#define CHARS_PER_SERVICE 8
+
+namespace {
+
+Database make_database() {
+  DatabaseBuilder builder;
+  uint16_t handle = 1;
+  for (size_t s = 0; s < NUM_SERVICES; s++) {
+    builder.AddService(handle, handle + 3 * CHARS_PER_SERVICE,
+                       Uuid::From16Bit(0x1800 + s), true);
+    handle++;
+    for (size_t c = 0; c < CHARS_PER_SERVICE; c++) {
+      builder.AddCharacteristic(handle, handle + 1,
+                                Uuid::From16Bit(0x2a00 + c), 0x12);
+      builder.AddDescriptor(handle + 2, Uuid::From16Bit(0x2902));
+      handle += 3;
+    }
+  }
+  return builder.Build();
+}
+
+// Handles looked up, in the order notifications of a busy server come in.
+std::vector<uint16_t> value_handles(const Database& db) {
+  std::vector<uint16_t> handles;
+  for (const Service& service : db.Services())
+    for (const Characteristic& charac : service.characteristics)
+      handles.push_back(charac.value_handle);
+  for (size_t i = 0; i < handles.size(); i++)
+    std::swap(handles[i], handles[(i * 7919) % handles.size()]);
+  return handles;
+}
+
+// The lookups of bta_gattc_cache.cc before the index.
+const Service* linear_find_service(const Database& db, uint16_t handle) {
+  for (const Service& service : db.Services()) {
+    if (handle >= service.handle && handle <= service.end_handle)
+      return &service;
+  }
+  return nullptr;
+}
+
+const Characteristic* linear_find_characteristic(const Database& db,
+                                                 uint16_t handle) {
+  const Service* service = linear_find_service(db, handle);
+  if (!service) return nullptr;
+  for (const Characteristic& charac : service->characteristics) {
+    if (handle == charac.value_handle) return &charac;
+  }
+  return nullptr;
+}
+
+const Characteristic* linear_find_owning_characteristic(const Database& db,
+                                                        uint16_t handle) {
+  const Service* service = linear_find_service(db, handle);
+  if (!service) return nullptr;
+  for (const Characteristic& charac : service->characteristics) {
+    for (const Descriptor& desc : charac.descriptors) {
+      if (handle == desc.handle) return &charac;
+    }
+  }
+  return nullptr;
+}
+
+template <bool kIndexed>
+void BM_FindCharacteristic(State& state) {
+  Database db = make_database();
+  std::vector<uint16_t> handles = value_handles(db);
+  size_t i = 0;
+  for (auto _ : state) {
+    uint16_t handle = handles[i++ % handles.size()];
+    const Characteristic* charac =
+        kIndexed ? db.FindCharacteristic(handle)
+                 : linear_find_characteristic(db, handle);
+    if (charac == nullptr) state.SkipWithError("not found");
+    benchmark::DoNotOptimize(charac);
+  }
+}
+
+// The CCCD writes of registering for notifications.
+template <bool kIndexed>
+void BM_FindOwningCharacteristic(State& state) {
+  Database db = make_database();
+  std::vector<uint16_t> handles = value_handles(db);
+  size_t i = 0;
+  for (auto _ : state) {
+    uint16_t handle = handles[i++ % handles.size()] + 1;
+    const Characteristic* charac = nullptr;
+    if (kIndexed)
+      db.FindDescriptor(handle, &charac);
+    else
+      charac = linear_find_owning_characteristic(db, handle);
+    if (charac == nullptr) state.SkipWithError("not found");
+    benchmark::DoNotOptimize(charac);
+  }
+}
+
+template <bool kIndexed>
+void BM_FindService(State& state) {
+  Database db = make_database();
+  std::vector<uint16_t> handles = value_handles(db);
+  size_t i = 0;
+  for (auto _ : state) {
+    uint16_t handle = handles[i++ % handles.size()];
+    const Service* service = kIndexed ? db.FindService(handle)
+                                      : linear_find_service(db, handle);
+    if (service == nullptr) state.SkipWithError("not found");
+    benchmark::DoNotOptimize(service);
+  }
+}
+
+// What building the index adds to loading a database.
+void BM_Deserialize(State& state) {
+  std::vector<StoredAttribute> attr = make_database().Serialize();
+  for (auto _ : state) {
+    bool success;
+    Database db = Database::Deserialize(attr, &success);
+    benchmark::DoNotOptimize(&db);
+  }
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_FindCharacteristic, false)
+    ->Name("BM_FindCharacteristic/linear");
+BENCHMARK_TEMPLATE(BM_FindCharacteristic, true)
+    ->Name("BM_FindCharacteristic/indexed");
+BENCHMARK_TEMPLATE(BM_FindOwningCharacteristic, false)
+    ->Name("BM_FindOwningCharacteristic/linear");
+BENCHMARK_TEMPLATE(BM_FindOwningCharacteristic, true)
+    ->Name("BM_FindOwningCharacteristic/indexed");
+BENCHMARK_TEMPLATE(BM_FindService, false)->Name("BM_FindService/linear");
+BENCHMARK_TEMPLATE(BM_FindService, true)->Name("BM_FindService/indexed");
+BENCHMARK(BM_Deserialize)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
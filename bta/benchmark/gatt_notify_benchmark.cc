@@ -0,0 +1,267 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <hardware/bt_gatt.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bta_gatt_api.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// A sensor notifying at 2 kHz over a 7.5 ms connection interval: the
+// notifications of a connection event come in as a burst.
+#define NOTIFY_RATE_HZ 2000
+#define CONN_INTERVAL_US 7500
+#define NOTIFY_PER_EVENT (NOTIFY_RATE_HZ * CONN_INTERVAL_US / 1000000)
+#define NOTIFY_BATCH_MAX 32
+
+namespace {
+
+const RawAddress PEER({0x00, 0x11, 0x22, 0x33, 0x44, 0x55});
+
+// The JNI thread, running one task per wakeup of its message loop.
+class JniThread {
+ public:
+  JniThread() : thread_([this] { Run(); }) {}
+
+  ~JniThread() {
+    Post(nullptr);
+    thread_.join();
+  }
+
+  void Post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    cv_.notify_one();
+  }
+
+  // Waits for the tasks posted so far to run.
+  void Sync() {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    Post([&] {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return done; });
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !tasks_.empty(); });
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      if (!task) return;
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  std::thread thread_;
+};
+
+// What the Java callback sees.
+uint32_t app_checksum;
+
+void notify_cb(int conn_id, const btgatt_notify_params_t& data) {
+  app_checksum += conn_id + data.handle + data.len + data.value[0];
+}
+
+void fill_pdu(std::vector<uint8_t>* pdu, size_t i) {
+  (*pdu)[0] = 0x10 + i;
+  (*pdu)[1] = 0x00;
+  for (size_t b = 2; b < pdu->size(); b++) (*pdu)[b] = b + i;
+}
+
+// gatt_process_notification, bta_gattc_process_indicate and bta_gattc_cback
+// as they were before the batches: the value buffers are copied whole, and
+// each notification is posted to the JNI thread on its own.
+void legacy_notify(JniThread* jni, const std::vector<uint8_t>& pdu) {
+  tGATT_VALUE value;
+  memset(&value, 0, sizeof(value));
+  value.handle = pdu[0] | (pdu[1] << 8);
+  value.len = pdu.size() - 2;
+  memcpy(value.value, pdu.data() + 2, value.len);
+  tGATT_CL_COMPLETE gatt_cl_complete;
+  gatt_cl_complete.att_value = value;
+  benchmark::DoNotOptimize(&gatt_cl_complete);
+
+  tBTA_GATTC_NOTIFY notify;
+  notify.handle = gatt_cl_complete.att_value.handle;
+  notify.trans_id = 0;
+  notify.is_notify = true;
+  notify.len = gatt_cl_complete.att_value.len;
+  notify.bda = PEER;
+  memcpy(notify.value, gatt_cl_complete.att_value.value, notify.len);
+  notify.conn_id = 3;
+  tBTA_GATTC bta_gattc;
+  bta_gattc.notify = notify;
+
+  tBTA_GATTC* p_data = (tBTA_GATTC*)malloc(sizeof(tBTA_GATTC));
+  memcpy(p_data, &bta_gattc, sizeof(tBTA_GATTC));
+  jni->Post([p_data] {
+    btgatt_notify_params_t data;
+    data.bda = p_data->notify.bda;
+    memcpy(data.value, p_data->notify.value, p_data->notify.len);
+    data.handle = p_data->notify.handle;
+    data.is_notify = p_data->notify.is_notify;
+    data.len = p_data->notify.len;
+    notify_cb(p_data->notify.conn_id, data);
+    free(p_data);
+  });
+}
+
+// The same path with the values copied up to their length and handed to the
+// JNI thread in batches.
+struct NotifyBatch {
+  struct Entry {
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t len;
+    bool is_notify;
+    uint32_t trans_id;
+    RawAddress bda;
+    size_t offset;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<uint8_t> values;
+};
+
+std::mutex notify_batch_mutex;
+NotifyBatch* pending_notify_batch = nullptr;
+
+void deliver_notify_batch(NotifyBatch* batch) {
+  {
+    std::lock_guard<std::mutex> lock(notify_batch_mutex);
+    if (pending_notify_batch == batch) pending_notify_batch = nullptr;
+  }
+
+  btgatt_notify_params_t data;
+  for (const NotifyBatch::Entry& entry : batch->entries) {
+    data.bda = entry.bda;
+    memcpy(data.value, batch->values.data() + entry.offset, entry.len);
+    data.handle = entry.handle;
+    data.is_notify = entry.is_notify;
+    data.len = entry.len;
+    notify_cb(entry.conn_id, data);
+  }
+  delete batch;
+}
+
+void batched_notify(JniThread* jni, const std::vector<uint8_t>& pdu) {
+  tGATT_CL_COMPLETE gatt_cl_complete;
+  tGATT_VALUE& value = gatt_cl_complete.att_value;
+  memset(&value, 0, offsetof(tGATT_VALUE, value));
+  value.read_sub_type = 0;
+  value.handle = pdu[0] | (pdu[1] << 8);
+  value.len = pdu.size() - 2;
+  memcpy(value.value, pdu.data() + 2, value.len);
+  benchmark::DoNotOptimize(&gatt_cl_complete);
+
+  tBTA_GATTC cb_data;
+  tBTA_GATTC_NOTIFY& notify = cb_data.notify;
+  notify.handle = value.handle;
+  notify.trans_id = 0;
+  notify.is_notify = true;
+  notify.len = value.len;
+  notify.bda = PEER;
+  memcpy(notify.value, value.value, value.len);
+  notify.conn_id = 3;
+
+  std::lock_guard<std::mutex> lock(notify_batch_mutex);
+  NotifyBatch* batch = pending_notify_batch;
+  if (!batch || batch->entries.size() >= NOTIFY_BATCH_MAX) {
+    batch = new NotifyBatch();
+    batch->entries.reserve(NOTIFY_BATCH_MAX);
+    batch->values.reserve(NOTIFY_BATCH_MAX * (GATT_DEF_BLE_MTU_SIZE - 3));
+    jni->Post([batch] { deliver_notify_batch(batch); });
+    pending_notify_batch = batch;
+  }
+
+  size_t offset = batch->values.size();
+  batch->values.insert(batch->values.end(), notify.value,
+                       notify.value + notify.len);
+  batch->entries.push_back({notify.conn_id, notify.handle, notify.len,
+                            notify.is_notify, notify.trans_id, notify.bda,
+                            offset});
+}
+
+// CPU time of both threads per notification, for values of state.range(0)
+// bytes.
+template <bool kBatched>
+void BM_Notify(State& state) {
+  JniThread jni;
+  std::vector<uint8_t> pdu(2 + state.range(0));
+  for (auto _ : state) {
+    for (size_t i = 0; i < NOTIFY_PER_EVENT; i++) {
+      fill_pdu(&pdu, i);
+      if (kBatched)
+        batched_notify(&jni, pdu);
+      else
+        legacy_notify(&jni, pdu);
+    }
+    // The next connection event comes after the JNI thread went idle
+    jni.Sync();
+  }
+  benchmark::DoNotOptimize(app_checksum);
+  state.counters["cpu_per_notification"] =
+      Counter(state.iterations() * NOTIFY_PER_EVENT,
+              Counter::kIsRate | Counter::kInvert);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Notify, false)
+    ->Name("BM_Notify/legacy")
+    ->Arg(20)
+    ->Arg(244)
+    ->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_Notify, true)
+    ->Name("BM_Notify/batched")
+    ->Arg(20)
+    ->Arg(244)
+    ->MeasureProcessCPUTime();
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -185,6 +185,8 @@ void bta_gattc_disable() {
   bta_gattc_cb.native_access_uuid_list.clear();
   bta_gattc_cb.native_access_notif_enabled = false;
 
+  bta_gattc_cache_cleanup();
+
   /* no registered apps, indicate disable completed */
   if (bta_gattc_cb.state != BTA_GATTC_STATE_DISABLING) {
     bta_gattc_cb = tBTA_GATTC_CB();
@@ -778,8 +780,12 @@ void bta_gattc_start_discover(tBTA_GATTC_CLCB* p_clcb,
       bta_gattc_set_discover_st(p_clcb->p_srcb);
 
       bta_gattc_init_cache(p_clcb->p_srcb);
-      p_clcb->status = bta_gattc_discover_pri_service(
-          p_clcb->bta_conn_id, p_clcb->p_srcb, GATT_DISC_SRVC_ALL);
+      /* servers with the Database Hash of a known one skip the discovery */
+      if (bta_gattc_read_db_hash(p_clcb))
+        p_clcb->status = GATT_SUCCESS;
+      else
+        p_clcb->status = bta_gattc_discover_pri_service(
+            p_clcb->bta_conn_id, p_clcb->p_srcb, GATT_DISC_SRVC_ALL);
       if (p_clcb->status != GATT_SUCCESS) {
         LOG(ERROR) << "discovery on server failed";
         bta_gattc_reset_discover_st(p_clcb->p_srcb, p_clcb->status);
@@ -1163,8 +1169,19 @@ void bta_gattc_op_cmpl(tBTA_GATTC_CLCB* p_clcb, tBTA_GATTC_DATA* p_data) {
 }
 
 /** operation completed */
-void bta_gattc_ignore_op_cmpl(UNUSED_ATTR tBTA_GATTC_CLCB* p_clcb,
+void bta_gattc_ignore_op_cmpl(tBTA_GATTC_CLCB* p_clcb,
                               tBTA_GATTC_DATA* p_data) {
+  /* the Database Hash read that starts the discovery. Every clcb of the
+   * server is in discovery by then, so reads other applications had in flight
+   * also end up here: only the one on the connection the read was sent on is
+   * taken, as that connection had no operation pending when it was sent. */
+  if (p_clcb->p_srcb && p_clcb->p_srcb->reading_db_hash &&
+      p_clcb->bta_conn_id == p_clcb->p_srcb->db_hash_conn_id &&
+      p_data->op_cmpl.op_code == GATTC_OPTYPE_READ) {
+    bta_gattc_db_hash_read_cmpl(p_clcb, &p_data->op_cmpl);
+    return;
+  }
+
   /* receive op complete when discovery is started, ignore the response,
       and wait for discovery finish and resent */
   VLOG(1) << __func__ << ": op = " << +p_data->hdr.layer_specific;
@@ -1508,10 +1525,12 @@ void bta_gattc_proc_native_access_notification(tBTA_GATTC_SERV* p_srcb,
   }
 }
 
-/** process all non-service change indication/notification */
+/** process all non-service change indication/notification, |p_cb_data| is
+ * filled in place and handed to the application */
 void bta_gattc_proc_other_indication(tBTA_GATTC_CLCB* p_clcb, uint8_t op,
                                      tGATT_CL_COMPLETE* p_data,
-                                     tBTA_GATTC_NOTIFY* p_notify) {
+                                     tBTA_GATTC* p_cb_data) {
+  tBTA_GATTC_NOTIFY* p_notify = &p_cb_data->notify;
   VLOG(1) << __func__
           << StringPrintf(
                  ": check p_data->att_value.handle=%d p_data->handle=%d",
@@ -1556,18 +1575,16 @@ void bta_gattc_proc_other_indication(tBTA_GATTC_CLCB* p_clcb, uint8_t op,
     }
   }
 #endif
-  if (p_clcb->p_rcb->p_cback) {
-    tBTA_GATTC bta_gattc;
-    bta_gattc.notify = *p_notify;
-    (*p_clcb->p_rcb->p_cback)(BTA_GATTC_NOTIF_EVT, &bta_gattc);
-  }
+  if (p_clcb->p_rcb->p_cback)
+    (*p_clcb->p_rcb->p_cback)(BTA_GATTC_NOTIF_EVT, p_cb_data);
 }
 
 /** process indication/notification */
 void bta_gattc_process_indicate(uint16_t conn_id, tGATTC_OPTYPE op,
                                 tGATT_CL_COMPLETE* p_data, uint32_t trans_id) {
   uint16_t handle = p_data->att_value.handle;
-  tBTA_GATTC_NOTIFY notify;
+  tBTA_GATTC cb_data;
+  tBTA_GATTC_NOTIFY& notify = cb_data.notify;
   RawAddress remote_bda;
   tGATT_IF gatt_if;
   tBTA_TRANSPORT transport;
@@ -1632,7 +1649,7 @@ void bta_gattc_process_indicate(uint16_t conn_id, tGATTC_OPTYPE op,
     }
 
     if (p_clcb != NULL)
-      bta_gattc_proc_other_indication(p_clcb, op, p_data, &notify);
+      bta_gattc_proc_other_indication(p_clcb, op, p_data, &cb_data);
   }
   /* no one intersted and need ack? */
   else if (op == GATTC_OPTYPE_INDICATION) {
@@ -27,6 +27,7 @@
 
 #include "bt_target.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
@@ -41,8 +42,10 @@
 #include "btm_int.h"
 #include "database.h"
 #include "database_builder.h"
+#include "database_store.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/thread.h"
 #include "sdp_api.h"
 #include "sdpdefs.h"
 #include "utl.h"
@@ -52,10 +55,12 @@ using bluetooth::Uuid;
 using gatt::Characteristic;
 using gatt::Database;
 using gatt::DatabaseBuilder;
+using gatt::DatabaseStore;
 using gatt::Descriptor;
 using gatt::IncludedService;
 using gatt::Service;
 using gatt::StoredAttribute;
+using gatt::StoredAttributes;
 
 #if (OFF_TARGET_TEST_ENABLED == TRUE)
 constexpr static std::pair<uint16_t, uint16_t> EXPLORE_END =
@@ -63,7 +68,10 @@ constexpr static std::pair<uint16_t, uint16_t> EXPLORE_END =
 #endif
 
 static void bta_gattc_cache_write(const RawAddress& server_bda,
-                                  const std::vector<StoredAttribute>& attr);
+                                  std::vector<StoredAttribute> attr,
+                                  const Octet16* p_db_hash);
+static DatabaseStore* bta_gattc_get_cache_store();
+static void bta_gattc_cache_schedule_flush();
 static tGATT_STATUS bta_gattc_sdp_service_disc(uint16_t conn_id,
                                                tBTA_GATTC_SERV* p_server_cb);
 const Descriptor* bta_gattc_get_descriptor_srcb(tBTA_GATTC_SERV* p_srcb,
@@ -75,8 +83,19 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
 
 #define BTA_GATT_SDP_DB_SIZE 4096
 
-#define GATT_CACHE_PREFIX "/data/misc/bluetooth/gatt_cache_"
-#define GATT_CACHE_VERSION 5
+#define GATT_CACHE_DIR "/data/misc/bluetooth"
+#define GATT_CACHE_PATH GATT_CACHE_DIR "/gatt_cache"
+/* Per server cache files of earlier versions: moved to |cache_store| when it
+ * is opened, then removed */
+#define GATT_CACHE_LEGACY_NAME "gatt_cache_"
+#define GATT_CACHE_PREFIX GATT_CACHE_DIR "/" GATT_CACHE_LEGACY_NAME
+#define GATT_CACHE_LEGACY_VERSION 5
+
+/* The cache of every bonded server, mapped on first use. Changes are written
+ * out on |cache_io_thread|, so saving a database after discovery does not
+ * block the BTA thread. */
+static DatabaseStore* cache_store;
+static thread_t* cache_io_thread;
 
 static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
                                                const RawAddress& bda) {
@@ -122,16 +141,9 @@ static void bta_gattc_display_explore_record(const DatabaseBuilder& database) {
 void bta_gattc_init_cache(tBTA_GATTC_SERV* p_srvc_cb) {
   p_srvc_cb->gatt_database = gatt::Database();
   p_srvc_cb->pending_discovery.Clear();
-}
-
-const Service* bta_gattc_find_matching_service(
-    const std::vector<Service>& services, uint16_t handle) {
-  for (const Service& service : services) {
-    if (handle >= service.handle && handle <= service.end_handle)
-      return &service;
-  }
-
-  return nullptr;
+  p_srvc_cb->reading_db_hash = false;
+  p_srvc_cb->db_hash_conn_id = GATT_INVALID_CONN_ID;
+  p_srvc_cb->has_db_hash = false;
 }
 
 /** Start primary service discovery */
@@ -149,6 +161,100 @@ tGATT_STATUS bta_gattc_discover_pri_service(uint16_t conn_id,
   return bta_gattc_sdp_service_disc(conn_id, p_server_cb);
 }
 
+/*******************************************************************************
+ *
+ * Function         bta_gattc_read_db_hash
+ *
+ * Description      Read the Database Hash characteristic of the server, which
+ *                  lets a database known for another server with the same
+ *                  hash be used instead of discovering it. Only done over LE,
+ *                  and with no operation in flight whose completion could be
+ *                  taken for the read's.
+ *
+ * Returns          true if the read was sent.
+ *
+ ******************************************************************************/
+bool bta_gattc_read_db_hash(tBTA_GATTC_CLCB* p_clcb) {
+  if (p_clcb->transport != BTA_TRANSPORT_LE || p_clcb->p_q_cmd != NULL)
+    return false;
+
+  tGATT_READ_PARAM read_param;
+  memset(&read_param, 0, sizeof(tGATT_READ_BY_TYPE));
+  read_param.char_type.s_handle = 0x0001;
+  read_param.char_type.e_handle = 0xFFFF;
+  read_param.char_type.uuid = Uuid::From16Bit(GATT_UUID_DATABASE_HASH);
+  if (GATTC_Read(p_clcb->bta_conn_id, GATT_READ_BY_TYPE, &read_param) !=
+      GATT_SUCCESS)
+    return false;
+
+  p_clcb->p_srcb->reading_db_hash = true;
+  p_clcb->p_srcb->db_hash_conn_id = p_clcb->bta_conn_id;
+  return true;
+}
+
+/** Use the database of a known or cached server with the Database Hash of
+ * |p_srvc_cb|. Returns false if there is none. */
+static bool bta_gattc_share_database(tBTA_GATTC_SERV* p_srvc_cb) {
+  tBTA_GATTC_SERV* p_other = bta_gattc_find_srcb_by_db_hash(p_srvc_cb);
+  if (p_other != NULL) {
+    p_srvc_cb->gatt_database = p_other->gatt_database;
+    return true;
+  }
+
+  StoredAttributes attr;
+  if (!bta_gattc_get_cache_store()->FindByDatabaseHash(p_srvc_cb->db_hash,
+                                                       &attr))
+    return false;
+  Database database = Database::FromStorage(std::move(attr));
+  if (database.IsEmpty()) return false;
+  p_srvc_cb->gatt_database = std::move(database);
+  return true;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_db_hash_read_cmpl
+ *
+ * Description      Database Hash read completed: take the database of a server
+ *                  with the same hash if there is one, or discover it.
+ *
+ * Returns          None.
+ *
+ ******************************************************************************/
+void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb,
+                                 tBTA_GATTC_OP_CMPL* p_data) {
+  tBTA_GATTC_SERV* p_srvc_cb = p_clcb->p_srcb;
+  p_srvc_cb->reading_db_hash = false;
+  p_srvc_cb->db_hash_conn_id = GATT_INVALID_CONN_ID;
+
+  if (p_data->status == GATT_SUCCESS && p_data->p_cmpl != NULL &&
+      p_data->p_cmpl->att_value.len == OCTET16_LEN) {
+    memcpy(p_srvc_cb->db_hash.data(), p_data->p_cmpl->att_value.value,
+           OCTET16_LEN);
+    p_srvc_cb->has_db_hash = true;
+  }
+
+  if (p_srvc_cb->has_db_hash && bta_gattc_share_database(p_srvc_cb)) {
+    LOG(INFO) << __func__ << ": known Database Hash, discovery skipped";
+
+    p_srvc_cb->state = BTA_GATTC_SERV_SAVE;
+    if (btm_sec_is_a_bonded_dev(p_srvc_cb->server_bda)) {
+      bta_gattc_cache_write(p_srvc_cb->server_bda,
+                            p_srvc_cb->gatt_database.Serialize(),
+                            &p_srvc_cb->db_hash);
+    }
+    bta_gattc_reset_discover_st(p_srvc_cb, GATT_SUCCESS);
+    return;
+  }
+
+  p_clcb->status = bta_gattc_discover_pri_service(
+      p_clcb->bta_conn_id, p_srvc_cb, GATT_DISC_SRVC_ALL);
+  if (p_clcb->status != GATT_SUCCESS) {
+    LOG(ERROR) << "discovery on server failed";
+    bta_gattc_reset_discover_st(p_srvc_cb, p_clcb->status);
+  }
+}
+
 /** start exploring next service, or finish discovery if no more services left
  */
 static void bta_gattc_explore_next_service(uint16_t conn_id,
@@ -191,8 +297,9 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
   p_clcb->p_srcb->state = BTA_GATTC_SERV_SAVE;
 
   if (btm_sec_is_a_bonded_dev(p_srvc_cb->server_bda)) {
-    bta_gattc_cache_write(p_clcb->p_srcb->server_bda,
-                          p_clcb->p_srcb->gatt_database.Serialize());
+    bta_gattc_cache_write(
+        p_clcb->p_srcb->server_bda, p_clcb->p_srcb->gatt_database.Serialize(),
+        p_srvc_cb->has_db_hash ? &p_srvc_cb->db_hash : NULL);
   }
 
   bta_gattc_reset_discover_st(p_clcb->p_srcb, GATT_SUCCESS);
@@ -452,31 +559,23 @@ const std::vector<Service>* bta_gattc_get_services(uint16_t conn_id) {
 
 const Service* bta_gattc_get_service_for_handle_srcb(tBTA_GATTC_SERV* p_srcb,
                                                      uint16_t handle) {
-  const std::vector<Service>* services = bta_gattc_get_services_srcb(p_srcb);
-  if (services == NULL) return NULL;
-  return bta_gattc_find_matching_service(*services, handle);
+  if (!p_srcb) return NULL;
+  return p_srcb->gatt_database.FindService(handle);
 }
 
 const Service* bta_gattc_get_service_for_handle(uint16_t conn_id,
                                                 uint16_t handle) {
-  const std::vector<Service>* services = bta_gattc_get_services(conn_id);
-  if (services == NULL) return NULL;
+  tBTA_GATTC_CLCB* p_clcb = bta_gattc_find_clcb_by_conn_id(conn_id);
 
-  return bta_gattc_find_matching_service(*services, handle);
+  if (p_clcb == NULL) return NULL;
+
+  return bta_gattc_get_service_for_handle_srcb(p_clcb->p_srcb, handle);
 }
 
 const Characteristic* bta_gattc_get_characteristic_srcb(tBTA_GATTC_SERV* p_srcb,
                                                         uint16_t handle) {
-  const Service* service =
-      bta_gattc_get_service_for_handle_srcb(p_srcb, handle);
-
-  if (!service) return NULL;
-
-  for (const Characteristic& charac : service->characteristics) {
-    if (handle == charac.value_handle) return &charac;
-  }
-
-  return NULL;
+  if (!p_srcb) return NULL;
+  return p_srcb->gatt_database.FindCharacteristic(handle);
 }
 
 const Characteristic* bta_gattc_get_characteristic(uint16_t conn_id,
@@ -491,20 +590,8 @@ const Characteristic* bta_gattc_get_characteristic(uint16_t conn_id,
 
 const Descriptor* bta_gattc_get_descriptor_srcb(tBTA_GATTC_SERV* p_srcb,
                                                 uint16_t handle) {
-  const Service* service =
-      bta_gattc_get_service_for_handle_srcb(p_srcb, handle);
-
-  if (!service) {
-    return NULL;
-  }
-
-  for (const Characteristic& charac : service->characteristics) {
-    for (const Descriptor& desc : charac.descriptors) {
-      if (handle == desc.handle) return &desc;
-    }
-  }
-
-  return NULL;
+  if (!p_srcb) return NULL;
+  return p_srcb->gatt_database.FindDescriptor(handle);
 }
 
 const Descriptor* bta_gattc_get_descriptor(uint16_t conn_id, uint16_t handle) {
@@ -518,18 +605,11 @@ const Descriptor* bta_gattc_get_descriptor(uint16_t conn_id, uint16_t handle) {
 
 const Characteristic* bta_gattc_get_owning_characteristic_srcb(
     tBTA_GATTC_SERV* p_srcb, uint16_t handle) {
-  const Service* service =
-      bta_gattc_get_service_for_handle_srcb(p_srcb, handle);
-
-  if (!service) return NULL;
+  if (!p_srcb) return NULL;
 
-  for (const Characteristic& charac : service->characteristics) {
-    for (const Descriptor& desc : charac.descriptors) {
-      if (handle == desc.handle) return &charac;
-    }
-  }
-
-  return NULL;
+  const Characteristic* charac = NULL;
+  if (!p_srcb->gatt_database.FindDescriptor(handle, &charac)) return NULL;
+  return charac;
 }
 
 const Characteristic* bta_gattc_get_owning_characteristic(uint16_t conn_id,
@@ -712,22 +792,11 @@ void bta_gattc_get_gatt_db(uint16_t conn_id, uint16_t start_handle,
                              count);
 }
 
-/*******************************************************************************
- *
- * Function         bta_gattc_cache_load
- *
- * Description      Load GATT cache from storage for server.
- *
- * Parameter        p_clcb: pointer to server clcb, that will
- *                          be filled from storage
- * Returns          true on success, false otherwise
- *
- ******************************************************************************/
-bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname),
-                                     p_clcb->p_srcb->server_bda);
-
+/* Reads the per server cache file |fname| of an earlier version into
+ * |*p_attr|. Returns false if it can't be read or does not describe a valid
+ * database. */
+static bool bta_gattc_cache_read_legacy(const char* fname,
+                                        std::vector<StoredAttribute>* p_attr) {
   FILE* fd = fopen(fname, "rb");
   if (!fd) {
     LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
@@ -736,39 +805,122 @@ bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb) {
   }
 
   uint16_t cache_ver = 0;
-  bool success = false;
   uint16_t num_attr = 0;
+  bool success = false;
+  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) == 1 &&
+      cache_ver == GATT_CACHE_LEGACY_VERSION &&
+      fread(&num_attr, sizeof(uint16_t), 1, fd) == 1) {
+    p_attr->resize(num_attr);
+    if (fread(p_attr->data(), sizeof(StoredAttribute), num_attr, fd) ==
+        num_attr) {
+      Database::Deserialize(*p_attr, &success);
+    }
+  }
+  fclose(fd);
 
-  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't read GATT cache version from: " << fname;
-    goto done;
+  if (!success) LOG(ERROR) << __func__ << ": dropping GATT cache " << fname;
+  return success;
+}
+
+/* Moves the per server cache files of earlier versions to |cache_store|,
+ * unless it already has a database for the server, and removes them. */
+static void bta_gattc_cache_migrate_legacy() {
+  DIR* dir = opendir(GATT_CACHE_DIR);
+  if (!dir) return;
+
+  const size_t name_len = strlen(GATT_CACHE_LEGACY_NAME);
+  bool changed = false;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    RawAddress bda;
+    if (strncmp(entry->d_name, GATT_CACHE_LEGACY_NAME, name_len) != 0 ||
+        strlen(entry->d_name) != name_len + 2 * sizeof(bda.address) ||
+        sscanf(entry->d_name + name_len, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
+               &bda.address[0], &bda.address[1], &bda.address[2],
+               &bda.address[3], &bda.address[4], &bda.address[5]) != 6) {
+      continue;
+    }
+
+    char fname[255] = {0};
+    bta_gattc_generate_cache_file_name(fname, sizeof(fname), bda);
+    std::vector<StoredAttribute> attr;
+    StoredAttributes stored;
+    if (!cache_store->Find(bda, &stored) &&
+        bta_gattc_cache_read_legacy(fname, &attr)) {
+      changed |= cache_store->Put(bda, std::move(attr));
+    }
+    unlink(fname);
   }
+  closedir(dir);
+
+  if (changed) bta_gattc_cache_schedule_flush();
+}
 
-  if (cache_ver != GATT_CACHE_VERSION) {
-    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
-    goto done;
+static DatabaseStore* bta_gattc_get_cache_store() {
+  if (cache_store == NULL) {
+    cache_store = new DatabaseStore(GATT_CACHE_PATH);
+    cache_store->Open();
+    bta_gattc_cache_migrate_legacy();
   }
+  return cache_store;
+}
+
+static void bta_gattc_cache_flush(void* context) {
+  static_cast<DatabaseStore*>(context)->Flush();
+}
 
-  if (fread(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't read number of GATT attributes: " << fname;
-    goto done;
+/* Writes out the changes to |cache_store| on |cache_io_thread|. */
+static void bta_gattc_cache_schedule_flush() {
+  if (cache_io_thread == NULL) {
+    cache_io_thread = thread_new("bta_gattc_cache_io");
   }
 
-  {
-    std::vector<StoredAttribute> attr(num_attr);
+  if (cache_io_thread == NULL ||
+      !thread_post(cache_io_thread, bta_gattc_cache_flush, cache_store)) {
+    LOG(ERROR) << __func__ << ": writing GATT cache on the caller's thread";
+    cache_store->Flush();
+  }
+}
 
-    if (fread(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-      LOG(ERROR) << __func__ << "s: can't read GATT attributes: " << fname;
-      goto done;
-    }
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_load
+ *
+ * Description      Load GATT cache from storage for server. The services are
+ *                  only built from it when they are first looked up.
+ *
+ * Parameter        p_clcb: pointer to server clcb, that will
+ *                          be filled from storage
+ * Returns          true on success, false otherwise
+ *
+ ******************************************************************************/
+bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb) {
+  tBTA_GATTC_SERV* p_srcb = p_clcb->p_srcb;
+  StoredAttributes attr;
+  if (!bta_gattc_get_cache_store()->Find(p_srcb->server_bda, &attr,
+                                         &p_srcb->has_db_hash,
+                                         &p_srcb->db_hash)) {
+    VLOG(1) << __func__ << ": no GATT cache for " << p_srcb->server_bda;
+    return false;
+  }
 
-    p_clcb->p_srcb->gatt_database = gatt::Database::Deserialize(attr, &success);
+  bool stored_empty = attr.count == 0;
+  Database database = Database::FromStorage(std::move(attr));
+  if (database.IsEmpty() && !stored_empty) {
+    /* not a database that can be used: drop it and discover the server */
+    LOG(ERROR) << __func__ << ": invalid GATT cache for " << p_srcb->server_bda;
+    p_srcb->has_db_hash = false;
+    bta_gattc_cache_reset(p_srcb->server_bda);
+    return false;
   }
 
-done:
-  fclose(fd);
-  return success;
+  /* servers with the same database share it */
+  tBTA_GATTC_SERV* p_other = bta_gattc_find_srcb_by_db_hash(p_srcb);
+  if (p_other != NULL)
+    p_srcb->gatt_database = p_other->gatt_database;
+  else
+    p_srcb->gatt_database = std::move(database);
+  return true;
 }
 
 /*******************************************************************************
@@ -776,47 +928,22 @@ done:
  * Function         bta_gattc_cache_write
  *
  * Description      This callout function is executed by GATT when a server
- *                  cache is available to save.
+ *                  cache is available to save. The file is written
+ *                  asynchronously.
  *
  * Parameter        server_bda: server bd address of this cache belongs to
  *                  attr: attributes to save.
+ *                  p_db_hash: Database Hash of the server, or NULL.
  * Returns
  *
  ******************************************************************************/
 static void bta_gattc_cache_write(const RawAddress& server_bda,
-                                  const std::vector<StoredAttribute>& attr) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
-
-  FILE* fd = fopen(fname, "wb");
-  if (!fd) {
-    LOG(ERROR) << __func__
-               << ": can't open GATT cache file for writing: " << fname;
-    return;
+                                  std::vector<StoredAttribute> attr,
+                                  const Octet16* p_db_hash) {
+  if (bta_gattc_get_cache_store()->Put(server_bda, std::move(attr),
+                                       p_db_hash)) {
+    bta_gattc_cache_schedule_flush();
   }
-
-  uint16_t cache_ver = GATT_CACHE_VERSION;
-  if (fwrite(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache version: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  uint16_t num_attr = attr.size();
-  if (fwrite(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't write GATT cache attribute count: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  if (fwrite(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache attributes: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  fclose(fd);
 }
 
 /*******************************************************************************
@@ -833,7 +960,33 @@ static void bta_gattc_cache_write(const RawAddress& server_bda,
  ******************************************************************************/
 void bta_gattc_cache_reset(const RawAddress& server_bda) {
   VLOG(1) << __func__;
+  if (bta_gattc_get_cache_store()->Remove(server_bda)) {
+    bta_gattc_cache_schedule_flush();
+  }
+
   char fname[255] = {0};
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
   unlink(fname);
 }
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_cleanup
+ *
+ * Description      Writes out any pending change to the GATT cache and
+ *                  releases it.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+void bta_gattc_cache_cleanup(void) {
+  /* Runs the flushes already posted */
+  thread_free(cache_io_thread);
+  cache_io_thread = NULL;
+
+  if (cache_store != NULL) {
+    cache_store->Flush();
+    delete cache_store;
+    cache_store = NULL;
+  }
+}
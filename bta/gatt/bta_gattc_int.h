@@ -225,6 +225,11 @@ typedef struct {
   uint8_t srvc_hdl_chg; /* service handle change indication pending */
   uint16_t attr_index;  /* cahce NV saving/loading attribute index */
 
+  bool reading_db_hash; /* Database Hash read is in flight */
+  uint16_t db_hash_conn_id; /* conn_id the Database Hash read was sent on */
+  bool has_db_hash;     /* db_hash holds the Database Hash of the server */
+  Octet16 db_hash;
+
   uint16_t mtu;
 } tBTA_GATTC_SERV;
 
@@ -431,6 +436,8 @@ extern void bta_gattc_clear_notif_registration(tBTA_GATTC_SERV* p_srcb,
                                                uint16_t end_handle);
 extern void bta_gattc_clear_notif_reg_on_disc(tBTA_GATTC_RCB *p_clreg, RawAddress bda);
 extern tBTA_GATTC_SERV* bta_gattc_find_srvr_cache(const RawAddress& bda);
+extern tBTA_GATTC_SERV* bta_gattc_find_srcb_by_db_hash(
+    const tBTA_GATTC_SERV* p_srcb);
 
 /* discovery functions */
 extern void bta_gattc_disc_res_cback(uint16_t conn_id,
@@ -442,6 +449,9 @@ extern void bta_gattc_disc_cmpl_cback(uint16_t conn_id,
 extern tGATT_STATUS bta_gattc_discover_pri_service(uint16_t conn_id,
                                                    tBTA_GATTC_SERV* p_server_cb,
                                                    uint8_t disc_type);
+extern bool bta_gattc_read_db_hash(tBTA_GATTC_CLCB* p_clcb);
+extern void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb,
+                                        tBTA_GATTC_OP_CMPL* p_data);
 extern void bta_gattc_search_service(tBTA_GATTC_CLCB* p_clcb,
                                      bluetooth::Uuid* p_uuid);
 extern const std::vector<gatt::Service>* bta_gattc_get_services(
@@ -472,6 +482,7 @@ extern bool bta_gattc_conn_dealloc(const RawAddress& remote_bda);
 
 extern bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb);
 extern void bta_gattc_cache_reset(const RawAddress& server_bda);
+extern void bta_gattc_cache_cleanup(void);
 
 extern tBTA_GATTC_CLCB* bta_gattc_cl_get_regcb_by_bdaddr(RawAddress bd_addr,
                                                    tBTA_TRANSPORT transport);
@@ -248,6 +248,33 @@ tBTA_GATTC_SERV* bta_gattc_find_srvr_cache(const RawAddress& bda) {
   }
   return NULL;
 }
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_find_srcb_by_db_hash
+ *
+ * Description      find another server whose database is known and has the
+ *                  same Database Hash as p_srcb
+ *
+ * Returns          pointer to the server cache.
+ *
+ ******************************************************************************/
+tBTA_GATTC_SERV* bta_gattc_find_srcb_by_db_hash(
+    const tBTA_GATTC_SERV* p_srcb) {
+  tBTA_GATTC_SERV* p_other = &bta_gattc_cb.known_server[0];
+  uint8_t i;
+
+  if (!p_srcb->has_db_hash) return NULL;
+
+  for (i = 0; i < BTM_GetWhiteListSize(); i++, p_other++) {
+    if (p_other != p_srcb && p_other->in_use && p_other->has_db_hash &&
+        p_other->db_hash == p_srcb->db_hash &&
+        !p_other->pending_discovery.InProgress() &&
+        !p_other->gatt_database.IsEmpty())
+      return p_other;
+  }
+  return NULL;
+}
 /*******************************************************************************
  *
  * Function         bta_gattc_find_scb_by_cid
@@ -21,6 +21,7 @@
 #include "stack/include/gattdefs.h"
 
 #include <base/logging.h>
+#include <algorithm>
 #include <memory>
 #include <sstream>
 
@@ -34,24 +35,28 @@ const Uuid SECONDARY_SERVICE = Uuid::From16Bit(GATT_UUID_SEC_SERVICE);
 const Uuid INCLUDE = Uuid::From16Bit(GATT_UUID_INCLUDE_SERVICE);
 const Uuid CHARACTERISTIC = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
 
+/* Handles per indexed attribute up to which lookups go through a table of
+ * every handle rather than a binary search. */
+constexpr size_t DENSE_INDEX_RATIO = 4;
+
 bool HandleInRange(const Service& svc, uint16_t handle) {
   return handle >= svc.handle && handle <= svc.end_handle;
 }
 }  // namespace
 
 Service* FindService(std::vector<Service>& services, uint16_t handle) {
-  for (Service& service : services) {
-    if (handle >= service.handle && handle <= service.end_handle)
-      return &service;
-  }
+  auto it = std::lower_bound(
+      services.begin(), services.end(), handle,
+      [](const Service& s, uint16_t handle) { return s.end_handle < handle; });
+  if (it == services.end() || !HandleInRange(*it, handle)) return nullptr;
 
-  return nullptr;
+  return &*it;
 }
 
 std::string Database::ToString() const {
   std::stringstream tmp;
 
-  for (const Service& service : services) {
+  for (const Service& service : Services()) {
     tmp << "Service: handle=" << loghex(service.handle)
         << ", end_handle=" << loghex(service.end_handle)
         << ", uuid=" << service.uuid << "\n";
@@ -81,8 +86,14 @@ std::string Database::ToString() const {
 std::vector<StoredAttribute> Database::Serialize() const {
   std::vector<StoredAttribute> nv_attr;
 
-  if (services.empty()) return std::vector<StoredAttribute>();
+  if (!content) return std::vector<StoredAttribute>();
 
+  const StoredAttributes& stored = content->stored;
+  if (stored.count != 0)
+    return std::vector<StoredAttribute>(stored.attr,
+                                        stored.attr + stored.count);
+
+  const std::vector<Service>& services = content->services;
   for (const Service& service : services) {
     // TODO: add constructor to NV_ATTR, use emplace_back
     nv_attr.push_back({service.handle,
@@ -119,46 +130,175 @@ std::vector<StoredAttribute> Database::Serialize() const {
 
 Database Database::Deserialize(const std::vector<StoredAttribute>& nv_attr,
                                bool* success) {
-  // clear reallocating
   Database result;
-  auto it = nv_attr.cbegin();
+  result.content = std::make_shared<Content>();
+  *success =
+      Deserialize(nv_attr.data(), nv_attr.size(), &result.content->services);
+  result.BuildIndex();
+  return result;
+}
+
+Database Database::FromStorage(StoredAttributes attrs) {
+  Database result;
+  if (attrs.count == 0) return result;
+  if (!IsValid(attrs.attr, attrs.count)) {
+    LOG(ERROR) << __func__ << ": stored database is not valid";
+    return result;
+  }
+  result.content = std::make_shared<Content>();
+  result.content->stored = std::move(attrs);
+  return result;
+}
+
+const std::vector<Service>& Database::Services() const {
+  static const std::vector<Service> empty;
+  if (!content) return empty;
+  if (content->stored.count != 0) Materialize();
+  return content->services;
+}
+
+void Database::Materialize() const {
+  StoredAttributes attrs = std::move(content->stored);
+  content->stored = StoredAttributes();
+  if (!Deserialize(attrs.attr, attrs.count, &content->services)) {
+    LOG(ERROR) << __func__ << ": stored database is not valid";
+    std::vector<Service>().swap(content->services);
+  }
+  BuildIndex();
+}
+
+void Database::BuildIndex() const {
+  std::vector<HandleEntry>& index = content->index;
+  index.clear();
+  for (const Service& service : content->services) {
+    for (const Characteristic& charac : service.characteristics) {
+      index.push_back({charac.value_handle, &charac, nullptr});
+      for (const Descriptor& desc : charac.descriptors)
+        index.push_back({desc.handle, &charac, &desc});
+    }
+  }
+  /* stable, so the first of duplicated handles is still found first */
+  std::stable_sort(index.begin(), index.end(),
+                   [](const HandleEntry& a, const HandleEntry& b) {
+                     return a.handle < b.handle;
+                   });
+  index.shrink_to_fit();
+
+  std::vector<uint16_t>& by_handle = content->by_handle;
+  by_handle.clear();
+  if (!index.empty() && index.size() < UINT16_MAX &&
+      index.back().handle - index.front().handle <
+          DENSE_INDEX_RATIO * index.size()) {
+    content->first_handle = index.front().handle;
+    by_handle.resize(index.back().handle - content->first_handle + 1);
+    for (size_t i = index.size(); i-- > 0;)
+      by_handle[index[i].handle - content->first_handle] = i + 1;
+  }
+  by_handle.shrink_to_fit();
+  content->indexed = true;
+}
+
+std::vector<Database::HandleEntry>::const_iterator Database::FindEntry(
+    uint16_t handle) const {
+  if (content->stored.count != 0) Materialize();
+  if (!content->indexed) BuildIndex();
+
+  const std::vector<HandleEntry>& index = content->index;
+  const std::vector<uint16_t>& by_handle = content->by_handle;
+  if (!by_handle.empty()) {
+    size_t offset = (uint16_t)(handle - content->first_handle);
+    if (offset >= by_handle.size() || by_handle[offset] == 0)
+      return index.end();
+    return index.begin() + by_handle[offset] - 1;
+  }
+  return std::lower_bound(
+      index.begin(), index.end(), handle,
+      [](const HandleEntry& e, uint16_t handle) { return e.handle < handle; });
+}
 
-  for (; it != nv_attr.cend(); ++it) {
+const Service* Database::FindService(uint16_t handle) const {
+  if (!content) return nullptr;
+  if (content->stored.count != 0) Materialize();
+  return gatt::FindService(content->services, handle);
+}
+
+const Characteristic* Database::FindCharacteristic(uint16_t handle) const {
+  if (!content) return nullptr;
+  for (auto it = FindEntry(handle);
+       it != content->index.end() && it->handle == handle; it++) {
+    if (it->descriptor == nullptr) return it->characteristic;
+  }
+  return nullptr;
+}
+
+const Descriptor* Database::FindDescriptor(
+    uint16_t handle, const Characteristic** p_owner) const {
+  if (!content) return nullptr;
+  for (auto it = FindEntry(handle);
+       it != content->index.end() && it->handle == handle; it++) {
+    if (it->descriptor == nullptr) continue;
+    if (p_owner != nullptr) *p_owner = it->characteristic;
+    return it->descriptor;
+  }
+  return nullptr;
+}
+
+std::vector<Service>& Database::MutableServices() {
+  if (!content) {
+    content = std::make_shared<Content>();
+  } else if (content.use_count() > 1 || content->stored.count != 0) {
+    std::shared_ptr<Content> copy = std::make_shared<Content>();
+    copy->services = Services();
+    content = std::move(copy);
+  }
+  /* rebuilt once the services are done with */
+  content->index.clear();
+  content->by_handle.clear();
+  content->indexed = false;
+  return content->services;
+}
+
+bool Database::Deserialize(const StoredAttribute* nv_attr, size_t count,
+                           std::vector<Service>* services) {
+  // clear reallocating
+  std::vector<Service>().swap(*services);
+  const StoredAttribute* it = nv_attr;
+  const StoredAttribute* end = nv_attr + count;
+
+  for (; it != end; ++it) {
     const auto& attr = *it;
     if (attr.type != PRIMARY_SERVICE && attr.type != SECONDARY_SERVICE) break;
-    result.services.emplace_back(
+    services->emplace_back(
         Service{.handle = attr.handle,
-                .end_handle = attr.value.service.end_handle,
+                .uuid = attr.value.service.uuid,
                 .is_primary = (attr.type == PRIMARY_SERVICE),
-                .uuid = attr.value.service.uuid});
+                .end_handle = attr.value.service.end_handle});
   }
 
-  auto current_service_it = result.services.begin();
-  for (; it != nv_attr.cend(); it++) {
+  auto current_service_it = services->begin();
+  for (; it != end; it++) {
     const auto& attr = *it;
 
     // go to the service this attribute belongs to; attributes are stored in
     // order, so iterating just forward is enough
-    while (current_service_it != result.services.end() &&
+    while (current_service_it != services->end() &&
            current_service_it->end_handle < attr.handle) {
       current_service_it++;
     }
 
-    if (current_service_it == result.services.end() ||
+    if (current_service_it == services->end() ||
         !HandleInRange(*current_service_it, attr.handle)) {
       LOG(ERROR) << "Can't find service for attribute with handle: "
                  << loghex(attr.handle);
-      *success = false;
-      return result;
+      return false;
     }
 
     if (attr.type == INCLUDE) {
       Service* included_service =
-          FindService(result.services, attr.value.included_service.handle);
+          gatt::FindService(*services, attr.value.included_service.handle);
       if (!included_service) {
         LOG(ERROR) << __func__ << ": Non-existing included service!";
-        *success = false;
-        return result;
+        return false;
       }
       current_service_it->included_services.push_back(IncludedService{
           .handle = attr.handle,
@@ -169,17 +309,66 @@ Database Database::Deserialize(const std::vector<StoredAttribute>& nv_attr,
     } else if (attr.type == CHARACTERISTIC) {
       current_service_it->characteristics.emplace_back(
           Characteristic{.declaration_handle = attr.handle,
+                         .uuid = attr.value.characteristic.uuid,
                          .value_handle = attr.value.characteristic.value_handle,
-                         .properties = attr.value.characteristic.properties,
-                         .uuid = attr.value.characteristic.uuid});
+                         .properties = attr.value.characteristic.properties});
 
     } else {
+      if (current_service_it->characteristics.empty()) {
+        LOG(ERROR) << __func__ << ": Descriptor outside of a characteristic";
+        return false;
+      }
       current_service_it->characteristics.back().descriptors.emplace_back(
           Descriptor{.handle = attr.handle, .uuid = attr.type});
     }
   }
-  *success = true;
-  return result;
+  return true;
+}
+
+bool Database::IsValid(const StoredAttribute* nv_attr, size_t count) {
+  const StoredAttribute* services = nv_attr;
+  const StoredAttribute* end = nv_attr + count;
+  const StoredAttribute* services_end = services;
+  while (services_end != end && (services_end->type == PRIMARY_SERVICE ||
+                                 services_end->type == SECONDARY_SERVICE)) {
+    services_end++;
+  }
+
+  auto in_range = [](const StoredAttribute& svc, uint16_t handle) {
+    return handle >= svc.handle && handle <= svc.value.service.end_handle;
+  };
+
+  // the checks of Deserialize(), without building anything
+  const StoredAttribute* current_service = services;
+  const StoredAttribute* with_characteristic = nullptr;
+  for (const StoredAttribute* it = services_end; it != end; it++) {
+    while (current_service != services_end &&
+           current_service->value.service.end_handle < it->handle) {
+      current_service++;
+    }
+
+    if (current_service == services_end ||
+        !in_range(*current_service, it->handle)) {
+      return false;
+    }
+
+    if (it->type == INCLUDE) {
+      uint16_t start_handle = it->value.included_service.handle;
+      const StoredAttribute* included = std::lower_bound(
+          services, services_end, start_handle,
+          [](const StoredAttribute& s, uint16_t handle) {
+            return s.value.service.end_handle < handle;
+          });
+      if (included == services_end || !in_range(*included, start_handle)) {
+        return false;
+      }
+    } else if (it->type == CHARACTERISTIC) {
+      with_characteristic = current_service;
+    } else if (with_characteristic != current_service) {
+      return false;
+    }
+  }
+  return true;
 }
 
 }  // namespace gatt
\ No newline at end of file
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <memory>
 #include <set>
 #include <string>
 #include <utility>
@@ -59,6 +60,14 @@ struct StoredAttribute {
   } value;
 };
 
+/* Attributes of a stored database, as Serialize() lays them out, in memory
+ * kept alive by |owner|, e.g. a mapping of the cache file. */
+struct StoredAttributes {
+  const StoredAttribute* attr = nullptr;
+  size_t count = 0;
+  std::shared_ptr<const void> owner;
+};
+
 struct IncludedService;
 struct Characteristic;
 struct Descriptor;
@@ -97,14 +106,28 @@ class DatabaseBuilder;
 class Database {
  public:
   /* Return true if there are no services in this database. */
-  bool IsEmpty() const { return services.empty(); }
+  bool IsEmpty() const {
+    return !content ||
+           (content->stored.count == 0 && content->services.empty());
+  }
 
   /* Clear the GATT database. This method forces relocation to ensure no extra
    * space is used unnecesarly */
-  void Clear() { std::vector<Service>().swap(services); }
+  void Clear() { content.reset(); }
 
   /* Return list of services available in this database */
-  const std::vector<Service>& Services() const { return services; }
+  const std::vector<Service>& Services() const;
+
+  /* Return the service that contains |handle|, or nullptr. */
+  const Service* FindService(uint16_t handle) const;
+
+  /* Return the characteristic whose value has |handle|, or nullptr. */
+  const Characteristic* FindCharacteristic(uint16_t handle) const;
+
+  /* Return the descriptor with |handle|, or nullptr. If |p_owner| is not
+   * null, it is set to the characteristic the descriptor belongs to. */
+  const Descriptor* FindDescriptor(
+      uint16_t handle, const Characteristic** p_owner = nullptr) const;
 
   std::string ToString() const;
 
@@ -113,14 +136,60 @@ class Database {
   static Database Deserialize(const std::vector<gatt::StoredAttribute>& nv_attr,
                               bool* success);
 
+  /* Return a database whose services are built from |attrs| only when they
+   * are first looked up, so a reconnection does not pay for it up front.
+   * |attrs| are checked to describe a valid database right away, the way
+   * Deserialize() would; if they do not, the returned database is empty. */
+  static Database FromStorage(StoredAttributes attrs);
+
   friend class DatabaseBuilder;
 
  private:
-  std::vector<Service> services;
+  /* A characteristic value or descriptor, in the index of a database. */
+  struct HandleEntry {
+    uint16_t handle;
+    const Characteristic* characteristic;
+    const Descriptor* descriptor; /* null for the characteristic value */
+  };
+
+  /* The services of a database. Copies of a database share them, as they do
+   * not change once built, so servers with the same database hold it once. */
+  struct Content {
+    /* Built on the first lookup if |stored| is set. */
+    std::vector<Service> services;
+    StoredAttributes stored;
+
+    /* Characteristic values and descriptors of |services| ordered by handle,
+     * built with them, so lookups by handle don't walk the database. */
+    std::vector<HandleEntry> index;
+    /* Position in |index| plus one of the first entry of each handle from
+     * |first_handle|, or 0 if it has none; left empty, for |index| to be
+     * searched, if the handles are too sparse for it to pay off. */
+    std::vector<uint16_t> by_handle;
+    uint16_t first_handle = 0;
+    bool indexed = false;
+  };
+
+  static bool Deserialize(const StoredAttribute* nv_attr, size_t count,
+                          std::vector<Service>* services);
+  /* Whether Deserialize() would succeed on |nv_attr|. */
+  static bool IsValid(const StoredAttribute* nv_attr, size_t count);
+  void Materialize() const;
+  void BuildIndex() const;
+
+  /* The first entry of the index for |handle|, or one with another handle. */
+  std::vector<HandleEntry>::const_iterator FindEntry(uint16_t handle) const;
+
+  /* The services, for DatabaseBuilder to change; no longer shared with the
+   * copies of this database. */
+  std::vector<Service>& MutableServices();
+
+  std::shared_ptr<Content> content;
 };
 
 /* Find a service that should contain handle. Helper method for internal use
- * inside gatt namespace.*/
+ * inside gatt namespace. |services| must be ordered by handle, as
+ * DatabaseBuilder and Deserialize() keep them.*/
 Service* FindService(std::vector<Service>& services, uint16_t handle);
 
 }  // namespace gatt
@@ -29,26 +29,25 @@ namespace gatt {
 
 void DatabaseBuilder::AddService(uint16_t handle, uint16_t end_handle,
                                  const Uuid& uuid, bool is_primary) {
+  std::vector<Service>& services = database.MutableServices();
+
   // general case optimization - we add services in order
-  if (database.services.empty() ||
-      database.services.back().end_handle < handle) {
-    database.services.emplace_back(Service{.handle = handle,
-                                           .end_handle = end_handle,
-                                           .is_primary = is_primary,
-                                           .uuid = uuid});
+  if (services.empty() || services.back().end_handle < handle) {
+    services.emplace_back(Service{.handle = handle,
+                                  .end_handle = end_handle,
+                                  .is_primary = is_primary,
+                                  .uuid = uuid});
   } else {
-    auto& vec = database.services;
-
     // Find first service whose start handle is bigger than new service handle
     auto it = std::lower_bound(
-        vec.begin(), vec.end(), handle,
+        services.begin(), services.end(), handle,
         [](Service s, uint16_t handle) { return s.end_handle < handle; });
 
     // Insert new service just before it
-    vec.emplace(it, Service{.handle = handle,
-                            .end_handle = end_handle,
-                            .is_primary = is_primary,
-                            .uuid = uuid});
+    services.emplace(it, Service{.handle = handle,
+                                 .end_handle = end_handle,
+                                 .is_primary = is_primary,
+                                 .uuid = uuid});
   }
 
   services_to_discover.insert({handle, end_handle});
@@ -57,7 +56,7 @@ void DatabaseBuilder::AddService(uint16_t handle, uint16_t end_handle,
 void DatabaseBuilder::AddIncludedService(uint16_t handle, const Uuid& uuid,
                                          uint16_t start_handle,
                                          uint16_t end_handle) {
-  Service* service = FindService(database.services, handle);
+  Service* service = FindService(database.MutableServices(), handle);
   if (!service) {
     LOG(ERROR) << "Illegal action to add to non-existing service!";
     return;
@@ -65,7 +64,7 @@ void DatabaseBuilder::AddIncludedService(uint16_t handle, const Uuid& uuid,
 
   /* We discover all Primary Services first. If included service was not seen
    * before, it must be a Secondary Service */
-  if (!FindService(database.services, start_handle)) {
+  if (!FindService(database.MutableServices(), start_handle)) {
     AddService(start_handle, end_handle, uuid, false /* not primary */);
   }
 
@@ -79,7 +78,7 @@ void DatabaseBuilder::AddIncludedService(uint16_t handle, const Uuid& uuid,
 
 void DatabaseBuilder::AddCharacteristic(uint16_t handle, uint16_t value_handle,
                                         const Uuid& uuid, uint8_t properties) {
-  Service* service = FindService(database.services, handle);
+  Service* service = FindService(database.MutableServices(), handle);
   if (!service) {
     LOG(ERROR) << "Illegal action to add to non-existing service!";
     return;
@@ -99,7 +98,7 @@ void DatabaseBuilder::AddCharacteristic(uint16_t handle, uint16_t value_handle,
 }
 
 void DatabaseBuilder::AddDescriptor(uint16_t handle, const Uuid& uuid) {
-  Service* service = FindService(database.services, handle);
+  Service* service = FindService(database.MutableServices(), handle);
   if (!service) {
     LOG(ERROR) << "Illegal action to add to non-existing service!";
     return;
@@ -143,7 +142,8 @@ DatabaseBuilder::CurrentlyExploredService() {
 }
 
 std::pair<uint16_t, uint16_t> DatabaseBuilder::NextDescriptorRangeToExplore() {
-  Service* service = FindService(database.services, pending_service.first);
+  Service* service =
+      FindService(database.MutableServices(), pending_service.first);
   if (!service || service->characteristics.empty()) {
     return {HANDLE_MAX, HANDLE_MAX};
   }
@@ -175,11 +175,12 @@ std::pair<uint16_t, uint16_t> DatabaseBuilder::NextDescriptorRangeToExplore() {
   return {HANDLE_MAX, HANDLE_MAX};
 }
 
-bool DatabaseBuilder::InProgress() const { return !database.services.empty(); }
+bool DatabaseBuilder::InProgress() const { return !database.IsEmpty(); }
 
 Database DatabaseBuilder::Build() {
   Database tmp = database;
   database.Clear();
+  if (tmp.content) tmp.BuildIndex();
   return tmp;
 }
 
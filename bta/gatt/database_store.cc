@@ -0,0 +1,552 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "database_store.h"
+#include "stack/include/gattdefs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/logging.h>
+#include <algorithm>
+
+using bluetooth::Uuid;
+
+namespace gatt {
+
+namespace {
+const Uuid PRIMARY_SERVICE = Uuid::From16Bit(GATT_UUID_PRI_SERVICE);
+const Uuid SECONDARY_SERVICE = Uuid::From16Bit(GATT_UUID_SEC_SERVICE);
+const Uuid INCLUDE = Uuid::From16Bit(GATT_UUID_INCLUDE_SERVICE);
+const Uuid CHARACTERISTIC = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+
+/* The file is a header, one record per server ordered by address, one blob
+ * per distinct database, then the attributes of each blob as StoredAttribute
+ * arrays. Blobs with a Database Hash come first, ordered by it. */
+constexpr uint32_t STORE_MAGIC = 0x43545447; /* "GTTC" */
+constexpr uint16_t STORE_VERSION = 2;
+
+struct FileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t attr_size;
+  uint32_t num_records;
+  uint32_t num_blobs;
+};
+
+struct FileRecord {
+  uint8_t address[RawAddress::kLength];
+  uint16_t reserved;
+  uint32_t blob; /* index of the blob of the database */
+};
+
+constexpr uint32_t BLOB_HAS_DB_HASH = 0x01;
+
+struct FileBlob {
+  uint8_t db_hash[OCTET16_LEN];
+  uint32_t flags;
+  uint32_t offset; /* of the attributes, from the start of the file */
+  uint32_t num_attr;
+  uint32_t reserved;
+  uint64_t hash;
+};
+
+constexpr size_t ATTR_ALIGN = 8;
+
+size_t align(size_t offset) {
+  return (offset + ATTR_ALIGN - 1) & ~(ATTR_ALIGN - 1);
+}
+
+/* Offset of the blobs and of the attributes in a file of |num_records| and
+ * |num_blobs|. */
+size_t blobs_offset(size_t num_records) {
+  return align(sizeof(FileHeader) + num_records * sizeof(FileRecord));
+}
+
+size_t attributes_offset(size_t num_records, size_t num_blobs) {
+  return blobs_offset(num_records) + num_blobs * sizeof(FileBlob);
+}
+
+/* Orders the blobs with a Database Hash first, by it. */
+bool blob_less(bool a_has_db_hash, const uint8_t* a_db_hash,
+               bool b_has_db_hash, const uint8_t* b_db_hash) {
+  if (a_has_db_hash != b_has_db_hash) return a_has_db_hash;
+  return a_has_db_hash && memcmp(a_db_hash, b_db_hash, OCTET16_LEN) < 0;
+}
+
+/* A UUID as two words, so attribute types compare inline. */
+struct UuidWords {
+  explicit UuidWords(const Uuid& uuid) {
+    memcpy(w, uuid.To128BitBE().data(), sizeof(w));
+  }
+  bool operator==(const UuidWords& rhs) const {
+    return w[0] == rhs.w[0] && w[1] == rhs.w[1];
+  }
+  uint64_t w[2];
+};
+
+/* Mixes in a word at a time; the attributes of a database are hashed each
+ * time it is loaded, so this has to be cheap next to a read. */
+class Hasher {
+ public:
+  void Add(uint64_t value) {
+    hash_ = (hash_ ^ value) * 0x9e3779b97f4a7c15ULL;
+    hash_ ^= hash_ >> 32;
+  }
+  void Add(const UuidWords& uuid) {
+    Add(uuid.w[0]);
+    Add(uuid.w[1]);
+  }
+  void Add(const Uuid& uuid) { Add(UuidWords(uuid)); }
+  uint64_t hash() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+/* |attr| with only the fields Serialize() fills in and the rest zeroed, so
+ * equal databases are equal byte for byte. */
+StoredAttribute canonical(const StoredAttribute& attr) {
+  StoredAttribute result;
+  memset(&result, 0, sizeof(result));
+  result.handle = attr.handle;
+  result.type = attr.type;
+  if (attr.type == PRIMARY_SERVICE || attr.type == SECONDARY_SERVICE) {
+    result.value.service.uuid = attr.value.service.uuid;
+    result.value.service.end_handle = attr.value.service.end_handle;
+  } else if (attr.type == INCLUDE) {
+    result.value.included_service.handle = attr.value.included_service.handle;
+    result.value.included_service.end_handle =
+        attr.value.included_service.end_handle;
+    result.value.included_service.uuid = attr.value.included_service.uuid;
+  } else if (attr.type == CHARACTERISTIC) {
+    result.value.characteristic.properties =
+        attr.value.characteristic.properties;
+    result.value.characteristic.value_handle =
+        attr.value.characteristic.value_handle;
+    result.value.characteristic.uuid = attr.value.characteristic.uuid;
+  }
+  return result;
+}
+}  // namespace
+
+uint64_t AttributesHash(const StoredAttribute* attr, size_t count) {
+  static const UuidWords primary_service(PRIMARY_SERVICE);
+  static const UuidWords secondary_service(SECONDARY_SERVICE);
+  static const UuidWords include(INCLUDE);
+  static const UuidWords characteristic(CHARACTERISTIC);
+
+  Hasher hasher;
+  for (const StoredAttribute* it = attr; it != attr + count; it++) {
+    UuidWords type(it->type);
+    hasher.Add(it->handle);
+    hasher.Add(type);
+    if (type == primary_service || type == secondary_service) {
+      hasher.Add(it->value.service.uuid);
+      hasher.Add(it->value.service.end_handle);
+    } else if (type == include) {
+      hasher.Add((uint64_t)it->value.included_service.handle << 16 |
+                 it->value.included_service.end_handle);
+      hasher.Add(it->value.included_service.uuid);
+    } else if (type == characteristic) {
+      hasher.Add((uint64_t)it->value.characteristic.properties << 16 |
+                 it->value.characteristic.value_handle);
+      hasher.Add(it->value.characteristic.uuid);
+    }
+  }
+  return hasher.hash();
+}
+
+struct DatabaseStore::Mapping {
+  ~Mapping() { munmap(const_cast<uint8_t*>(data), size); }
+
+  /* Maps |path| if it holds a store, or returns null. */
+  static std::shared_ptr<const Mapping> Map(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno != ENOENT)
+        LOG(ERROR) << __func__ << ": can't open " << path << ": "
+                   << strerror(errno);
+      return nullptr;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FileHeader))
+      data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      LOG(ERROR) << __func__ << ": can't map " << path;
+      return nullptr;
+    }
+
+    std::shared_ptr<Mapping> mapping(new Mapping());
+    mapping->data = static_cast<const uint8_t*>(data);
+    mapping->size = st.st_size;
+
+    const FileHeader* header =
+        reinterpret_cast<const FileHeader*>(mapping->data);
+    if (header->magic != STORE_MAGIC || header->version != STORE_VERSION ||
+        header->attr_size != sizeof(StoredAttribute) ||
+        header->num_records > mapping->size / sizeof(FileRecord) ||
+        header->num_blobs > mapping->size / sizeof(FileBlob) ||
+        attributes_offset(header->num_records, header->num_blobs) >
+            mapping->size) {
+      LOG(ERROR) << __func__ << ": " << path << " is not a valid GATT cache";
+      return nullptr;
+    }
+    mapping->records =
+        reinterpret_cast<const FileRecord*>(mapping->data + sizeof(FileHeader));
+    mapping->num_records = header->num_records;
+    mapping->blobs = reinterpret_cast<const FileBlob*>(
+        mapping->data + blobs_offset(header->num_records));
+    mapping->num_blobs = header->num_blobs;
+    return mapping;
+  }
+
+  /* The blob of the record of |address|, or null. */
+  const FileBlob* Find(const RawAddress& address) const {
+    const FileRecord* end = records + num_records;
+    const FileRecord* record = std::lower_bound(
+        records, end, address, [](const FileRecord& r, const RawAddress& a) {
+          return memcmp(r.address, a.address, RawAddress::kLength) < 0;
+        });
+    if (record == end ||
+        memcmp(record->address, address.address, RawAddress::kLength) != 0 ||
+        record->blob >= num_blobs)
+      return nullptr;
+    return &blobs[record->blob];
+  }
+
+  /* The blob with |db_hash| as Database Hash, or null. */
+  const FileBlob* FindByDatabaseHash(const Octet16& db_hash) const {
+    const FileBlob* end = blobs + num_blobs;
+    const FileBlob* blob = std::lower_bound(
+        blobs, end, db_hash, [](const FileBlob& b, const Octet16& h) {
+          return blob_less(b.flags & BLOB_HAS_DB_HASH, b.db_hash, true,
+                           h.data());
+        });
+    if (blob == end || !(blob->flags & BLOB_HAS_DB_HASH) ||
+        memcmp(blob->db_hash, db_hash.data(), OCTET16_LEN) != 0)
+      return nullptr;
+    return blob;
+  }
+
+  /* The attributes of |blob|, or null if they are not within the file. */
+  const StoredAttribute* Attributes(const FileBlob& blob) const {
+    if (blob.offset < attributes_offset(num_records, num_blobs) ||
+        blob.offset % ATTR_ALIGN != 0 || blob.offset > size ||
+        blob.num_attr > (size - blob.offset) / sizeof(StoredAttribute))
+      return nullptr;
+    return reinterpret_cast<const StoredAttribute*>(data + blob.offset);
+  }
+
+  /* Sets |*p_attr| to the attributes of |blob| if they are valid. */
+  bool Get(const FileBlob& blob, std::shared_ptr<const Mapping> self,
+           StoredAttributes* p_attr) const {
+    const StoredAttribute* attr = Attributes(blob);
+    if (attr == nullptr || blob.num_attr == 0 ||
+        AttributesHash(attr, blob.num_attr) != blob.hash)
+      return false;
+    p_attr->attr = attr;
+    p_attr->count = blob.num_attr;
+    p_attr->owner = std::move(self);
+    return true;
+  }
+
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  const FileRecord* records = nullptr;
+  size_t num_records = 0;
+  const FileBlob* blobs = nullptr;
+  size_t num_blobs = 0;
+};
+
+DatabaseStore::DatabaseStore(std::string path) : path_(std::move(path)) {}
+
+DatabaseStore::~DatabaseStore() = default;
+
+bool DatabaseStore::Open() {
+  std::shared_ptr<const Mapping> mapping = Mapping::Map(path_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  mapping_ = mapping;
+  return mapping_ != nullptr;
+}
+
+bool DatabaseStore::Find(const RawAddress& address, StoredAttributes* p_attr,
+                         bool* p_has_db_hash, Octet16* p_db_hash) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = pending_.find(address);
+  if (it != pending_.end()) {
+    if (it->second == nullptr) return false;
+    p_attr->attr = it->second->attr.data();
+    p_attr->count = it->second->attr.size();
+    p_attr->owner = it->second;
+    if (p_has_db_hash != nullptr) {
+      *p_has_db_hash = it->second->has_db_hash;
+      if (it->second->has_db_hash) *p_db_hash = it->second->db_hash;
+    }
+    return true;
+  }
+
+  if (mapping_ == nullptr) return false;
+  const FileBlob* blob = mapping_->Find(address);
+  if (blob == nullptr) return false;
+
+  if (!mapping_->Get(*blob, mapping_, p_attr)) {
+    LOG(ERROR) << __func__ << ": corrupted GATT cache for " << address;
+    return false;
+  }
+  if (p_has_db_hash != nullptr) {
+    *p_has_db_hash = blob->flags & BLOB_HAS_DB_HASH;
+    if (*p_has_db_hash)
+      memcpy(p_db_hash->data(), blob->db_hash, OCTET16_LEN);
+  }
+  return true;
+}
+
+bool DatabaseStore::FindByDatabaseHash(const Octet16& db_hash,
+                                       StoredAttributes* p_attr) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (const auto& change : pending_) {
+    const Record* record = change.second.get();
+    if (record == nullptr || !record->has_db_hash || record->db_hash != db_hash)
+      continue;
+    p_attr->attr = record->attr.data();
+    p_attr->count = record->attr.size();
+    p_attr->owner = change.second;
+    return true;
+  }
+
+  /* A database is what its hash says whichever servers it is stored for, so
+   * one all of them have been dropped for is still good. */
+  if (mapping_ == nullptr) return false;
+  const FileBlob* blob = mapping_->FindByDatabaseHash(db_hash);
+  if (blob == nullptr) return false;
+  if (!mapping_->Get(*blob, mapping_, p_attr)) {
+    LOG(ERROR) << __func__ << ": corrupted GATT cache";
+    return false;
+  }
+  return true;
+}
+
+bool DatabaseStore::Put(const RawAddress& address,
+                        std::vector<StoredAttribute> attr,
+                        const Octet16* p_db_hash) {
+  if (attr.empty() || attr.size() > UINT16_MAX) return Remove(address);
+
+  std::shared_ptr<Record> record(new Record());
+  for (StoredAttribute& it : attr) it = canonical(it);
+  record->hash = AttributesHash(attr.data(), attr.size());
+  record->has_db_hash = p_db_hash != nullptr;
+  if (p_db_hash != nullptr) record->db_hash = *p_db_hash;
+  record->attr = std::move(attr);
+  return Change(address, std::move(record));
+}
+
+bool DatabaseStore::Remove(const RawAddress& address) {
+  return Change(address, nullptr);
+}
+
+bool DatabaseStore::Change(const RawAddress& address,
+                           std::shared_ptr<const Record> record) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_[address] = std::move(record);
+  if (flush_scheduled_) return false;
+  flush_scheduled_ = true;
+  return true;
+}
+
+bool DatabaseStore::Flush() {
+  std::map<RawAddress, std::shared_ptr<const Record>> changes;
+  std::shared_ptr<const Mapping> mapping;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    changes = pending_;
+    mapping = mapping_;
+    flush_scheduled_ = false;
+  }
+  if (changes.empty()) return true;
+
+  /* What goes in the new file: the changed databases, and the rest as they
+   * are in the current file. */
+  struct Blob {
+    const StoredAttribute* attr;
+    size_t count;
+    uint64_t hash;
+    bool has_db_hash;
+    const uint8_t* db_hash;
+  };
+  std::map<RawAddress, Blob> entries;
+  if (mapping != nullptr) {
+    for (size_t i = 0; i < mapping->num_records; i++) {
+      const FileRecord& record = mapping->records[i];
+      RawAddress address;
+      memcpy(address.address, record.address, RawAddress::kLength);
+      if (record.blob >= mapping->num_blobs || changes.count(address) != 0)
+        continue;
+      const FileBlob& blob = mapping->blobs[record.blob];
+      const StoredAttribute* attr = mapping->Attributes(blob);
+      if (attr == nullptr) continue;
+      entries[address] = {attr, blob.num_attr, blob.hash,
+                          (blob.flags & BLOB_HAS_DB_HASH) != 0, blob.db_hash};
+    }
+  }
+  for (const auto& change : changes) {
+    const Record* record = change.second.get();
+    if (record == nullptr) continue;
+    entries[change.first] = {record->attr.data(), record->attr.size(),
+                             record->hash, record->has_db_hash,
+                             record->db_hash.data()};
+  }
+
+  /* Each distinct database is written once, however many servers have it. */
+  std::vector<Blob> blobs;
+  std::vector<size_t> entry_blob;
+  std::multimap<uint64_t, size_t> blobs_by_hash;
+  for (const auto& entry : entries) {
+    const Blob& e = entry.second;
+    size_t index = blobs.size();
+    auto range = blobs_by_hash.equal_range(e.hash);
+    for (auto it = range.first; it != range.second; it++) {
+      const Blob& b = blobs[it->second];
+      if (b.count == e.count && b.has_db_hash == e.has_db_hash &&
+          (!e.has_db_hash || memcmp(b.db_hash, e.db_hash, OCTET16_LEN) == 0) &&
+          memcmp(b.attr, e.attr, e.count * sizeof(StoredAttribute)) == 0) {
+        index = it->second;
+        break;
+      }
+    }
+    if (index == blobs.size()) {
+      blobs.push_back(e);
+      blobs_by_hash.emplace(e.hash, index);
+    }
+    entry_blob.push_back(index);
+  }
+
+  std::vector<size_t> order(blobs.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&blobs](size_t a, size_t b) {
+    return blob_less(blobs[a].has_db_hash, blobs[a].db_hash,
+                     blobs[b].has_db_hash, blobs[b].db_hash);
+  });
+  std::vector<uint32_t> position(blobs.size());
+  for (size_t i = 0; i < order.size(); i++) position[order[i]] = i;
+
+  size_t size = attributes_offset(entries.size(), blobs.size());
+  for (const Blob& blob : blobs)
+    size += align(blob.count * sizeof(StoredAttribute));
+
+  std::vector<uint8_t> image(size);
+  FileHeader header = {STORE_MAGIC, STORE_VERSION, sizeof(StoredAttribute),
+                       (uint32_t)entries.size(), (uint32_t)blobs.size()};
+  memcpy(image.data(), &header, sizeof(header));
+
+  size_t record_offset = sizeof(FileHeader);
+  size_t i = 0;
+  for (const auto& entry : entries) {
+    FileRecord record = {};
+    memcpy(record.address, entry.first.address, RawAddress::kLength);
+    record.blob = position[entry_blob[i++]];
+    memcpy(&image[record_offset], &record, sizeof(record));
+    record_offset += sizeof(record);
+  }
+
+  size_t blob_offset = blobs_offset(entries.size());
+  size_t attr_offset = attributes_offset(entries.size(), blobs.size());
+  for (size_t index : order) {
+    const Blob& b = blobs[index];
+    FileBlob blob = {};
+    if (b.has_db_hash) {
+      memcpy(blob.db_hash, b.db_hash, OCTET16_LEN);
+      blob.flags = BLOB_HAS_DB_HASH;
+    }
+    blob.offset = attr_offset;
+    blob.num_attr = b.count;
+    blob.hash = b.hash;
+    memcpy(&image[blob_offset], &blob, sizeof(blob));
+    blob_offset += sizeof(blob);
+
+    size_t len = b.count * sizeof(StoredAttribute);
+    memcpy(&image[attr_offset], b.attr, len);
+    attr_offset += align(len);
+  }
+
+  if (!Write(image)) return false;
+
+  std::shared_ptr<const Mapping> written = Mapping::Map(path_);
+  if (written == nullptr) return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  mapping_ = written;
+  /* Changes made while writing stay for the next flush. */
+  for (const auto& change : changes) {
+    auto it = pending_.find(change.first);
+    if (it != pending_.end() && it->second == change.second) pending_.erase(it);
+  }
+  return true;
+}
+
+bool DatabaseStore::Write(const std::vector<uint8_t>& image) const {
+  /* Written aside and renamed over the store, so the file mapped meanwhile
+   * does not change and an interrupted write leaves the old one. */
+  std::string temp_path = path_ + ".new";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+  if (fd < 0) {
+    LOG(ERROR) << __func__ << ": can't open " << temp_path << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  size_t written = 0;
+  while (written < image.size()) {
+    ssize_t ret = write(fd, image.data() + written, image.size() - written);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) {
+      LOG(ERROR) << __func__ << ": can't write " << temp_path << ": "
+                 << strerror(errno);
+      close(fd);
+      unlink(temp_path.c_str());
+      return false;
+    }
+    written += ret;
+  }
+
+  if (fsync(fd) < 0) {
+    LOG(WARNING) << __func__ << ": can't fsync " << temp_path << ": "
+                 << strerror(errno);
+  }
+  close(fd);
+
+  if (rename(temp_path.c_str(), path_.c_str()) < 0) {
+    LOG(ERROR) << __func__ << ": can't replace " << path_ << ": "
+               << strerror(errno);
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace gatt
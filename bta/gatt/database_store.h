@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gatt/database.h"
+#include "raw_address.h"
+#include "stack/include/bt_types.h"
+
+namespace gatt {
+
+/* Hash of the attributes in |attr|, over the fields Serialize() fills in. Not
+ * to be confused with the Database Hash a server exposes. */
+uint64_t AttributesHash(const StoredAttribute* attr, size_t count);
+
+/* The GATT client cache of every server, in a single file that is memory
+ * mapped, so loading the database of a server on reconnection is a binary
+ * search with no read or copy. Servers with the same database share one copy
+ * of it, found by the Database Hash characteristic of the server if it has
+ * one (Core 5.1, Vol 3, Part G, 7.3). Each copy is recorded with its
+ * AttributesHash(), which is checked before it is handed out.
+ *
+ * Changes are kept in memory until Flush() writes out a new file and maps it,
+ * so it can be left to an I/O thread and a burst of changes costs one write.
+ * Databases handed out keep the mapping they point into alive. Find(), Put()
+ * and Remove() may run on one thread while Flush() runs on another. */
+class DatabaseStore {
+ public:
+  explicit DatabaseStore(std::string path);
+  ~DatabaseStore();
+
+  DatabaseStore(const DatabaseStore&) = delete;
+  DatabaseStore& operator=(const DatabaseStore&) = delete;
+
+  /* Maps the file. Returns false, leaving the store empty, if there is no
+   * valid file. */
+  bool Open();
+
+  /* Sets |*p_attr| to the database stored for |address| and returns true, or
+   * returns false if there is none. If |p_has_db_hash| is not null, it is set
+   * to whether the database was stored with a Database Hash, and if so
+   * |*p_db_hash| to it. */
+  bool Find(const RawAddress& address, StoredAttributes* p_attr,
+            bool* p_has_db_hash = nullptr, Octet16* p_db_hash = nullptr) const;
+
+  /* Sets |*p_attr| to a database stored with |db_hash| as Database Hash, for
+   * any server, and returns true; returns false if there is none. */
+  bool FindByDatabaseHash(const Octet16& db_hash,
+                          StoredAttributes* p_attr) const;
+
+  /* Stores |attr| for |address|, replacing what was there, with the Database
+   * Hash |*p_db_hash| of the server if not null. Returns true if a Flush() has
+   * to be scheduled for it. */
+  bool Put(const RawAddress& address, std::vector<StoredAttribute> attr,
+           const Octet16* p_db_hash = nullptr);
+
+  /* Drops the database of |address|. Returns true if a Flush() has to be
+   * scheduled for it. */
+  bool Remove(const RawAddress& address);
+
+  /* Writes the store with the changes made so far to a new file, which then
+   * replaces the old one and is mapped. Blocks on I/O. Returns false on error,
+   * in which case the changes are kept for the next Flush(). */
+  bool Flush();
+
+ private:
+  struct Record {
+    uint64_t hash;
+    bool has_db_hash;
+    Octet16 db_hash;
+    std::vector<StoredAttribute> attr;
+  };
+  struct Mapping;
+
+  bool Change(const RawAddress& address, std::shared_ptr<const Record> record);
+  bool Write(const std::vector<uint8_t>& image) const;
+
+  const std::string path_;
+
+  mutable std::mutex mutex_;  // protects the following.
+  std::shared_ptr<const Mapping> mapping_;
+  /* Changes not written out yet; a null record is a removal. */
+  std::map<RawAddress, std::shared_ptr<const Record>> pending_;
+  bool flush_scheduled_ = false;
+};
+
+}  // namespace gatt
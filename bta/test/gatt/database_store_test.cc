@@ -0,0 +1,289 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gatt/database.h"
+#include "gatt/database_builder.h"
+#include "gatt/database_store.h"
+#include "stack/include/gattdefs.h"
+
+using bluetooth::Uuid;
+
+namespace gatt {
+
+namespace {
+const RawAddress PEER_1({0x00, 0x11, 0x22, 0x33, 0x44, 0x55});
+const RawAddress PEER_2({0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb});
+const RawAddress PEER_3({0xcc, 0xdd, 0xee, 0xff, 0x00, 0x11});
+
+const Octet16 DB_HASH_1{0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                        0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10};
+const Octet16 DB_HASH_2{0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87,
+                        0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f};
+
+Uuid SERVICE_1_UUID = Uuid::FromString("1800");
+Uuid SERVICE_2_UUID = Uuid::FromString("180f");
+Uuid CHAR_UUID = Uuid::FromString("2a19");
+Uuid DESC_UUID = Uuid::FromString("2902");
+
+/* A database with |num_services| services of a characteristic and a CCCD. */
+Database make_database(uint16_t num_services) {
+  DatabaseBuilder builder;
+  for (uint16_t i = 0; i < num_services; i++) {
+    uint16_t handle = 1 + i * 4;
+    builder.AddService(handle, handle + 3,
+                       i % 2 ? SERVICE_2_UUID : SERVICE_1_UUID, true);
+    builder.AddCharacteristic(handle + 1, handle + 2, CHAR_UUID, 0x12);
+    builder.AddDescriptor(handle + 3, DESC_UUID);
+  }
+  return builder.Build();
+}
+
+std::vector<uint16_t> service_handles(const Database& db) {
+  std::vector<uint16_t> handles;
+  for (const Service& service : db.Services()) {
+    handles.push_back(service.handle);
+  }
+  return handles;
+}
+
+std::vector<StoredAttribute> stored(const DatabaseStore& store,
+                                    const RawAddress& address) {
+  StoredAttributes attr;
+  if (!store.Find(address, &attr)) return std::vector<StoredAttribute>();
+  return Database::FromStorage(attr).Serialize();
+}
+
+class GattDatabaseStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+#if defined(OS_GENERIC)
+    tmp_dir_ = "/tmp/btgcXXXXXX";
+#else
+    tmp_dir_ = "/data/local/tmp/btgcXXXXXX";
+#endif  // !defined(OS_GENERIC)
+    ASSERT_NE(nullptr, mkdtemp(&tmp_dir_[0]));
+    path_ = tmp_dir_ + "/gatt_cache";
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    rmdir(tmp_dir_.c_str());
+  }
+
+  std::string tmp_dir_;
+  std::string path_;
+};
+
+}  // namespace
+
+bool operator==(const StoredAttribute& a, const StoredAttribute& b) {
+  return AttributesHash(&a, 1) == AttributesHash(&b, 1);
+}
+
+TEST_F(GattDatabaseStoreTest, stores_until_flushed_and_reopened) {
+  DatabaseStore store(path_);
+  EXPECT_FALSE(store.Open());
+
+  std::vector<StoredAttribute> db_1 = make_database(3).Serialize();
+  std::vector<StoredAttribute> db_2 = make_database(8).Serialize();
+
+  // Only the first change schedules a flush
+  EXPECT_TRUE(store.Put(PEER_1, db_1));
+  EXPECT_FALSE(store.Put(PEER_2, db_2));
+  EXPECT_EQ(db_1, stored(store, PEER_1));
+
+  ASSERT_TRUE(store.Flush());
+  EXPECT_EQ(db_1, stored(store, PEER_1));
+  EXPECT_EQ(db_2, stored(store, PEER_2));
+
+  DatabaseStore reopened(path_);
+  ASSERT_TRUE(reopened.Open());
+  bool has_db_hash = true;
+  StoredAttributes attr;
+  ASSERT_TRUE(reopened.Find(PEER_2, &attr, &has_db_hash));
+  EXPECT_FALSE(has_db_hash);
+  EXPECT_EQ(db_2, stored(reopened, PEER_2));
+  EXPECT_EQ(db_1, stored(reopened, PEER_1));
+}
+
+TEST_F(GattDatabaseStoreTest, removes_and_replaces) {
+  DatabaseStore store(path_);
+  store.Put(PEER_1, make_database(3).Serialize());
+  store.Put(PEER_2, make_database(4).Serialize());
+  ASSERT_TRUE(store.Flush());
+
+  EXPECT_TRUE(store.Remove(PEER_1));
+  EXPECT_FALSE(store.Put(PEER_2, make_database(6).Serialize()));
+  StoredAttributes attr;
+  EXPECT_FALSE(store.Find(PEER_1, &attr));
+  ASSERT_TRUE(store.Flush());
+
+  DatabaseStore reopened(path_);
+  ASSERT_TRUE(reopened.Open());
+  EXPECT_FALSE(reopened.Find(PEER_1, &attr));
+  EXPECT_EQ(make_database(6).Serialize(), stored(reopened, PEER_2));
+}
+
+TEST_F(GattDatabaseStoreTest, builds_services_on_first_lookup) {
+  DatabaseStore store(path_);
+  store.Put(PEER_1, make_database(5).Serialize());
+  ASSERT_TRUE(store.Flush());
+
+  StoredAttributes attr;
+  ASSERT_TRUE(store.Find(PEER_1, &attr));
+  Database db = Database::FromStorage(attr);
+  EXPECT_FALSE(db.IsEmpty());
+  EXPECT_EQ(std::vector<uint16_t>({1, 5, 9, 13, 17}), service_handles(db));
+  EXPECT_EQ(make_database(5).ToString(), db.ToString());
+
+  // The database outlives the mapping the store replaces
+  store.Put(PEER_1, make_database(2).Serialize());
+  ASSERT_TRUE(store.Flush());
+  Database old_db = Database::FromStorage(attr);
+  attr = StoredAttributes();
+  EXPECT_EQ(5U, old_db.Services().size());
+
+  db.Clear();
+  EXPECT_TRUE(db.IsEmpty());
+}
+
+TEST_F(GattDatabaseStoreTest, shares_databases_by_database_hash) {
+  DatabaseStore store(path_);
+  store.Put(PEER_1, make_database(3).Serialize(), &DB_HASH_1);
+  store.Put(PEER_3, make_database(5).Serialize());
+
+  // A new server of the same model finds the database before it is written
+  StoredAttributes attr;
+  ASSERT_TRUE(store.FindByDatabaseHash(DB_HASH_1, &attr));
+  EXPECT_EQ(make_database(3).Serialize(),
+            Database::FromStorage(attr).Serialize());
+  EXPECT_FALSE(store.FindByDatabaseHash(DB_HASH_2, &attr));
+
+  store.Put(PEER_2, Database::FromStorage(attr).Serialize(), &DB_HASH_1);
+  ASSERT_TRUE(store.Flush());
+
+  DatabaseStore reopened(path_);
+  ASSERT_TRUE(reopened.Open());
+  ASSERT_TRUE(reopened.FindByDatabaseHash(DB_HASH_1, &attr));
+  EXPECT_EQ(make_database(3).Serialize(),
+            Database::FromStorage(attr).Serialize());
+
+  // Both servers point to a single copy
+  StoredAttributes attr_1, attr_2;
+  bool has_db_hash = false;
+  Octet16 db_hash = {};
+  ASSERT_TRUE(reopened.Find(PEER_1, &attr_1));
+  ASSERT_TRUE(reopened.Find(PEER_2, &attr_2, &has_db_hash, &db_hash));
+  EXPECT_EQ(attr_1.attr, attr_2.attr);
+  EXPECT_EQ(attr.attr, attr_2.attr);
+  EXPECT_TRUE(has_db_hash);
+  EXPECT_EQ(DB_HASH_1, db_hash);
+  ASSERT_TRUE(reopened.Find(PEER_3, &attr, &has_db_hash));
+  EXPECT_FALSE(has_db_hash);
+
+  // The database is dropped with the last server that has it
+  reopened.Remove(PEER_1);
+  reopened.Remove(PEER_2);
+  ASSERT_TRUE(reopened.Flush());
+  EXPECT_FALSE(reopened.FindByDatabaseHash(DB_HASH_1, &attr));
+  EXPECT_EQ(make_database(5).Serialize(), stored(reopened, PEER_3));
+}
+
+TEST_F(GattDatabaseStoreTest, does_not_load_invalid_database) {
+  // Services first, then the characteristic and CCCD of each
+  std::vector<StoredAttribute> valid = make_database(3).Serialize();
+  ASSERT_EQ(9U, valid.size());
+
+  std::vector<StoredAttribute> no_characteristic = valid;
+  no_characteristic.erase(no_characteristic.begin() + 3);
+
+  std::vector<StoredAttribute> outside_services = valid;
+  outside_services.back().handle = 0x0100;
+
+  std::vector<StoredAttribute> missing_include = valid;
+  missing_include[3].type = Uuid::From16Bit(GATT_UUID_INCLUDE_SERVICE);
+  missing_include[3].value.included_service.handle = 0x0100;
+
+  DatabaseStore store(path_);
+  store.Put(PEER_1, valid);
+  store.Put(PEER_2, no_characteristic);
+  store.Put(PEER_3, outside_services);
+  ASSERT_TRUE(store.Flush());
+
+  StoredAttributes attr;
+  ASSERT_TRUE(store.Find(PEER_1, &attr));
+  EXPECT_FALSE(Database::FromStorage(attr).IsEmpty());
+  ASSERT_TRUE(store.Find(PEER_2, &attr));
+  EXPECT_TRUE(Database::FromStorage(attr).IsEmpty());
+  ASSERT_TRUE(store.Find(PEER_3, &attr));
+  EXPECT_TRUE(Database::FromStorage(attr).IsEmpty());
+
+  store.Put(PEER_3, missing_include);
+  ASSERT_TRUE(store.Flush());
+  ASSERT_TRUE(store.Find(PEER_3, &attr));
+  EXPECT_TRUE(Database::FromStorage(attr).IsEmpty());
+}
+
+TEST_F(GattDatabaseStoreTest, copies_share_services) {
+  DatabaseStore store(path_);
+  store.Put(PEER_1, make_database(4).Serialize());
+  StoredAttributes attr;
+  ASSERT_TRUE(store.Find(PEER_1, &attr));
+
+  Database db = Database::FromStorage(attr);
+  Database copy = db;
+  EXPECT_EQ(4U, copy.Services().size());
+  EXPECT_EQ(&db.Services(), &copy.Services());
+
+  copy.Clear();
+  EXPECT_TRUE(copy.IsEmpty());
+  EXPECT_EQ(4U, db.Services().size());
+}
+
+TEST_F(GattDatabaseStoreTest, rejects_corrupted_database) {
+  DatabaseStore store(path_);
+  store.Put(PEER_1, make_database(3).Serialize());
+  store.Put(PEER_2, make_database(4).Serialize());
+  ASSERT_TRUE(store.Flush());
+
+  // Overwrite the end of the file, where the last attribute of PEER_2 is
+  int fd = open(path_.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> garbage(sizeof(StoredAttribute), 0xff);
+  off_t offset = lseek(fd, 0, SEEK_END) - garbage.size();
+  ASSERT_EQ((ssize_t)garbage.size(),
+            pwrite(fd, garbage.data(), garbage.size(), offset));
+  close(fd);
+
+  DatabaseStore reopened(path_);
+  ASSERT_TRUE(reopened.Open());
+  StoredAttributes attr;
+  EXPECT_TRUE(reopened.Find(PEER_1, &attr));
+  EXPECT_FALSE(reopened.Find(PEER_2, &attr));
+}
+
+}  // namespace gatt
@@ -204,4 +204,91 @@ TEST(GattCacheTest, stored_attribute_to_binary_descriptor_test) {
   // LOG(ERROR) << " " << base::HexEncode(&attr, len);
   EXPECT_EQ(memcmp(binary_form, &attr, len), 0);
 }
-}  // namespace gatt
\ No newline at end of file
+
+/* This test makes sure that lookups by handle find the attributes of a
+ * database, whether it was built or deserialized. */
+TEST(GattDatabaseTest, find_by_handle_test) {
+  DatabaseBuilder builder;
+  builder.AddService(0x0001, 0x000f, SERVICE_1_UUID, true);
+  builder.AddService(0x0010, 0x001f, SERVICE_2_UUID, false);
+  builder.AddCharacteristic(0x0003, 0x0004, SERVICE_1_CHAR_1_UUID, 0x02);
+  builder.AddDescriptor(0x0005, SERVICE_1_CHAR_1_DESC_1_UUID);
+  builder.AddCharacteristic(0x0011, 0x0012, SERVICE_1_CHAR_1_UUID, 0x10);
+  builder.AddDescriptor(0x0013, SERVICE_1_CHAR_1_DESC_1_UUID);
+
+  Database built = builder.Build();
+  bool success = false;
+  Database deserialized = Database::Deserialize(built.Serialize(), &success);
+  ASSERT_TRUE(success);
+
+  for (const Database* db : {&built, &deserialized}) {
+    ASSERT_NE(nullptr, db->FindService(0x0005));
+    EXPECT_EQ(0x0001, db->FindService(0x0005)->handle);
+    ASSERT_NE(nullptr, db->FindService(0x001f));
+    EXPECT_EQ(0x0010, db->FindService(0x001f)->handle);
+    EXPECT_EQ(nullptr, db->FindService(0x0020));
+
+    const Characteristic* charac = db->FindCharacteristic(0x0012);
+    ASSERT_NE(nullptr, charac);
+    EXPECT_EQ(0x0011, charac->declaration_handle);
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x0011));
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x0005));
+
+    const Characteristic* owner = nullptr;
+    const Descriptor* desc = db->FindDescriptor(0x0005, &owner);
+    ASSERT_NE(nullptr, desc);
+    EXPECT_EQ(0x0005, desc->handle);
+    ASSERT_NE(nullptr, owner);
+    EXPECT_EQ(0x0004, owner->value_handle);
+    EXPECT_EQ(nullptr, db->FindDescriptor(0x0004));
+    EXPECT_EQ(nullptr, db->FindDescriptor(0x0006));
+  }
+
+  EXPECT_EQ(nullptr, Database().FindCharacteristic(0x0004));
+}
+
+/* Same as above, for a database whose handles are too far apart to be looked
+ * up through a table of every handle, so lookups go through a binary search. */
+TEST(GattDatabaseTest, find_by_handle_sparse_test) {
+  DatabaseBuilder builder;
+  builder.AddService(0x0001, 0x000f, SERVICE_1_UUID, true);
+  builder.AddService(0x8000, 0x800f, SERVICE_2_UUID, false);
+  builder.AddCharacteristic(0x0003, 0x0004, SERVICE_1_CHAR_1_UUID, 0x02);
+  builder.AddDescriptor(0x0005, SERVICE_1_CHAR_1_DESC_1_UUID);
+  builder.AddCharacteristic(0x8001, 0x8002, SERVICE_1_CHAR_1_UUID, 0x10);
+  builder.AddDescriptor(0x8003, SERVICE_1_CHAR_1_DESC_1_UUID);
+
+  Database built = builder.Build();
+  bool success = false;
+  Database deserialized = Database::Deserialize(built.Serialize(), &success);
+  ASSERT_TRUE(success);
+
+  for (const Database* db : {&built, &deserialized}) {
+    ASSERT_NE(nullptr, db->FindService(0x8003));
+    EXPECT_EQ(0x8000, db->FindService(0x8003)->handle);
+    EXPECT_EQ(nullptr, db->FindService(0x4000));
+
+    const Characteristic* charac = db->FindCharacteristic(0x0004);
+    ASSERT_NE(nullptr, charac);
+    EXPECT_EQ(0x0003, charac->declaration_handle);
+    charac = db->FindCharacteristic(0x8002);
+    ASSERT_NE(nullptr, charac);
+    EXPECT_EQ(0x8001, charac->declaration_handle);
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x0002));
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x4000));
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x8003));
+    EXPECT_EQ(nullptr, db->FindCharacteristic(0x8004));
+
+    const Characteristic* owner = nullptr;
+    const Descriptor* desc = db->FindDescriptor(0x8003, &owner);
+    ASSERT_NE(nullptr, desc);
+    EXPECT_EQ(0x8003, desc->handle);
+    ASSERT_NE(nullptr, owner);
+    EXPECT_EQ(0x8002, owner->value_handle);
+    ASSERT_NE(nullptr, db->FindDescriptor(0x0005));
+    EXPECT_EQ(nullptr, db->FindDescriptor(0x8002));
+    EXPECT_EQ(nullptr, db->FindDescriptor(0x0006));
+    EXPECT_EQ(nullptr, db->FindDescriptor(0xffff));
+  }
+}
+}  // namespace gatt
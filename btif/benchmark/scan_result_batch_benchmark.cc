@@ -0,0 +1,304 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "btif/include/btif_scan_result_batcher.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+using Clock = std::chrono::steady_clock;
+
+// Reports per second of a busy scan, e.g. a crowded room with duplicate
+// filtering off.
+#define REPORTS_PER_SEC 2000
+// Reports per iteration.
+#define NUM_REPORTS 1000
+
+namespace {
+
+// Stand-in for the jni thread: runs posted closures in order, like
+// do_in_jni_thread.
+class Worker {
+ public:
+  Worker() : thread_([this] { Run(); }) {}
+
+  ~Worker() {
+    Post(nullptr);
+    thread_.join();
+  }
+
+  void Post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    cv_.notify_one();
+  }
+
+  // Waits until everything posted so far ran.
+  void Drain() {
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    Post([&] {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      done = true;
+      done_cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&] { return done; });
+  }
+
+ private:
+  void Run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !tasks_.empty(); });
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      if (!task) return;
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  std::thread thread_;
+};
+
+struct Report {
+  btgatt_scan_result_record_t record;
+  std::vector<uint8_t> adv_data;
+};
+
+std::vector<Report> make_reports() {
+  std::vector<Report> reports(NUM_REPORTS);
+  for (size_t i = 0; i < reports.size(); i++) {
+    Report& r = reports[i];
+    memset(&r.record, 0, sizeof(r.record));
+    r.record.event_type = 0x0013;
+    r.record.bda.address[4] = i >> 8;
+    r.record.bda.address[5] = i;
+    r.record.rssi = -40 - (i % 50);
+    r.adv_data.assign(31 + i % 32, static_cast<uint8_t>(i));
+    r.record.adv_data_len = r.adv_data.size();
+  }
+  return reports;
+}
+
+// What the scanner client does with a result.
+struct Sink {
+  std::vector<double> latency_us;
+  uint64_t checksum = 0;
+
+  void Deliver(const btgatt_scan_result_record_t& record, const uint8_t* data,
+               Clock::time_point received) {
+    checksum += record.rssi + data[0];
+    latency_us.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - received)
+            .count());
+  }
+};
+
+// One closure per result carrying a copy of its advertising data, as
+// bta_scan_results_cb does by default.
+class PerResult {
+ public:
+  PerResult(Worker* worker, Sink* sink, uint16_t /* window_ms */)
+      : worker_(worker), sink_(sink) {}
+
+  void Add(const Report& r, Clock::time_point received) {
+    std::vector<uint8_t> value(r.adv_data.begin(), r.adv_data.end());
+    btgatt_scan_result_record_t record = r.record;
+    Sink* sink = sink_;
+    worker_->Post([sink, record, value, received] {
+      sink->Deliver(record, value.data(), received);
+    });
+  }
+
+  Clock::time_point Deadline() const { return Clock::time_point::max(); }
+  void Poll(Clock::time_point /* now */) {}
+  void Flush() {}
+
+ private:
+  Worker* worker_;
+  Sink* sink_;
+};
+
+// Results collected by ScanResultBatcher and posted once per window.
+class Batched {
+ public:
+  Batched(Worker* worker, Sink* sink, uint16_t window_ms)
+      : worker_(worker), sink_(sink), window_(window_ms) {
+    batcher_.Configure(1, window_ms, 0);
+  }
+
+  void Add(const Report& r, Clock::time_point received) {
+    if (batcher_.NumResults() == 0) first_ = received;
+    received_.push_back(received);
+    if (batcher_.Add(r.record, r.adv_data.data())) Flush();
+  }
+
+  // When the batch timer would fire.
+  Clock::time_point Deadline() const {
+    if (batcher_.NumResults() == 0) return Clock::time_point::max();
+    return first_ + window_;
+  }
+
+  // Stands in for the batch timer.
+  void Poll(Clock::time_point now) {
+    if (batcher_.NumResults() != 0 && now - first_ >= window_) Flush();
+  }
+
+  void Flush() {
+    if (batcher_.NumResults() == 0) return;
+    auto results = std::make_shared<std::vector<uint8_t>>(batcher_.Take());
+    auto received =
+        std::make_shared<std::vector<Clock::time_point>>(std::move(received_));
+    received_.clear();
+    Sink* sink = sink_;
+    worker_->Post([sink, results, received] {
+      btgatt_scan_result_record_t record;
+      size_t i = 0;
+      for (size_t offset = 0; offset < results->size();
+           offset += sizeof(record) + record.adv_data_len) {
+        memcpy(&record, results->data() + offset, sizeof(record));
+        sink->Deliver(record, results->data() + offset + sizeof(record),
+                      (*received)[i++]);
+      }
+    });
+  }
+
+ private:
+  Worker* worker_;
+  Sink* sink_;
+  ScanResultBatcher batcher_;
+  std::chrono::milliseconds window_;
+  Clock::time_point first_;
+  std::vector<Clock::time_point> received_;
+};
+
+double process_cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void report_latency(State& state, Sink* sink) {
+  std::vector<double>& l = sink->latency_us;
+  if (l.empty()) return;
+  std::sort(l.begin(), l.end());
+  double sum = 0;
+  for (double v : l) sum += v;
+  state.counters["latency_mean_us"] = sum / l.size();
+  state.counters["latency_p99_us"] = l[l.size() * 99 / 100];
+  state.counters["latency_max_us"] = l.back();
+}
+
+// As fast as the results can be handed over: CPU time per result on both
+// threads.
+template <typename Delivery>
+void BM_Throughput(State& state) {
+  static const std::vector<Report> reports = make_reports();
+  Worker worker;
+  Sink sink;
+  Delivery delivery(&worker, &sink, state.range(0));
+
+  for (auto _ : state) {
+    for (const Report& r : reports) delivery.Add(r, Clock::now());
+    delivery.Flush();
+    worker.Drain();
+  }
+
+  benchmark::DoNotOptimize(sink.checksum);
+  state.SetItemsProcessed(state.iterations() * reports.size());
+  state.counters["cpu_per_report"] =
+      Counter(state.iterations() * reports.size(),
+              Counter::kIsRate | Counter::kInvert);
+}
+
+// Results arriving at REPORTS_PER_SEC: how long they wait to be delivered,
+// and the CPU time spent per result on both threads.
+template <typename Delivery>
+void BM_Paced(State& state) {
+  static const std::vector<Report> reports = make_reports();
+  const auto interval = std::chrono::microseconds(1000000 / REPORTS_PER_SEC);
+  Worker worker;
+  Sink sink;
+  Delivery delivery(&worker, &sink, state.range(0));
+  double cpu_us = 0;
+
+  for (auto _ : state) {
+    double start_us = process_cpu_us();
+    Clock::time_point next = Clock::now();
+    for (const Report& r : reports) {
+      for (;;) {
+        Clock::time_point wake = std::min(next, delivery.Deadline());
+        std::this_thread::sleep_until(wake);
+        if (wake == next) break;
+        delivery.Poll(Clock::now());
+      }
+      delivery.Add(r, Clock::now());
+      next += interval;
+    }
+    while (delivery.Deadline() != Clock::time_point::max()) {
+      std::this_thread::sleep_until(delivery.Deadline());
+      delivery.Poll(Clock::now());
+    }
+    worker.Drain();
+    cpu_us += process_cpu_us() - start_us;
+  }
+
+  report_latency(state, &sink);
+  state.counters["cpu_per_report_us"] =
+      cpu_us / (state.iterations() * reports.size());
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Throughput, PerResult)->Arg(0)->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_Throughput, Batched)->Arg(50)->MeasureProcessCPUTime();
+
+BENCHMARK_TEMPLATE(BM_Paced, PerResult)->Arg(0)->Iterations(3)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Paced, Batched)
+    ->Arg(10)
+    ->Arg(50)
+    ->Arg(100)
+    ->Iterations(3)
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
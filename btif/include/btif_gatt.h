@@ -34,4 +34,5 @@ extern const btgatt_server_interface_t btgattServerInterface;
 
 BleAdvertiserInterface* get_ble_advertiser_instance();
 BleScannerInterface* get_ble_scanner_instance();
+void btif_ble_scanner_cleanup();
 #endif
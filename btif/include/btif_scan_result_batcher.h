@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <hardware/ble_scanner.h>
+
+/* Most results held for one batch, whatever the scanners asked for. */
+#ifndef BTIF_SCAN_BATCH_MAX_RESULTS
+#define BTIF_SCAN_BATCH_MAX_RESULTS 1024
+#endif
+
+/* Bytes reserved for a batch up front: room for a legacy advertisement and
+ * its scan response per result at 2000 results/s over a 50 ms window. */
+#ifndef BTIF_SCAN_BATCH_RESERVE
+#define BTIF_SCAN_BATCH_RESERVE \
+  (100 * (sizeof(btgatt_scan_result_record_t) + 62))
+#endif
+
+/* Collects scan results for the scanners that enabled batching into one
+ * contiguous buffer, laid out as btgatt_scan_result_record_t headers each
+ * followed by its advertising data, and decides when the batch is due.
+ *
+ * Also keeps track of which scanners are registered, so that the per result
+ * callback can be skipped once every one of them receives batches. Not thread
+ * safe; only used on the bta thread. */
+class ScanResultBatcher {
+ public:
+  ScanResultBatcher() { results_.reserve(BTIF_SCAN_BATCH_RESERVE); }
+
+  ScanResultBatcher(const ScanResultBatcher&) = delete;
+  ScanResultBatcher& operator=(const ScanResultBatcher&) = delete;
+
+  void AddScanner(int scanner_id) { registered_.insert(scanner_id); }
+
+  void RemoveScanner(int scanner_id) {
+    registered_.erase(scanner_id);
+    config_.erase(scanner_id);
+  }
+
+  /* Enables batching for |scanner_id|, or disables it if both limits are 0. */
+  void Configure(int scanner_id, uint16_t window_ms, uint16_t max_results) {
+    if (window_ms == 0 && max_results == 0) {
+      config_.erase(scanner_id);
+      return;
+    }
+    config_[scanner_id] = {window_ms, max_results};
+  }
+
+  /* Whether results are to be collected at all. */
+  bool Enabled() const { return !config_.empty(); }
+
+  /* Whether some scanner still takes results one at a time. */
+  bool DeliverEachResult() const {
+    if (config_.empty()) return true;
+    for (int scanner_id : registered_)
+      if (config_.count(scanner_id) == 0) return true;
+    return false;
+  }
+
+  /* Time a batch may wait after its first result, in milliseconds; 0 if only
+   * the count limits it. */
+  uint64_t WindowMs() const {
+    uint64_t window_ms = 0;
+    for (const auto& it : config_)
+      if (it.second.window_ms != 0 &&
+          (window_ms == 0 || it.second.window_ms < window_ms))
+        window_ms = it.second.window_ms;
+    return window_ms;
+  }
+
+  size_t MaxResults() const {
+    size_t max_results = BTIF_SCAN_BATCH_MAX_RESULTS;
+    for (const auto& it : config_)
+      if (it.second.max_results != 0 && it.second.max_results < max_results)
+        max_results = it.second.max_results;
+    return max_results;
+  }
+
+  /* Appends a result. Returns true if the batch is now due. */
+  bool Add(const btgatt_scan_result_record_t& record, const uint8_t* adv_data) {
+    size_t offset = results_.size();
+    results_.resize(offset + sizeof(record) + record.adv_data_len);
+    memcpy(&results_[offset], &record, sizeof(record));
+    if (adv_data != nullptr && record.adv_data_len != 0)
+      memcpy(&results_[offset + sizeof(record)], adv_data, record.adv_data_len);
+    num_results_++;
+    return num_results_ >= MaxResults();
+  }
+
+  size_t NumResults() const { return num_results_; }
+
+  /* Scanners the current batch goes to. */
+  std::vector<int> Scanners() const {
+    std::vector<int> scanners;
+    for (const auto& it : config_) scanners.push_back(it.first);
+    return scanners;
+  }
+
+  /* Hands the pending results over, leaving an empty batch. */
+  std::vector<uint8_t> Take() {
+    std::vector<uint8_t> results;
+    results.reserve(BTIF_SCAN_BATCH_RESERVE);
+    results.swap(results_);
+    num_results_ = 0;
+    return results;
+  }
+
+  /* Forgets the scanners, their settings and the pending results. */
+  void Clear() {
+    registered_.clear();
+    config_.clear();
+    Take();
+  }
+
+ private:
+  struct Config {
+    uint16_t window_ms;
+    uint16_t max_results;
+  };
+
+  std::set<int> registered_;
+  std::map<int, Config> config_;
+  std::vector<uint8_t> results_;
+  size_t num_results_ = 0;
+};
@@ -71,6 +71,7 @@
 #include "device/include/device_iot_config.h"
 #include "btsnoop.h"
 #include "btsnoop_mem.h"
+#include "hci_layer.h"
 #include "common/address_obfuscator.h"
 #include "common/os_utils.h"
 #include "device/include/interop.h"
@@ -84,6 +85,8 @@
 #include "stack_manager.h"
 #include "stack_interface.h"
 #include "stack/include/btm_api.h"
+#include "stack/include/btm_ble_api.h"
+#include "stack/include/l2c_api.h"
 
 using base::Bind;
 using bluetooth::hearing_aid::HearingAidInterface;
@@ -384,6 +387,9 @@ static void dump(int fd, const char** arguments) {
   alarm_debug_dump(fd);
   HearingAid::DebugDump(fd);
   connection_manager::dump(fd);
+  btm_ble_adv_cache_dump(fd);
+  l2c_sched_dump(fd);
+  hci_layer_debug_dump(fd);
   bluetooth::bqr::DebugDump(fd);
 #if (BTSNOOP_MEM == TRUE)
   btif_debug_btsnoop_dump(fd);
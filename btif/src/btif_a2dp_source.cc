@@ -125,6 +125,7 @@ extern bool reconfig_a2dp;
 extern bool tx_enc_update_initiated;
 extern bool is_block_hal_start;
 static void btif_a2dp_source_command_ready(fixed_queue_t* queue, void* context);
+static void btif_a2dp_source_enqueue_cmd(BT_HDR* p_buf);
 static void btif_a2dp_source_startup_delayed(void* context);
 static void btif_a2dp_source_shutdown_delayed(void* context);
 
@@ -262,7 +263,12 @@ bool btif_a2dp_source_startup(void) {
 
   btif_a2dp_source_cb.tx_audio_queue = fixed_queue_new(SIZE_MAX);
 
-  btif_a2dp_source_cb.cmd_msg_queue = fixed_queue_new(SIZE_MAX);
+  // Commands come from several threads but are only consumed by the media
+  // worker, so the lock-free MPSC ring avoids a mutex and two eventfd
+  // syscalls per command. It is bounded like the worker's own work queue;
+  // see btif_a2dp_source_enqueue_cmd().
+  btif_a2dp_source_cb.cmd_msg_queue =
+      fixed_queue_new_ring(MAX_MEDIA_WORKQUEUE_SEM_COUNT, FIXED_QUEUE_MPSC);
   fixed_queue_register_dequeue(
       btif_a2dp_source_cb.cmd_msg_queue,
       thread_get_reactor(btif_a2dp_source_cb.worker_thread),
@@ -313,13 +319,15 @@ void btif_a2dp_source_shutdown(void) {
   btif_a2dp_source_cancel_remote_start();
   btif_dispatch_sm_event(BTIF_AV_RESET_REMOTE_STARTED_FLAG_EVT, NULL, 0);
 
-  // Exit the thread
-  fixed_queue_free(btif_a2dp_source_cb.cmd_msg_queue, NULL);
-  btif_a2dp_source_cb.cmd_msg_queue = NULL;
+  // Exit the thread. The ring only takes one consumer, so the worker stops
+  // taking commands before the queue is freed here.
+  fixed_queue_unregister_dequeue(btif_a2dp_source_cb.cmd_msg_queue);
   thread_post(btif_a2dp_source_cb.worker_thread,
               btif_a2dp_source_shutdown_delayed, NULL);
   thread_free(btif_a2dp_source_cb.worker_thread);
   btif_a2dp_source_cb.worker_thread = NULL;
+  fixed_queue_free(btif_a2dp_source_cb.cmd_msg_queue, osi_free);
+  btif_a2dp_source_cb.cmd_msg_queue = NULL;
   APPL_TRACE_EVENT("## A2DP SOURCE MEDIA THREAD STOPPED ##");
 }
 
@@ -467,6 +475,17 @@ static void btif_a2dp_source_unblock_audio_start_timeout(void* context) {
   }
 }
 
+// Queues |p_buf| for the media worker. Commands come a few per stream state
+// change, so a full ring means the worker is stuck: the command is dropped
+// rather than blocking the caller, which may be the one the worker waits on.
+static void btif_a2dp_source_enqueue_cmd(BT_HDR* p_buf) {
+  if (!fixed_queue_try_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf)) {
+    APPL_TRACE_ERROR("%s: media worker command queue full, dropping event %d",
+                     __func__, p_buf->event);
+    osi_free(p_buf);
+  }
+}
+
 static void btif_a2dp_source_command_ready(fixed_queue_t* queue,
                                            UNUSED_ATTR void* context) {
   BT_HDR* p_msg = (BT_HDR*)fixed_queue_dequeue(queue);
@@ -611,7 +630,7 @@ void btif_a2dp_source_start_audio_req(void) {
 
   BTIF_TRACE_DEBUG("%s:", __func__);
   p_buf->event = BTIF_MEDIA_AUDIO_TX_START;
-  fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+  btif_a2dp_source_enqueue_cmd(p_buf);
   memset(&btif_a2dp_source_cb.stats, 0, sizeof(btif_media_stats_t));
   // Assign session_start_us to 1 when time_get_os_boottime_us() is 0 to
   // indicate btif_a2dp_source_start_audio_req() has been called
@@ -648,7 +667,7 @@ void btif_a2dp_source_stop_audio_req(void) {
    * processing during the shutdown of the Bluetooth stack.
    */
   if (btif_a2dp_source_cb.cmd_msg_queue != NULL) {
-    fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+    btif_a2dp_source_enqueue_cmd(p_buf);
   } else if (pending_cmd == A2DP_CTRL_CMD_STOP ||
       pending_cmd == A2DP_CTRL_CMD_SUSPEND) {
     BTIF_TRACE_DEBUG("media msg queue null, ack pending stop/suspend");
@@ -681,7 +700,7 @@ static void btif_a2dp_source_encoder_init_req(
 
   memcpy(p_buf, p_msg, sizeof(tBTIF_A2DP_SOURCE_ENCODER_INIT));
   p_buf->hdr.event = BTIF_MEDIA_SOURCE_ENCODER_INIT;
-  fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+  btif_a2dp_source_enqueue_cmd(&p_buf->hdr);
 }
 
 void btif_media_send_reset_vendor_state() {
@@ -689,7 +708,7 @@ void btif_media_send_reset_vendor_state() {
   BT_HDR *p_buf = (BT_HDR *)osi_malloc(sizeof(BT_HDR));
   p_buf->event = BTIF_MEDIA_RESET_VS_STATE;
   if (btif_a2dp_source_cb.cmd_msg_queue != NULL)
-    fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+    btif_a2dp_source_enqueue_cmd(p_buf);
 }
 
 static void btif_a2dp_source_encoder_init_event(BT_HDR* p_msg) {
@@ -730,7 +749,7 @@ void btif_a2dp_source_encoder_user_config_update_req(
   p_buf->user_config = codec_user_config;
   p_buf->hdr.event = BTIF_MEDIA_SOURCE_ENCODER_USER_CONFIG_UPDATE;
   p_buf->bd_addr = bd_addr;
-  fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+  btif_a2dp_source_enqueue_cmd(&p_buf->hdr);
 }
 
 static void btif_a2dp_source_encoder_user_config_update_event(BT_HDR* p_msg) {
@@ -751,7 +770,7 @@ void btif_a2dp_source_feeding_update_req(
 
   p_buf->feeding_params = codec_audio_config;
   p_buf->hdr.event = BTIF_MEDIA_AUDIO_FEEDING_UPDATE;
-  fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+  btif_a2dp_source_enqueue_cmd(&p_buf->hdr);
 }
 
 static void btif_a2dp_source_audio_feeding_update_event(BT_HDR* p_msg) {
@@ -1236,7 +1255,7 @@ static bool btif_a2dp_source_audio_tx_flush_req(void) {
    * processing during the shutdown of the Bluetooth stack.
    */
   if (btif_a2dp_source_cb.cmd_msg_queue != NULL)
-    fixed_queue_enqueue(btif_a2dp_source_cb.cmd_msg_queue, p_buf);
+    btif_a2dp_source_enqueue_cmd(p_buf);
 
   return true;
 }
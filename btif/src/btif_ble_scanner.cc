@@ -41,7 +41,9 @@
 #include "btif_dm.h"
 #include "btif_gatt.h"
 #include "btif_gatt_util.h"
+#include "btif_scan_result_batcher.h"
 #include "btif_storage.h"
+#include "osi/include/alarm.h"
 #include "osi/include/log.h"
 #include "vendor_api.h"
 #include "stack_manager.h"
@@ -91,6 +93,10 @@ void btif_address_cache_init(void) {
   remote_bdaddr_cache_ordered = {};
 }
 
+// all access to these variables should be done on the bta thread
+ScanResultBatcher scan_result_batcher;
+alarm_t* scan_result_batch_timer = nullptr;
+
 void bta_batch_scan_threshold_cb(tBTM_BLE_REF_VALUE ref_value) {
   SCAN_CBACK_IN_JNI(batchscan_threshold_cb, ref_value);
 }
@@ -102,23 +108,22 @@ void bta_batch_scan_reports_cb(int client_id, tBTA_STATUS status,
                     num_records, std::move(data));
 }
 
-void bta_scan_results_cb_impl(RawAddress bd_addr, tBT_DEVICE_TYPE device_type,
-                              int8_t rssi, uint8_t addr_type,
-                              uint16_t ble_evt_type, uint8_t ble_primary_phy,
-                              uint8_t ble_secondary_phy,
-                              uint8_t ble_advertising_sid, int8_t ble_tx_power,
-                              uint16_t ble_periodic_adv_int,
-                              vector<uint8_t> value, RawAddress original_bda) {
+// Records what a scan result tells about the remote device. Returns false if
+// the result is to be dropped.
+bool scan_result_update_properties(RawAddress bd_addr,
+                                   tBT_DEVICE_TYPE device_type,
+                                   uint8_t addr_type, const uint8_t* p_data,
+                                   size_t len) {
   uint8_t remote_name_len;
   bt_device_type_t dev_type;
   bt_property_t properties;
 
   const uint8_t* p_eir_remote_name = AdvertiseDataParser::GetFieldByType(
-      value, BTM_EIR_COMPLETE_LOCAL_NAME_TYPE, &remote_name_len);
+      p_data, len, BTM_EIR_COMPLETE_LOCAL_NAME_TYPE, &remote_name_len);
 
   if (p_eir_remote_name == NULL) {
     p_eir_remote_name = AdvertiseDataParser::GetFieldByType(
-        value, BT_EIR_SHORTENED_LOCAL_NAME_TYPE, &remote_name_len);
+        p_data, len, BT_EIR_SHORTENED_LOCAL_NAME_TYPE, &remote_name_len);
   }
 
   if ((addr_type != BLE_ADDR_RANDOM) || (p_eir_remote_name)) {
@@ -132,7 +137,7 @@ void bta_scan_results_cb_impl(RawAddress bd_addr, tBT_DEVICE_TYPE device_type,
           LOG_INFO(LOG_TAG,
                    "%s dropping invalid packet - device name too long: %d",
                    __func__, remote_name_len);
-          return;
+          return false;
         }
 
         bt_bdname_t bdname;
@@ -153,18 +158,149 @@ void bta_scan_results_cb_impl(RawAddress bd_addr, tBT_DEVICE_TYPE device_type,
   btif_storage_set_remote_device_property(&(bd_addr), &properties);
 
   btif_storage_set_remote_addr_type(&bd_addr, addr_type);
+  return true;
+}
+
+void bta_scan_results_cb_impl(RawAddress bd_addr, tBT_DEVICE_TYPE device_type,
+                              int8_t rssi, uint8_t addr_type,
+                              uint16_t ble_evt_type, uint8_t ble_primary_phy,
+                              uint8_t ble_secondary_phy,
+                              uint8_t ble_advertising_sid, int8_t ble_tx_power,
+                              uint16_t ble_periodic_adv_int,
+                              vector<uint8_t> value, RawAddress original_bda) {
+  if (!scan_result_update_properties(bd_addr, device_type, addr_type,
+                                     value.data(), value.size()))
+    return;
+
   HAL_CBACK(bt_gatt_callbacks, scanner->scan_result_cb, ble_evt_type, addr_type,
             &bd_addr, ble_primary_phy, ble_secondary_phy, ble_advertising_sid,
             ble_tx_power, rssi, ble_periodic_adv_int, std::move(value),
             &original_bda);
 }
 
+void bta_scan_results_batch_cb_impl(std::vector<int> scanners, int num_results,
+                                    bool update_properties,
+                                    vector<uint8_t> results) {
+  if (update_properties) {
+    // Nobody gets these results one at a time, so record here what they tell
+    // about the remote devices.
+    btgatt_scan_result_record_t record;
+    for (size_t offset = 0; offset < results.size();
+         offset += sizeof(record) + record.adv_data_len) {
+      memcpy(&record, &results[offset], sizeof(record));
+      scan_result_update_properties(record.bda, record.device_type,
+                                    record.addr_type,
+                                    results.data() + offset + sizeof(record),
+                                    record.adv_data_len);
+    }
+  }
+
+  if (!bt_gatt_callbacks || !bt_gatt_callbacks->scanner->batch_scan_result_cb)
+    return;
+
+  BTIF_TRACE_API("HAL bt_gatt_callbacks->scanner->batch_scan_result_cb");
+  for (size_t i = 0; i + 1 < scanners.size(); i++)
+    bt_gatt_callbacks->scanner->batch_scan_result_cb(scanners[i], num_results,
+                                                     results);
+  if (!scanners.empty())
+    bt_gatt_callbacks->scanner->batch_scan_result_cb(
+        scanners.back(), num_results, std::move(results));
+}
+
+void bta_scan_results_batch_flush() {
+  if (scan_result_batcher.NumResults() == 0) return;
+
+  alarm_cancel(scan_result_batch_timer);
+  std::vector<int> scanners = scan_result_batcher.Scanners();
+  int num_results = scan_result_batcher.NumResults();
+  bool update_properties = !scan_result_batcher.DeliverEachResult();
+  do_in_jni_thread(Bind(bta_scan_results_batch_cb_impl, std::move(scanners),
+                        num_results, update_properties,
+                        scan_result_batcher.Take()));
+}
+
+void bta_scan_results_batch_timeout(void* /* data */) {
+  bta_scan_results_batch_flush();
+}
+
+// Adds a result to the pending batch of the scanners that enabled batching.
+void bta_scan_results_batch_add(const tBTA_DM_INQ_RES* r) {
+  btgatt_scan_result_record_t record;
+  uint8_t len;
+
+  // Checked here rather than when the batch is delivered, so that it does not
+  // need to be taken apart again.
+  const uint8_t* p_name = AdvertiseDataParser::GetFieldByType(
+      r->p_eir, r->eir_len, BTM_EIR_COMPLETE_LOCAL_NAME_TYPE, &len);
+  if (p_name == NULL)
+    p_name = AdvertiseDataParser::GetFieldByType(
+        r->p_eir, r->eir_len, BT_EIR_SHORTENED_LOCAL_NAME_TYPE, &len);
+  if (p_name != NULL &&
+      (len > BD_NAME_LEN + 1 ||
+       (len == BD_NAME_LEN + 1 && p_name[BD_NAME_LEN] != '\0')))
+    return;
+
+  memset(&record, 0, sizeof(record));
+  record.event_type = r->ble_evt_type;
+  record.addr_type = r->ble_addr_type;
+  record.bda = r->bd_addr;
+  record.primary_phy = r->ble_primary_phy;
+  record.secondary_phy = r->ble_secondary_phy;
+  record.advertising_sid = r->ble_advertising_sid;
+  record.tx_power = r->ble_tx_power;
+  record.rssi = r->rssi;
+  record.periodic_adv_int = r->ble_periodic_adv_int;
+  record.original_bda = r->original_bda;
+  record.device_type = r->device_type;
+  record.adv_data_len = r->p_eir ? r->eir_len : 0;
+
+  bool first = scan_result_batcher.NumResults() == 0;
+  if (scan_result_batcher.Add(record, r->p_eir)) {
+    bta_scan_results_batch_flush();
+    return;
+  }
+
+  uint64_t window_ms = scan_result_batcher.WindowMs();
+  if (first && window_ms != 0) {
+    if (scan_result_batch_timer == nullptr)
+      scan_result_batch_timer = alarm_new("btif_ble_scanner.batch_timer");
+    alarm_set_on_mloop(scan_result_batch_timer, window_ms,
+                       bta_scan_results_batch_timeout, nullptr);
+  }
+}
+
+void bta_scan_results_batch_configure(int scanner_id, uint16_t window_ms,
+                                      uint16_t max_results) {
+  // Results collected so far go out under the old settings.
+  bta_scan_results_batch_flush();
+  scan_result_batcher.Configure(scanner_id, window_ms, max_results);
+}
+
+void bta_scanner_registered(int scanner_id) {
+  // A scanner taking each result would change how the pending ones go out.
+  bta_scan_results_batch_flush();
+  scan_result_batcher.AddScanner(scanner_id);
+}
+
+void bta_scanner_unregister(int scanner_id) {
+  bta_scan_results_batch_flush();
+  scan_result_batcher.RemoveScanner(scanner_id);
+  BTA_GATTC_AppDeregister(scanner_id);
+}
+
+void bta_scanner_cleanup() {
+  scan_result_batcher.Clear();
+  alarm_free(scan_result_batch_timer);
+  scan_result_batch_timer = nullptr;
+}
+
 void bta_scan_results_cb(tBTA_DM_SEARCH_EVT event, tBTA_DM_SEARCH* p_data) {
   uint8_t len;
 
   if (event == BTA_DM_INQ_CMPL_EVT) {
     BTIF_TRACE_DEBUG("%s  BLE observe complete. Num Resp %d", __func__,
                      p_data->inq_cmpl.num_resps);
+    bta_scan_results_batch_flush();
     return;
   }
 
@@ -173,6 +309,20 @@ void bta_scan_results_cb(tBTA_DM_SEARCH_EVT event, tBTA_DM_SEARCH* p_data) {
     return;
   }
 
+  if (scan_result_batcher.Enabled()) {
+    bta_scan_results_batch_add(&p_data->inq_res);
+
+    if (!scan_result_batcher.DeliverEachResult()) {
+      if (p_data->inq_res.p_eir &&
+          AdvertiseDataParser::GetFieldByType(
+              p_data->inq_res.p_eir, p_data->inq_res.eir_len,
+              BTM_EIR_COMPLETE_LOCAL_NAME_TYPE, &len)) {
+        p_data->inq_res.remt_name_not_required = true;
+      }
+      return;
+    }
+  }
+
   vector<uint8_t> value;
   if (p_data->inq_res.p_eir) {
     value.insert(value.begin(), p_data->inq_res.p_eir,
@@ -210,20 +360,35 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
   void RegisterScanner(const bluetooth::Uuid& app_uuid, RegisterCallback cb) override {
     if (!stack_manager_get_interface()->get_stack_is_running()) return;
 
-    do_in_bta_thread(FROM_HERE,
-                     Bind(
-                         [](RegisterCallback cb) {
-                           BTA_GATTC_AppRegister(
-                               bta_cback,
-                               jni_thread_wrapper(FROM_HERE, std::move(cb)),
-                               false);
-                         },
-                         std::move(cb)));
+    do_in_bta_thread(
+        FROM_HERE,
+        Bind(
+            [](RegisterCallback cb) {
+              BTA_GATTC_AppRegister(
+                  bta_cback,
+                  Bind(
+                      [](RegisterCallback cb, uint8_t scanner_id,
+                         uint8_t status) {
+                        if (status == GATT_SUCCESS)
+                          bta_scanner_registered(scanner_id);
+                        cb.Run(scanner_id, status);
+                      },
+                      jni_thread_wrapper(FROM_HERE, std::move(cb))),
+                  false);
+            },
+            std::move(cb)));
   }
 
   void Unregister(int scanner_id) override {
     if (!stack_manager_get_interface()->get_stack_is_running()) return;
-    do_in_bta_thread(FROM_HERE, Bind(&BTA_GATTC_AppDeregister, scanner_id));
+    do_in_bta_thread(FROM_HERE, Bind(&bta_scanner_unregister, scanner_id));
+  }
+
+  void SetScanResultBatching(int scanner_id, uint16_t window_ms,
+                             uint16_t max_results) override {
+    if (!stack_manager_get_interface()->get_stack_is_running()) return;
+    do_in_bta_thread(FROM_HERE, Bind(&bta_scan_results_batch_configure,
+                                     scanner_id, window_ms, max_results));
   }
 
   void RegisterCallbacks(ScanningCallbacks* callbacks) {
@@ -237,6 +402,8 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
           if (!start) {
             do_in_bta_thread(FROM_HERE,
                              Bind(&BTA_DmBleObserve, false, 0, nullptr));
+            do_in_bta_thread(FROM_HERE,
+                             Bind(&bta_scan_results_batch_flush));
             return;
           }
 
@@ -437,3 +604,7 @@ BleScannerInterface* get_ble_scanner_instance() {
 
   return btLeScannerInstance;
 }
+
+void btif_ble_scanner_cleanup() {
+  do_in_bta_thread(FROM_HERE, Bind(&bta_scanner_cleanup));
+}
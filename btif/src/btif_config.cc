@@ -22,15 +22,19 @@
 
 #include <base/logging.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include <btif_keystore.h>
 #include "bt_types.h"
@@ -45,9 +49,12 @@
 #include "osi/include/allocator.h"
 #include "osi/include/compat.h"
 #include "osi/include/config.h"
+#include "osi/include/future.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/properties.h"
+#include "osi/include/thread.h"
+#include "osi/include/time.h"
 
 #define BT_CONFIG_SOURCE_TAG_NUM 1010001
 
@@ -78,7 +85,8 @@ static const char* CONFIG_LEGACY_FILE_PATH =
 static const period_ms_t CONFIG_SETTLE_PERIOD_MS = 3000;
 
 static void timer_config_save_cb(void* data);
-static void btif_config_write(uint16_t event, char* p_param);
+static future_t* btif_config_write(bool backup, bool wait);
+static void btif_config_io_write(void* context);
 static bool is_factory_reset(void);
 static void delete_config_files(void);
 static void btif_config_remove_unpaired(config_t* config);
@@ -189,6 +197,56 @@ static void read_or_set_metrics_salt() {
 static std::recursive_mutex config_lock;  // protects operations on |config|.
 static alarm_t* config_timer;
 
+// Write-behind persistence.
+//
+// Mutators record the sections they touch in |dirty_sections|. When a write
+// is due, only those sections are copied out of |config| under |config_lock|
+// and handed to |config_io_thread|, which merges them into its own
+// |persisted_config| and writes that to disk. Snapshots that queue up while a
+// write is in progress are merged together, so a burst of saves costs a
+// single write and fsync.
+typedef struct {
+  // Copies of the dirty sections, or of the whole config if |full|.
+  config_t* delta;
+  // Names of the dirty sections, including ones that have been removed.
+  std::vector<std::string> sections;
+  bool full;
+  // Whether to move the current file to |CONFIG_BACKUP_PATH| first.
+  bool backup;
+  // Readied with FUTURE_SUCCESS or FUTURE_FAIL once written, if not NULL.
+  future_t* done;
+} config_snapshot_t;
+
+typedef struct {
+  size_t writes;
+  size_t failed_writes;
+  size_t coalesced_snapshots;
+  size_t sections_snapshotted;
+  size_t last_write_bytes;
+  uint64_t total_write_bytes;
+  uint64_t last_write_us;
+  uint64_t total_write_us;
+  uint64_t max_write_us;
+} config_write_stats_t;
+
+// Protected by |config_lock|.
+static std::unordered_set<std::string> dirty_sections;
+static bool config_dirty_all;
+
+static thread_t* config_io_thread;
+// Only accessed on |config_io_thread|.
+static config_t* persisted_config;
+
+static std::mutex snapshot_lock;  // protects the following.
+static std::vector<config_snapshot_t*> pending_snapshots;
+static config_write_stats_t write_stats;
+
+// Records that |section| differs from what was last handed to the I/O thread.
+// Must be called with |config_lock| held.
+static void btif_config_mark_dirty(const char* section) {
+  if (!config_dirty_all) dirty_sections.insert(section);
+}
+
 // Module lifecycle functions
 
 static future_t* init(void) {
@@ -261,6 +319,17 @@ static future_t* init(void) {
   // Read or set metrics 256 bit hashing salt
   read_or_set_metrics_salt();
 
+  // Nothing has been written by this instance yet, so the first write
+  // snapshots everything.
+  config_dirty_all = true;
+  dirty_sections.clear();
+
+  config_io_thread = thread_new("btif_config_io");
+  if (!config_io_thread) {
+    LOG_ERROR(LOG_TAG, "%s unable to create I/O thread.", __func__);
+    goto error;
+  }
+
   // TODO(sharvil): use a non-wake alarm for this once we have
   // API support for it. There's no need to wake the system to
   // write back to disk.
@@ -275,8 +344,10 @@ static future_t* init(void) {
   return future_new_immediate(FUTURE_SUCCESS);
 
 error:
+  thread_free(config_io_thread);
   alarm_free(config_timer);
   config_free(config);
+  config_io_thread = NULL;
   config_timer = NULL;
   config = NULL;
   btif_config_source = NOT_LOADED;
@@ -308,6 +379,12 @@ static future_t* clean_up(void) {
   alarm_free(config_timer);
   config_timer = NULL;
 
+  // The flush above waited for every queued write, so the I/O thread is idle.
+  thread_free(config_io_thread);
+  config_io_thread = NULL;
+  config_free(persisted_config);
+  persisted_config = NULL;
+
   std::unique_lock<std::recursive_mutex> lock(config_lock);
   config_free(config);
   config = NULL;
@@ -386,6 +463,7 @@ bool btif_config_set_int(const char* section, const char* key, int value) {
 
   std::unique_lock<std::recursive_mutex> lock(config_lock);
   config_set_int(config, section, key, value);
+  btif_config_mark_dirty(section);
 
   return true;
 }
@@ -397,6 +475,7 @@ bool btif_config_set_uint16(const char* section, const char* key, uint16_t value
 
   std::unique_lock<std::recursive_mutex> lock(config_lock);
   config_set_uint16(config, section, key, value);
+  btif_config_mark_dirty(section);
 
   return true;
 }
@@ -409,6 +488,7 @@ bool btif_config_set_uint64(const char* section, const char* key,
 
   std::unique_lock<std::recursive_mutex> lock(config_lock);
   config_set_uint64(config, section, key, value);
+  btif_config_mark_dirty(section);
 
   return true;
 }
@@ -442,6 +522,7 @@ bool btif_config_set_str(const char* section, const char* key,
 
   std::unique_lock<std::recursive_mutex> lock(config_lock);
   config_set_string(config, section, key, value);
+  btif_config_mark_dirty(section);
   return true;
 }
 
@@ -501,10 +582,12 @@ bool btif_config_get_bin(const char* section, const char* key, uint8_t* value,
       get_bluetooth_keystore_interface()->set_encrypt_key_or_remove_key(
           section + std::string("-") + key, &value_str_from_config[0]);
       config_set_string(config, section, key, ENCRYPTED_STR.c_str());
+      btif_config_mark_dirty(section);
     }
   } else {
     if (in_encrypt_key_name_list && is_key_encrypted) {
       config_set_string(config, section, key, value_str->c_str());
+      btif_config_mark_dirty(section);
     }
   }
 
@@ -553,6 +636,7 @@ bool btif_config_set_bin(const char* section, const char* key,
   {
     std::unique_lock<std::recursive_mutex> lock(config_lock);
     config_set_string(config, section, key, value_str.c_str());
+    btif_config_mark_dirty(section);
   }
 
   osi_free(str);
@@ -594,6 +678,7 @@ bool btif_config_remove(const char* section, const char* key) {
         section + std::string("-") + key, "");
   }
   std::unique_lock<std::recursive_mutex> lock(config_lock);
+  btif_config_mark_dirty(section);
   return config_remove_key(config, section, key);
 }
 
@@ -609,7 +694,7 @@ void btif_config_flush(void) {
   CHECK(config_timer != NULL);
 
   alarm_cancel(config_timer);
-  btif_config_write(0, NULL);
+  future_await(btif_config_write(true, true));
 }
 
 bool btif_config_clear(void) {
@@ -618,42 +703,134 @@ bool btif_config_clear(void) {
 
   alarm_cancel(config_timer);
 
-  std::unique_lock<std::recursive_mutex> lock(config_lock);
-  config_free(config);
+  future_t* done;
+  {
+    std::unique_lock<std::recursive_mutex> lock(config_lock);
+    config_free(config);
 
-  config = config_new_empty();
-  if (config == NULL) return false;
+    config = config_new_empty();
+    if (config == NULL) return false;
 
-  bool ret = config_save(config, CONFIG_FILE_PATH);
-  btif_config_source = RESET;
+    config_dirty_all = true;
+    dirty_sections.clear();
+    done = btif_config_write(false, true);
+    btif_config_source = RESET;
+  }
 
-  return ret;
+  return future_await(done) == FUTURE_SUCCESS;
 }
 
 static void timer_config_save_cb(UNUSED_ATTR void* data) {
-  // Moving file I/O to btif context instead of timer callback because
-  // it usually takes a lot of time to be completed, introducing
-  // delays during A2DP playback causing blips or choppiness.
-  btif_transfer_context(btif_config_write, 0, NULL, 0, NULL);
+  // Only the dirty sections are copied here; the file I/O happens on
+  // |config_io_thread| so it cannot delay A2DP or the btif thread.
+  btif_config_write(true, false);
 }
 
-static void btif_config_write(UNUSED_ATTR uint16_t event,
-                              UNUSED_ATTR char* p_param) {
+// Snapshots the dirty sections of |config| and queues them for
+// |config_io_thread|. Returns a future that is readied once they are on disk
+// if |wait| is true, NULL otherwise.
+static future_t* btif_config_write(bool backup, bool wait) {
   CHECK(config != NULL);
-  CHECK(config_timer != NULL);
+  CHECK(config_io_thread != NULL);
 
-  std::unique_lock<std::recursive_mutex> lock(config_lock);
-  rename(CONFIG_FILE_PATH, CONFIG_BACKUP_PATH);
-  config_t* config_paired = config_new_clone(config);
+  future_t* done = wait ? future_new() : NULL;
+  config_snapshot_t* snapshot = new config_snapshot_t();
+  snapshot->backup = backup;
+  snapshot->done = done;
+  {
+    std::unique_lock<std::recursive_mutex> lock(config_lock);
+    if (!config_dirty_all && dirty_sections.empty() && !wait) {
+      delete snapshot;
+      return NULL;
+    }
 
-  if (config_paired != NULL) {
-    btif_config_remove_unpaired(config_paired);
-    config_save(config_paired, CONFIG_FILE_PATH);
-    config_free(config_paired);
+    if (config_dirty_all) {
+      snapshot->delta = config_new_clone(config);
+      snapshot->full = true;
+    } else {
+      snapshot->delta = config_new_empty();
+      for (const std::string& section : dirty_sections) {
+        config_copy_section(snapshot->delta, config, section.c_str());
+        snapshot->sections.push_back(section);
+      }
+    }
+    config_dirty_all = false;
+    dirty_sections.clear();
+
+    // Queued before |config_lock| is released so snapshots reach the I/O
+    // thread in the order they were taken.
+    std::lock_guard<std::mutex> snapshot_guard(snapshot_lock);
+    if (pending_snapshots.empty())
+      thread_post(config_io_thread, btif_config_io_write, NULL);
+    pending_snapshots.push_back(snapshot);
   }
-  if (is_common_criteria_mode()) {
-    get_bluetooth_keystore_interface()->set_encrypt_key_or_remove_key(
-        CONFIG_FILE_PREFIX, CONFIG_FILE_HASH);
+
+  return done;
+}
+
+// Runs on |config_io_thread|. Merges every queued snapshot into
+// |persisted_config| and writes it out once.
+static void btif_config_io_write(UNUSED_ATTR void* context) {
+  std::vector<config_snapshot_t*> snapshots;
+  {
+    std::lock_guard<std::mutex> lock(snapshot_lock);
+    snapshots.swap(pending_snapshots);
+  }
+
+  bool changed = false;
+  bool backup = true;
+  size_t sections = 0;
+  for (config_snapshot_t* snapshot : snapshots) {
+    if (snapshot->full) {
+      config_free(persisted_config);
+      persisted_config = snapshot->delta;
+      snapshot->delta = NULL;
+      changed = true;
+    } else if (!snapshot->sections.empty()) {
+      CHECK(persisted_config != NULL);
+      for (const std::string& section : snapshot->sections)
+        config_copy_section(persisted_config, snapshot->delta,
+                            section.c_str());
+      sections += snapshot->sections.size();
+      changed = true;
+    }
+    // A reset must not leave the previous contents behind as the backup.
+    if (!snapshot->backup) backup = false;
+  }
+
+  bool ret = true;
+  if (changed) {
+    uint64_t start_us = time_get_os_boottime_us();
+    if (backup) rename(CONFIG_FILE_PATH, CONFIG_BACKUP_PATH);
+    btif_config_remove_unpaired(persisted_config);
+    ret = config_save(persisted_config, CONFIG_FILE_PATH);
+    if (is_common_criteria_mode()) {
+      get_bluetooth_keystore_interface()->set_encrypt_key_or_remove_key(
+          CONFIG_FILE_PREFIX, CONFIG_FILE_HASH);
+    }
+    uint64_t write_us = time_get_os_boottime_us() - start_us;
+
+    struct stat st;
+    size_t bytes = (ret && stat(CONFIG_FILE_PATH, &st) == 0) ? st.st_size : 0;
+
+    std::lock_guard<std::mutex> lock(snapshot_lock);
+    write_stats.writes++;
+    if (!ret) write_stats.failed_writes++;
+    write_stats.coalesced_snapshots += snapshots.size() - 1;
+    write_stats.sections_snapshotted += sections;
+    write_stats.last_write_bytes = bytes;
+    write_stats.total_write_bytes += bytes;
+    write_stats.last_write_us = write_us;
+    write_stats.total_write_us += write_us;
+    if (write_us > write_stats.max_write_us)
+      write_stats.max_write_us = write_us;
+  }
+
+  for (config_snapshot_t* snapshot : snapshots) {
+    if (snapshot->done)
+      future_ready(snapshot->done, ret ? FUTURE_SUCCESS : FUTURE_FAIL);
+    config_free(snapshot->delta);
+    delete snapshot;
   }
 }
 
@@ -721,6 +898,22 @@ void btif_debug_config_dump(int fd) {
   dprintf(fd, "  File created/tagged: %s\n", btif_config_time_created);
   dprintf(fd, "  File source: %s\n",
           config_get_string(config, INFO_SECTION, FILE_SOURCE, "Original"));
+
+  std::lock_guard<std::mutex> lock(snapshot_lock);
+  dprintf(fd, "  Writes: %zu (%zu failed), saves coalesced: %zu\n",
+          write_stats.writes, write_stats.failed_writes,
+          write_stats.coalesced_snapshots);
+  dprintf(fd, "  Sections snapshotted: %zu\n",
+          write_stats.sections_snapshotted);
+  dprintf(fd, "  Bytes written: %zu last, %" PRIu64 " total\n",
+          write_stats.last_write_bytes, write_stats.total_write_bytes);
+  dprintf(fd,
+          "  Write latency: %" PRIu64 " us last, %" PRIu64 " us avg, %" PRIu64
+          " us max\n",
+          write_stats.last_write_us,
+          write_stats.writes ? write_stats.total_write_us / write_stats.writes
+                             : 0,
+          write_stats.max_write_us);
 }
 
 static void btif_config_remove_restricted(config_t* config) {
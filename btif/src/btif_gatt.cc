@@ -70,6 +70,7 @@ static bt_status_t btif_gatt_init(const btgatt_callbacks_t* callbacks) {
 static void btif_gatt_cleanup(void) {
   if (bt_gatt_callbacks) bt_gatt_callbacks = NULL;
 
+  btif_ble_scanner_cleanup();
   BTA_GATTC_Disable();
   BTA_GATTS_Disable();
 }
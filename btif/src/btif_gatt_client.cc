@@ -33,6 +33,7 @@
 #include <hardware/bluetooth.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mutex>
 #include "device/include/controller.h"
 
 #include "btif_common.h"
@@ -70,12 +71,18 @@ extern const btgatt_callbacks_t* bt_gatt_callbacks;
   do {                                                                         \
     if (bt_gatt_callbacks && bt_gatt_callbacks->client->P_CBACK) {             \
       BTIF_TRACE_API("HAL bt_gatt_callbacks->client->%s", #P_CBACK);           \
+      btif_gattc_close_notify_batch();                                         \
       do_in_jni_thread(Bind(bt_gatt_callbacks->client->P_CBACK, __VA_ARGS__)); \
     } else {                                                                   \
       ASSERTC(0, "Callback is NULL", 0);                                       \
     }                                                                          \
   } while (0)
 
+/* Most notifications delivered to the app in a single JNI thread wakeup */
+#ifndef BTIF_GATTC_NOTIFY_BATCH_MAX
+#define BTIF_GATTC_NOTIFY_BATCH_MAX 32
+#endif
+
 #define CHECK_BTGATT_INIT()                                      \
   do {                                                           \
     if (bt_gatt_callbacks == NULL) {                             \
@@ -100,6 +107,100 @@ namespace {
 
 uint8_t rssi_request_client_if;
 
+/* Notifications waiting for the JNI thread. Their values are kept back to
+ * back, each copied once and only up to its length. */
+struct NotifyBatch {
+  struct Entry {
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t len;
+    bool is_notify;
+    uint32_t trans_id;
+    RawAddress bda;
+    size_t offset; /* of the value in |values| */
+  };
+
+  ~NotifyBatch();
+
+  void Append(const tBTA_GATTC_NOTIFY& notify) {
+    size_t offset = values.size();
+    values.insert(values.end(), notify.value, notify.value + notify.len);
+    entries.push_back({notify.conn_id, notify.handle, notify.len,
+                       notify.is_notify, notify.trans_id, notify.bda, offset});
+  }
+
+  vector<Entry> entries;
+  vector<uint8_t> values;
+};
+
+std::mutex notify_batch_mutex;
+/* The batch posted to the JNI thread that is not being delivered yet, which
+ * notifications are appended to. */
+NotifyBatch* pending_notify_batch = nullptr;
+
+/* The task owning the batch may also be dropped undelivered, with the JNI
+ * thread */
+NotifyBatch::~NotifyBatch() {
+  std::lock_guard<std::mutex> lock(notify_batch_mutex);
+  if (pending_notify_batch == this) pending_notify_batch = nullptr;
+}
+
+void btif_gattc_deliver_notify_batch(NotifyBatch* batch) {
+  {
+    std::lock_guard<std::mutex> lock(notify_batch_mutex);
+    if (pending_notify_batch == batch) pending_notify_batch = nullptr;
+  }
+
+  btgatt_notify_params_t data;
+  for (const NotifyBatch::Entry& entry : batch->entries) {
+    data.bda = entry.bda;
+    memcpy(data.value, batch->values.data() + entry.offset, entry.len);
+    data.handle = entry.handle;
+    data.is_notify = entry.is_notify;
+    data.len = entry.len;
+
+    HAL_CBACK(bt_gatt_callbacks, client->notify_cb, entry.conn_id, data);
+
+    if (!entry.is_notify)
+      BTA_GATTC_SendIndConfirm(entry.conn_id, entry.handle, entry.trans_id);
+  }
+}
+
+/* Hands a notification to the JNI thread, along with the ones received since
+ * it last woke up */
+void btif_gattc_queue_notify(const tBTA_GATTC_NOTIFY& notify) {
+  NotifyBatch* batch;
+  {
+    std::lock_guard<std::mutex> lock(notify_batch_mutex);
+    batch = pending_notify_batch;
+    if (batch && batch->entries.size() < BTIF_GATTC_NOTIFY_BATCH_MAX) {
+      batch->Append(notify);
+      return;
+    }
+
+    batch = new NotifyBatch();
+    batch->entries.reserve(BTIF_GATTC_NOTIFY_BATCH_MAX);
+    batch->values.reserve(BTIF_GATTC_NOTIFY_BATCH_MAX *
+                          (GATT_DEF_BLE_MTU_SIZE - 3));
+    batch->Append(notify);
+    pending_notify_batch = batch;
+  }
+
+  /* Notifications, and the BTA events and read/write completions that close
+   * batches, all come from the BTA thread, so nothing is posted in between.
+   * If the task can't be posted, the batch goes with it. */
+  if (do_in_jni_thread(FROM_HERE, Bind(&btif_gattc_deliver_notify_batch,
+                                       Owned(batch))) != BT_STATUS_SUCCESS)
+    LOG_ERROR(LOG_TAG, "%s: notifications dropped", __func__);
+}
+
+/* Events and callbacks other than notifications are posted on their own;
+ * later notifications must not overtake them in a batch posted before. */
+void btif_gattc_close_notify_batch() {
+  std::lock_guard<std::mutex> lock(notify_batch_mutex);
+  pending_notify_batch = nullptr;
+}
+
 void btif_gattc_upstreams_evt(uint16_t event, char* p_param) {
   LOG_VERBOSE(LOG_TAG, "%s: Event %d", __func__, event);
 
@@ -120,26 +221,6 @@ void btif_gattc_upstreams_evt(uint16_t event, char* p_param) {
       break;
     }
 
-    case BTA_GATTC_NOTIF_EVT: {
-      btgatt_notify_params_t data;
-
-      data.bda = p_data->notify.bda;
-      memcpy(data.value, p_data->notify.value, p_data->notify.len);
-
-      data.handle = p_data->notify.handle;
-      data.is_notify = p_data->notify.is_notify;
-      data.len = p_data->notify.len;
-
-      HAL_CBACK(bt_gatt_callbacks, client->notify_cb, p_data->notify.conn_id,
-                data);
-
-      if (!p_data->notify.is_notify)
-        BTA_GATTC_SendIndConfirm(p_data->notify.conn_id, p_data->notify.handle,
-            p_data->notify.trans_id);
-
-      break;
-    }
-
     case BTA_GATTC_OPEN_EVT: {
       VLOG(1) << "BTA_GATTC_OPEN_EVT " << p_data->open.remote_bda;
       HAL_CBACK(bt_gatt_callbacks, client->open_cb, p_data->open.conn_id,
@@ -217,6 +298,12 @@ void btif_gattc_upstreams_evt(uint16_t event, char* p_param) {
 }
 
 void bta_gattc_cback(tBTA_GATTC_EVT event, tBTA_GATTC* p_data) {
+  if (event == BTA_GATTC_NOTIF_EVT) {
+    btif_gattc_queue_notify(p_data->notify);
+    return;
+  }
+
+  btif_gattc_close_notify_batch();
   bt_status_t status =
       btif_transfer_context(btif_gattc_upstreams_evt, (uint16_t)event,
                             (char*)p_data, sizeof(tBTA_GATTC), NULL);
@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "btif/include/btif_scan_result_batcher.h"
+
+namespace {
+
+btgatt_scan_result_record_t make_record(uint8_t n, uint16_t adv_data_len) {
+  btgatt_scan_result_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.event_type = 0x0013;
+  record.bda.address[5] = n;
+  record.rssi = -n;
+  record.adv_data_len = adv_data_len;
+  return record;
+}
+
+const uint8_t kAdv[] = {0x02, 0x01, 0x06, 0x03, 0x09, 'a', 'b'};
+
+}  // namespace
+
+TEST(ScanResultBatcherTest, records_are_packed_back_to_back) {
+  ScanResultBatcher batcher;
+  batcher.Configure(1, 50, 0);
+  ASSERT_TRUE(batcher.Enabled());
+
+  EXPECT_FALSE(batcher.Add(make_record(1, sizeof(kAdv)), kAdv));
+  EXPECT_FALSE(batcher.Add(make_record(2, 0), nullptr));
+  EXPECT_EQ(2U, batcher.NumResults());
+
+  std::vector<uint8_t> results = batcher.Take();
+  EXPECT_EQ(0U, batcher.NumResults());
+  ASSERT_EQ(2 * sizeof(btgatt_scan_result_record_t) + sizeof(kAdv),
+            results.size());
+
+  btgatt_scan_result_record_t record;
+  memcpy(&record, results.data(), sizeof(record));
+  EXPECT_EQ(1, record.bda.address[5]);
+  EXPECT_EQ(-1, record.rssi);
+  EXPECT_EQ(sizeof(kAdv), record.adv_data_len);
+  EXPECT_EQ(0, memcmp(results.data() + sizeof(record), kAdv, sizeof(kAdv)));
+
+  memcpy(&record, results.data() + sizeof(record) + sizeof(kAdv),
+         sizeof(record));
+  EXPECT_EQ(2, record.bda.address[5]);
+  EXPECT_EQ(0, record.adv_data_len);
+}
+
+TEST(ScanResultBatcherTest, tightest_limits_win) {
+  ScanResultBatcher batcher;
+  EXPECT_FALSE(batcher.Enabled());
+
+  batcher.Configure(1, 100, 0);
+  batcher.Configure(2, 20, 3);
+  EXPECT_EQ(20U, batcher.WindowMs());
+  EXPECT_EQ(3U, batcher.MaxResults());
+  EXPECT_EQ(std::vector<int>({1, 2}), batcher.Scanners());
+
+  EXPECT_FALSE(batcher.Add(make_record(1, 0), nullptr));
+  EXPECT_FALSE(batcher.Add(make_record(2, 0), nullptr));
+  EXPECT_TRUE(batcher.Add(make_record(3, 0), nullptr));
+
+  // Back to one result at a time for scanner 2.
+  batcher.Configure(2, 0, 0);
+  EXPECT_EQ(100U, batcher.WindowMs());
+  EXPECT_EQ(size_t{BTIF_SCAN_BATCH_MAX_RESULTS}, batcher.MaxResults());
+}
+
+TEST(ScanResultBatcherTest, each_result_while_a_scanner_does_not_batch) {
+  ScanResultBatcher batcher;
+  batcher.AddScanner(1);
+  batcher.AddScanner(2);
+  EXPECT_TRUE(batcher.DeliverEachResult());
+
+  batcher.Configure(1, 50, 0);
+  EXPECT_TRUE(batcher.DeliverEachResult());
+  batcher.Configure(2, 50, 0);
+  EXPECT_FALSE(batcher.DeliverEachResult());
+
+  batcher.RemoveScanner(2);
+  EXPECT_FALSE(batcher.DeliverEachResult());
+  batcher.RemoveScanner(1);
+  EXPECT_FALSE(batcher.Enabled());
+  EXPECT_TRUE(batcher.DeliverEachResult());
+}
+
+TEST(ScanResultBatcherTest, clear_forgets_everything) {
+  ScanResultBatcher batcher;
+  batcher.AddScanner(1);
+  batcher.Configure(1, 50, 0);
+  batcher.Add(make_record(1, 0), nullptr);
+  EXPECT_FALSE(batcher.DeliverEachResult());
+
+  batcher.Clear();
+  EXPECT_FALSE(batcher.Enabled());
+  EXPECT_EQ(0U, batcher.NumResults());
+  EXPECT_TRUE(batcher.Take().empty());
+  EXPECT_TRUE(batcher.Scanners().empty());
+
+  // A scanner registered afterwards takes each result again.
+  batcher.AddScanner(2);
+  batcher.Configure(3, 50, 0);
+  EXPECT_TRUE(batcher.DeliverEachResult());
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <base/message_loop/message_loop.h>
+#include <benchmark/benchmark.h>
+#include <hardware/bluetooth.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "common/execution_barrier.h"
+#include "osi/include/alarm.h"
+#include "osi/include/wakelock.h"
+
+using ::benchmark::State;
+using bluetooth::common::ExecutionBarrier;
+
+// Roughly the number of live alarms with hundreds of L2CAP channels, GATT
+// connections and security records.
+#define NUM_ALARMS 10000
+
+// Alarms are spread over this window when measuring firing latency.
+#define FIRE_WINDOW_MS 500
+
+base::MessageLoop* get_message_loop() { return nullptr; }
+
+static int acquire_wake_lock_cb(const char* lock_name) {
+  return BT_STATUS_SUCCESS;
+}
+
+static int release_wake_lock_cb(const char* lock_name) {
+  return BT_STATUS_SUCCESS;
+}
+
+static bt_os_callouts_t bt_wakelock_callouts = {
+    sizeof(bt_os_callouts_t), NULL, acquire_wake_lock_cb, release_wake_lock_cb};
+
+static uint64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  return (ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000ULL);
+}
+
+static uint64_t g_expected_fire_us[NUM_ALARMS];
+static std::vector<uint64_t> g_fire_latency_us;
+static std::atomic<int> g_fired;
+static std::unique_ptr<ExecutionBarrier> g_all_fired_barrier;
+
+static void record_fire(void* data) {
+  size_t index = reinterpret_cast<uintptr_t>(data);
+  uint64_t now = now_us();
+  g_fire_latency_us[index] =
+      now > g_expected_fire_us[index] ? now - g_expected_fire_us[index] : 0;
+  if (++g_fired == NUM_ALARMS) g_all_fired_barrier->NotifyFinished();
+}
+
+static void do_nothing(void* data) {}
+
+class BM_Alarm : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    wakelock_set_os_callouts(&bt_wakelock_callouts);
+    for (int i = 0; i < NUM_ALARMS; i++) alarms_.push_back(alarm_new("bench"));
+  }
+
+  void TearDown(State& st) override {
+    for (alarm_t* alarm : alarms_) alarm_free(alarm);
+    alarms_.clear();
+    alarm_cleanup();
+    wakelock_cleanup();
+    wakelock_set_os_callouts(NULL);
+    benchmark::Fixture::TearDown(st);
+  }
+
+  // Pseudo-random but repeatable interval in [base_ms, base_ms + range_ms).
+  static period_ms_t interval(int i, period_ms_t base_ms,
+                              period_ms_t range_ms) {
+    return base_ms + (static_cast<period_ms_t>(i) * 7919) % range_ms;
+  }
+
+  std::vector<alarm_t*> alarms_;
+};
+
+// Cost of arming NUM_ALARMS alarms with scattered far-future deadlines.
+BENCHMARK_F(BM_Alarm, schedule)(State& state) {
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_ALARMS; i++)
+      alarm_set(alarms_[i], interval(i, 60000, 60000), do_nothing, nullptr);
+    state.PauseTiming();
+    for (alarm_t* alarm : alarms_) alarm_cancel(alarm);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_ALARMS);
+}
+
+// Cost of cancelling NUM_ALARMS pending alarms in scheduling order.
+BENCHMARK_F(BM_Alarm, cancel)(State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int i = 0; i < NUM_ALARMS; i++)
+      alarm_set(alarms_[i], interval(i, 60000, 60000), do_nothing, nullptr);
+    state.ResumeTiming();
+    for (alarm_t* alarm : alarms_) alarm_cancel(alarm);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_ALARMS);
+}
+
+// Re-arming already pending alarms, as L2CAP RTX/ERTM timers do on every
+// acknowledged frame.
+BENCHMARK_F(BM_Alarm, reschedule)(State& state) {
+  for (int i = 0; i < NUM_ALARMS; i++)
+    alarm_set(alarms_[i], interval(i, 60000, 60000), do_nothing, nullptr);
+  int round = 0;
+  for (auto _ : state) {
+    round++;
+    for (int i = 0; i < NUM_ALARMS; i++)
+      alarm_set(alarms_[i], interval(i + round, 60000, 60000), do_nothing,
+                nullptr);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_ALARMS);
+}
+
+// Lateness of each callback relative to its deadline with NUM_ALARMS alarms
+// spread over FIRE_WINDOW_MS.
+BENCHMARK_F(BM_Alarm, fire_latency)(State& state) {
+  g_fire_latency_us.assign(NUM_ALARMS, 0);
+  for (auto _ : state) {
+    g_fired = 0;
+    g_all_fired_barrier = std::make_unique<ExecutionBarrier>();
+    uint64_t start_us = now_us();
+    for (int i = 0; i < NUM_ALARMS; i++) {
+      period_ms_t delay_ms = interval(i, 10, FIRE_WINDOW_MS);
+      g_expected_fire_us[i] = start_us + delay_ms * 1000;
+      alarm_set(alarms_[i], delay_ms, record_fire,
+                reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+    }
+    g_all_fired_barrier->WaitForExecution();
+  }
+
+  std::sort(g_fire_latency_us.begin(), g_fire_latency_us.end());
+  uint64_t total_us = 0;
+  for (uint64_t latency : g_fire_latency_us) total_us += latency;
+  state.counters["avg_late_us"] = total_us / NUM_ALARMS;
+  state.counters["p99_late_us"] = g_fire_latency_us[NUM_ALARMS * 99 / 100];
+  state.counters["max_late_us"] = g_fire_latency_us.back();
+}
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
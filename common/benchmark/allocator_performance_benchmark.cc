@@ -0,0 +1,124 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "osi/include/allocation_tracker.h"
+#include "osi/include/allocator.h"
+#include "osi/include/buffer_pool.h"
+
+using ::benchmark::State;
+
+// Number of buffers held at once, roughly the depth of an ACL RX burst.
+#define BURST_SIZE 64
+
+static const allocator_id_t bench_allocator_id = 43;
+
+// The pre-pool osi_malloc path: malloc plus allocation tracker bookkeeping.
+static void* tracked_malloc(size_t size) {
+  void* ptr = malloc(allocation_tracker_resize_for_canary(size));
+  return allocation_tracker_notify_alloc(bench_allocator_id, ptr, size);
+}
+
+static void tracked_free(void* ptr) {
+  free(allocation_tracker_notify_free(bench_allocator_id, ptr));
+}
+
+class BM_Allocator : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    allocation_tracker_init();
+    buffer_pool_reset_stats();
+  }
+  void TearDown(State& st) override {
+    st.counters["hits"] = buffer_pool_hit_count();
+    st.counters["misses"] = buffer_pool_miss_count();
+    buffer_pool_trim();
+    benchmark::Fixture::TearDown(st);
+  }
+};
+
+BENCHMARK_DEFINE_F(BM_Allocator, tracked_malloc_burst)(State& state) {
+  size_t size = state.range(0);
+  void* buffers[BURST_SIZE];
+  for (auto _ : state) {
+    for (int i = 0; i < BURST_SIZE; i++) buffers[i] = tracked_malloc(size);
+    for (int i = 0; i < BURST_SIZE; i++) tracked_free(buffers[i]);
+  }
+  state.SetItemsProcessed(state.iterations() * BURST_SIZE);
+}
+
+BENCHMARK_DEFINE_F(BM_Allocator, osi_malloc_burst)(State& state) {
+  size_t size = state.range(0);
+  void* buffers[BURST_SIZE];
+  for (auto _ : state) {
+    for (int i = 0; i < BURST_SIZE; i++) buffers[i] = osi_malloc(size);
+    for (int i = 0; i < BURST_SIZE; i++) osi_free(buffers[i]);
+  }
+  state.SetItemsProcessed(state.iterations() * BURST_SIZE);
+}
+
+// Allocate on the benchmark thread, free on another one, as HCI RX and the
+// btu thread do.
+BENCHMARK_DEFINE_F(BM_Allocator, tracked_malloc_cross_thread)(State& state) {
+  size_t size = state.range(0);
+  std::vector<void*> buffers(BURST_SIZE);
+  for (auto _ : state) {
+    for (int i = 0; i < BURST_SIZE; i++) buffers[i] = tracked_malloc(size);
+    std::thread consumer([&buffers]() {
+      for (void* ptr : buffers) tracked_free(ptr);
+    });
+    consumer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * BURST_SIZE);
+}
+
+BENCHMARK_DEFINE_F(BM_Allocator, osi_malloc_cross_thread)(State& state) {
+  size_t size = state.range(0);
+  std::vector<void*> buffers(BURST_SIZE);
+  for (auto _ : state) {
+    for (int i = 0; i < BURST_SIZE; i++) buffers[i] = osi_malloc(size);
+    std::thread consumer([&buffers]() {
+      for (void* ptr : buffers) osi_free(ptr);
+    });
+    consumer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * BURST_SIZE);
+}
+
+// HCI event, BT_SMALL_BUFFER_SIZE and BT_DEFAULT_BUFFER_SIZE sized requests.
+BENCHMARK_REGISTER_F(BM_Allocator, tracked_malloc_burst)
+    ->Arg(265)
+    ->Arg(660)
+    ->Arg(4112);
+BENCHMARK_REGISTER_F(BM_Allocator, osi_malloc_burst)
+    ->Arg(265)
+    ->Arg(660)
+    ->Arg(4112);
+BENCHMARK_REGISTER_F(BM_Allocator, tracked_malloc_cross_thread)->Arg(4112);
+BENCHMARK_REGISTER_F(BM_Allocator, osi_malloc_cross_thread)->Arg(4112);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
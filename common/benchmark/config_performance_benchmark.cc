@@ -0,0 +1,139 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "osi/include/config.h"
+
+using ::benchmark::State;
+
+// Number of bonded devices in the synthetic bt_config.conf.
+#define NUM_DEVICES 500
+
+static std::string device_section(int i) {
+  char name[18];
+  snprintf(name, sizeof(name), "00:11:22:%02x:%02x:%02x", (i >> 16) & 0xff,
+           (i >> 8) & 0xff, i & 0xff);
+  return name;
+}
+
+// Writes a bt_config.conf with NUM_DEVICES bonded devices carrying the keys
+// btif_config/btif_storage store for a typical dual-mode device.
+static void write_config(const char* path) {
+  FILE* fp = fopen(path, "w");
+  fprintf(fp,
+          "[Info]\nFileSource = Empty\nTimeCreated = 2019-01-01 00:00:00\n\n"
+          "[Adapter]\nAddress = 00:11:22:ff:ff:ff\nName = bench\n"
+          "ScanMode = 0\nDiscoveryTimeout = 120\n\n");
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    fprintf(fp,
+            "[%s]\nTimestamp = %d\nName = Device %d\nDevClass = 2360344\n"
+            "DevType = 3\nAddrType = 0\nManufacturer = 15\nLmpVer = 9\n"
+            "LmpSubVer = 4096\nService = 0000110b-0000-1000-8000-00805f9b34fb "
+            "0000110e-0000-1000-8000-00805f9b34fb\n"
+            "LinkKeyType = 5\nPinLength = 0\n"
+            "LinkKey = 00112233445566778899aabbccddeeff\n"
+            "LE_KEY_PENC = 00112233445566778899aabbccddeeff0011223344556677"
+            "8899\nLE_KEY_PID = 00112233445566778899aabbccddeeff00112233445566"
+            "\nLE_KEY_LENC = 00112233445566778899aabbccddeeff00112233\n"
+            "AvrcpCtVersion = 1542\nAvrcpFeatures = 8\n\n",
+            device_section(i).c_str(), 1546300800 + i, i);
+  }
+  fclose(fp);
+}
+
+class BM_Config : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    char dir_template[] = "/tmp/config_benchmark.XXXXXX";
+    dir_ = mkdtemp(dir_template);
+    path_ = dir_ + "/bt_config.conf";
+    save_path_ = dir_ + "/bt_config.save.conf";
+    write_config(path_.c_str());
+    for (int i = 0; i < NUM_DEVICES; i++)
+      sections_.push_back(device_section(i));
+  }
+
+  void TearDown(State& st) override {
+    unlink(path_.c_str());
+    unlink(save_path_.c_str());
+    rmdir(dir_.c_str());
+    sections_.clear();
+    benchmark::Fixture::TearDown(st);
+  }
+
+  std::string dir_;
+  std::string path_;
+  std::string save_path_;
+  std::vector<std::string> sections_;
+};
+
+// Parsing the whole file at stack start-up.
+BENCHMARK_F(BM_Config, load)(State& state) {
+  for (auto _ : state) {
+    config_t* config = config_new(path_.c_str());
+    benchmark::DoNotOptimize(config);
+    config_free(config);
+  }
+}
+
+// Reading one key from every device, as btif_storage_load_bonded_devices
+// does for each of a few dozen keys.
+BENCHMARK_F(BM_Config, get_string)(State& state) {
+  config_t* config = config_new(path_.c_str());
+  for (auto _ : state) {
+    for (const std::string& section : sections_)
+      benchmark::DoNotOptimize(
+          config_get_string(config, section.c_str(), "LinkKey", NULL));
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_DEVICES);
+  config_free(config);
+}
+
+// Updating an existing key in every device, e.g. connection timestamps.
+BENCHMARK_F(BM_Config, set_existing)(State& state) {
+  config_t* config = config_new(path_.c_str());
+  int round = 0;
+  for (auto _ : state) {
+    round++;
+    for (const std::string& section : sections_)
+      config_set_int(config, section.c_str(), "Timestamp", round);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_DEVICES);
+  config_free(config);
+}
+
+// Writing the whole file back, as every btif_config flush does.
+BENCHMARK_F(BM_Config, save)(State& state) {
+  config_t* config = config_new(path_.c_str());
+  for (auto _ : state) config_save(config, save_path_.c_str());
+  config_free(config);
+}
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -63,6 +63,15 @@ void callback_batch(fixed_queue_t* queue, void* data) {
   }
 }
 
+// Drains everything currently visible in |queue| in one reactor wakeup.
+void callback_batch_drain(fixed_queue_t* queue, void* data) {
+  CHECK_NE(queue, nullptr);
+  while (fixed_queue_try_dequeue(queue) != nullptr) g_counter++;
+  if (g_counter >= NUM_MESSAGES_TO_SEND) {
+    g_counter_barrier->NotifyFinished();
+  }
+}
+
 class BM_ThreadPerformance : public ::benchmark::Fixture {
  protected:
   void SetUp(State& st) override {
@@ -308,6 +317,72 @@ BENCHMARK_F(BM_OsiReactorThread, sequential_execution_using_reactor)
   }
 };
 
+// Same as BM_OsiReactorThread, but with the lock-free ring variant of
+// fixed_queue_t in place of the mutex/semaphore one.
+class BM_OsiReactorRingThread : public BM_OsiReactorThread {
+ protected:
+  void SetUp(State& st) override {
+    BM_OsiReactorThread::SetUp(st);
+    fixed_queue_free(bt_msg_queue_, nullptr);
+    bt_msg_queue_ =
+        fixed_queue_new_ring(NUM_MESSAGES_TO_SEND, FIXED_QUEUE_SPSC);
+  }
+};
+
+BENCHMARK_F(BM_OsiReactorRingThread, batch_enque_dequeue_using_reactor)
+(State& state) {
+  fixed_queue_register_dequeue(bt_msg_queue_, thread_get_reactor(thread_),
+                               callback_batch, nullptr);
+  for (auto _ : state) {
+    g_counter = 0;
+    g_counter_barrier = std::make_unique<ExecutionBarrier>();
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      fixed_queue_enqueue(bt_msg_queue_, (void*)&g_counter);
+    }
+    g_counter_barrier->WaitForExecution();
+  }
+};
+
+BENCHMARK_F(BM_OsiReactorRingThread, sequential_execution_using_reactor)
+(State& state) {
+  fixed_queue_register_dequeue(bt_msg_queue_, thread_get_reactor(thread_),
+                               callback_sequential_queue, nullptr);
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      g_counter_barrier = std::make_unique<ExecutionBarrier>();
+      fixed_queue_enqueue(bt_msg_queue_, (void*)&g_counter);
+      g_counter_barrier->WaitForExecution();
+    }
+  }
+};
+
+BENCHMARK_F(BM_OsiReactorThread, batch_drain_using_reactor)(State& state) {
+  fixed_queue_register_dequeue(bt_msg_queue_, thread_get_reactor(thread_),
+                               callback_batch_drain, nullptr);
+  for (auto _ : state) {
+    g_counter = 0;
+    g_counter_barrier = std::make_unique<ExecutionBarrier>();
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      fixed_queue_enqueue(bt_msg_queue_, (void*)&g_counter);
+    }
+    g_counter_barrier->WaitForExecution();
+  }
+};
+
+BENCHMARK_F(BM_OsiReactorRingThread, batch_drain_using_reactor)
+(State& state) {
+  fixed_queue_register_dequeue(bt_msg_queue_, thread_get_reactor(thread_),
+                               callback_batch_drain, nullptr);
+  for (auto _ : state) {
+    g_counter = 0;
+    g_counter_barrier = std::make_unique<ExecutionBarrier>();
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      fixed_queue_enqueue(bt_msg_queue_, (void*)&g_counter);
+    }
+    g_counter_barrier->WaitForExecution();
+  }
+};
+
 class BM_MessageLooopThread : public BM_ThreadPerformance {
  protected:
   void SetUp(State& st) override {
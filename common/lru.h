@@ -0,0 +1,148 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include <base/logging.h>
+
+namespace bluetooth {
+namespace common {
+
+/**
+ * Fixed capacity map that evicts the least recently used entry when full.
+ *
+ * Not thread safe; callers are expected to use it from a single thread (e.g.
+ * the btu thread) or provide their own locking.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache {
+ public:
+  using Entry = std::pair<K, V>;
+
+  explicit LruCache(size_t capacity) : capacity_(capacity) {
+    CHECK(capacity_ > 0) << __func__ << ": capacity must be positive";
+    map_.reserve(capacity_);
+  }
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  /**
+   * Return a pointer to the value for |key| and mark it as most recently used,
+   * or nullptr if absent. The pointer is invalidated by Put, Remove or Clear.
+   */
+  V* Get(const K& key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return nullptr;
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+    return &it->second->second;
+  }
+
+  /**
+   * Same as Get but does not change the eviction order.
+   */
+  V* Peek(const K& key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return nullptr;
+    return &it->second->second;
+  }
+
+  /**
+   * Insert or replace the value for |key| and mark it as most recently used.
+   * If an entry had to be evicted to make room, it is stored in |evicted| when
+   * that is not nullptr.
+   *
+   * @return true if an entry was evicted
+   */
+  bool Put(const K& key, V value, Entry* evicted = nullptr) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      it->second->second = std::move(value);
+      lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+      return false;
+    }
+
+    bool did_evict = false;
+    if (map_.size() >= capacity_) {
+      auto& oldest = lru_list_.back();
+      map_.erase(oldest.first);
+      if (evicted != nullptr) *evicted = std::move(oldest);
+      lru_list_.pop_back();
+      did_evict = true;
+    }
+    lru_list_.emplace_front(key, std::move(value));
+    map_[key] = lru_list_.begin();
+    return did_evict;
+  }
+
+  /**
+   * Remove |key| from the cache.
+   *
+   * @return true if it was present
+   */
+  bool Remove(const K& key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return false;
+    lru_list_.erase(it->second);
+    map_.erase(it);
+    return true;
+  }
+
+  /**
+   * Remove every entry for which |pred(key, value)| returns true.
+   *
+   * @return number of entries removed
+   */
+  template <typename Pred>
+  size_t RemoveIf(Pred pred) {
+    size_t removed = 0;
+    for (auto it = lru_list_.begin(); it != lru_list_.end();) {
+      if (pred(it->first, it->second)) {
+        map_.erase(it->first);
+        it = lru_list_.erase(it);
+        removed++;
+      } else {
+        ++it;
+      }
+    }
+    return removed;
+  }
+
+  void Clear() {
+    map_.clear();
+    lru_list_.clear();
+  }
+
+  size_t Size() const { return map_.size(); }
+
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  const size_t capacity_;
+  // Most recently used entry first.
+  std::list<Entry> lru_list_;
+  std::unordered_map<K, typename std::list<Entry>::iterator, Hash> map_;
+};
+
+}  // namespace common
+}  // namespace bluetooth
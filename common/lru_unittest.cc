@@ -0,0 +1,77 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "lru.h"
+
+#include <gtest/gtest.h>
+
+using bluetooth::common::LruCache;
+
+TEST(LruCacheTest, get_and_put) {
+  LruCache<int, int> cache(3);
+  EXPECT_EQ(nullptr, cache.Get(1));
+  EXPECT_FALSE(cache.Put(1, 10));
+  EXPECT_FALSE(cache.Put(2, 20));
+  ASSERT_NE(nullptr, cache.Get(1));
+  EXPECT_EQ(10, *cache.Get(1));
+
+  // Replacing does not evict.
+  EXPECT_FALSE(cache.Put(1, 11));
+  EXPECT_EQ(11, *cache.Get(1));
+  EXPECT_EQ(2U, cache.Size());
+}
+
+TEST(LruCacheTest, evicts_least_recently_used) {
+  LruCache<int, int> cache(3);
+  cache.Put(1, 10);
+  cache.Put(2, 20);
+  cache.Put(3, 30);
+
+  // 1 becomes the most recently used, so 2 is evicted next.
+  cache.Get(1);
+  std::pair<int, int> evicted;
+  EXPECT_TRUE(cache.Put(4, 40, &evicted));
+  EXPECT_EQ(2, evicted.first);
+  EXPECT_EQ(20, evicted.second);
+  EXPECT_EQ(nullptr, cache.Peek(2));
+  EXPECT_EQ(3U, cache.Size());
+
+  // Peek does not refresh 3, so it goes next.
+  cache.Peek(3);
+  EXPECT_TRUE(cache.Put(5, 50, &evicted));
+  EXPECT_EQ(3, evicted.first);
+}
+
+TEST(LruCacheTest, remove_and_clear) {
+  LruCache<int, int> cache(4);
+  for (int i = 0; i < 4; i++) cache.Put(i, i * 10);
+
+  EXPECT_TRUE(cache.Remove(2));
+  EXPECT_FALSE(cache.Remove(2));
+  EXPECT_EQ(3U, cache.Size());
+
+  EXPECT_EQ(1U, cache.RemoveIf(
+                    [](int /* key */, int value) { return value == 30; }));
+  EXPECT_EQ(nullptr, cache.Peek(3));
+  EXPECT_EQ(2U, cache.Size());
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.Size());
+  EXPECT_EQ(nullptr, cache.Get(0));
+  EXPECT_FALSE(cache.Put(7, 70));
+}
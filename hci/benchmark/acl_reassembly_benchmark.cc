@@ -0,0 +1,171 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "bt_hdr_chain.h"
+#include "device/include/controller.h"
+#include "hci_internals.h"
+#include "osi/include/allocator.h"
+#include "packet_fragmenter.h"
+
+using ::benchmark::State;
+
+// LE CoC SDUs received per iteration, and their size: about 64 KB, as large
+// as fits in one K-frame.
+#define NUM_SDUS 16
+#define SDU_SIZE 65525
+
+// Data in the LE ACL packets from the controller.
+#define LE_ACL_DATA_SIZE 251
+
+namespace {
+
+const allocator_t plain_allocator = {malloc, free};
+
+// The SDU being put together, as l2c_lcc_proc_pdu and l2c_lcc_proc_chain do.
+std::vector<uint8_t> sdu(SDU_SIZE);
+size_t sdu_len;
+size_t sdu_expected;
+size_t sdus_received;
+
+// Notes |len| more bytes were copied into the SDU.
+void sdu_grew(size_t len) {
+  sdu_len += len;
+  if (sdu_len == sdu_expected) {
+    benchmark::DoNotOptimize(sdu[sdu_len - 1]);
+    sdus_received++;
+    sdu_len = 0;
+    sdu_expected = 0;
+  }
+}
+
+// Skips the ACL and L2CAP headers of a K-frame, and copies its data into the
+// SDU.
+void reassembled(BT_HDR* packet) {
+  if (packet->event == MSG_HC_TO_STACK_HCI_ACL_CHAIN) {
+    BtHdrChain* chain = BtHdrChain::Unwrap(packet);
+    chain->TrimFront(HCI_ACL_PREAMBLE_SIZE + 4);
+    if (sdu_expected == 0) {
+      uint16_t length = 0;
+      chain->ReadUint16(0, &length);
+      chain->TrimFront(2);
+      sdu_expected = length;
+    }
+    size_t len = chain->Len();
+    chain->MoveTo(sdu.data() + sdu_len);
+    sdu_grew(len);
+    delete chain;
+    return;
+  }
+
+  uint8_t* data = packet->data + packet->offset + HCI_ACL_PREAMBLE_SIZE + 4;
+  size_t len = packet->len - HCI_ACL_PREAMBLE_SIZE - 4;
+  if (sdu_expected == 0) {
+    sdu_expected = data[0] | (data[1] << 8);
+    data += 2;
+    len -= 2;
+  }
+  memcpy(sdu.data() + sdu_len, data, len);
+  sdu_grew(len);
+  free(packet);
+}
+
+void fragmented(BT_HDR*, bool) {}
+void transmit_finished(BT_HDR*, bool) {}
+
+// The ACL packets carrying NUM_SDUS SDUs in K-frames of up to |mps| bytes.
+std::vector<BT_HDR*> make_fragments(size_t mps) {
+  std::vector<BT_HDR*> fragments;
+  std::vector<uint8_t> payload(2 + SDU_SIZE, 0x5a);
+  payload[0] = SDU_SIZE & 0xff;
+  payload[1] = SDU_SIZE >> 8;
+
+  for (size_t i = 0; i < NUM_SDUS; i++) {
+    for (size_t pdu = 0; pdu < payload.size(); pdu += mps) {
+      size_t pdu_len = std::min(mps, payload.size() - pdu);
+      std::vector<uint8_t> frame(4 + pdu_len);
+      uint8_t* p = frame.data();
+      UINT16_TO_STREAM(p, pdu_len);
+      UINT16_TO_STREAM(p, 0x0040);  // the CID
+      memcpy(p, payload.data() + pdu, pdu_len);
+
+      for (size_t pos = 0; pos < frame.size(); pos += LE_ACL_DATA_SIZE) {
+        size_t len = std::min<size_t>(LE_ACL_DATA_SIZE, frame.size() - pos);
+        BT_HDR* packet = static_cast<BT_HDR*>(
+            malloc(BT_HDR_SIZE + HCI_ACL_PREAMBLE_SIZE + len));
+        packet->event = MSG_HC_TO_STACK_HCI_ACL;
+        packet->offset = 0;
+        packet->len = HCI_ACL_PREAMBLE_SIZE + len;
+        packet->layer_specific = 0;
+        p = packet->data;
+        UINT16_TO_STREAM(p, pos == 0 ? 0x2040 : 0x1040);
+        UINT16_TO_STREAM(p, len);
+        memcpy(p, frame.data() + pos, len);
+        fragments.push_back(packet);
+      }
+    }
+  }
+  return fragments;
+}
+
+template <bool chained>
+void BM_ReassembleSdus(State& state) {
+  controller_t controller = {};
+  const packet_fragmenter_t* fragmenter =
+      packet_fragmenter_get_test_interface(&controller, &plain_allocator);
+  packet_fragmenter_callbacks_t callbacks = {fragmented, reassembled,
+                                             transmit_finished, NULL};
+  fragmenter->init(&callbacks);
+  fragmenter->set_chained_reassembly(chained);
+  sdus_received = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<BT_HDR*> fragments = make_fragments(state.range(0));
+    state.ResumeTiming();
+
+    for (BT_HDR* fragment : fragments)
+      fragmenter->reassemble_and_dispatch(fragment);
+  }
+
+  fragmenter->cleanup();
+  if (sdus_received != static_cast<size_t>(state.iterations()) * NUM_SDUS)
+    state.SkipWithError("SDUs lost");
+  state.SetBytesProcessed(state.iterations() * NUM_SDUS * SDU_SIZE);
+}
+
+}  // namespace
+
+// MPS: the largest K-frame that fits in BT_DEFAULT_BUFFER_SIZE, which is as
+// far as copying reassembly goes; and one K-frame per SDU, which only
+// chaining can take.
+BENCHMARK_TEMPLATE(BM_ReassembleSdus, false)->Arg(4000);
+BENCHMARK_TEMPLATE(BM_ReassembleSdus, true)->Arg(4000)->Arg(SDU_SIZE + 2);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
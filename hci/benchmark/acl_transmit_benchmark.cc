@@ -0,0 +1,187 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "device/include/controller.h"
+#include "hci_internals.h"
+#include "hci_tx_batch.h"
+#include "osi/include/allocator.h"
+#include "packet_fragmenter.h"
+
+using ::benchmark::State;
+
+// L2CAP data sent per iteration.
+#define TOTAL_BYTES (1024 * 1024)
+
+namespace {
+
+const allocator_t plain_allocator = {malloc, free};
+
+uint16_t acl_data_size;
+uint16_t get_acl_data_size() { return acl_data_size; }
+
+int tx_fd = -1;
+size_t syscalls;
+
+// What hci_layer_linux did with every fragment: one write() with the H4 type
+// byte put in front of it.
+void write_fragment(BT_HDR* packet, bool send_transmit_finished) {
+  uint8_t* addr = packet->data + packet->offset - 1;
+  uint8_t store = *addr;
+  *addr = HCI_PACKET_TYPE_ACL_DATA;
+  ssize_t ret = write(tx_fd, addr, packet->len + 1);
+  *addr = store;
+  syscalls++;
+  if (ret != packet->len + 1) abort();
+  if (send_transmit_finished) free(packet);
+}
+
+void write_batch(HciTxBatch* batch) {
+  if (!batch->Write(tx_fd, &syscalls)) abort();
+  for (BT_HDR* packet : batch->released()) free(packet);
+  batch->Clear();
+}
+
+void reassembled(BT_HDR* packet) { free(packet); }
+void transmit_finished(BT_HDR* packet, bool) { free(packet); }
+
+// The controller: reads everything written to the socket.
+class Controller {
+ public:
+  Controller() {
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv_);
+    tx_fd = sv_[0];
+  }
+
+  ~Controller() {
+    close(sv_[0]);
+    close(sv_[1]);
+  }
+
+  std::thread Receive(size_t bytes) {
+    return std::thread([this, bytes] {
+      std::vector<uint8_t> buf(65536);
+      size_t received = 0;
+      while (received < bytes) {
+        ssize_t ret = read(sv_[1], buf.data(), buf.size());
+        if (ret <= 0) return;
+        received += ret;
+      }
+    });
+  }
+
+ private:
+  int sv_[2];
+};
+
+// L2CAP SDUs of |sdu_size| bytes making up TOTAL_BYTES, as ACL packets.
+std::vector<BT_HDR*> make_sdus(size_t sdu_size, size_t* wire_bytes) {
+  std::vector<BT_HDR*> sdus;
+  size_t fragments_per_sdu = (sdu_size + acl_data_size - 1) / acl_data_size;
+  *wire_bytes = 0;
+  for (size_t sent = 0; sent < TOTAL_BYTES; sent += sdu_size) {
+    // One byte of headroom for the H4 type, as from L2CAP
+    BT_HDR* packet = static_cast<BT_HDR*>(
+        malloc(BT_HDR_SIZE + 1 + HCI_ACL_PREAMBLE_SIZE + sdu_size));
+    packet->event = MSG_STACK_TO_HC_HCI_ACL;
+    packet->offset = 1;
+    packet->len = HCI_ACL_PREAMBLE_SIZE + sdu_size;
+    packet->layer_specific = 0;
+    uint8_t* p = packet->data + packet->offset;
+    UINT16_TO_STREAM(p, 0x2001);
+    UINT16_TO_STREAM(p, sdu_size);
+    memset(p, static_cast<uint8_t>(sent), sdu_size);
+    sdus.push_back(packet);
+    *wire_bytes += fragments_per_sdu * (1 + HCI_ACL_PREAMBLE_SIZE) + sdu_size;
+  }
+  return sdus;
+}
+
+template <bool batched>
+void BM_TransmitL2cap(State& state) {
+  acl_data_size = state.range(1);
+  controller_t controller;
+  controller.get_acl_data_size_classic = get_acl_data_size;
+  controller.get_acl_data_size_ble = get_acl_data_size;
+  const packet_fragmenter_t* fragmenter =
+      packet_fragmenter_get_test_interface(&controller, &plain_allocator);
+  packet_fragmenter_callbacks_t callbacks = {write_fragment, reassembled,
+                                             transmit_finished, write_batch};
+  fragmenter->init(&callbacks);
+
+  Controller receiver;
+  HciTxBatch batch;
+  size_t sdus_sent = 0;
+  size_t l2cap_bytes = 0;
+  syscalls = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    size_t wire_bytes;
+    std::vector<BT_HDR*> sdus = make_sdus(state.range(0), &wire_bytes);
+    std::thread reader = receiver.Receive(wire_bytes);
+    state.ResumeTiming();
+
+    for (BT_HDR* sdu : sdus) {
+      if (batched) {
+        fragmenter->fragment_and_batch(sdu, &batch);
+      } else {
+        fragmenter->fragment_and_dispatch(sdu);
+      }
+    }
+    if (batched) write_batch(&batch);
+    reader.join();
+    sdus_sent += sdus.size();
+    l2cap_bytes += sdus.size() * state.range(0);
+  }
+
+  fragmenter->cleanup();
+  state.SetBytesProcessed(l2cap_bytes);
+  state.counters["syscalls_per_sdu"] =
+      static_cast<double>(syscalls) / sdus_sent;
+}
+
+}  // namespace
+
+// {SDU size, controller ACL data size}: the default L2CAP MTU and a large
+// SDU, over BR/EDR 3-DH5 and LE packets.
+BENCHMARK_TEMPLATE(BM_TransmitL2cap, false)
+    ->Args({672, 1021})
+    ->Args({4096, 1021})
+    ->Args({4096, 251})
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_TransmitL2cap, true)
+    ->Args({672, 1021})
+    ->Args({4096, 1021})
+    ->Args({4096, 251})
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "btsnoop_ring.h"
+
+using ::benchmark::State;
+
+// Packets captured per iteration: a burst that fits in the ring.
+#define BURST 256
+
+namespace {
+
+// A btsnoop record header, as btsnoop.cc writes it.
+struct __attribute__((__packed__)) RecordHeader {
+  uint32_t length_original;
+  uint32_t length_captured;
+  uint32_t flags;
+  uint32_t dropped_packets;
+  uint64_t timestamp;
+  uint8_t type;
+};
+
+RecordHeader make_header(size_t len) {
+  RecordHeader header = {};
+  header.length_original = header.length_captured = len + 1;
+  header.type = 2;
+  return header;
+}
+
+// What btsnoop_write_packet did on the capturing thread for every packet: a
+// poll() and a writev() to the log file.
+void BM_CaptureSync(State& state) {
+  FILE* log = tmpfile();
+  int fd = fileno(log);
+  std::vector<uint8_t> packet(state.range(0), 0x5a);
+  RecordHeader header = make_header(packet.size());
+
+  for (auto _ : state) {
+    for (int i = 0; i < BURST; i++) {
+      struct pollfd fds = {fd, POLLOUT, 0};
+      struct iovec iov[] = {{&header, sizeof(header)},
+                            {packet.data(), packet.size()}};
+      if (poll(&fds, 1, 0) > 0 && fds.revents & POLLOUT) {
+        benchmark::DoNotOptimize(writev(fd, iov, 2));
+      }
+    }
+  }
+
+  fclose(log);
+  state.SetItemsProcessed(state.iterations() * BURST);
+}
+
+// The ring push that replaces it, with a writer thread draining the ring to
+// the log file in batches as btsnoop.cc does. The writer catches up between
+// bursts, so no packet is dropped.
+void BM_CaptureAsync(State& state) {
+  FILE* log = tmpfile();
+  int fd = fileno(log);
+  std::vector<uint8_t> packet(state.range(0), 0x5a);
+  RecordHeader header = make_header(packet.size());
+  BtsnoopRing ring;
+  std::atomic<bool> stop(false);
+
+  std::thread writer([&] {
+    std::vector<struct iovec> iov;
+    while (!stop.load()) {
+      size_t consumed = ring.ForEachRecord([&](uint8_t* record, size_t len) {
+        iov.push_back({record, len});
+      });
+      for (size_t i = 0; i < iov.size(); i += IOV_MAX) {
+        benchmark::DoNotOptimize(
+            writev(fd, &iov[i], std::min<size_t>(IOV_MAX, iov.size() - i)));
+      }
+      iov.clear();
+      ring.Consume(consumed);
+      if (consumed == 0) usleep(1000);
+    }
+  });
+
+  for (auto _ : state) {
+    for (int i = 0; i < BURST; i++)
+      ring.Push(&header, sizeof(header), packet.data(), packet.size());
+
+    state.PauseTiming();
+    while (ring.Pending() != 0) usleep(100);
+    state.ResumeTiming();
+  }
+
+  stop = true;
+  writer.join();
+  fclose(log);
+  state.SetItemsProcessed(state.iterations() * BURST);
+  state.counters["dropped"] = ring.Dropped();
+}
+
+}  // namespace
+
+// An HCI event, and a full BR/EDR 3-DH5 ACL packet.
+BENCHMARK(BM_CaptureSync)->Arg(16)->Arg(1021);
+BENCHMARK(BM_CaptureAsync)->Arg(16)->Arg(1021);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
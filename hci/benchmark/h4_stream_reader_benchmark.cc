@@ -0,0 +1,166 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "h4_stream_reader.h"
+#include "hci_internals.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// ACL packets sent by the controller stand-in per iteration.
+#define NUM_PACKETS 4096
+
+namespace {
+
+const allocator_t plain_allocator = {malloc, free};
+
+// The controller: writes ACL packets with |payload_size| bytes of data to the
+// socket as fast as the reader takes them.
+class Controller {
+ public:
+  Controller(size_t payload_size) {
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv_);
+    for (size_t i = 0; i < NUM_PACKETS; i++) {
+      stream_.push_back(HCI_PACKET_TYPE_ACL_DATA);
+      stream_.push_back(0x01);
+      stream_.push_back(0x20);
+      stream_.push_back(payload_size & 0xff);
+      stream_.push_back(payload_size >> 8);
+      stream_.insert(stream_.end(), payload_size, static_cast<uint8_t>(i));
+    }
+  }
+
+  ~Controller() {
+    close(sv_[0]);
+    close(sv_[1]);
+  }
+
+  // Starts sending one iteration worth of packets.
+  std::thread Send() {
+    return std::thread([this] {
+      size_t pos = 0;
+      while (pos < stream_.size()) {
+        ssize_t ret = write(sv_[1], stream_.data() + pos,
+                            std::min<size_t>(65536, stream_.size() - pos));
+        if (ret <= 0) return;
+        pos += ret;
+      }
+    });
+  }
+
+  int fd() const { return sv_[0]; }
+  size_t bytes() const { return stream_.size(); }
+
+ private:
+  int sv_[2];
+  std::vector<uint8_t> stream_;
+};
+
+ssize_t read_all(int fd, uint8_t* buf, size_t len, size_t* reads) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t ret = read(fd, buf + done, len - done);
+    (*reads)++;
+    if (ret <= 0) return ret;
+    done += ret;
+  }
+  return done;
+}
+
+// What monitor_socket_stream did before: a read for the type, one for the
+// header and one for the payload, into a BT_HDR big enough for any packet.
+void BM_ReadPerPacket(State& state) {
+  Controller controller(state.range(0));
+  size_t reads = 0;
+  uint8_t buf[2000];
+
+  for (auto _ : state) {
+    std::thread sender = controller.Send();
+    for (size_t i = 0; i < NUM_PACKETS; i++) {
+      read_all(controller.fd(), buf, 1, &reads);
+      read_all(controller.fd(), buf + 1, HCI_ACL_PREAMBLE_SIZE, &reads);
+      size_t len = buf[3] | (buf[4] << 8);
+      BT_HDR* packet = static_cast<BT_HDR*>(malloc(2000 + BT_HDR_SIZE));
+      read_all(controller.fd(), buf + 1 + HCI_ACL_PREAMBLE_SIZE, len, &reads);
+      packet->len = HCI_ACL_PREAMBLE_SIZE + len;
+      memcpy(packet->data, buf + 1, packet->len);
+      benchmark::DoNotOptimize(packet->data[0]);
+      free(packet);
+    }
+    sender.join();
+  }
+
+  state.SetBytesProcessed(state.iterations() * controller.bytes());
+  state.counters["packets"] = Counter(state.iterations() * NUM_PACKETS,
+                                      Counter::kIsRate);
+  state.counters["reads_per_packet"] =
+      static_cast<double>(reads) / (state.iterations() * NUM_PACKETS);
+}
+
+void BM_H4StreamReader(State& state) {
+  Controller controller(state.range(0));
+  H4StreamReader reader(&plain_allocator);
+  std::vector<BT_HDR*> packets;
+  size_t reads = 0;
+
+  for (auto _ : state) {
+    std::thread sender = controller.Send();
+    size_t received = 0;
+    while (received < NUM_PACKETS) {
+      if (reader.Read(controller.fd()) <= 0) break;
+      reads++;
+      reader.Frame(&packets);
+      for (BT_HDR* packet : packets) {
+        benchmark::DoNotOptimize(packet->data[0]);
+        free(packet);
+      }
+      received += packets.size();
+      packets.clear();
+    }
+    sender.join();
+  }
+
+  state.SetBytesProcessed(state.iterations() * controller.bytes());
+  state.counters["packets"] = Counter(state.iterations() * NUM_PACKETS,
+                                      Counter::kIsRate);
+  state.counters["reads_per_packet"] =
+      static_cast<double>(reads) / (state.iterations() * NUM_PACKETS);
+}
+
+}  // namespace
+
+// LE data length 251, and the largest BR/EDR packet, 3-DH5.
+BENCHMARK(BM_ReadPerPacket)->Arg(251)->Arg(1021)->UseRealTime();
+BENCHMARK(BM_H4StreamReader)->Arg(251)->Arg(1021)->UseRealTime();
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include <vector>
+
+// A compressed btsnoop log holds the usual btsnoop records in blocks, each
+// one deflated on its own:
+//
+//   file header:   "btsnoopz" | version (4) | datalink (4)
+//   repeated {
+//     block header:  compressed length (4) | length (4) | records (4) |
+//                    first timestamp (8) | last timestamp (8)
+//     deflate { repeated { btsnoop record } }
+//   }
+//
+// Integers are big endian, as in btsnoop. The block headers make up an index:
+// a reader can hop from one to the next and only inflate the blocks covering
+// the time it is after. tools/scripts/btsnoopz.py turns a compressed log back
+// into a btsnoop one.
+
+#define BTSNOOPZ_VERSION 1
+#define BTSNOOPZ_FILE_HEADER_SIZE 16
+#define BTSNOOPZ_BLOCK_HEADER_SIZE 28
+
+// Uncompressed bytes of records gathered before a block is written out.
+#ifndef BTSNOOPZ_BLOCK_SIZE
+#define BTSNOOPZ_BLOCK_SIZE (64 * 1024)
+#endif
+
+typedef struct {
+  off_t offset;  // of the compressed data
+  uint32_t compressed_len;
+  uint32_t len;
+  uint32_t records;
+  uint64_t first_timestamp;
+  uint64_t last_timestamp;
+} btsnoopz_block_t;
+
+// Gathers btsnoop records and writes them out as compressed blocks. Not
+// thread safe.
+class BtsnoopBlockWriter {
+ public:
+  explicit BtsnoopBlockWriter(size_t block_size = BTSNOOPZ_BLOCK_SIZE);
+  ~BtsnoopBlockWriter();
+
+  BtsnoopBlockWriter(const BtsnoopBlockWriter&) = delete;
+  BtsnoopBlockWriter& operator=(const BtsnoopBlockWriter&) = delete;
+
+  // Writes the header of a compressed log to |fd|.
+  static bool WriteFileHeader(int fd);
+
+  // Adds the btsnoop record of |len| bytes at |record|: its header, then the
+  // bytes captured.
+  void Add(const uint8_t* record, size_t len);
+
+  bool Full() const { return block_.size() >= block_size_; }
+  bool Empty() const { return records_ == 0; }
+
+  // Compresses the records added into a block and writes it to |fd|. The
+  // records are gone afterwards, written out or not.
+  bool Flush(int fd);
+
+  // Bytes of records added, and of blocks written, so far.
+  uint64_t BytesIn() const { return bytes_in_; }
+  uint64_t BytesOut() const { return bytes_out_; }
+
+ private:
+  size_t block_size_;
+  z_stream stream_;
+  bool stream_ok_;
+  std::vector<uint8_t> block_;
+  std::vector<uint8_t> compressed_;
+  uint32_t records_ = 0;
+  uint64_t first_timestamp_ = 0;
+  uint64_t last_timestamp_ = 0;
+  uint64_t bytes_in_ = 0;
+  uint64_t bytes_out_ = 0;
+};
+
+// Reads the block headers of the compressed log in |fd| into |index|. A block
+// cut short, as the last one may be, is left out. Returns false if |fd| does
+// not hold a compressed log.
+bool btsnoopz_read_index(int fd, std::vector<btsnoopz_block_t>* index);
+
+// Inflates the records of |block| in the compressed log in |fd| into
+// |records|.
+bool btsnoopz_read_block(int fd, const btsnoopz_block_t& block,
+                         std::vector<uint8_t>* records);
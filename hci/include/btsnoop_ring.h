@@ -0,0 +1,143 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+/* Bytes of captured packets that can wait for the btsnoop writer. Rounded up
+ * to a power of two. */
+#ifndef BTSNOOP_RING_SIZE
+#define BTSNOOP_RING_SIZE (1024 * 1024)
+#endif
+
+/* Records on their way from the thread capturing HCI packets to the one
+ * writing them to the btsnoop log.
+ *
+ * One producer and one consumer share the ring without locking. Each record
+ * is kept in one piece, so the consumer can hand it to writev() where it
+ * lies. A record that does not fit is dropped and counted rather than waited
+ * for: capturing must never hold up the HCI thread. */
+class BtsnoopRing {
+ public:
+  explicit BtsnoopRing(size_t size = BTSNOOP_RING_SIZE)
+      : buffer_(round_up_pow2(size)), mask_(buffer_.size() - 1) {}
+
+  BtsnoopRing(const BtsnoopRing&) = delete;
+  BtsnoopRing& operator=(const BtsnoopRing&) = delete;
+
+  /* Producer: adds a record made of the |header_len| bytes at |header|
+   * followed by the |len| bytes at |data|. Returns false, and counts a drop,
+   * if there is no room for it. */
+  bool Push(const void* header, size_t header_len, const void* data,
+            size_t len) {
+    size_t record_len = header_len + len;
+    size_t need = align(sizeof(uint32_t) + record_len);
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t to_end = buffer_.size() - (head & mask_);
+
+    // A record that would run off the end starts over at the beginning, the
+    // bytes skipped marked as such.
+    size_t skip = need > to_end ? to_end : 0;
+    if (need > buffer_.size() || buffer_.size() - (head - tail) < skip + need) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (skip != 0) {
+      put_length(head, kSkip);
+      head += skip;
+    }
+
+    put_length(head, record_len);
+    uint8_t* p = &buffer_[(head & mask_) + sizeof(uint32_t)];
+    memcpy(p, header, header_len);
+    memcpy(p + header_len, data, len);
+    head_.store(head + need, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer: calls |fn(uint8_t* record, size_t len)| for each record
+   * waiting, oldest first. The records stay in place, and may be written to,
+   * until Consume() is given the bytes returned. */
+  template <typename Fn>
+  size_t ForEachRecord(Fn fn) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t pos = tail;
+    while (pos != head) {
+      uint32_t len;
+      memcpy(&len, &buffer_[pos & mask_], sizeof(len));
+      if (len == kSkip) {
+        pos += buffer_.size() - (pos & mask_);
+        continue;
+      }
+      fn(&buffer_[(pos & mask_) + sizeof(uint32_t)], len);
+      pos += align(sizeof(uint32_t) + len);
+    }
+    return pos - tail;
+  }
+
+  /* Consumer: frees the |bytes| visited by ForEachRecord(). */
+  void Consume(size_t bytes) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + bytes,
+                std::memory_order_release);
+  }
+
+  size_t Size() const { return buffer_.size(); }
+
+  /* Bytes taken by the records waiting. */
+  size_t Pending() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  /* Records dropped since the ring was made. */
+  uint32_t Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr uint32_t kSkip = UINT32_MAX;
+
+  static size_t round_up_pow2(size_t size) {
+    size_t pow2 = 64;
+    while (pow2 < size) pow2 <<= 1;
+    return pow2;
+  }
+
+  // Keeps the record lengths aligned, and leaves room for one at the end.
+  static size_t align(size_t len) {
+    return (len + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+  }
+
+  void put_length(size_t pos, uint32_t len) {
+    memcpy(&buffer_[pos & mask_], &len, sizeof(len));
+  }
+
+  std::vector<uint8_t> buffer_;
+  size_t mask_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "bt_types.h"
+#include "hci_internals.h"
+#include "osi/include/allocator.h"
+
+/* Bytes read from the controller socket at once. A packet that does not fit
+ * makes the buffer grow to hold it. */
+#ifndef H4_READ_BUFFER_SIZE
+#define H4_READ_BUFFER_SIZE 16384
+#endif
+
+/* Frames the packets of an H4 byte stream (a packet type byte followed by an
+ * HCI command, ACL, SCO or event packet).
+ *
+ * Instead of reading the type, the header and the payload of every packet
+ * separately, it reads as much as the socket holds in one read() and frames
+ * all the complete packets in it, keeping a trailing partial packet for the
+ * next read. Framed packets are BT_HDRs sized to the packet, with |event| set
+ * to MSG_HC_TO_STACK_HCI_EVT, _ACL or _SCO. Not thread safe. */
+class H4StreamReader {
+ public:
+  explicit H4StreamReader(const allocator_t* allocator,
+                          size_t buffer_size = H4_READ_BUFFER_SIZE);
+
+  H4StreamReader(const H4StreamReader&) = delete;
+  H4StreamReader& operator=(const H4StreamReader&) = delete;
+
+  /* Reads once from |fd|. Returns what read() returned. */
+  ssize_t Read(int fd);
+
+  /* Copies |len| bytes of the stream in, as Read would. Returns false if
+   * there is no room; Frame makes room. */
+  bool Append(const uint8_t* data, size_t len);
+
+  /* Appends the complete packets received so far to |packets|; the caller
+   * owns them. Returns false if the stream holds an unknown packet type, in
+   * which case it cannot be framed any further. */
+  bool Frame(std::vector<BT_HDR*>* packets);
+
+  /* Bytes of a partial packet waiting for the rest. */
+  size_t Pending() const { return end_ - begin_; }
+
+  /* Type byte that made Frame fail. */
+  uint8_t bad_type() const { return bad_type_; }
+
+ private:
+  /* Moves the partial packet to the front and makes sure a packet of
+   * |packet_size| bytes fits. */
+  void Compact(size_t packet_size);
+
+  const allocator_t* allocator_;
+  std::vector<uint8_t> buffer_;
+  /* unframed bytes are buffer_[begin_, end_) */
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  uint8_t bad_type_ = 0;
+};
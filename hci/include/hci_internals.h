@@ -18,6 +18,15 @@
 
 #pragma once
 
+// Packet type byte preceding each packet on the H4 transport
+enum HciPacketType {
+  HCI_PACKET_TYPE_UNKNOWN = 0,
+  HCI_PACKET_TYPE_COMMAND = 1,
+  HCI_PACKET_TYPE_ACL_DATA = 2,
+  HCI_PACKET_TYPE_SCO_DATA = 3,
+  HCI_PACKET_TYPE_EVENT = 4
+};
+
 // 2 bytes for opcode, 1 byte for parameter length (Volume 2, Part E, 5.4.1)
 #define HCI_COMMAND_PREAMBLE_SIZE 3
 // 2 bytes for handle, 2 bytes for data length (Volume 2, Part E, 5.4.2)
@@ -0,0 +1,159 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hcidefs.h"
+
+/* HCI commands sent to the controller and waiting for their Command Complete
+ * or Command Status event.
+ *
+ * A response is matched to the oldest command with its opcode without
+ * looking at the others. Each command has a deadline of its own; they are
+ * kept in a heap so the earliest is always at hand for the response timer.
+ * The commands are not owned. Not thread safe. */
+template <typename T>
+class HciPendingCommands {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  /* Adds |command|, sent with |opcode|, to be answered by |deadline|. */
+  void Add(uint16_t opcode, T* command, TimePoint deadline) {
+    uint64_t seq = next_seq_++;
+    by_seq_[seq] = {command, opcode, deadline};
+    by_opcode_[opcode].push_back(seq);
+    deadlines_.push({deadline, seq});
+    if (is_vendor_specific(opcode)) vendor_specific_++;
+  }
+
+  /* Removes and returns the oldest command answered by a response for
+   * |opcode|, or NULL if there is none.
+   *
+   * Some controllers answer vendor specific commands with another vendor
+   * specific opcode, or none at all; such a response goes to the oldest
+   * vendor specific command if none has the opcode. */
+  T* Take(uint16_t opcode) {
+    auto it = by_opcode_.find(opcode);
+    if (it != by_opcode_.end()) return remove(it);
+
+    if (vendor_specific_ == 0 || !(is_vendor_specific(opcode) || opcode == 0))
+      return NULL;
+    for (const auto& pending : by_seq_) {
+      if (is_vendor_specific(pending.second.opcode))
+        return remove(by_opcode_.find(pending.second.opcode));
+    }
+    return NULL;
+  }
+
+  /* Returns the command with the earliest deadline, and the deadline in
+   * |*deadline|, or NULL if there are no commands. */
+  T* NextDeadline(TimePoint* deadline) {
+    const Entry* entry = next_deadline();
+    if (entry == NULL) return NULL;
+    *deadline = entry->deadline;
+    return entry->command;
+  }
+
+  /* Moves the earliest deadline back to |deadline|. Returns the command it
+   * is for, or NULL if there are no commands. */
+  T* PostponeNext(TimePoint deadline) {
+    Entry* entry = next_deadline();
+    if (entry == NULL) return NULL;
+    uint64_t seq = deadlines_.top().second;
+    deadlines_.pop();
+    entry->deadline = deadline;
+    deadlines_.push({deadline, seq});
+    return entry->command;
+  }
+
+  /* Calls |fn(T* command)| for each command, oldest first. */
+  template <typename Fn>
+  void ForEach(Fn fn) const {
+    for (const auto& pending : by_seq_) fn(pending.second.command);
+  }
+
+  size_t Size() const { return by_seq_.size(); }
+  bool Empty() const { return by_seq_.empty(); }
+
+  void Clear() {
+    by_seq_.clear();
+    by_opcode_.clear();
+    deadlines_ = DeadlineHeap();
+    vendor_specific_ = 0;
+  }
+
+ private:
+  struct Entry {
+    T* command;
+    uint16_t opcode;
+    TimePoint deadline;
+  };
+  typedef std::pair<TimePoint, uint64_t> Deadline;
+  typedef std::priority_queue<Deadline, std::vector<Deadline>,
+                              std::greater<Deadline>>
+      DeadlineHeap;
+
+  static bool is_vendor_specific(uint16_t opcode) {
+    return (opcode & HCI_GRP_VENDOR_SPECIFIC) == HCI_GRP_VENDOR_SPECIFIC;
+  }
+
+  T* remove(typename std::unordered_map<uint16_t,
+                                        std::deque<uint64_t>>::iterator it) {
+    uint64_t seq = it->second.front();
+    it->second.pop_front();
+    if (it->second.empty()) by_opcode_.erase(it);
+
+    auto pending = by_seq_.find(seq);
+    T* command = pending->second.command;
+    if (is_vendor_specific(pending->second.opcode)) vendor_specific_--;
+    by_seq_.erase(pending);
+    return command;
+  }
+
+  // Deadlines of commands since answered, or moved, are left in the heap
+  // and dropped once they come to the top.
+  Entry* next_deadline() {
+    while (!deadlines_.empty()) {
+      auto pending = by_seq_.find(deadlines_.top().second);
+      if (pending != by_seq_.end() &&
+          pending->second.deadline == deadlines_.top().first)
+        return &pending->second;
+      deadlines_.pop();
+    }
+    return NULL;
+  }
+
+  uint64_t next_seq_ = 0;
+  // The commands in the order they were sent, and by opcode, oldest first
+  std::map<uint64_t, Entry> by_seq_;
+  std::unordered_map<uint16_t, std::deque<uint64_t>> by_opcode_;
+  DeadlineHeap deadlines_;
+  size_t vendor_specific_ = 0;
+};
@@ -0,0 +1,188 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "bt_types.h"
+#include "hci_internals.h"
+#include "hci_layer.h"
+#include "osi/include/osi.h"
+
+/* Fragments gathered before they have to be written out. Each one takes two
+ * iovecs. */
+#ifndef HCI_TX_BATCH_MAX_FRAGMENTS
+#define HCI_TX_BATCH_MAX_FRAGMENTS 128
+#endif
+
+/* Outgoing HCI packets and ACL fragments gathered to be written to the
+ * controller with a single writev().
+ *
+ * A fragment is either a whole packet with its header in place, or a slice
+ * of the data of an ACL packet with an ACL header of its own kept here. The
+ * packets are never written to, so all the fragments of a packet can be
+ * queued at once without copying the data; they must stay untouched until
+ * the batch has been sent. Not thread safe. */
+class HciTxBatch {
+ public:
+  explicit HciTxBatch(size_t max_fragments = HCI_TX_BATCH_MAX_FRAGMENTS)
+      : max_fragments_(max_fragments) {
+    fragments_.reserve(max_fragments);
+    iov_.reserve(2 * max_fragments);
+  }
+
+  HciTxBatch(const HciTxBatch&) = delete;
+  HciTxBatch& operator=(const HciTxBatch&) = delete;
+
+  /* Adds the |len| bytes at |data|, which lie within |packet|. They are sent
+   * after |acl_header| (HCI_ACL_PREAMBLE_SIZE bytes), or as they are if it is
+   * null, in which case they must be all of |packet|. */
+  void Add(BT_HDR* packet, const uint8_t* acl_header, uint8_t* data,
+           uint16_t len) {
+    Fragment fragment;
+    fragment.packet = packet;
+    fragment.data = data;
+    fragment.len = len;
+    fragment.preamble[0] = h4_type(packet->event);
+    fragment.preamble_len = 1;
+    if (acl_header != nullptr) {
+      memcpy(fragment.preamble + 1, acl_header, HCI_ACL_PREAMBLE_SIZE);
+      fragment.preamble_len += HCI_ACL_PREAMBLE_SIZE;
+    }
+    fragments_.push_back(fragment);
+    bytes_ += fragment.preamble_len + len;
+  }
+
+  /* Marks all of |packet| as added. Released packets are for the sender to
+   * free once the batch has been sent. */
+  void Release(BT_HDR* packet) { released_.push_back(packet); }
+
+  bool Full() const { return fragments_.size() >= max_fragments_; }
+  bool Empty() const { return fragments_.empty(); }
+  size_t Fragments() const { return fragments_.size(); }
+  size_t Bytes() const { return bytes_; }
+  std::vector<BT_HDR*>& released() { return released_; }
+
+  /* Calls |fn| with each fragment in turn as a BT_HDR holding just that
+   * fragment, for senders that cannot gather. A fragment without a header of
+   * its own is its whole packet, handed over as it is and not touched after
+   * the call: a command may already have been answered and freed by then.
+   * The header of a fragment that has its own is written over the bytes
+   * preceding its data for the length of the call, and the packet restored
+   * afterwards; such packets are released to the batch, so they stay around
+   * until it has been sent. */
+  template <typename Fn>
+  void ForEachFragment(Fn fn) {
+    for (const Fragment& fragment : fragments_) {
+      BT_HDR* packet = fragment.packet;
+      size_t header_len = fragment.preamble_len - 1;
+      if (header_len == 0) {
+        fn(packet);
+        continue;
+      }
+
+      uint16_t offset = packet->offset;
+      uint16_t len = packet->len;
+      uint8_t* header = fragment.data - header_len;
+      uint8_t saved[HCI_ACL_PREAMBLE_SIZE];
+
+      memcpy(saved, header, header_len);
+      memcpy(header, fragment.preamble + 1, header_len);
+      packet->offset = header - packet->data;
+      packet->len = fragment.len + header_len;
+      fn(packet);
+      memcpy(header, saved, header_len);
+      packet->offset = offset;
+      packet->len = len;
+    }
+  }
+
+  /* Writes every fragment to |fd| preceded by its H4 packet type, using as
+   * few writev() calls as IOV_MAX and short writes allow. Adds the calls made
+   * to |*syscalls|. Returns false if a write failed. */
+  bool Write(int fd, size_t* syscalls) {
+    iov_.clear();
+    for (Fragment& fragment : fragments_) {
+      iov_.push_back({fragment.preamble, fragment.preamble_len});
+      iov_.push_back({fragment.data, fragment.len});
+    }
+
+    struct iovec* iov = iov_.data();
+    size_t count = iov_.size();
+    while (count > 0) {
+      ssize_t ret;
+      OSI_NO_INTR(ret = writev(fd, iov, std::min<size_t>(count, IOV_MAX)));
+      (*syscalls)++;
+      if (ret < 0) return false;
+
+      size_t written = ret;
+      while (count > 0 && written >= iov->iov_len) {
+        written -= iov->iov_len;
+        iov++;
+        count--;
+      }
+      if (count > 0) {
+        iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+        iov->iov_len -= written;
+      }
+    }
+    return true;
+  }
+
+  void Clear() {
+    fragments_.clear();
+    released_.clear();
+    bytes_ = 0;
+  }
+
+ private:
+  struct Fragment {
+    BT_HDR* packet;
+    uint8_t* data;
+    uint16_t len;
+    uint8_t preamble[1 + HCI_ACL_PREAMBLE_SIZE];
+    uint8_t preamble_len;
+  };
+
+  static uint8_t h4_type(uint16_t event) {
+    switch (event & MSG_EVT_MASK) {
+      case MSG_STACK_TO_HC_HCI_CMD:
+        return HCI_PACKET_TYPE_COMMAND;
+      case MSG_STACK_TO_HC_HCI_ACL:
+        return HCI_PACKET_TYPE_ACL_DATA;
+      case MSG_STACK_TO_HC_HCI_SCO:
+        return HCI_PACKET_TYPE_SCO_DATA;
+      default:
+        return HCI_PACKET_TYPE_UNKNOWN;
+    }
+  }
+
+  size_t max_fragments_;
+  std::vector<Fragment> fragments_;
+  std::vector<BT_HDR*> released_;
+  std::vector<struct iovec> iov_;
+  size_t bytes_ = 0;
+};
@@ -22,10 +22,13 @@
 #include "hci_layer.h"
 #include "osi/include/allocator.h"
 
+class HciTxBatch;
+
 typedef void (*transmit_finished_cb)(BT_HDR* packet, bool all_fragments_sent);
 typedef void (*packet_reassembled_cb)(BT_HDR* packet);
 typedef void (*packet_fragmented_cb)(BT_HDR* packet,
                                      bool send_transmit_finished);
+typedef void (*batch_full_cb)(HciTxBatch* batch);
 
 typedef struct {
   // Called for every packet fragment.
@@ -37,6 +40,11 @@ typedef struct {
   // Called when the fragmenter finishes sending all requested fragments,
   // but the packet has not been entirely sent.
   transmit_finished_cb transmit_finished;
+
+  // Called when the fragments batched so far have to be sent before the
+  // fragmenter can go on, because the batch is full or because a packet is
+  // about to be handed back to transmit_finished part way.
+  batch_full_cb batch_full;
 } packet_fragmenter_callbacks_t;
 
 typedef struct packet_fragmenter_t {
@@ -49,12 +57,25 @@ typedef struct packet_fragmenter_t {
   // Fragments |packet| if necessary and hands off everything to the fragmented
   // callback.
   void (*fragment_and_dispatch)(BT_HDR* packet);
+  // Like fragment_and_dispatch, but adds the fragments of |packet| to |batch|
+  // instead of handing them to the fragmented callback one at a time. Their
+  // headers are kept in the batch rather than written over the data, so the
+  // whole packet can be sent at once; it is released to the batch when all of
+  // it has been added.
+  void (*fragment_and_batch)(BT_HDR* packet, HciTxBatch* batch);
   // If |packet| is a complete packet, forwards to the reassembled callback.
   // Otherwise
   // holds onto it until all fragments arrive, at which point the reassembled
   // callback is called
   // with the reassembled data.
   void (*reassemble_and_dispatch)(BT_HDR* packet);
+
+  // When |enabled|, fragmented ACL packets are reassembled by chaining the
+  // fragments in a BtHdrChain instead of copying them into one buffer, and
+  // handed to the reassembled callback wrapped in a
+  // MSG_HC_TO_STACK_HCI_ACL_CHAIN BT_HDR. Packets that came in one fragment
+  // are handed over as they are either way.
+  void (*set_chained_reassembly)(bool enabled);
 } packet_fragmenter_t;
 
 const packet_fragmenter_t* packet_fragmenter_get_interface();
@@ -18,7 +18,12 @@
 
 #define LOG_TAG "bt_snoop"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <base/logging.h>
@@ -41,7 +46,9 @@
 
 #include "bt_types.h"
 #include "hci/include/btsnoop.h"
+#include "hci/include/btsnoop_compressed.h"
 #include "hci/include/btsnoop_mem.h"
+#include "hci/include/btsnoop_ring.h"
 #include "hci_layer.h"
 #include "internal_include/bt_trace.h"
 #include "osi/include/log.h"
@@ -85,6 +92,24 @@
   #define DEFAULT_BTSNOOP_PATH "btsnoop_hci.log"
 #endif  //OFF_TARGET_TEST_ENABLED
 #define BTSNOOP_MAX_PACKETS_PROPERTY "persist.bluetooth.btsnoopsize"
+// Whether packets are written to the log by a thread of their own rather
+// than by the thread capturing them.
+#define BTSNOOP_ASYNC_PROPERTY "persist.bluetooth.btsnoopasync"
+
+// How long captured packets may wait for the writer thread, unless the ring
+// fills up faster.
+#ifndef BTSNOOP_FLUSH_INTERVAL_MS
+#define BTSNOOP_FLUSH_INTERVAL_MS 100
+#endif
+// Whether the log is written in compressed blocks, see btsnoop_compressed.h.
+// Needs the writer thread. The log file name then ends in
+// BTSNOOP_COMPRESSED_SUFFIX.
+#define BTSNOOP_COMPRESS_PROPERTY "persist.bluetooth.btsnoopcompress"
+#define BTSNOOP_COMPRESSED_SUFFIX ".z"
+// How long packets may wait for the rest of their compressed block.
+#ifndef BTSNOOPZ_FLUSH_INTERVAL_MS
+#define BTSNOOPZ_FLUSH_INTERVAL_MS 2000
+#endif
 
 typedef enum {
   kCommandPacket = 1,
@@ -122,6 +147,25 @@ static int32_t packets_per_file;
 static int32_t packet_counter;
 static bool sock_snoop_active = false;
 
+// The writer thread, and the packets waiting for it. Null when packets are
+// written as they are captured.
+static BtsnoopRing* snoop_ring;
+static std::thread snoop_writer;
+static std::mutex snoop_writer_mutex;
+static std::condition_variable snoop_writer_cv;
+static bool snoop_writer_stop;
+static std::vector<struct iovec> snoop_iov;
+// Drops counted when the current file was opened, and by the last record
+// written out. The records carry the drops since their file began.
+static uint32_t snoop_file_drops_base;
+static uint32_t snoop_last_drops;
+static uint32_t snoop_logged_drops;
+// The block being put together when the log is compressed, and when it was
+// begun.
+static bool is_btsnoop_compressed;
+static BtsnoopBlockWriter* snoop_blocks;
+static std::chrono::steady_clock::time_point snoop_block_started;
+
 extern bt_logger_interface_t *logger_interface;
 int64_t gmt_offset;
 int64_t tmp_gmt_offset;
@@ -369,6 +413,9 @@ static void delete_btsnoop_files(bool filtered);
 static std::string get_btsnoop_log_path(bool filtered);
 static std::string get_btsnoop_last_log_path(std::string log_path);
 static void open_next_snoop_file();
+static void open_next_snoop_file_locked();
+static void start_snoop_writer();
+static void stop_snoop_writer();
 static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
                                  bool is_received, uint64_t timestamp_us);
 
@@ -487,10 +534,14 @@ static future_t* start_up() {
   }
 
   if (is_btsnoop_enabled || is_vndbtsnoop_enabled) {
+    bool async = osi_property_get_int32(BTSNOOP_ASYNC_PROPERTY, 1);
+    is_btsnoop_compressed =
+        async && osi_property_get_int32(BTSNOOP_COMPRESS_PROPERTY, 0);
     open_next_snoop_file();
     packets_per_file = (//osi_property_get_int32(BTSNOOP_MAX_PACKETS_PROPERTY,
                                               DEFAULT_BTSNOOP_SIZE);
     btsnoop_net_open();
+    if (async) start_snoop_writer();
     START_SNOOP_LOGGING();
   }
   LOG_DEBUG(LOG_TAG, "%s: vendor_logging_level values is %d ", __func__, vendor_logging_level);
@@ -513,6 +564,7 @@ static future_t* shut_down(void) {
   }
 #endif
 
+  stop_snoop_writer();
   if (logfile_fd != INVALID_FD) close(logfile_fd);
   logfile_fd = INVALID_FD;
 
@@ -572,7 +624,7 @@ static void capture(const BT_HDR* buffer, bool is_received) {
 
   btsnoop_mem_capture(buffer, timestamp_us);
 
-  if (logfile_fd == INVALID_FD) return;
+  if (snoop_ring == nullptr && logfile_fd == INVALID_FD) return;
 
   switch (buffer->event & MSG_EVT_MASK) {
     case MSG_HC_TO_STACK_HCI_EVT:
@@ -897,6 +949,10 @@ static void delete_btsnoop_files(bool filtered) {
   auto log_path = get_btsnoop_log_path(filtered);
   remove(log_path.c_str());
   remove(get_btsnoop_last_log_path(log_path).c_str());
+
+  log_path += BTSNOOP_COMPRESSED_SUFFIX;
+  remove(log_path.c_str());
+  remove(get_btsnoop_last_log_path(log_path).c_str());
 }
 
 std::string get_btsnoop_log_path(bool filtered) {
@@ -913,9 +969,14 @@ std::string get_btsnoop_last_log_path(std::string btsnoop_path) {
 }
 
 static void open_next_snoop_file() {
+  std::lock_guard<std::mutex> lock(btSnoopFd_mutex);
+  open_next_snoop_file_locked();
+}
+
+// As open_next_snoop_file, with |btSnoopFd_mutex| held by the caller.
+static void open_next_snoop_file_locked() {
   packet_counter = 0;
 
-  std::lock_guard<std::mutex> lock(btSnoopFd_mutex);
   if(sock_snoop_active)
     return;
 
@@ -925,6 +986,7 @@ static void open_next_snoop_file() {
   }
 
   auto log_path = get_btsnoop_log_path(is_btsnoop_filtered);
+  if (is_btsnoop_compressed) log_path += BTSNOOP_COMPRESSED_SUFFIX;
   auto last_log_path = get_btsnoop_last_log_path(log_path);
 
   if (rename(log_path.c_str(), last_log_path.c_str()) != 0 && errno != ENOENT)
@@ -941,7 +1003,11 @@ static void open_next_snoop_file() {
     return;
   }
 
-  write(logfile_fd, "btsnoop\0\0\0\0\1\0\0\x3\xea", 16);
+  if (is_btsnoop_compressed) {
+    BtsnoopBlockWriter::WriteFileHeader(logfile_fd);
+  } else {
+    write(logfile_fd, "btsnoop\0\0\0\0\1\0\0\x3\xea", 16);
+  }
 }
 
 typedef struct {
@@ -1076,6 +1142,18 @@ static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
   header.timestamp = htonll(timestamp_us + BTSNOOP_EPOCH_DELTA);
   header.type = type;
 
+  if (snoop_ring != nullptr) {
+    // The writer thread makes the drop count relative to the file it goes
+    // in, and does everything else.
+    header.dropped_packets = htonl(snoop_ring->Dropped());
+    size_t threshold = snoop_ring->Size() / 4;
+    size_t pending = snoop_ring->Pending();
+    if (snoop_ring->Push(&header, sizeof(header), packet, length_he - 1) &&
+        pending < threshold && snoop_ring->Pending() >= threshold)
+      snoop_writer_cv.notify_one();
+    return;
+  }
+
   btsnoop_net_write(&header, sizeof(btsnoop_header_t));
   btsnoop_net_write(packet, length_he - 1);
 
@@ -1103,8 +1181,139 @@ static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
   }
 }
 
+// Writes the records gathered in |snoop_iov| to the log file.
+static void write_snoop_records() {
+  struct iovec* iov = snoop_iov.data();
+  size_t count = snoop_iov.size();
+  while (count > 0 && logfile_fd != INVALID_FD) {
+    int n = std::min<size_t>(count, IOV_MAX);
+    if (TEMP_FAILURE_RETRY(writev(logfile_fd, iov, n)) < 0) {
+      LOG_ERROR(LOG_TAG, "%s writev failed errno %d (%s)", __func__, errno,
+                strerror(errno));
+      break;
+    }
+    iov += n;
+    count -= n;
+  }
+  snoop_iov.clear();
+}
+
+// Compresses the records gathered in |snoop_blocks| and writes them to the log
+// file as a block. Blocks never go to the snoop socket.
+static void write_snoop_block() {
+  if (sock_snoop_active) return;
+  if (!snoop_blocks->Flush(logfile_fd) && logfile_fd != INVALID_FD)
+    LOG_ERROR(LOG_TAG, "%s unable to write block errno %d (%s)", __func__,
+              errno, strerror(errno));
+}
+
+// Writes out the records waiting in the ring, rotating the log file as they
+// fill it. Runs on the writer thread, holding |btSnoopFd_mutex| so that
+// update_snoop_fd can't swap the file out from under it.
+static void flush_snoop_ring() {
+  std::lock_guard<std::mutex> lock(btSnoopFd_mutex);
+  auto now = std::chrono::steady_clock::now();
+  size_t consumed = snoop_ring->ForEachRecord([now](uint8_t* record,
+                                                 size_t len) {
+    btsnoop_header_t header;
+    memcpy(&header, record, sizeof(header));
+    uint32_t drops = ntohl(header.dropped_packets);
+
+    packet_counter++;
+    if (!sock_snoop_active && packet_counter > packets_per_file) {
+      write_snoop_records();
+      if (snoop_blocks != nullptr) write_snoop_block();
+      open_next_snoop_file_locked();
+      snoop_file_drops_base = snoop_last_drops;
+    }
+    snoop_last_drops = drops;
+
+    header.dropped_packets = htonl(drops - snoop_file_drops_base);
+    memcpy(record, &header, sizeof(header));
+    btsnoop_net_write(record, len);
+    if (snoop_blocks != nullptr && !sock_snoop_active) {
+      if (snoop_blocks->Empty()) snoop_block_started = now;
+      snoop_blocks->Add(record, len);
+      if (snoop_blocks->Full()) write_snoop_block();
+    } else {
+      snoop_iov.push_back({record, len});
+    }
+  });
+  write_snoop_records();
+  snoop_ring->Consume(consumed);
+
+  // A block left part full goes out anyway after a while, so that not too
+  // much is lost if the process dies.
+  if (snoop_blocks != nullptr && !snoop_blocks->Empty() &&
+      now - snoop_block_started >=
+          std::chrono::milliseconds(BTSNOOPZ_FLUSH_INTERVAL_MS))
+    write_snoop_block();
+
+  uint32_t dropped = snoop_ring->Dropped();
+  if (dropped != snoop_logged_drops) {
+    LOG_WARN(LOG_TAG, "%s dropped %u packets, ring full", __func__,
+             dropped - snoop_logged_drops);
+    snoop_logged_drops = dropped;
+  }
+}
+
+// The writer thread: wakes up every BTSNOOP_FLUSH_INTERVAL_MS, or when the
+// ring is filling up, and writes out what it holds. A wakeup missed because
+// the capturing thread does not take |snoop_writer_mutex| only costs a wait
+// for the timeout.
+static void run_snoop_writer() {
+  std::unique_lock<std::mutex> lock(snoop_writer_mutex);
+  while (!snoop_writer_stop) {
+    snoop_writer_cv.wait_for(
+        lock, std::chrono::milliseconds(BTSNOOP_FLUSH_INTERVAL_MS));
+    lock.unlock();
+    flush_snoop_ring();
+    lock.lock();
+  }
+  lock.unlock();
+  flush_snoop_ring();
+
+  std::lock_guard<std::mutex> fd_lock(btSnoopFd_mutex);
+  if (snoop_blocks != nullptr) write_snoop_block();
+}
+
+static void start_snoop_writer() {
+  snoop_ring = new BtsnoopRing();
+  snoop_iov.reserve(IOV_MAX);
+  snoop_writer_stop = false;
+  snoop_file_drops_base = 0;
+  snoop_last_drops = 0;
+  snoop_logged_drops = 0;
+  if (is_btsnoop_compressed) snoop_blocks = new BtsnoopBlockWriter();
+  snoop_writer = std::thread(run_snoop_writer);
+}
+
+// Writes out the packets still waiting and stops the writer thread.
+static void stop_snoop_writer() {
+  if (snoop_ring == nullptr) return;
+
+  {
+    std::lock_guard<std::mutex> lock(snoop_writer_mutex);
+    snoop_writer_stop = true;
+  }
+  snoop_writer_cv.notify_one();
+  snoop_writer.join();
+  delete snoop_ring;
+  snoop_ring = nullptr;
+
+  std::lock_guard<std::mutex> lock(btSnoopFd_mutex);
+  if (snoop_blocks != nullptr) {
+    LOG_INFO(LOG_TAG, "%s compressed %" PRIu64 " bytes of records to %" PRIu64,
+             __func__, snoop_blocks->BytesIn(), snoop_blocks->BytesOut());
+    delete snoop_blocks;
+    snoop_blocks = nullptr;
+  }
+}
+
 void update_snoop_fd(int snoop_fd) {
   std::lock_guard<std::mutex> lock(btSnoopFd_mutex);
+  // The records of the block being gathered belong to the log file
+  if (snoop_blocks != nullptr) write_snoop_block();
   LOG_INFO(LOG_TAG, "%s Now writing to server socket", __func__);
   sock_snoop_active = true;
   logfile_fd = snoop_fd;
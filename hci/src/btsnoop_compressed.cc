@@ -0,0 +1,193 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btsnoop_compressed.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "osi/include/osi.h"
+
+static const char BTSNOOPZ_MAGIC[] = "btsnoopz";
+static const uint32_t BTSNOOP_DATALINK_HCI_UART = 1002;
+
+// Where the timestamp lies in a btsnoop record.
+static const size_t RECORD_TIMESTAMP_OFFSET = 16;
+static const size_t RECORD_HEADER_SIZE = 24;
+
+static uint8_t* put_be(uint8_t* p, uint64_t value, size_t len) {
+  for (size_t i = 0; i < len; i++) p[i] = value >> (8 * (len - 1 - i));
+  return p + len;
+}
+
+static uint64_t get_be(const uint8_t* p, size_t len) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < len; i++) value = (value << 8) | p[i];
+  return value;
+}
+
+// Reads exactly |len| bytes at |offset| of |fd|.
+static bool read_at(int fd, off_t offset, void* buf, size_t len) {
+  uint8_t* p = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t ret;
+    OSI_NO_INTR(ret = pread(fd, p, len, offset));
+    if (ret <= 0) return false;
+    p += ret;
+    offset += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+// Writes all of |iov| to |fd|.
+static bool write_all(int fd, struct iovec* iov, int count) {
+  while (count > 0) {
+    ssize_t ret;
+    OSI_NO_INTR(ret = writev(fd, iov, count));
+    if (ret < 0) return false;
+
+    size_t written = ret;
+    while (count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+BtsnoopBlockWriter::BtsnoopBlockWriter(size_t block_size)
+    : block_size_(block_size) {
+  memset(&stream_, 0, sizeof(stream_));
+  // The stream is reset rather than set up again for every block, which
+  // would allocate its window and tables each time.
+  stream_ok_ = deflateInit(&stream_, Z_DEFAULT_COMPRESSION) == Z_OK;
+  block_.reserve(block_size + UINT16_MAX);
+  compressed_.resize(deflateBound(&stream_, block_.capacity()));
+}
+
+BtsnoopBlockWriter::~BtsnoopBlockWriter() {
+  if (stream_ok_) deflateEnd(&stream_);
+}
+
+bool BtsnoopBlockWriter::WriteFileHeader(int fd) {
+  uint8_t header[BTSNOOPZ_FILE_HEADER_SIZE];
+  memcpy(header, BTSNOOPZ_MAGIC, 8);
+  uint8_t* p = put_be(header + 8, BTSNOOPZ_VERSION, 4);
+  put_be(p, BTSNOOP_DATALINK_HCI_UART, 4);
+
+  struct iovec iov = {header, sizeof(header)};
+  return write_all(fd, &iov, 1);
+}
+
+void BtsnoopBlockWriter::Add(const uint8_t* record, size_t len) {
+  if (len < RECORD_HEADER_SIZE) return;
+
+  uint64_t timestamp = get_be(record + RECORD_TIMESTAMP_OFFSET, 8);
+  if (records_ == 0) first_timestamp_ = timestamp;
+  last_timestamp_ = timestamp;
+  records_++;
+  block_.insert(block_.end(), record, record + len);
+  bytes_in_ += len;
+}
+
+bool BtsnoopBlockWriter::Flush(int fd) {
+  if (records_ == 0) return true;
+
+  bool ok = stream_ok_;
+  if (ok) {
+    size_t bound = deflateBound(&stream_, block_.size());
+    if (compressed_.size() < bound) compressed_.resize(bound);
+
+    deflateReset(&stream_);
+    stream_.next_in = block_.data();
+    stream_.avail_in = block_.size();
+    stream_.next_out = compressed_.data();
+    stream_.avail_out = compressed_.size();
+    ok = deflate(&stream_, Z_FINISH) == Z_STREAM_END;
+  }
+
+  if (ok) {
+    uint8_t header[BTSNOOPZ_BLOCK_HEADER_SIZE];
+    uint8_t* p = put_be(header, stream_.total_out, 4);
+    p = put_be(p, block_.size(), 4);
+    p = put_be(p, records_, 4);
+    p = put_be(p, first_timestamp_, 8);
+    put_be(p, last_timestamp_, 8);
+
+    struct iovec iov[] = {{header, sizeof(header)},
+                          {compressed_.data(), stream_.total_out}};
+    ok = write_all(fd, iov, 2);
+    if (ok) bytes_out_ += sizeof(header) + stream_.total_out;
+  }
+
+  block_.clear();
+  records_ = 0;
+  return ok;
+}
+
+bool btsnoopz_read_index(int fd, std::vector<btsnoopz_block_t>* index) {
+  uint8_t header[BTSNOOPZ_BLOCK_HEADER_SIZE];
+  if (!read_at(fd, 0, header, BTSNOOPZ_FILE_HEADER_SIZE) ||
+      memcmp(header, BTSNOOPZ_MAGIC, 8) != 0 ||
+      get_be(header + 8, 4) != BTSNOOPZ_VERSION)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) return false;
+
+  index->clear();
+  off_t offset = BTSNOOPZ_FILE_HEADER_SIZE;
+  while (read_at(fd, offset, header, sizeof(header))) {
+    btsnoopz_block_t block;
+    block.offset = offset + sizeof(header);
+    block.compressed_len = get_be(header, 4);
+    block.len = get_be(header + 4, 4);
+    block.records = get_be(header + 8, 4);
+    block.first_timestamp = get_be(header + 12, 8);
+    block.last_timestamp = get_be(header + 20, 8);
+    if (block.offset + block.compressed_len > st.st_size) break;
+
+    index->push_back(block);
+    offset = block.offset + block.compressed_len;
+  }
+  return true;
+}
+
+bool btsnoopz_read_block(int fd, const btsnoopz_block_t& block,
+                         std::vector<uint8_t>* records) {
+  std::vector<uint8_t> compressed(block.compressed_len);
+  if (!read_at(fd, block.offset, compressed.data(), compressed.size()))
+    return false;
+
+  records->resize(block.len);
+  uLongf len = block.len;
+  if (uncompress(records->data(), &len, compressed.data(),
+                 compressed.size()) != Z_OK ||
+      len != block.len)
+    return false;
+  return true;
+}
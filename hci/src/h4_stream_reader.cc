@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "h4_stream_reader.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hci_internals.h"
+#include "hci_layer.h"
+#include "osi/include/osi.h"
+
+H4StreamReader::H4StreamReader(const allocator_t* allocator,
+                               size_t buffer_size)
+    : allocator_(allocator), buffer_(buffer_size) {}
+
+ssize_t H4StreamReader::Read(int fd) {
+  if (end_ == buffer_.size()) Compact(end_ - begin_ + 1);
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = read(fd, buffer_.data() + end_, buffer_.size() - end_));
+  if (ret > 0) end_ += ret;
+  return ret;
+}
+
+bool H4StreamReader::Append(const uint8_t* data, size_t len) {
+  if (buffer_.size() - end_ < len) return false;
+  memcpy(buffer_.data() + end_, data, len);
+  end_ += len;
+  return true;
+}
+
+bool H4StreamReader::Frame(std::vector<BT_HDR*>* packets) {
+  while (end_ > begin_) {
+    const uint8_t* p = buffer_.data() + begin_;
+    size_t available = end_ - begin_ - 1;
+    size_t preamble_size;
+    uint16_t event;
+
+    switch (p[0]) {
+      case HCI_PACKET_TYPE_COMMAND:
+        preamble_size = HCI_COMMAND_PREAMBLE_SIZE;
+        event = MSG_HC_TO_STACK_HCI_EVT;
+        break;
+      case HCI_PACKET_TYPE_ACL_DATA:
+        preamble_size = HCI_ACL_PREAMBLE_SIZE;
+        event = MSG_HC_TO_STACK_HCI_ACL;
+        break;
+      case HCI_PACKET_TYPE_SCO_DATA:
+        preamble_size = HCI_SCO_PREAMBLE_SIZE;
+        event = MSG_HC_TO_STACK_HCI_SCO;
+        break;
+      case HCI_PACKET_TYPE_EVENT:
+        preamble_size = HCI_EVENT_PREAMBLE_SIZE;
+        event = MSG_HC_TO_STACK_HCI_EVT;
+        break;
+      default:
+        bad_type_ = p[0];
+        return false;
+    }
+
+    if (available < preamble_size) break;
+
+    /* The length is the last field of every preamble; only ACL uses two
+     * bytes for it. */
+    const uint8_t* preamble = p + 1;
+    size_t payload_size = preamble[preamble_size - 1];
+    if (p[0] == HCI_PACKET_TYPE_ACL_DATA)
+      payload_size = preamble[2] | (preamble[3] << 8);
+
+    size_t len = preamble_size + payload_size;
+    if (available < len) {
+      Compact(len + 1);
+      return true;
+    }
+
+    BT_HDR* packet =
+        static_cast<BT_HDR*>(allocator_->alloc(BT_HDR_SIZE + len));
+    packet->event = event;
+    packet->len = len;
+    packet->offset = 0;
+    packet->layer_specific = 0;
+    memcpy(packet->data, preamble, len);
+    packets->push_back(packet);
+
+    begin_ += len + 1;
+  }
+
+  Compact(0);
+  return true;
+}
+
+void H4StreamReader::Compact(size_t packet_size) {
+  if (begin_ == end_) {
+    begin_ = end_ = 0;
+  } else if (begin_ != 0) {
+    memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  if (buffer_.size() < packet_size) buffer_.resize(packet_size);
+}
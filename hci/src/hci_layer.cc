@@ -27,23 +27,27 @@
 #include <base/threading/thread.h>
 
 #include <signal.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
+#include <queue>
 
 #include "btcore/include/module.h"
 #include "btsnoop.h"
 #include "buffer_allocator.h"
 #include "hci_inject.h"
 #include "hci_internals.h"
+#include "hci_pending_commands.h"
+#include "hci_tx_batch.h"
 #include "hcidefs.h"
 #include "hcimsgs.h"
 #include "bt_utils.h"
 #include "osi/include/alarm.h"
-#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/properties.h"
 #include "osi/include/reactor.h"
@@ -54,6 +58,8 @@
 
 extern void hci_initialize();
 extern hci_transmit_status_t hci_transmit(BT_HDR* packet);
+extern hci_transmit_status_t hci_transmit_batch(HciTxBatch* batch,
+                                                size_t* syscalls);
 extern void hci_close();
 extern int hci_open_firmware_log_file();
 extern void hci_close_firmware_log_file(int fd);
@@ -116,12 +122,30 @@ static alarm_t *hci_timeout_abort_timer;
 // Outbound-related
 static int command_credits = 1;
 static std::mutex command_credits_mutex;
-static std::queue<base::Closure> command_queue;
+// Commands waiting for credits, and whether the HCI thread has been asked to
+// send those it has credits for
+static std::queue<waiting_command_t*> command_queue;
+static bool commands_ready_posted;
+
+// Outbound data packets waiting for the HCI thread, which sends all of them
+// with as few writes as it can
+static std::mutex packet_queue_mutex;
+static std::queue<BT_HDR*> packet_queue;
+static HciTxBatch tx_batch;
+
+// Transmit statistics for the debug dump
+static std::atomic<uint64_t> tx_packets;
+static std::atomic<uint64_t> tx_fragments;
+static std::atomic<uint64_t> tx_batches;
+static std::atomic<uint64_t> tx_syscalls;
 
 // Inbound-related
 static alarm_t* command_response_timer;
-static list_t* commands_pending_response;
+static HciPendingCommands<waiting_command_t> commands_pending_response;
 static std::recursive_mutex commands_pending_response_mutex;
+// The command |command_response_timer| is set for, and when it goes off
+static waiting_command_t* timed_command;
+static std::chrono::steady_clock::time_point timed_command_deadline;
 
 static std::mutex monitor_cmd_stats;
 struct monitor_command {
@@ -145,14 +169,16 @@ static void event_finish_startup(void* context);
 static void startup_timer_expired(void* context);
 
 static void enqueue_command(waiting_command_t* wait_entry);
-static void event_command_ready(waiting_command_t* wait_entry);
+static void post_commands_ready();
+static void event_commands_ready();
 static void enqueue_packet(void* packet);
-static void event_packet_ready(void* packet);
+static void event_packets_ready(void);
 static void command_timed_out(void* context);
 
 static void update_command_response_timer(void);
 
 static void transmit_fragment(BT_HDR* packet, bool send_transmit_finished);
+static void transmit_batch(HciTxBatch* batch);
 static void dispatch_reassembled(BT_HDR* packet);
 static void fragmenter_transmit_finished(BT_HDR* packet,
                                          bool all_fragments_sent);
@@ -167,7 +193,8 @@ void inc_rx_packet_counter() {
 }
 
 static const packet_fragmenter_callbacks_t packet_fragmenter_callbacks = {
-    transmit_fragment, dispatch_reassembled, fragmenter_transmit_finished};
+    transmit_fragment, dispatch_reassembled, fragmenter_transmit_finished,
+    transmit_batch};
 
 void initialization_complete() {
   std::lock_guard<std::mutex> lock(message_loop_mutex);
@@ -229,6 +256,8 @@ static future_t* hci_module_start_up(void) {
   // This value can change when you get a command complete or command status
   // event.
   command_credits = 1;
+  commands_ready_posted = false;
+  timed_command = NULL;
 
   // For now, always use the default timeout on non-Android builds.
   period_ms_t startup_timeout_ms = DEFAULT_STARTUP_TIMEOUT_MS;
@@ -271,14 +300,6 @@ static future_t* hci_module_start_up(void) {
     LOG_ERROR(LOG_TAG, "%s unable to make thread RT.", __func__);
   }
 
-  commands_pending_response = list_new(NULL);
-  if (!commands_pending_response) {
-    LOG_ERROR(LOG_TAG,
-              "%s unable to create list for commands pending response.",
-              __func__);
-    goto error;
-  }
-
   // Make sure we run in a bounded amount of time
   future_t* local_startup_future;
   local_startup_future = future_new();
@@ -286,6 +307,12 @@ static future_t* hci_module_start_up(void) {
   alarm_set(startup_timer, startup_timeout_ms, startup_timer_expired, NULL);
 
   packet_fragmenter->init(&packet_fragmenter_callbacks);
+  // Chain the fragments of large ACL packets rather than copying them. Off
+  // unless asked for: chains are not capped at BT_DEFAULT_BUFFER_SIZE for any
+  // channel, while only LE CoC and eRTM channels take packets past it
+  packet_fragmenter->set_chained_reassembly(
+      osi_property_get_int32("persist.bluetooth.acl_chained_reassembly", 0) !=
+      0);
 
   thread_post(thread, message_loop_run, NULL);
 
@@ -326,8 +353,25 @@ static future_t* hci_module_shut_down() {
 
   {
     std::lock_guard<std::recursive_mutex> lock(commands_pending_response_mutex);
-    list_free(commands_pending_response);
-    commands_pending_response = NULL;
+    commands_pending_response.Clear();
+    timed_command = NULL;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(command_credits_mutex);
+    while (!command_queue.empty()) {
+      buffer_allocator->free(command_queue.front()->command);
+      osi_free(command_queue.front());
+      command_queue.pop();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(packet_queue_mutex);
+    while (!packet_queue.empty()) {
+      buffer_allocator->free(packet_queue.front());
+      packet_queue.pop();
+    }
   }
 
   packet_fragmenter->cleanup();
@@ -448,33 +492,57 @@ static void startup_timer_expired(UNUSED_ATTR void* context) {
 
 // Command/packet transmitting functions
 static void enqueue_command(waiting_command_t* wait_entry) {
-  base::Closure callback = base::Bind(&event_command_ready, wait_entry);
-
   std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
-  if (command_credits > 0) {
-    std::lock_guard<std::mutex> message_loop_lock(message_loop_mutex);
-    if (message_loop_ == nullptr) {
-      // HCI Layer was shut down
-      buffer_allocator->free(wait_entry->command);
-      osi_free(wait_entry);
-      return;
-    }
-    message_loop_->task_runner()->PostTask(FROM_HERE, std::move(callback));
-    command_credits--;
-  } else {
-    command_queue.push(std::move(callback));
+  std::lock_guard<std::mutex> message_loop_lock(message_loop_mutex);
+  if (message_loop_ == nullptr) {
+    // HCI Layer was shut down
+    buffer_allocator->free(wait_entry->command);
+    osi_free(wait_entry);
+    return;
   }
+  command_queue.push(wait_entry);
+  post_commands_ready();
+}
+
+// Has the HCI thread send the queued commands there are credits for, unless
+// it already has been. Called with |command_credits_mutex| and
+// |message_loop_mutex| held.
+static void post_commands_ready() {
+  if (command_credits <= 0 || command_queue.empty() || commands_ready_posted)
+    return;
+  message_loop_->task_runner()->PostTask(FROM_HERE,
+                                         base::Bind(&event_commands_ready));
+  commands_ready_posted = true;
 }
 
-static void event_command_ready(waiting_command_t* wait_entry) {
+// Sends as many queued commands as there are credits for, with one write
+// where the transport allows it.
+static void event_commands_ready() {
   {
-    /// Move it to the list of commands awaiting response
+    std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
     std::lock_guard<std::recursive_mutex> lock(commands_pending_response_mutex);
-    wait_entry->timestamp = std::chrono::steady_clock::now();
-    list_append(commands_pending_response, wait_entry);
+    commands_ready_posted = false;
+
+    auto now = std::chrono::steady_clock::now();
+    while (command_credits > 0 && !command_queue.empty()) {
+      waiting_command_t* wait_entry = command_queue.front();
+      command_queue.pop();
+      command_credits--;
+
+      // Awaiting response before it is even sent, so that the response
+      // cannot beat it there
+      wait_entry->timestamp = now;
+      commands_pending_response.Add(
+          wait_entry->opcode, wait_entry,
+          now + std::chrono::milliseconds(COMMAND_PENDING_TIMEOUT_MS));
+
+      BT_HDR* command = wait_entry->command;
+      tx_batch.Add(command, NULL, command->data + command->offset,
+                   command->len);
+    }
   }
-  // Send it off
-  packet_fragmenter->fragment_and_dispatch(wait_entry->command);
+  // Commands are not released to the batch: they are freed once answered
+  transmit_batch(&tx_batch);
 
   update_command_response_timer();
 }
@@ -486,14 +554,33 @@ static void enqueue_packet(void* packet) {
     buffer_allocator->free(packet);
     return;
   }
-  message_loop_->task_runner()->PostTask(
-      FROM_HERE, base::Bind(&event_packet_ready, packet));
+
+  bool was_empty;
+  {
+    std::lock_guard<std::mutex> queue_lock(packet_queue_mutex);
+    was_empty = packet_queue.empty();
+    packet_queue.push((BT_HDR*)packet);
+  }
+  // Packets queued behind this one go out with it
+  if (was_empty) {
+    message_loop_->task_runner()->PostTask(FROM_HERE,
+                                           base::Bind(&event_packets_ready));
+  }
 }
 
-static void event_packet_ready(void* pkt) {
-  // The queue may be the command queue or the packet queue, we don't care
-  BT_HDR* packet = (BT_HDR*)pkt;
-  packet_fragmenter->fragment_and_dispatch(packet);
+static void event_packets_ready(void) {
+  std::queue<BT_HDR*> packets;
+  {
+    std::lock_guard<std::mutex> lock(packet_queue_mutex);
+    std::swap(packets, packet_queue);
+  }
+
+  tx_packets += packets.size();
+  while (!packets.empty()) {
+    packet_fragmenter->fragment_and_batch(packets.front(), &tx_batch);
+    packets.pop();
+  }
+  transmit_batch(&tx_batch);
 }
 
 // Callback for the fragmenter to send a fragment
@@ -519,6 +606,34 @@ static void transmit_fragment(BT_HDR* packet, bool send_transmit_finished) {
     buffer_allocator->free(packet);
 }
 
+// Callback for the fragmenter to send the fragments it batched, and the
+// end of event_packets_ready
+static void transmit_batch(HciTxBatch* batch) {
+  if (batch->Empty()) return;
+
+  batch->ForEachFragment(
+      [](BT_HDR* fragment) { btsnoop->capture(fragment, false); });
+
+  size_t syscalls = 0;
+  hci_transmit_status_t status = hci_transmit_batch(batch, &syscalls);
+
+  if (status == HCI_TRANSMIT_DAEMON_DIED) {
+    LOG_ERROR(LOG_TAG, "%s: unable to send packets to hci hal daemon ",
+              __func__);
+    usleep(100000);
+    LOG_ERROR(LOG_TAG, "%s: Killing bluetooth process due to TX failed ",
+              __func__);
+    kill(getpid(), SIGKILL);
+  }
+
+  tx_fragments += batch->Fragments();
+  tx_batches++;
+  tx_syscalls += syscalls;
+
+  for (BT_HDR* packet : batch->released()) buffer_allocator->free(packet);
+  batch->Clear();
+}
+
 static void fragmenter_transmit_finished(BT_HDR* packet,
                                          bool all_fragments_sent) {
   if (all_fragments_sent) {
@@ -543,6 +658,16 @@ static void hci_timeout_abort(UNUSED_ATTR void *context) {
 // Print debugging information and quit. Don't dereference original_wait_entry.
 static void command_timed_out(void* original_wait_entry) {
   std::unique_lock<std::recursive_mutex> lock(commands_pending_response_mutex);
+  // The command timed was answered as the timer went off, and the next one
+  // still has time left
+  std::chrono::steady_clock::time_point deadline;
+  if (commands_pending_response.NextDeadline(&deadline) == NULL ||
+      deadline > std::chrono::steady_clock::now()) {
+    timed_command = NULL;
+    update_command_response_timer();
+    return;
+  }
+
   // Dynamically increase command timeout if applicable.
   {
     std::unique_lock<std::mutex> lock(monitor_cmd_stats);
@@ -562,8 +687,12 @@ static void command_timed_out(void* original_wait_entry) {
               (unsigned long long)cmd_stats.lapsed_timeout,
               (unsigned long long)new_timeout);
       cmd_stats.lapsed_timeout += new_timeout;
+      timed_command_deadline = std::chrono::steady_clock::now() +
+                               std::chrono::milliseconds(new_timeout);
+      timed_command =
+          commands_pending_response.PostponeNext(timed_command_deadline);
       alarm_set(command_response_timer, new_timeout, command_timed_out,
-                list_front(commands_pending_response));
+                timed_command);
       return;
     }
   }
@@ -571,11 +700,8 @@ static void command_timed_out(void* original_wait_entry) {
   LOG_ERROR(LOG_TAG, "%s: %d commands pending response", __func__,
             get_num_waiting_commands());
 
-  for (const list_node_t* node = list_begin(commands_pending_response);
-       node != list_end(commands_pending_response); node = list_next(node)) {
-    waiting_command_t* wait_entry =
-        reinterpret_cast<waiting_command_t*>(list_node(node));
-
+  commands_pending_response.ForEach([original_wait_entry](
+                                        waiting_command_t* wait_entry) {
     int wait_time_ms =
         std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - wait_entry->timestamp)
@@ -596,7 +722,7 @@ static void command_timed_out(void* original_wait_entry) {
     }
 
     LOG_EVENT_INT(BT_HCI_TIMEOUT_TAG_NUM, wait_entry->opcode);
-  }
+  });
   lock.unlock();
 
   // Don't request a firmware dump for multiple hci timeouts
@@ -647,13 +773,7 @@ void process_command_credits(int credits) {
 
   // Subtract commands in flight.
   command_credits = credits - get_num_waiting_commands();
-
-  while (command_credits > 0 && command_queue.size() > 0) {
-    message_loop_->task_runner()->PostTask(FROM_HERE,
-                                           std::move(command_queue.front()));
-    command_queue.pop();
-    command_credits--;
-  }
+  post_commands_ready();
 }
 
 // Returns true if the event was intercepted and should not proceed to
@@ -765,51 +885,31 @@ static void dispatch_reassembled(BT_HDR* packet) {
 static waiting_command_t* get_waiting_command(command_opcode_t opcode) {
   std::lock_guard<std::recursive_mutex> lock(commands_pending_response_mutex);
 
-  for (const list_node_t* node = list_begin(commands_pending_response);
-       node != list_end(commands_pending_response); node = list_next(node)) {
-    waiting_command_t* wait_entry =
-        reinterpret_cast<waiting_command_t*>(list_node(node));
-
-    if (!wait_entry || wait_entry->opcode != opcode) continue;
-
-    list_remove(commands_pending_response, wait_entry);
-
-    return wait_entry;
-  }
-  // look for any command complete with improper VS Opcode
-  for (const list_node_t *node = list_begin(commands_pending_response);
-      node != list_end(commands_pending_response);
-      node = list_next(node)) {
-    waiting_command_t *wait_entry =
-        reinterpret_cast<waiting_command_t*> (list_node(node));
-
-    if (wait_entry && (wait_entry->opcode != opcode) &&
-        (((wait_entry->opcode & HCI_GRP_VENDOR_SPECIFIC) == HCI_GRP_VENDOR_SPECIFIC) &&
-         (((opcode & HCI_GRP_VENDOR_SPECIFIC) == HCI_GRP_VENDOR_SPECIFIC) ||
-            opcode == 0))) {
-      LOG_DEBUG(LOG_TAG,"%s Treat it as valid, wait_entry opcode 0x%x opcode 0x%x",
-                __func__, wait_entry->opcode, opcode);
-    } else {
-      continue;
-    }
-
-    list_remove(commands_pending_response, wait_entry);
-
-    return wait_entry;
+  waiting_command_t* wait_entry = commands_pending_response.Take(opcode);
+  if (wait_entry != NULL && wait_entry->opcode != opcode) {
+    LOG_DEBUG(LOG_TAG,
+              "%s Treat it as valid, wait_entry opcode 0x%x opcode 0x%x",
+              __func__, wait_entry->opcode, opcode);
   }
-  return NULL;
+  return wait_entry;
 }
 
 static int get_num_waiting_commands() {
   std::lock_guard<std::recursive_mutex> lock(commands_pending_response_mutex);
-  return list_length(commands_pending_response);
+  return commands_pending_response.Size();
 }
 
+// Sets the response timer for the command with the earliest deadline, unless
+// it is set for it already.
 static void update_command_response_timer(void) {
   std::lock_guard<std::recursive_mutex> lock(commands_pending_response_mutex);
 
   if (command_response_timer == NULL) return;
-  if (list_is_empty(commands_pending_response)) {
+
+  std::chrono::steady_clock::time_point deadline;
+  waiting_command_t* next = commands_pending_response.NextDeadline(&deadline);
+  if (next == NULL) {
+    timed_command = NULL;
     if (alarm_is_scheduled(command_response_timer)) {
       alarm_cancel(command_response_timer);
     } else {
@@ -821,18 +921,28 @@ static void update_command_response_timer(void) {
       std::unique_lock<std::mutex> lock(monitor_cmd_stats);
       memset(&cmd_stats, 0, sizeof(struct monitor_command));
     }
-  } else {
-    alarm_set(command_response_timer, COMMAND_PENDING_TIMEOUT_MS,
-              command_timed_out, list_front(commands_pending_response));
-    /* This block of code executes when command is sent out.
-     * Start monitoring incoming events.
-     */
-    {
-      std::unique_lock<std::mutex> lock(monitor_cmd_stats);
-      memset(&cmd_stats, 0, sizeof(struct monitor_command));
-      cmd_stats.is_monitor_enabled = true;
-      cmd_stats.lapsed_timeout = COMMAND_PENDING_TIMEOUT_MS;
-    }
+    return;
+  }
+
+  if (next == timed_command && deadline == timed_command_deadline &&
+      alarm_is_scheduled(command_response_timer))
+    return;
+
+  timed_command = next;
+  timed_command_deadline = deadline;
+  auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now());
+  alarm_set(command_response_timer,
+            timeout.count() > 0 ? timeout.count() : 0, command_timed_out,
+            next);
+  /* This block of code executes when the timer is set for another command.
+   * Start monitoring incoming events.
+   */
+  {
+    std::unique_lock<std::mutex> lock(monitor_cmd_stats);
+    memset(&cmd_stats, 0, sizeof(struct monitor_command));
+    cmd_stats.is_monitor_enabled = true;
+    cmd_stats.lapsed_timeout = COMMAND_PENDING_TIMEOUT_MS;
   }
 }
 
@@ -861,6 +971,20 @@ void hci_layer_cleanup_interface() {
   }
 }
 
+void hci_layer_debug_dump(int fd) {
+  uint64_t packets = tx_packets;
+  uint64_t syscalls = tx_syscalls;
+
+  dprintf(fd, "\nHCI transmit:\n");
+  dprintf(fd, "  Data packets: %llu  Fragments: %llu\n",
+          (unsigned long long)packets, (unsigned long long)tx_fragments);
+  dprintf(fd, "  Batches: %llu  Writes: %llu\n",
+          (unsigned long long)tx_batches, (unsigned long long)syscalls);
+  if (packets != 0) {
+    dprintf(fd, "  Writes per packet: %.3f\n", (double)syscalls / packets);
+  }
+}
+
 const hci_t* hci_layer_get_interface() {
   buffer_allocator = buffer_allocator_get_interface();
   btsnoop = btsnoop_get_interface();
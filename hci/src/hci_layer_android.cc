@@ -27,6 +27,7 @@
 #include <base/location.h>
 #include <base/logging.h>
 #include "buffer_allocator.h"
+#include "hci_tx_batch.h"
 #include "osi/include/log.h"
 #include <cutils/properties.h>
 
@@ -201,6 +202,18 @@ hci_transmit_status_t hci_transmit(BT_HDR* packet) {
   return status;
 }
 
+// The HAL takes one packet per call, so the fragments are sent one by one.
+hci_transmit_status_t hci_transmit_batch(HciTxBatch* batch,
+                                         size_t* syscalls) {
+  hci_transmit_status_t status = HCI_TRANSMIT_SUCCESS;
+  batch->ForEachFragment([&status, syscalls](BT_HDR* fragment) {
+    if (status != HCI_TRANSMIT_SUCCESS) return;
+    status = hci_transmit(fragment);
+    (*syscalls)++;
+  });
+  return status;
+}
+
 int hci_open_firmware_log_file() {
   if (rename(LOG_PATH, LAST_LOG_PATH) == -1 && errno != ENOENT) {
     LOG_ERROR(LOG_TAG, "%s unable to rename '%s' to '%s': %s", __func__,
@@ -29,14 +29,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
+#include <vector>
 
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include "buffer_allocator.h"
+#include "h4_stream_reader.h"
 #include "hci_internals.h"
 #include "hci_layer.h"
+#include "hci_tx_batch.h"
 #include "osi/include/compat.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
@@ -92,14 +95,6 @@ struct mgmt_event_read_index {
   uint16_t index[0];
 } __attribute__((packed));
 
-enum HciPacketType {
-  HCI_PACKET_TYPE_UNKNOWN = 0,
-  HCI_PACKET_TYPE_COMMAND = 1,
-  HCI_PACKET_TYPE_ACL_DATA = 2,
-  HCI_PACKET_TYPE_SCO_DATA = 3,
-  HCI_PACKET_TYPE_EVENT = 4
-};
-
 extern void initialization_complete();
 extern void hci_event_received(const base::Location& from_here,
                                BT_HDR* packet);
@@ -173,94 +168,30 @@ void monitor_socket_packet(int ctrl_fd, int fd) {
   }
 }
 
-static int do_read(int fd, unsigned char* buf, size_t len)
-{
-  int bytes_left = len, bytes_read = 0, read_offset = 0;
-  while(bytes_left > 0) {
-    bytes_read = read(fd, buf + read_offset, bytes_left);
-    if(bytes_read < 0) {
-       LOG(ERROR) << "read fail Error " << strerror(errno);
-      return -1;
-    } else if (bytes_read == 0) {
-      LOG(INFO) << " read returned 0, read bytes"  << (len-bytes_left) << " expected len" << len;
-      return (len - bytes_left);
-    } else {
-      if(bytes_read < bytes_left) {
-        bytes_left -= bytes_read;
-        read_offset += bytes_read;
-      } else {
-        break;
-      }
-    }
+static void dispatch_packet(BT_HDR* packet) {
+  switch (packet->event) {
+    case MSG_HC_TO_STACK_HCI_ACL:
+      acl_event_received(packet);
+      break;
+    case MSG_HC_TO_STACK_HCI_SCO:
+      sco_data_received(packet);
+      break;
+    default:
+      hci_event_received(FROM_HERE, packet);
+      break;
   }
-
-  return len;
 }
 
 void monitor_socket_stream(int ctrl_fd, int fd) {
-  const allocator_t* buffer_allocator = buffer_allocator_get_interface();
-  const size_t buf_size = 2000;
-  uint8_t buf[buf_size];
-  unsigned int packet_length;
-  ssize_t len = read(fd, buf, 1);
+  H4StreamReader reader(buffer_allocator_get_interface());
+  std::vector<BT_HDR*> packets;
 
-  while (len > 0) {
-    if (len == buf_size)
-      LOG(FATAL) << "This packet filled buffer, if it have continuation we "
-                    "don't know how to merge it, increase buffer size!";
-
-    uint8_t type = buf[0];
-
-    size_t packet_size = buf_size + BT_HDR_SIZE;
-    BT_HDR* packet =
-        reinterpret_cast<BT_HDR*>(buffer_allocator->alloc(packet_size));
-    packet->offset = 0;
-    packet->layer_specific = 0;
-    LOG(INFO) << "packet type:" << +type;
-    switch (type) {
-      case HCI_PACKET_TYPE_COMMAND:
-        len = do_read(fd,buf+1,BT_CMD_HDR_SIZE);
-        packet->event = MSG_HC_TO_STACK_HCI_EVT;
-        packet_length = buf[3];
-        packet->len = packet_length + BT_CMD_HDR_SIZE;
-        len = do_read(fd,buf+1,packet->len);
-        memcpy(packet->data, buf+1, packet->len);
-        hci_event_received(FROM_HERE, packet);
-        break;
-      case HCI_PACKET_TYPE_ACL_DATA:
-        len = do_read(fd,buf+1,BT_ACL_HDR_SIZE);
-        packet->event = MSG_HC_TO_STACK_HCI_ACL;
-        packet_length = (buf[4] << 8) + buf[3];
-        packet->len = packet_length + BT_ACL_HDR_SIZE;
-        LOG(INFO) << "total packet length to be read:" << packet->len;
-        LOG(INFO) << "packet_length:" << packet_length;
-        len = do_read(fd, buf+BT_ACL_HDR_SIZE+1, packet_length);
-        LOG(INFO) << "length of bytes read:" << +len;
-        memcpy(packet->data, buf+1, packet->len);
-        acl_event_received(packet);
-        break;
-      case HCI_PACKET_TYPE_SCO_DATA:
-        len = do_read(fd,buf+1,BT_SCO_HDR_SIZE);
-        packet->event = MSG_HC_TO_STACK_HCI_SCO;
-        packet_length = buf[3];
-        packet->len = packet_length + BT_CMD_HDR_SIZE;
-        len = do_read(fd,buf+1,packet->len);
-        memcpy(packet->data, buf+1, packet->len);
-        sco_data_received(packet);
-        break;
-      case HCI_PACKET_TYPE_EVENT:
-        len = do_read(fd,buf+1,BT_EVT_HDR_SIZE);
-        packet->event = MSG_HC_TO_STACK_HCI_EVT;
-        packet_length = buf[2];
-        packet->len = packet_length + BT_EVT_HDR_SIZE;
-        len = do_read(fd, buf+BT_EVT_HDR_SIZE+1, packet_length);
-        memcpy(packet->data, buf+1, packet->len);
-        hci_event_received(FROM_HERE, packet);
-        break;
-      default:
-        LOG(FATAL) << "Unexpected event type: " << +type;
-        break;
-    }
+  while (reader.Read(fd) > 0) {
+    /* Everything that arrived with this read goes up in one go */
+    if (!reader.Frame(&packets))
+      LOG(FATAL) << "Unexpected event type: " << +reader.bad_type();
+    for (BT_HDR* packet : packets) dispatch_packet(packet);
+    packets.clear();
 
     fd_set fds;
     FD_ZERO(&fds);
@@ -273,8 +204,11 @@ void monitor_socket_stream(int ctrl_fd, int fd) {
       LOG(INFO) << "exitting";
       return;
     }
-    len = read(fd, buf, 1);
   }
+
+  if (reader.Pending() != 0)
+    LOG(INFO) << "read returned 0 with " << reader.Pending()
+              << " bytes of a partial packet";
 }
 
 /* TODO: should thread the device waiting and return immedialty */
@@ -418,6 +352,17 @@ hci_transmit_status_t hci_transmit(BT_HDR* packet) {
   return status;
 }
 
+hci_transmit_status_t hci_transmit_batch(HciTxBatch* batch,
+                                         size_t* syscalls) {
+  CHECK(bt_vendor_fd != -1);
+
+  if (!batch->Write(bt_vendor_fd, syscalls)) {
+    LOG(FATAL) << strerror(errno);
+    return HCI_TRANSMIT_DAEMON_DIED;
+  }
+  return HCI_TRANSMIT_SUCCESS;
+}
+
 #if (OFF_TARGET_TEST_ENABLED == FALSE)
 static int wait_hcidev(void) {
   struct sockaddr_hci addr;
@@ -24,10 +24,12 @@
 #include <string.h>
 #include <unordered_map>
 
+#include "bt_hdr_chain.h"
 #include "bt_target.h"
 #include "buffer_allocator.h"
 #include "device/include/controller.h"
 #include "hci_internals.h"
+#include "hci_tx_batch.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 
@@ -51,11 +53,23 @@ static const packet_fragmenter_callbacks_t* callbacks;
 
 static std::unordered_map<uint16_t /* handle */, BT_HDR*> partial_packets;
 
+// Used instead of partial_packets when reassembling into chains
+static bool chained_reassembly;
+static std::unordered_map<uint16_t /* handle */, BtHdrChain*> partial_chains;
+
 static void init(const packet_fragmenter_callbacks_t* result_callbacks) {
   callbacks = result_callbacks;
 }
 
-static void cleanup() { partial_packets.clear(); }
+static void cleanup() {
+  partial_packets.clear();
+  for (auto& entry : partial_chains) delete entry.second;
+  partial_chains.clear();
+}
+
+static void set_chained_reassembly(bool enabled) {
+  chained_reassembly = enabled;
+}
 
 static void fragment_and_dispatch(BT_HDR* packet) {
   CHECK(packet != NULL);
@@ -115,10 +129,107 @@ static void fragment_and_dispatch(BT_HDR* packet) {
   callbacks->fragmented(packet, true);
 }
 
+static void add_to_batch(HciTxBatch* batch, BT_HDR* packet,
+                         const uint8_t* acl_header, uint8_t* data,
+                         uint16_t len) {
+  if (batch->Full()) callbacks->batch_full(batch);
+  batch->Add(packet, acl_header, data, len);
+}
+
+static void fragment_and_batch(BT_HDR* packet, HciTxBatch* batch) {
+  CHECK(packet != NULL);
+
+  uint16_t event = packet->event & MSG_EVT_MASK;
+  uint8_t* stream = packet->data + packet->offset;
+
+  uint16_t max_data_size =
+      SUB_EVENT(packet->event) == LOCAL_BR_EDR_CONTROLLER_ID
+          ? controller->get_acl_data_size_classic()
+          : controller->get_acl_data_size_ble();
+
+  // Sent as it is unless it is an ACL packet too big for the controller
+  if (event != MSG_STACK_TO_HC_HCI_ACL ||
+      packet->len <= max_data_size + HCI_ACL_PREAMBLE_SIZE) {
+    add_to_batch(batch, packet, NULL, stream, packet->len);
+    batch->Release(packet);
+    return;
+  }
+
+  uint16_t handle;
+  STREAM_TO_UINT16(handle, stream);
+  uint8_t* data = stream + 2;
+  uint16_t remaining_length = packet->len - HCI_ACL_PREAMBLE_SIZE;
+  uint8_t header[HCI_ACL_PREAMBLE_SIZE];
+
+  while (remaining_length > max_data_size) {
+    stream = header;
+    UINT16_TO_STREAM(stream, handle);
+    UINT16_TO_STREAM(stream, max_data_size);
+    add_to_batch(batch, packet, header, data, max_data_size);
+
+    data += max_data_size;
+    remaining_length -= max_data_size;
+    handle = APPLY_CONTINUATION_FLAG(handle);
+
+    if (packet->layer_specific) {
+      packet->layer_specific--;
+
+      if (packet->layer_specific == 0) {
+        // Send what was batched, then hand the rest back with its header in
+        // place as fragment_and_dispatch does.
+        callbacks->batch_full(batch);
+
+        packet->offset = data - HCI_ACL_PREAMBLE_SIZE - packet->data;
+        packet->len = remaining_length + HCI_ACL_PREAMBLE_SIZE;
+        stream = packet->data + packet->offset;
+        UINT16_TO_STREAM(stream, handle);
+        UINT16_TO_STREAM(stream, remaining_length);
+
+        packet->event = MSG_HC_TO_STACK_L2C_SEG_XMIT;
+        callbacks->transmit_finished(packet, false);
+        return;
+      }
+    }
+  }
+
+  stream = header;
+  UINT16_TO_STREAM(stream, handle);
+  UINT16_TO_STREAM(stream, remaining_length);
+  add_to_batch(batch, packet, header, data, remaining_length);
+  batch->Release(packet);
+}
+
 static bool check_uint16_overflow(uint16_t a, uint16_t b) {
   return (UINT16_MAX - a) < b;
 }
 
+// Adds continuation |packet| to the |chain| being reassembled for |handle|,
+// and dispatches the chain once it is complete.
+static void append_to_chain(uint16_t handle, BtHdrChain* chain,
+                            BT_HDR* packet) {
+  // The ACL length of the first fragment was set to that of the whole packet
+  uint16_t acl_length = 0;
+  chain->ReadUint16(2, &acl_length);
+  size_t full_length = acl_length + HCI_ACL_PREAMBLE_SIZE;
+
+  packet->offset = HCI_ACL_PREAMBLE_SIZE;
+  packet->len -= HCI_ACL_PREAMBLE_SIZE;
+  if (chain->Len() + packet->len > full_length) {
+    LOG_WARN(LOG_TAG,
+             "%s got packet which would exceed expected length of %zu. "
+             "Truncating.",
+             __func__, full_length);
+    packet->len = full_length - chain->Len();
+  }
+  chain->Append(packet);
+
+  if (chain->Len() == full_length) {
+    partial_chains.erase(handle);
+    callbacks->reassembled(
+        BtHdrChain::Wrap(chain, MSG_HC_TO_STACK_HCI_ACL_CHAIN));
+  }
+}
+
 static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
   if ((packet->event & MSG_EVT_MASK) == MSG_HC_TO_STACK_HCI_ACL) {
     uint8_t* stream = packet->data;
@@ -154,6 +265,16 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
         buffer_allocator->free(hdl);
       }
 
+      auto chain_iter = partial_chains.find(handle);
+      if (chain_iter != partial_chains.end()) {
+        LOG_WARN(LOG_TAG,
+                 "%s found unfinished packet for handle with start packet. "
+                 "Dropping old.",
+                 __func__);
+        delete chain_iter->second;
+        partial_chains.erase(chain_iter);
+      }
+
       if (acl_length < L2CAP_HEADER_SIZE) {
         LOG_WARN(LOG_TAG, "%s L2CAP packet too small (%d < %d). Dropping it.",
                  __func__, packet->len, L2CAP_HEADER_SIZE);
@@ -168,10 +289,11 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
           l2cap_length + L2CAP_HEADER_SIZE + HCI_ACL_PREAMBLE_SIZE;
 
       // Check for buffer overflow and that the full packet size + BT_HDR size
-      // is less than the max buffer size
+      // is less than the max buffer size, which chains are not limited by
       if (check_uint16_overflow(l2cap_length,
                                 (L2CAP_HEADER_SIZE + HCI_ACL_PREAMBLE_SIZE)) ||
-          ((full_length + sizeof(BT_HDR)) > BT_DEFAULT_BUFFER_SIZE)) {
+          (!chained_reassembly &&
+           (full_length + sizeof(BT_HDR)) > BT_DEFAULT_BUFFER_SIZE)) {
         LOG_ERROR(LOG_TAG, "%s Dropping L2CAP packet with invalid length (%d).",
                   __func__, l2cap_length);
         buffer_allocator->free(packet);
@@ -188,6 +310,20 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
         return;
       }
 
+      if (chained_reassembly) {
+        // Keep the fragment as it is, with the ACL length of the whole packet
+        stream = packet->data;
+        STREAM_SKIP_UINT16(stream);  // skip the handle
+        UINT16_TO_STREAM(stream, full_length - HCI_ACL_PREAMBLE_SIZE);
+
+        // Continuations are expected to be the size of the first fragment
+        BtHdrChain* chain = new BtHdrChain(buffer_allocator);
+        chain->Reserve(full_length / packet->len + 1);
+        chain->Append(packet);
+        partial_chains[handle] = chain;
+        return;
+      }
+
       BT_HDR* partial_packet =
           (BT_HDR*)buffer_allocator->alloc(full_length + sizeof(BT_HDR));
       partial_packet->event = packet->event;
@@ -206,6 +342,12 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
       // Free the old packet buffer, since we don't need it anymore
       buffer_allocator->free(packet);
     } else {
+      auto chain_iter = partial_chains.find(handle);
+      if (chain_iter != partial_chains.end()) {
+        append_to_chain(handle, chain_iter->second, packet);
+        return;
+      }
+
       auto map_iter = partial_packets.find(handle);
       if (map_iter == partial_packets.end()) {
         LOG_WARN(LOG_TAG,
@@ -250,7 +392,9 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
 static const packet_fragmenter_t interface = {init, cleanup,
 
                                               fragment_and_dispatch,
-                                              reassemble_and_dispatch};
+                                              fragment_and_batch,
+                                              reassemble_and_dispatch,
+                                              set_chained_reassembly};
 
 const packet_fragmenter_t* packet_fragmenter_get_interface() {
   controller = controller_get_interface();
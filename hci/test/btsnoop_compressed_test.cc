@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "btsnoop_compressed.h"
+
+namespace {
+
+const uint64_t FIRST_TIMESTAMP = 0x00e2e3d8a1b2c3d4ULL;
+
+void put_be(uint8_t* p, uint64_t value, size_t len) {
+  for (size_t i = 0; i < len; i++) p[i] = value >> (8 * (len - 1 - i));
+}
+
+// A btsnoop record for an ACL packet of |len| bytes, |n| microseconds into
+// the capture.
+std::vector<uint8_t> make_record(size_t n, size_t len) {
+  std::vector<uint8_t> record(24 + 1 + len);
+  put_be(&record[0], 1 + len, 4);
+  put_be(&record[4], 1 + len, 4);
+  put_be(&record[8], n & 1, 4);
+  put_be(&record[16], FIRST_TIMESTAMP + n, 8);
+  record[24] = 2;
+  for (size_t i = 0; i < len; i++) record[25 + i] = (n + i / 8) & 0xff;
+  return record;
+}
+
+class BtsnoopCompressedTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    file_ = tmpfile();
+    fd_ = fileno(file_);
+  }
+
+  void TearDown() override { fclose(file_); }
+
+  // Writes a compressed log of |count| records to the file, in blocks of
+  // |block_size| bytes, and returns the records as one run of bytes.
+  std::vector<uint8_t> write_log(size_t count, size_t block_size) {
+    std::vector<uint8_t> all;
+    BtsnoopBlockWriter writer(block_size);
+    EXPECT_TRUE(BtsnoopBlockWriter::WriteFileHeader(fd_));
+    for (size_t n = 0; n < count; n++) {
+      std::vector<uint8_t> record = make_record(n, 10 + n % 300);
+      writer.Add(record.data(), record.size());
+      all.insert(all.end(), record.begin(), record.end());
+      if (writer.Full()) {
+        EXPECT_TRUE(writer.Flush(fd_));
+      }
+    }
+    EXPECT_TRUE(writer.Flush(fd_));
+    EXPECT_EQ(all.size(), writer.BytesIn());
+    EXPECT_LT(writer.BytesOut(), writer.BytesIn() / 4);
+    return all;
+  }
+
+  FILE* file_;
+  int fd_;
+};
+
+}  // namespace
+
+TEST_F(BtsnoopCompressedTest, round_trips_records) {
+  std::vector<uint8_t> written = write_log(2000, 8192);
+
+  std::vector<btsnoopz_block_t> index;
+  ASSERT_TRUE(btsnoopz_read_index(fd_, &index));
+  ASSERT_GT(index.size(), 10U);
+
+  std::vector<uint8_t> read;
+  size_t records = 0;
+  uint64_t timestamp = FIRST_TIMESTAMP;
+  for (const btsnoopz_block_t& block : index) {
+    EXPECT_EQ(timestamp, block.first_timestamp);
+    timestamp = block.last_timestamp + 1;
+    records += block.records;
+
+    std::vector<uint8_t> block_records;
+    ASSERT_TRUE(btsnoopz_read_block(fd_, block, &block_records));
+    read.insert(read.end(), block_records.begin(), block_records.end());
+  }
+  EXPECT_EQ(2000U, records);
+  EXPECT_EQ(written, read);
+}
+
+TEST_F(BtsnoopCompressedTest, seeks_by_timestamp) {
+  write_log(2000, 8192);
+  std::vector<btsnoopz_block_t> index;
+  ASSERT_TRUE(btsnoopz_read_index(fd_, &index));
+
+  // Only the block holding the record wanted is inflated.
+  uint64_t wanted = FIRST_TIMESTAMP + 1234;
+  auto block = std::find_if(index.begin(), index.end(),
+                            [wanted](const btsnoopz_block_t& block) {
+                              return block.last_timestamp >= wanted;
+                            });
+  ASSERT_NE(index.end(), block);
+  ASSERT_LE(block->first_timestamp, wanted);
+
+  std::vector<uint8_t> records;
+  ASSERT_TRUE(btsnoopz_read_block(fd_, *block, &records));
+  std::vector<uint8_t> expected = make_record(1234, 10 + 1234 % 300);
+  EXPECT_NE(records.end(), std::search(records.begin(), records.end(),
+                                       expected.begin(), expected.end()));
+}
+
+TEST_F(BtsnoopCompressedTest, leaves_out_block_cut_short) {
+  write_log(500, 4096);
+  std::vector<btsnoopz_block_t> index;
+  ASSERT_TRUE(btsnoopz_read_index(fd_, &index));
+  size_t blocks = index.size();
+
+  const btsnoopz_block_t& last = index.back();
+  ASSERT_EQ(0, ftruncate(fd_, last.offset + last.compressed_len / 2));
+  ASSERT_TRUE(btsnoopz_read_index(fd_, &index));
+  EXPECT_EQ(blocks - 1, index.size());
+}
+
+TEST_F(BtsnoopCompressedTest, rejects_plain_btsnoop) {
+  ASSERT_EQ(16, write(fd_, "btsnoop\0\0\0\0\1\0\0\x3\xea", 16));
+  std::vector<btsnoopz_block_t> index;
+  EXPECT_FALSE(btsnoopz_read_index(fd_, &index));
+}
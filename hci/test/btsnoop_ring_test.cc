@@ -0,0 +1,117 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "btsnoop_ring.h"
+
+namespace {
+
+typedef std::vector<uint8_t> Record;
+
+// Pushes |header| followed by |len| bytes of |fill|.
+bool push(BtsnoopRing* ring, uint8_t header, size_t len, uint8_t fill) {
+  std::vector<uint8_t> data(len, fill);
+  return ring->Push(&header, 1, data.data(), data.size());
+}
+
+std::vector<Record> drain(BtsnoopRing* ring) {
+  std::vector<Record> records;
+  size_t consumed = ring->ForEachRecord([&](uint8_t* record, size_t len) {
+    records.emplace_back(record, record + len);
+  });
+  ring->Consume(consumed);
+  return records;
+}
+
+Record record(uint8_t header, size_t len, uint8_t fill) {
+  Record bytes(1 + len, fill);
+  bytes[0] = header;
+  return bytes;
+}
+
+}  // namespace
+
+TEST(BtsnoopRingTest, passes_records_in_order) {
+  BtsnoopRing ring(256);
+  EXPECT_EQ(256U, ring.Size());
+  ASSERT_TRUE(push(&ring, 1, 10, 0xaa));
+  ASSERT_TRUE(push(&ring, 2, 0, 0));
+  ASSERT_TRUE(push(&ring, 3, 30, 0xbb));
+  EXPECT_NE(0U, ring.Pending());
+
+  std::vector<Record> expected = {record(1, 10, 0xaa), record(2, 0, 0),
+                                  record(3, 30, 0xbb)};
+  EXPECT_EQ(expected, drain(&ring));
+  EXPECT_EQ(0U, ring.Pending());
+  EXPECT_TRUE(drain(&ring).empty());
+}
+
+TEST(BtsnoopRingTest, keeps_records_whole_across_the_end) {
+  BtsnoopRing ring(128);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(push(&ring, i, 37, i));
+    ASSERT_TRUE(push(&ring, i + 100, 11, i));
+    std::vector<Record> expected = {record(i, 37, i), record(i + 100, 11, i)};
+    EXPECT_EQ(expected, drain(&ring));
+  }
+  EXPECT_EQ(0U, ring.Dropped());
+}
+
+TEST(BtsnoopRingTest, counts_records_dropped_when_full) {
+  BtsnoopRing ring(128);
+  int pushed = 0;
+  while (push(&ring, pushed, 27, 0)) pushed++;
+  EXPECT_EQ(4, pushed);
+  EXPECT_EQ(1U, ring.Dropped());
+  EXPECT_FALSE(push(&ring, 0, 200, 0));
+  EXPECT_EQ(2U, ring.Dropped());
+
+  EXPECT_EQ(4U, drain(&ring).size());
+  EXPECT_TRUE(push(&ring, 0, 27, 0));
+  EXPECT_EQ(2U, ring.Dropped());
+}
+
+TEST(BtsnoopRingTest, hands_records_between_threads) {
+  BtsnoopRing ring(1024);
+  const int kRecords = 20000;
+  std::thread producer([&ring] {
+    for (int i = 0; i < kRecords; i++) {
+      uint32_t value = i;
+      while (!ring.Push(&value, sizeof(value), &value, i % 50 ? 0 : 1)) {
+      }
+    }
+  });
+
+  int received = 0;
+  while (received < kRecords) {
+    size_t consumed = ring.ForEachRecord([&](uint8_t* record, size_t len) {
+      uint32_t value;
+      memcpy(&value, record, sizeof(value));
+      EXPECT_EQ(static_cast<uint32_t>(received), value);
+      EXPECT_EQ(received % 50 ? 4U : 5U, len);
+      received++;
+    });
+    ring.Consume(consumed);
+  }
+  producer.join();
+  EXPECT_EQ(0U, ring.Pending());
+}
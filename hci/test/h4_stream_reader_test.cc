@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "h4_stream_reader.h"
+#include "hci_layer.h"
+
+namespace {
+
+std::vector<uint8_t> acl_packet(uint16_t handle, size_t payload_size) {
+  std::vector<uint8_t> packet = {
+      HCI_PACKET_TYPE_ACL_DATA, static_cast<uint8_t>(handle),
+      static_cast<uint8_t>(handle >> 8), static_cast<uint8_t>(payload_size),
+      static_cast<uint8_t>(payload_size >> 8)};
+  for (size_t i = 0; i < payload_size; i++) packet.push_back(i);
+  return packet;
+}
+
+std::vector<uint8_t> event_packet(uint8_t code, uint8_t payload_size) {
+  std::vector<uint8_t> packet = {HCI_PACKET_TYPE_EVENT, code, payload_size};
+  for (size_t i = 0; i < payload_size; i++) packet.push_back(0xa0 + i);
+  return packet;
+}
+
+void free_all(std::vector<BT_HDR*>* packets) {
+  for (BT_HDR* packet : *packets) allocator_malloc.free(packet);
+  packets->clear();
+}
+
+}  // namespace
+
+TEST(H4StreamReaderTest, frames_several_packets_per_read) {
+  H4StreamReader reader(&allocator_malloc, 256);
+  std::vector<uint8_t> stream = event_packet(0x0e, 4);
+  std::vector<uint8_t> acl = acl_packet(0x2001, 27);
+  stream.insert(stream.end(), acl.begin(), acl.end());
+  std::vector<uint8_t> sco = {HCI_PACKET_TYPE_SCO_DATA, 0x02, 0x00, 2, 7, 8};
+  stream.insert(stream.end(), sco.begin(), sco.end());
+
+  ASSERT_TRUE(reader.Append(stream.data(), stream.size()));
+  std::vector<BT_HDR*> packets;
+  ASSERT_TRUE(reader.Frame(&packets));
+  ASSERT_EQ(3U, packets.size());
+  EXPECT_EQ(0U, reader.Pending());
+
+  EXPECT_EQ(MSG_HC_TO_STACK_HCI_EVT, packets[0]->event);
+  EXPECT_EQ(6, packets[0]->len);
+  EXPECT_EQ(0x0e, packets[0]->data[0]);
+
+  EXPECT_EQ(MSG_HC_TO_STACK_HCI_ACL, packets[1]->event);
+  EXPECT_EQ(31, packets[1]->len);
+  EXPECT_EQ(0, memcmp(packets[1]->data, acl.data() + 1, 31));
+
+  EXPECT_EQ(MSG_HC_TO_STACK_HCI_SCO, packets[2]->event);
+  EXPECT_EQ(5, packets[2]->len);
+  EXPECT_EQ(8, packets[2]->data[4]);
+  free_all(&packets);
+}
+
+TEST(H4StreamReaderTest, keeps_partial_packets) {
+  H4StreamReader reader(&allocator_malloc, 64);
+  std::vector<uint8_t> stream = acl_packet(0x2001, 10);
+  std::vector<BT_HDR*> packets;
+
+  // One byte at a time, the packet only comes out once it is complete.
+  for (size_t i = 0; i < stream.size(); i++) {
+    ASSERT_TRUE(reader.Append(&stream[i], 1));
+    ASSERT_TRUE(reader.Frame(&packets));
+    EXPECT_EQ(i + 1 == stream.size() ? 1U : 0U, packets.size());
+  }
+  EXPECT_EQ(0U, reader.Pending());
+  free_all(&packets);
+}
+
+TEST(H4StreamReaderTest, grows_for_large_packets) {
+  int sv[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+  H4StreamReader reader(&allocator_malloc, 128);
+  std::vector<uint8_t> stream = acl_packet(0x2001, 1000);
+  std::vector<uint8_t> event = event_packet(0x13, 5);
+  stream.insert(stream.end(), event.begin(), event.end());
+  ASSERT_EQ(static_cast<ssize_t>(stream.size()),
+            write(sv[1], stream.data(), stream.size()));
+
+  std::vector<BT_HDR*> packets;
+  while (packets.size() < 2) {
+    ASSERT_GT(reader.Read(sv[0]), 0);
+    ASSERT_TRUE(reader.Frame(&packets));
+  }
+  EXPECT_EQ(1004, packets[0]->len);
+  EXPECT_EQ(0, memcmp(packets[0]->data, stream.data() + 1, 1004));
+  EXPECT_EQ(7, packets[1]->len);
+  free_all(&packets);
+
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(H4StreamReaderTest, rejects_unknown_packet_types) {
+  H4StreamReader reader(&allocator_malloc, 64);
+  std::vector<uint8_t> stream = event_packet(0x0e, 1);
+  stream.push_back(0x42);
+
+  ASSERT_TRUE(reader.Append(stream.data(), stream.size()));
+  std::vector<BT_HDR*> packets;
+  EXPECT_FALSE(reader.Frame(&packets));
+  EXPECT_EQ(1U, packets.size());
+  EXPECT_EQ(0x42, reader.bad_type());
+  free_all(&packets);
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "hci_pending_commands.h"
+
+namespace {
+
+typedef HciPendingCommands<int> PendingCommands;
+typedef PendingCommands::TimePoint TimePoint;
+
+const uint16_t RESET = 0x0c03;
+const uint16_t READ_BD_ADDR = 0x1009;
+const uint16_t VENDOR_A = 0xfc0c;
+const uint16_t VENDOR_B = 0xfd53;
+
+TimePoint at(int ms) {
+  return TimePoint() + std::chrono::milliseconds(ms);
+}
+
+}  // namespace
+
+TEST(HciPendingCommandsTest, matches_oldest_with_opcode) {
+  int commands[4];
+  PendingCommands pending;
+  pending.Add(RESET, &commands[0], at(10));
+  pending.Add(READ_BD_ADDR, &commands[1], at(20));
+  pending.Add(RESET, &commands[2], at(30));
+  EXPECT_EQ(3U, pending.Size());
+
+  EXPECT_EQ(&commands[1], pending.Take(READ_BD_ADDR));
+  EXPECT_EQ(nullptr, pending.Take(READ_BD_ADDR));
+  EXPECT_EQ(&commands[0], pending.Take(RESET));
+  EXPECT_EQ(&commands[2], pending.Take(RESET));
+  EXPECT_TRUE(pending.Empty());
+}
+
+TEST(HciPendingCommandsTest, matches_vendor_specific_responses_loosely) {
+  int commands[3];
+  PendingCommands pending;
+  pending.Add(RESET, &commands[0], at(10));
+  pending.Add(VENDOR_A, &commands[1], at(20));
+  pending.Add(VENDOR_B, &commands[2], at(30));
+
+  // Only vendor specific or no opcode stands in for another
+  EXPECT_EQ(nullptr, pending.Take(READ_BD_ADDR));
+  EXPECT_EQ(&commands[1], pending.Take(0xfe00));
+  EXPECT_EQ(&commands[2], pending.Take(0x0000));
+  EXPECT_EQ(nullptr, pending.Take(0x0000));
+  EXPECT_EQ(&commands[0], pending.Take(RESET));
+}
+
+TEST(HciPendingCommandsTest, keeps_the_earliest_deadline) {
+  int commands[3];
+  PendingCommands pending;
+  TimePoint deadline;
+  EXPECT_EQ(nullptr, pending.NextDeadline(&deadline));
+
+  pending.Add(RESET, &commands[0], at(30));
+  pending.Add(READ_BD_ADDR, &commands[1], at(10));
+  pending.Add(VENDOR_A, &commands[2], at(20));
+
+  EXPECT_EQ(&commands[1], pending.NextDeadline(&deadline));
+  EXPECT_EQ(at(10), deadline);
+
+  pending.Take(READ_BD_ADDR);
+  EXPECT_EQ(&commands[2], pending.NextDeadline(&deadline));
+  EXPECT_EQ(at(20), deadline);
+
+  EXPECT_EQ(&commands[2], pending.PostponeNext(at(50)));
+  EXPECT_EQ(&commands[0], pending.NextDeadline(&deadline));
+  EXPECT_EQ(at(30), deadline);
+
+  pending.Take(RESET);
+  EXPECT_EQ(&commands[2], pending.NextDeadline(&deadline));
+  EXPECT_EQ(at(50), deadline);
+
+  pending.Clear();
+  EXPECT_EQ(nullptr, pending.NextDeadline(&deadline));
+  EXPECT_EQ(nullptr, pending.PostponeNext(at(60)));
+}
+
+TEST(HciPendingCommandsTest, lists_oldest_first) {
+  int commands[3];
+  PendingCommands pending;
+  pending.Add(VENDOR_A, &commands[0], at(30));
+  pending.Add(RESET, &commands[1], at(10));
+  pending.Add(VENDOR_A, &commands[2], at(20));
+  pending.Take(RESET);
+
+  std::vector<int*> listed;
+  pending.ForEach([&listed](int* command) { listed.push_back(command); });
+  std::vector<int*> expected = {&commands[0], &commands[2]};
+  EXPECT_EQ(expected, listed);
+}
@@ -21,9 +21,16 @@
 #include "AllocationTestHarness.h"
 
 #include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <string>
+
+#include "bt_hdr_chain.h"
 #include "device/include/controller.h"
 #include "hci_internals.h"
+#include "hci_tx_batch.h"
 #include "osi/include/allocator.h"
 #include "osi/include/osi.h"
 #include "packet_fragmenter.h"
@@ -32,7 +39,8 @@
 DECLARE_TEST_MODES(init, set_data_sizes, no_fragmentation, fragmentation,
                    ble_no_fragmentation, ble_fragmentation,
                    non_acl_passthrough_fragmentation, no_reassembly, reassembly,
-                   non_acl_passthrough_reassembly);
+                   non_acl_passthrough_reassembly, batch_fragmentation,
+                   chained_reassembly);
 
 #define LOCAL_BLE_CONTROLLER_ID 1
 
@@ -57,6 +65,8 @@ static const uint16_t test_handle_continuation = (0x1992 & 0xCFFF) | 0x1000;
 static int packet_index;
 static unsigned int data_size_sum;
 
+static std::string batched_stream;
+
 static const packet_fragmenter_t* fragmenter;
 
 static BT_HDR* manufacture_packet_for_fragmentation(uint16_t event,
@@ -203,6 +213,27 @@ static void expect_packet_reassembled(uint16_t event, BT_HDR* packet,
   osi_free(packet);
 }
 
+// Sends |batch| through a socket the way hci_transmit_batch does, and keeps
+// what came out the other end in |batched_stream|.
+static void send_batch(HciTxBatch* batch) {
+  int sv[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+  size_t syscalls = 0;
+  EXPECT_TRUE(batch->Write(sv[0], &syscalls));
+  EXPECT_EQ(1U, syscalls);
+
+  std::string received(batch->Bytes(), 0);
+  EXPECT_EQ((ssize_t)received.size(),
+            read(sv[1], &received[0], received.size()));
+  batched_stream += received;
+  close(sv[0]);
+  close(sv[1]);
+
+  for (BT_HDR* packet : batch->released()) osi_free(packet);
+  batch->Clear();
+}
+
 STUB_FUNCTION(void, fragmented_callback, (BT_HDR * packet, bool send_complete))
 DURING(no_fragmentation) AT_CALL(0) {
   expect_packet_fragmented(MSG_STACK_TO_HC_HCI_ACL, 42, packet,
@@ -253,6 +284,27 @@ DURING(non_acl_passthrough_reassembly) AT_CALL(0) {
   return;
 }
 
+DURING(chained_reassembly) AT_CALL(0) {
+  EXPECT_EQ(MSG_HC_TO_STACK_HCI_ACL_CHAIN, packet->event);
+  BtHdrChain* chain = BtHdrChain::Unwrap(packet);
+  // Every fragment is kept, without its ACL header past the first one
+  EXPECT_EQ((strlen(sample_data) + 2 + 38 - 1) / 38, chain->NumBuffers());
+  EXPECT_EQ(HCI_ACL_PREAMBLE_SIZE + 2 + strlen(sample_data), chain->Len());
+  expect_packet_reassembled(MSG_HC_TO_STACK_HCI_ACL, chain->Flatten(),
+                            sample_data);
+  delete chain;
+  return;
+}
+
+UNEXPECTED_CALL;
+}
+
+STUB_FUNCTION(void, batch_full_callback, (HciTxBatch * batch))
+DURING(batch_fragmentation) {
+  send_batch(batch);
+  return;
+}
+
 UNEXPECTED_CALL;
 }
 
@@ -265,7 +317,7 @@ UNEXPECTED_CALL;
 STUB_FUNCTION(uint16_t, get_acl_data_size_classic, (void))
 DURING(no_fragmentation, non_acl_passthrough_fragmentation, no_reassembly)
 return 42;
-DURING(fragmentation) return 10;
+DURING(fragmentation, batch_fragmentation) return 10;
 DURING(no_reassembly) return 1337;
 
 UNEXPECTED_CALL;
@@ -284,6 +336,7 @@ static void reset_for(TEST_MODES_T next) {
   RESET_CALL_COUNT(fragmented_callback);
   RESET_CALL_COUNT(reassembled_callback);
   RESET_CALL_COUNT(transmit_finished_callback);
+  RESET_CALL_COUNT(batch_full_callback);
   RESET_CALL_COUNT(get_acl_data_size_classic);
   RESET_CALL_COUNT(get_acl_data_size_ble);
   CURRENT_TEST_MODE = next;
@@ -298,15 +351,18 @@ class PacketFragmenterTest : public AllocationTestHarness {
 
     packet_index = 0;
     data_size_sum = 0;
+    batched_stream.clear();
 
     callbacks.fragmented = fragmented_callback;
     callbacks.reassembled = reassembled_callback;
     callbacks.transmit_finished = transmit_finished_callback;
+    callbacks.batch_full = batch_full_callback;
     controller.get_acl_data_size_classic = get_acl_data_size_classic;
     controller.get_acl_data_size_ble = get_acl_data_size_ble;
 
     reset_for(init);
     fragmenter->init(&callbacks);
+    fragmenter->set_chained_reassembly(false);
   }
 
   virtual void TearDown() {
@@ -368,6 +424,76 @@ TEST_F(PacketFragmenterTest, test_non_acl_passthrough_fragmentation) {
   EXPECT_CALL_COUNT(fragmented_callback, 1);
 }
 
+TEST_F(PacketFragmenterTest, test_fragment_into_batch) {
+  reset_for(batch_fragmentation);
+  BT_HDR* packet = manufacture_packet_for_fragmentation(MSG_STACK_TO_HC_HCI_ACL,
+                                                        sample_data);
+  HciTxBatch batch(8);
+  fragmenter->fragment_and_batch(packet, &batch);
+  send_batch(&batch);
+
+  // The fragments fragment_and_dispatch would make, each after its H4 type
+  std::string expected;
+  size_t total = strlen(sample_data);
+  size_t fragments = 0;
+  uint16_t handle = test_handle_start;
+  for (size_t sent = 0; sent < total; sent += 10) {
+    size_t length = std::min<size_t>(10, total - sent);
+    expected += (char)HCI_PACKET_TYPE_ACL_DATA;
+    expected += (char)(handle & 0xff);
+    expected += (char)(handle >> 8);
+    expected += (char)length;
+    expected += (char)0;
+    expected.append(sample_data + sent, length);
+    handle = test_handle_continuation;
+    fragments++;
+  }
+  EXPECT_EQ(expected, batched_stream);
+  EXPECT_CALL_COUNT(batch_full_callback, (fragments - 1) / 8);
+}
+
+TEST_F(PacketFragmenterTest, test_batch_command_freed_during_send) {
+  reset_for(batch_fragmentation);
+  BT_HDR* command = manufacture_packet_for_fragmentation(
+      MSG_STACK_TO_HC_HCI_CMD, small_sample_data);
+  BT_HDR* packet = manufacture_packet_for_fragmentation(MSG_STACK_TO_HC_HCI_ACL,
+                                                        small_sample_data);
+  HciTxBatch batch;
+  batch.Add(command, NULL, command->data + command->offset, command->len);
+  fragmenter->fragment_and_batch(packet, &batch);
+
+  // Each fragment the way a sender that cannot gather sees it. The command is
+  // answered, and freed, before the sender returns.
+  std::string sent;
+  batch.ForEachFragment([&sent](BT_HDR* fragment) {
+    sent.append((const char*)fragment->data + fragment->offset, fragment->len);
+    if ((fragment->event & MSG_EVT_MASK) == MSG_STACK_TO_HC_HCI_CMD)
+      osi_free(fragment);
+  });
+
+  std::string expected = small_sample_data;
+  size_t total = strlen(small_sample_data);
+  uint16_t handle = test_handle_start;
+  for (size_t offset = 0; offset < total; offset += 10) {
+    size_t length = std::min<size_t>(10, total - offset);
+    expected += (char)(handle & 0xff);
+    expected += (char)(handle >> 8);
+    expected += (char)length;
+    expected += (char)0;
+    expected.append(small_sample_data + offset, length);
+    handle = test_handle_continuation;
+  }
+  EXPECT_EQ(expected, sent);
+
+  // The ACL packet is left as it was, for the sender to free
+  ASSERT_EQ(1U, batch.released().size());
+  EXPECT_EQ(packet, batch.released()[0]);
+  EXPECT_EQ(0, packet->offset);
+  EXPECT_EQ(strlen(small_sample_data) + HCI_ACL_PREAMBLE_SIZE, packet->len);
+  osi_free(packet);
+  batch.Clear();
+}
+
 TEST_F(PacketFragmenterTest, test_no_reassembly_necessary) {
   reset_for(no_reassembly);
   manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_ACL, 1337,
@@ -394,3 +520,13 @@ TEST_F(PacketFragmenterTest, test_non_acl_passthrough_reasseembly) {
   EXPECT_EQ(strlen(sample_data), data_size_sum);
   EXPECT_CALL_COUNT(reassembled_callback, 1);
 }
+
+TEST_F(PacketFragmenterTest, test_chained_reassembly) {
+  reset_for(chained_reassembly);
+  fragmenter->set_chained_reassembly(true);
+  manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_ACL, 42,
+                                         sample_data);
+
+  EXPECT_EQ(strlen(sample_data), data_size_sum);
+  EXPECT_CALL_COUNT(reassembled_callback, 1);
+}
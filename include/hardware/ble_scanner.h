@@ -43,11 +43,37 @@ typedef void (*scan_result_callback)(uint16_t event_type, uint8_t addr_type,
                                      int8_t rssi, uint16_t periodic_adv_int,
                                      std::vector<uint8_t> adv_data);
 
+/** Header of each scan result in the data passed to batch_scan_result_cb. It
+ * is followed by |adv_data_len| bytes of advertising data, and then by the
+ * header of the next result. Headers are not aligned; copy them out with
+ * memcpy. */
+typedef struct {
+  uint16_t event_type;
+  uint16_t periodic_adv_int;
+  uint16_t adv_data_len;
+  uint8_t addr_type;
+  RawAddress bda;
+  uint8_t primary_phy;
+  uint8_t secondary_phy;
+  uint8_t advertising_sid;
+  int8_t tx_power;
+  int8_t rssi;
+  RawAddress original_bda;
+  uint8_t device_type;
+} btgatt_scan_result_record_t;
+
+/** Callback for scan results of a scanner that enabled batching, see
+ * BleScannerInterface::SetScanResultBatching. |results| holds |num_results|
+ * records laid out as described for btgatt_scan_result_record_t. */
+typedef void (*batch_scan_result_callback)(int scanner_id, int num_results,
+                                           std::vector<uint8_t> results);
+
 typedef struct {
   scan_result_callback scan_result_cb;
   batchscan_reports_callback batchscan_reports_cb;
   batchscan_threshold_callback batchscan_threshold_cb;
   track_adv_event_callback track_adv_event_cb;
+  batch_scan_result_callback batch_scan_result_cb;
 } btgatt_scanner_callbacks_t;
 
 class BleScannerInterface {
@@ -79,6 +105,18 @@ class BleScannerInterface {
   /** Start or stop LE device scanning */
   virtual void Scan(bool start) = 0;
 
+  /** Deliver the scan results of |scanner_id| through batch_scan_result_cb,
+   * at most |window_ms| after the first result of a batch was received, or
+   * as soon as |max_results| results are pending. Passing 0 for both goes
+   * back to delivering each result through scan_result_cb. When several
+   * scanners enable batching, they share the shortest window and smallest
+   * count. scan_result_cb keeps being called while any registered scanner
+   * has not enabled batching; results of scanners that did must then be
+   * ignored there. */
+  virtual void SetScanResultBatching(int /* scanner_id */,
+                                     uint16_t /* window_ms */,
+                                     uint16_t /* max_results */) {}
+
   /** Setup scan filter params */
   virtual void ScanFilterParamSetup(
       uint8_t client_if, uint8_t action, uint8_t filt_index,
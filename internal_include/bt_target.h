@@ -817,6 +817,14 @@
 #define GATT_MAX_EATT_CHANNELS 64
 #endif
 
+/* How long the server may hold a notification back to send it along with
+ * others of the same bearer in a Multiple Handle Value Notification, for
+ * clients that support them. 0 sends each notification on its own. The
+ * default of persist.bluetooth.gatt_multi_notif_coalesce_ms. */
+#ifndef GATT_MULTI_NOTIF_COALESCE_MS
+#define GATT_MULTI_NOTIF_COALESCE_MS 0
+#endif
+
 /* connection manager doesn't generate it's own IDs. Instead, all GATT clients
  * use their gatt_if to identify against conection manager. When stack tries to
  * create l2cap connection, it will use this fixed ID. */
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size-class pool allocator used underneath |osi_malloc| and |osi_free|.
+//
+// Requests up to the largest size class (|BT_DEFAULT_BUFFER_SIZE| plus
+// allocation tracker canaries) are served from per-thread free lists, which
+// are refilled from and drained to a shared depot in batches so that
+// producer/consumer thread pairs (e.g. HCI RX -> btu) keep recycling the same
+// blocks. Larger requests fall through to malloc.
+//
+// All functions are thread safe.
+
+// Allocates |size| bytes. Never returns NULL; aborts if the system is out of
+// memory.
+void* buffer_pool_alloc(size_t size);
+
+// Allocates |size| zero-initialized bytes. Never returns NULL.
+void* buffer_pool_calloc(size_t size);
+
+// Returns |ptr| to the pool. |ptr| must have been returned by
+// |buffer_pool_alloc| or |buffer_pool_calloc|. Safe to call with NULL.
+void buffer_pool_free(void* ptr);
+
+// Releases every block cached by the calling thread and by the shared depot
+// back to the system. Counters are preserved.
+void buffer_pool_trim(void);
+
+// Resets the hit/miss/high-water counters. Useful mostly for testing.
+void buffer_pool_reset_stats(void);
+
+// Number of allocations that were served from the pool rather than malloc.
+size_t buffer_pool_hit_count(void);
+
+// Number of allocations that had to call malloc, including oversized ones.
+size_t buffer_pool_miss_count(void);
+
+// Dumps per size class hit/miss/high-water statistics to the |fd| file
+// descriptor in user-readable text format. The |fd| must be valid.
+void buffer_pool_debug_dump(int fd);
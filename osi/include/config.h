@@ -54,6 +54,14 @@ std::string checksum_read(const char* filename);
 // Clients must call config_free on the returned object.
 config_t* config_new_clone(const config_t* src);
 
+// Makes |section| in |dst| an exact copy of |section| in |src|. If |dst|
+// already has the section, its entries are replaced in place so the section
+// keeps its position; otherwise it is appended. If |src| has no such section
+// it is removed from |dst|. Returns true if |src| has the section.
+// None of |dst|, |src|, or |section| may be NULL.
+bool config_copy_section(config_t* dst, const config_t* src,
+                         const char* section);
+
 // Frees resources associated with the config file. No further operations may
 // be performed on the |config| object after calling this function. |config|
 // may be NULL.
@@ -27,6 +27,16 @@ struct fixed_queue_t;
 typedef struct fixed_queue_t fixed_queue_t;
 typedef struct reactor_t reactor_t;
 
+typedef enum {
+  // Exactly one thread enqueues and exactly one thread dequeues.
+  FIXED_QUEUE_SPSC,
+  // Any number of threads enqueue and exactly one thread dequeues.
+  FIXED_QUEUE_MPSC,
+} fixed_queue_ring_mode_t;
+
+// Largest capacity accepted by |fixed_queue_new_ring|.
+#define FIXED_QUEUE_RING_MAX_CAPACITY (1 << 20)
+
 typedef void (*fixed_queue_free_cb)(void* data);
 typedef void (*fixed_queue_cb)(fixed_queue_t* queue, void* context);
 
@@ -36,6 +46,23 @@ typedef void (*fixed_queue_cb)(fixed_queue_t* queue, void* context);
 // the returned queue with |fixed_queue_free|.
 fixed_queue_t* fixed_queue_new(size_t capacity);
 
+// Creates a new fixed queue backed by a bounded, lock-free ring buffer.
+// |capacity| must be non-zero and no larger than
+// |FIXED_QUEUE_RING_MAX_CAPACITY|; it is rounded up to a power of two. Enqueue
+// and dequeue never take a lock or allocate, and the dequeue file descriptor
+// is only signalled when the queue goes from empty to non-empty. |mode|
+// restricts which threads may touch the queue: every dequeue-side call
+// (dequeue, try_dequeue, try_peek_first, flush) must come from the single
+// consumer thread. |fixed_queue_try_peek_last|,
+// |fixed_queue_try_remove_from_queue| and |fixed_queue_get_list| are not
+// supported. In MPSC mode the dequeue file descriptor can become readable a
+// moment before the head element is visible, so reactor callbacks should use
+// |fixed_queue_dequeue| rather than |fixed_queue_try_dequeue|. Returns NULL
+// on failure. The caller must free the returned queue
+// with |fixed_queue_free|.
+fixed_queue_t* fixed_queue_new_ring(size_t capacity,
+                                    fixed_queue_ring_mode_t mode);
+
 // Frees a queue and (optionally) the enqueued elements.
 // |queue| is the queue to free. If the |free_cb| callback is not null,
 // it is called on each queue element to free it.
@@ -36,11 +36,12 @@
 
 #include <hardware/bluetooth.h>
 
+#include <algorithm>
 #include <mutex>
+#include <vector>
 
 #include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
-#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/semaphore.h"
@@ -107,8 +108,19 @@ struct alarm_t {
 
   bool for_msg_loop;  // True, if the alarm should be processed on message loop
   CancelableClosureInStruct closure;  // posted to message loop for processing
+
+  // Position in the |alarms| heap, or ALARM_NOT_PENDING. Lets cancel and
+  // reschedule find the alarm without a search.
+  size_t heap_index;
+  // Insertion order, used to fire alarms with equal deadlines in the order
+  // they were scheduled.
+  uint64_t sequence;
+  // Number of times this alarm is sitting in |queue| waiting to be processed.
+  size_t queued_count;
 };
 
+#define ALARM_NOT_PENDING SIZE_MAX
+
 // If the next wakeup time is less than this threshold, we should acquire
 // a wakelock instead of setting a wake alarm so we're not bouncing in
 // and out of suspend frequently. This value is externally visible to allow
@@ -124,9 +136,12 @@ static const clockid_t CLOCK_ID_ALARM = CLOCK_BOOTTIME_ALARM;
 
 // This mutex ensures that the |alarm_set|, |alarm_cancel|, and alarm callback
 // functions execute serially and not concurrently. As a result, this mutex
-// also protects the |alarms| list.
+// also protects the |alarms| heap.
 static std::mutex alarms_mutex;
-static list_t* alarms;
+// Binary min-heap of pending alarms ordered by (deadline, sequence). The
+// earliest alarm is always at index 0.
+static std::vector<alarm_t*>* alarms;
+static uint64_t alarms_sequence;
 static timer_t timer;
 static timer_t wakeup_timer;
 static bool timer_set;
@@ -148,6 +163,9 @@ static void alarm_set_internal(alarm_t* alarm, period_ms_t period,
                                fixed_queue_t* queue, bool for_msg_loop);
 static void* alarm_cancel_internal(alarm_t* alarm);
 static void remove_pending_alarm(alarm_t* alarm);
+static alarm_t* alarms_front(void);
+static void alarms_push(alarm_t* alarm);
+static void alarms_remove(alarm_t* alarm);
 static void schedule_next_instance(alarm_t* alarm);
 static void reschedule_root_alarm(void);
 static void alarm_queue_ready(fixed_queue_t* queue, void* context);
@@ -188,6 +206,7 @@ static alarm_t* alarm_new_internal(const char* name, bool is_periodic) {
   ret->stats.name = osi_strdup(name);
 
   ret->for_msg_loop = false;
+  ret->heap_index = ALARM_NOT_PENDING;
   // placement new
   new (&ret->closure) CancelableClosureInStruct();
 
@@ -274,8 +293,7 @@ void* alarm_cancel(alarm_t* alarm) {
 // Internal implementation of canceling an alarm.
 // The caller must hold the |alarms_mutex|
 static void* alarm_cancel_internal(alarm_t* alarm) {
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarms_front() == alarm);
 
   remove_pending_alarm(alarm);
 
@@ -318,7 +336,7 @@ void alarm_cleanup(void) {
   semaphore_free(alarm_expired);
   alarm_expired = NULL;
 
-  list_free(alarms);
+  delete alarms;
   alarms = NULL;
 }
 
@@ -332,11 +350,7 @@ static bool lazy_initialize(void) {
 
   std::lock_guard<std::mutex> lock(alarms_mutex);
 
-  alarms = list_new(NULL);
-  if (!alarms) {
-    LOG_ERROR(LOG_TAG, "%s unable to allocate alarm list.", __func__);
-    goto error;
-  }
+  alarms = new std::vector<alarm_t*>();
 
   if (!timer_create_internal(CLOCK_ID, &timer)) goto error;
   timer_initialized = true;
@@ -395,7 +409,7 @@ error:
 
   if (timer_initialized) timer_delete(timer);
 
-  list_free(alarms);
+  delete alarms;
   alarms = NULL;
 
   return false;
@@ -414,28 +428,101 @@ static period_ms_t now(void) {
   return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000LL);
 }
 
-// Remove alarm from internal alarm list and the processing queue
+// Returns true if alarm |a| should fire before alarm |b|.
+static bool alarm_before(const alarm_t* a, const alarm_t* b) {
+  if (a->deadline != b->deadline) return a->deadline < b->deadline;
+  return a->sequence < b->sequence;
+}
+
+static void alarms_set(size_t index, alarm_t* alarm) {
+  (*alarms)[index] = alarm;
+  alarm->heap_index = index;
+}
+
+static void alarms_sift_up(size_t index) {
+  alarm_t* alarm = (*alarms)[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (!alarm_before(alarm, (*alarms)[parent])) break;
+    alarms_set(index, (*alarms)[parent]);
+    index = parent;
+  }
+  alarms_set(index, alarm);
+}
+
+static void alarms_sift_down(size_t index) {
+  size_t size = alarms->size();
+  alarm_t* alarm = (*alarms)[index];
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) break;
+    if (child + 1 < size && alarm_before((*alarms)[child + 1], (*alarms)[child]))
+      child++;
+    if (!alarm_before((*alarms)[child], alarm)) break;
+    alarms_set(index, (*alarms)[child]);
+    index = child;
+  }
+  alarms_set(index, alarm);
+}
+
+// Returns the alarm with the earliest deadline, or NULL if none is pending.
+// The caller must hold the |alarms_mutex|
+static alarm_t* alarms_front(void) {
+  return alarms->empty() ? NULL : alarms->front();
+}
+
+// The caller must hold the |alarms_mutex|
+static void alarms_push(alarm_t* alarm) {
+  CHECK(alarm->heap_index == ALARM_NOT_PENDING);
+  alarm->sequence = alarms_sequence++;
+  alarms->push_back(alarm);
+  alarms_sift_up(alarms->size() - 1);
+}
+
+// Removes |alarm| from the heap if it is there.
+// The caller must hold the |alarms_mutex|
+static void alarms_remove(alarm_t* alarm) {
+  size_t index = alarm->heap_index;
+  if (index == ALARM_NOT_PENDING) return;
+  CHECK((*alarms)[index] == alarm);
+
+  alarm->heap_index = ALARM_NOT_PENDING;
+  alarm_t* last = alarms->back();
+  alarms->pop_back();
+  if (last == alarm) return;
+
+  alarms_set(index, last);
+  if (index > 0 && alarm_before(last, (*alarms)[(index - 1) / 2]))
+    alarms_sift_up(index);
+  else
+    alarms_sift_down(index);
+}
+
+// Remove alarm from internal alarm heap and the processing queue
 // The caller must hold the |alarms_mutex|
 static void remove_pending_alarm(alarm_t* alarm) {
-  list_remove(alarms, alarm);
+  alarms_remove(alarm);
 
   if (alarm->for_msg_loop) {
     alarm->closure.i.Cancel();
   } else {
-    while (fixed_queue_try_remove_from_queue(alarm->queue, alarm) != NULL) {
+    // Only search the processing queue if the dispatcher actually put the
+    // alarm there.
+    while (alarm->queued_count > 0 &&
+           fixed_queue_try_remove_from_queue(alarm->queue, alarm) != NULL) {
       // Remove all repeated alarm instances from the queue.
       // NOTE: We are defensive here - we shouldn't have repeated alarm
       // instances
+      alarm->queued_count--;
     }
   }
 }
 
 // Must be called with |alarms_mutex| held
 static void schedule_next_instance(alarm_t* alarm) {
-  // If the alarm is currently set and it's at the start of the list,
+  // If the alarm is currently set and it's at the top of the heap,
   // we'll need to re-schedule since we've adjusted the earliest deadline.
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarms_front() == alarm);
   if (alarm->callback) remove_pending_alarm(alarm);
 
   // Calculate the next deadline for this alarm
@@ -445,26 +532,12 @@ static void schedule_next_instance(alarm_t* alarm) {
     ms_into_period = ((just_now - alarm->creation_time) % alarm->period);
   alarm->deadline = just_now + (alarm->period - ms_into_period);
 
-  // Add it into the timer list sorted by deadline (earliest deadline first).
-  if (list_is_empty(alarms) ||
-      ((alarm_t*)list_front(alarms))->deadline > alarm->deadline) {
-    list_prepend(alarms, alarm);
-  } else {
-    for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-         node = list_next(node)) {
-      list_node_t* next = list_next(node);
-      if (next == list_end(alarms) ||
-          ((alarm_t*)list_node(next))->deadline > alarm->deadline) {
-        list_insert_after(alarms, node, alarm);
-        break;
-      }
-    }
-  }
+  // Add it into the timer heap (earliest deadline first).
+  alarms_push(alarm);
 
   // If the new alarm has the earliest deadline, we need to re-evaluate our
   // schedule.
-  if (needs_reschedule ||
-      (!list_is_empty(alarms) && list_front(alarms) == alarm)) {
+  if (needs_reschedule || alarms_front() == alarm) {
     reschedule_root_alarm();
   }
 }
@@ -482,9 +555,9 @@ static void reschedule_root_alarm(void) {
   struct itimerspec timer_time;
   memset(&timer_time, 0, sizeof(timer_time));
 
-  if (list_is_empty(alarms)) goto done;
+  next = alarms_front();
+  if (next == NULL) goto done;
 
-  next = static_cast<alarm_t*>(list_front(alarms));
   next_expiration = next->deadline - now();
   if (next_expiration < TIMER_INTERVAL_FOR_WAKELOCK_IN_MS) {
     if (!timer_set) {
@@ -613,6 +686,7 @@ static void alarm_queue_ready(fixed_queue_t* queue, UNUSED_ATTR void* context) {
 
   std::unique_lock<std::mutex> lock(alarms_mutex);
   alarm_t* alarm = (alarm_t*)fixed_queue_try_dequeue(queue);
+  if (alarm != NULL && alarm->queued_count > 0) alarm->queued_count--;
   alarm_ready_generic(alarm, lock);
 }
 
@@ -636,13 +710,13 @@ static void callback_dispatch(UNUSED_ATTR void* context) {
     // Take into account that the alarm may get cancelled before we get to it.
     // We're done here if there are no alarms or the alarm at the front is in
     // the future. Exit right away since there's nothing left to do.
-    if (list_is_empty(alarms) ||
-        (alarm = static_cast<alarm_t*>(list_front(alarms)))->deadline > now()) {
+    alarm = alarms_front();
+    if (alarm == NULL || alarm->deadline > now()) {
       reschedule_root_alarm();
       continue;
     }
 
-    list_remove(alarms, alarm);
+    alarms_remove(alarm);
 
     if (alarm->is_periodic) {
       alarm->prev_deadline = alarm->deadline;
@@ -662,6 +736,7 @@ static void callback_dispatch(UNUSED_ATTR void* context) {
       alarm->closure.i.Reset(Bind(alarm_ready_mloop, alarm));
       get_message_loop()->task_runner()->PostTask(FROM_HERE, alarm->closure.i.callback());
     } else {
+      alarm->queued_count++;
       fixed_queue_enqueue(alarm->queue, alarm);
     }
   }
@@ -746,12 +821,12 @@ void alarm_debug_dump(int fd) {
 
   period_ms_t just_now = now();
 
-  dprintf(fd, "  Total Alarms: %zu\n\n", list_length(alarms));
+  dprintf(fd, "  Total Alarms: %zu\n\n", alarms->size());
 
-  // Dump info for each alarm
-  for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-       node = list_next(node)) {
-    alarm_t* alarm = (alarm_t*)list_node(node);
+  // Dump info for each alarm, earliest deadline first
+  std::vector<alarm_t*> sorted(*alarms);
+  std::sort(sorted.begin(), sorted.end(), alarm_before);
+  for (alarm_t* alarm : sorted) {
     alarm_stats_t* stats = &alarm->stats;
 
     dprintf(fd, "  Alarm : %s (%s)\n", stats->name,
@@ -21,13 +21,14 @@
 
 #include "osi/include/allocation_tracker.h"
 #include "osi/include/allocator.h"
+#include "osi/include/buffer_pool.h"
 
 static const allocator_id_t alloc_allocator_id = 42;
 
 char* osi_strdup(const char* str) {
   size_t size = strlen(str) + 1;  // + 1 for the null terminator
   size_t real_size = allocation_tracker_resize_for_canary(size);
-  void* ptr = malloc(real_size);
+  void* ptr = buffer_pool_alloc(real_size);
   CHECK(ptr);
 
   char* new_string = static_cast<char*>(
@@ -43,7 +44,7 @@ char* osi_strndup(const char* str, size_t len) {
   if (len < size) size = len;
 
   size_t real_size = allocation_tracker_resize_for_canary(size + 1);
-  void* ptr = malloc(real_size);
+  void* ptr = buffer_pool_alloc(real_size);
   CHECK(ptr);
 
   char* new_string = static_cast<char*>(
@@ -58,7 +59,7 @@ char* osi_strndup(const char* str, size_t len) {
 void* osi_malloc(size_t size) {
   CHECK(static_cast<ssize_t>(size) >= 0);
   size_t real_size = allocation_tracker_resize_for_canary(size);
-  void* ptr = malloc(real_size);
+  void* ptr = buffer_pool_alloc(real_size);
   CHECK(ptr);
   return allocation_tracker_notify_alloc(alloc_allocator_id, ptr, size);
 }
@@ -66,13 +67,13 @@ void* osi_malloc(size_t size) {
 void* osi_calloc(size_t size) {
   CHECK(static_cast<ssize_t>(size) >= 0);
   size_t real_size = allocation_tracker_resize_for_canary(size);
-  void* ptr = calloc(1, real_size);
+  void* ptr = buffer_pool_calloc(real_size);
   CHECK(ptr);
   return allocation_tracker_notify_alloc(alloc_allocator_id, ptr, size);
 }
 
 void osi_free(void* ptr) {
-  free(allocation_tracker_notify_free(alloc_allocator_id, ptr));
+  buffer_pool_free(allocation_tracker_notify_free(alloc_allocator_id, ptr));
 }
 
 void osi_free_and_reset(void** p_ptr) {
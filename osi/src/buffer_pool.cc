@@ -0,0 +1,388 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "internal_include/bt_target.h"
+
+#define LOG_TAG "bt_osi_buffer_pool"
+
+#include "osi/include/buffer_pool.h"
+
+#include <base/logging.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "osi/include/osi.h"
+
+// Extra room on top of each nominal size so that a request for exactly
+// |BT_SMALL_BUFFER_SIZE| or |BT_DEFAULT_BUFFER_SIZE| still fits after the
+// allocation tracker adds its two canaries.
+#define BUFFER_POOL_CANARY_SLACK 32
+
+// Size classes, smallest first. A request is served from the first class
+// that is large enough.
+//   - small control blocks and short HCI commands
+//   - a full HCI event (BT_HDR + 2 byte header + 255 byte payload)
+//   - HCI command / small ACL buffers
+//   - default ACL / L2CAP buffers
+static const size_t class_sizes[] = {
+    128,
+    BT_HDR_SIZE + 2 + 255 + BUFFER_POOL_CANARY_SLACK,
+    BT_SMALL_BUFFER_SIZE + BUFFER_POOL_CANARY_SLACK,
+    BT_DEFAULT_BUFFER_SIZE + BUFFER_POOL_CANARY_SLACK,
+};
+
+// Maximum number of free blocks each thread keeps per class. Half of this is
+// moved to or from the shared depot at a time.
+static const size_t class_thread_limits[] = {128, 64, 32, 16};
+
+// Maximum number of free blocks the shared depot keeps per class before
+// returning them to the system.
+static const size_t class_depot_limits[] = {512, 256, 128, 64};
+
+#define NUM_CLASSES ARRAY_SIZE(class_sizes)
+#define CLASS_NONE 0xFF
+
+static const uint32_t BUFFER_POOL_MAGIC = 0xB7B00F5E;
+
+// Prepended to every block. Sized to keep the returned pointer as aligned as
+// the one returned by malloc.
+typedef struct {
+  uint32_t magic;
+  uint8_t class_index;
+  uint8_t reserved[3];
+  size_t size;
+} __attribute__((aligned(16))) block_header_t;
+static_assert(sizeof(block_header_t) % alignof(max_align_t) == 0,
+              "block_header_t would misalign the returned pointer");
+
+// Free blocks are chained through their first word.
+typedef struct free_block_t {
+  struct free_block_t* next;
+} free_block_t;
+
+typedef struct {
+  free_block_t* head;
+  size_t count;
+} free_list_t;
+
+typedef struct {
+  free_list_t lists[NUM_CLASSES];
+  bool registered;
+  bool exited;
+} thread_cache_t;
+
+typedef struct {
+  std::atomic<size_t> hits;
+  std::atomic<size_t> misses;
+  std::atomic<size_t> depot_refills;
+  std::atomic<size_t> depot_drains;
+  std::atomic<size_t> released;
+  std::atomic<size_t> in_use;
+  std::atomic<size_t> high_water;
+} class_stats_t;
+
+static_assert(ARRAY_SIZE(class_thread_limits) == NUM_CLASSES,
+              "class_thread_limits must match class_sizes");
+static_assert(ARRAY_SIZE(class_depot_limits) == NUM_CLASSES,
+              "class_depot_limits must match class_sizes");
+
+static thread_local thread_cache_t thread_cache;
+
+static std::mutex depot_lock;
+static free_list_t depot[NUM_CLASSES];
+
+static class_stats_t class_stats[NUM_CLASSES];
+static std::atomic<size_t> oversize_allocs;
+static std::atomic<size_t> oversize_in_use;
+
+static pthread_key_t thread_exit_key;
+static pthread_once_t thread_exit_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_cache_flush(thread_cache_t* cache);
+
+static void on_thread_exit(void* context) {
+  thread_cache_t* cache = static_cast<thread_cache_t*>(context);
+  thread_cache_flush(cache);
+  // Blocks freed by later thread-exit handlers bypass the cache.
+  cache->exited = true;
+}
+
+static void create_thread_exit_key(void) {
+  pthread_key_create(&thread_exit_key, on_thread_exit);
+}
+
+static thread_cache_t* get_thread_cache(void) {
+  thread_cache_t* cache = &thread_cache;
+  if (!cache->registered) {
+    pthread_once(&thread_exit_key_once, create_thread_exit_key);
+    pthread_setspecific(thread_exit_key, cache);
+    cache->registered = true;
+  }
+  return cache->exited ? nullptr : cache;
+}
+
+static uint8_t class_for_size(size_t size) {
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    if (size <= class_sizes[i]) return i;
+  }
+  return CLASS_NONE;
+}
+
+static inline block_header_t* header_of(void* ptr) {
+  return reinterpret_cast<block_header_t*>(ptr) - 1;
+}
+
+static inline void* block_of(block_header_t* header) { return header + 1; }
+
+static void account_alloc(class_stats_t* stats) {
+  size_t in_use = stats->in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+  size_t high_water = stats->high_water.load(std::memory_order_relaxed);
+  while (in_use > high_water &&
+         !stats->high_water.compare_exchange_weak(high_water, in_use,
+                                                  std::memory_order_relaxed)) {
+  }
+}
+
+// Moves up to |count| blocks from the head of |from| to the head of |to|.
+static size_t move_blocks(free_list_t* from, free_list_t* to, size_t count) {
+  size_t moved = 0;
+  while (moved < count && from->head != nullptr) {
+    free_block_t* block = from->head;
+    from->head = block->next;
+    block->next = to->head;
+    to->head = block;
+    moved++;
+  }
+  from->count -= moved;
+  to->count += moved;
+  return moved;
+}
+
+static void release_list(free_list_t* list) {
+  while (list->head != nullptr) {
+    free_block_t* block = list->head;
+    list->head = block->next;
+    free(header_of(block));
+  }
+  list->count = 0;
+}
+
+static void thread_cache_flush(thread_cache_t* cache) {
+  free_list_t excess[NUM_CLASSES] = {};
+  {
+    std::lock_guard<std::mutex> lock(depot_lock);
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+      free_list_t* list = &cache->lists[i];
+      size_t room = class_depot_limits[i] > depot[i].count
+                        ? class_depot_limits[i] - depot[i].count
+                        : 0;
+      move_blocks(list, &depot[i], room);
+      move_blocks(list, &excess[i], list->count);
+    }
+  }
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    class_stats[i].released.fetch_add(excess[i].count,
+                                      std::memory_order_relaxed);
+    release_list(&excess[i]);
+  }
+}
+
+static void* alloc_from_class(uint8_t class_index) {
+  class_stats_t* stats = &class_stats[class_index];
+  thread_cache_t* cache = get_thread_cache();
+
+  if (cache != nullptr) {
+    free_list_t* list = &cache->lists[class_index];
+    if (list->head == nullptr) {
+      std::lock_guard<std::mutex> lock(depot_lock);
+      if (move_blocks(&depot[class_index], list,
+                      class_thread_limits[class_index] / 2) > 0)
+        stats->depot_refills.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (list->head != nullptr) {
+      free_block_t* block = list->head;
+      list->head = block->next;
+      list->count--;
+      stats->hits.fetch_add(1, std::memory_order_relaxed);
+      account_alloc(stats);
+      return block;
+    }
+  }
+
+  block_header_t* header = static_cast<block_header_t*>(
+      malloc(sizeof(block_header_t) + class_sizes[class_index]));
+  CHECK(header);
+  header->magic = BUFFER_POOL_MAGIC;
+  header->class_index = class_index;
+  header->size = class_sizes[class_index];
+  stats->misses.fetch_add(1, std::memory_order_relaxed);
+  account_alloc(stats);
+  return block_of(header);
+}
+
+void* buffer_pool_alloc(size_t size) {
+  uint8_t class_index = class_for_size(size);
+  if (class_index != CLASS_NONE) return alloc_from_class(class_index);
+
+  block_header_t* header =
+      static_cast<block_header_t*>(malloc(sizeof(block_header_t) + size));
+  CHECK(header);
+  header->magic = BUFFER_POOL_MAGIC;
+  header->class_index = CLASS_NONE;
+  header->size = size;
+  oversize_allocs.fetch_add(1, std::memory_order_relaxed);
+  oversize_in_use.fetch_add(1, std::memory_order_relaxed);
+  return block_of(header);
+}
+
+void* buffer_pool_calloc(size_t size) {
+  void* ptr = buffer_pool_alloc(size);
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+void buffer_pool_free(void* ptr) {
+  if (ptr == nullptr) return;
+
+  block_header_t* header = header_of(ptr);
+  CHECK(header->magic == BUFFER_POOL_MAGIC);
+
+  uint8_t class_index = header->class_index;
+  if (class_index == CLASS_NONE) {
+    oversize_in_use.fetch_sub(1, std::memory_order_relaxed);
+    free(header);
+    return;
+  }
+  CHECK(class_index < NUM_CLASSES);
+
+  class_stats_t* stats = &class_stats[class_index];
+  stats->in_use.fetch_sub(1, std::memory_order_relaxed);
+
+  free_block_t* block = static_cast<free_block_t*>(ptr);
+  thread_cache_t* cache = get_thread_cache();
+  if (cache == nullptr) {
+    std::unique_lock<std::mutex> lock(depot_lock);
+    if (depot[class_index].count < class_depot_limits[class_index]) {
+      block->next = depot[class_index].head;
+      depot[class_index].head = block;
+      depot[class_index].count++;
+      return;
+    }
+    lock.unlock();
+    stats->released.fetch_add(1, std::memory_order_relaxed);
+    free(header);
+    return;
+  }
+
+  free_list_t* list = &cache->lists[class_index];
+  block->next = list->head;
+  list->head = block;
+  list->count++;
+  if (list->count <= class_thread_limits[class_index]) return;
+
+  // The thread cache is full: hand half of it to the depot so that the
+  // allocating side of a producer/consumer pair can pick it up, and give
+  // back to the system whatever the depot has no room for.
+  free_list_t excess = {};
+  {
+    std::lock_guard<std::mutex> lock(depot_lock);
+    size_t batch = class_thread_limits[class_index] / 2;
+    size_t room =
+        class_depot_limits[class_index] > depot[class_index].count
+            ? class_depot_limits[class_index] - depot[class_index].count
+            : 0;
+    size_t moved = move_blocks(list, &depot[class_index], std::min(batch, room));
+    move_blocks(list, &excess, batch - moved);
+  }
+  stats->depot_drains.fetch_add(1, std::memory_order_relaxed);
+  stats->released.fetch_add(excess.count, std::memory_order_relaxed);
+  release_list(&excess);
+}
+
+void buffer_pool_trim(void) {
+  thread_cache_t* cache = get_thread_cache();
+  if (cache != nullptr) {
+    for (size_t i = 0; i < NUM_CLASSES; i++) release_list(&cache->lists[i]);
+  }
+
+  free_list_t lists[NUM_CLASSES] = {};
+  {
+    std::lock_guard<std::mutex> lock(depot_lock);
+    for (size_t i = 0; i < NUM_CLASSES; i++)
+      move_blocks(&depot[i], &lists[i], depot[i].count);
+  }
+  for (size_t i = 0; i < NUM_CLASSES; i++) release_list(&lists[i]);
+}
+
+void buffer_pool_reset_stats(void) {
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    class_stats_t* stats = &class_stats[i];
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->depot_refills = 0;
+    stats->depot_drains = 0;
+    stats->released = 0;
+    stats->high_water = stats->in_use.load();
+  }
+  oversize_allocs = 0;
+}
+
+size_t buffer_pool_hit_count(void) {
+  size_t hits = 0;
+  for (size_t i = 0; i < NUM_CLASSES; i++) hits += class_stats[i].hits;
+  return hits;
+}
+
+size_t buffer_pool_miss_count(void) {
+  size_t misses = oversize_allocs;
+  for (size_t i = 0; i < NUM_CLASSES; i++) misses += class_stats[i].misses;
+  return misses;
+}
+
+void buffer_pool_debug_dump(int fd) {
+  dprintf(fd, "\nBluetooth Buffer Pool Statistics:\n");
+
+  size_t depot_counts[NUM_CLASSES];
+  {
+    std::lock_guard<std::mutex> lock(depot_lock);
+    for (size_t i = 0; i < NUM_CLASSES; i++) depot_counts[i] = depot[i].count;
+  }
+
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    const class_stats_t* stats = &class_stats[i];
+    size_t hits = stats->hits;
+    size_t misses = stats->misses;
+    size_t total = hits + misses;
+    dprintf(fd, "  Class %zu (%zu octets)\n", i, class_sizes[i]);
+    dprintf(fd, "    Hits/misses               : %zu / %zu (%zu%% hit)\n",
+            hits, misses, total ? (hits * 100) / total : 0);
+    dprintf(fd, "    In use/high-water         : %zu / %zu\n",
+            stats->in_use.load(), stats->high_water.load());
+    dprintf(fd, "    Depot refills/drains/size : %zu / %zu / %zu\n",
+            stats->depot_refills.load(), stats->depot_drains.load(),
+            depot_counts[i]);
+    dprintf(fd, "    Released to system        : %zu\n",
+            stats->released.load());
+  }
+  dprintf(fd, "  Oversized allocated/in use  : %zu / %zu\n",
+          oversize_allocs.load(), oversize_in_use.load());
+}
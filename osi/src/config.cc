@@ -40,18 +40,60 @@
 #include "bt_target.h"
 #include <inttypes.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
+// Hashes and compares NUL-terminated strings by content, so that the indices
+// below can be keyed by the strings the sections and entries already own and
+// looked up with caller-provided |const char*| without building a
+// std::string.
+struct cstr_hash {
+  size_t operator()(const char* str) const {
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for (; *str; str++) {
+      hash ^= (uint8_t)*str;
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+};
+
+struct cstr_equal {
+  bool operator()(const char* a, const char* b) const {
+    return strcmp(a, b) == 0;
+  }
+};
+
 typedef struct {
-  char* key;
+  // Interned; owned by |config_t::keys|.
+  const char* key;
   char* value;
 } entry_t;
 
+typedef std::unordered_map<const char*, entry_t*, cstr_hash, cstr_equal>
+    entry_index_t;
+
 typedef struct {
   char* name;
+  // Entries in insertion order, used for iteration and |config_save|.
   list_t* entries;
+  // Entries keyed by |entry_t::key|.
+  entry_index_t* index;
 } section_t;
 
+typedef std::unordered_map<const char*, section_t*, cstr_hash, cstr_equal>
+    section_index_t;
+typedef std::unordered_set<const char*, cstr_hash, cstr_equal> key_pool_t;
+
 struct config_t {
+  // Sections in insertion order, used for iteration and |config_save|.
   list_t* sections;
+  // Sections keyed by |section_t::name|.
+  section_index_t* index;
+  // Interned key strings. Every device section repeats the same few dozen
+  // keys, so each distinct key is stored once and shared by all entries.
+  key_pool_t* keys;
 };
 
 // Empty definition; this type is aliased to list_node_t.
@@ -63,6 +105,9 @@ static section_t* section_new(const char* name);
 static void section_free(void* ptr);
 static section_t* section_find(const config_t* config, const char* section);
 
+static section_t* section_add(config_t* config, const char* name);
+static const char* key_intern(config_t* config, const char* key);
+
 static entry_t* entry_new(const char* key, const char* value);
 static void entry_free(void* ptr);
 static entry_t* entry_find(const config_t* config, const char* section,
@@ -76,6 +121,8 @@ config_t* config_new_empty(void) {
     LOG_ERROR(LOG_TAG, "%s unable to allocate list for sections.", __func__);
     goto error;
   }
+  config->index = new section_index_t();
+  config->keys = new key_pool_t();
 
   return config;
 
@@ -145,10 +192,47 @@ config_t* config_new_clone(const config_t* src) {
   return ret;
 }
 
+bool config_copy_section(config_t* dst, const config_t* src,
+                         const char* section) {
+  CHECK(dst != NULL);
+  CHECK(src != NULL);
+  CHECK(section != NULL);
+
+  const section_t* src_sec = section_find(src, section);
+  if (!src_sec) {
+    config_remove_section(dst, section);
+    return false;
+  }
+
+  section_t* dst_sec = section_find(dst, section);
+  if (dst_sec) {
+    dst_sec->index->clear();
+    list_clear(dst_sec->entries);
+  } else {
+    dst_sec = section_add(dst, section);
+    CHECK(dst_sec != NULL);
+  }
+
+  for (const list_node_t* node = list_begin(src_sec->entries);
+       node != list_end(src_sec->entries); node = list_next(node)) {
+    const entry_t* src_entry = static_cast<entry_t*>(list_node(node));
+    entry_t* entry =
+        entry_new(key_intern(dst, src_entry->key), src_entry->value);
+    list_append(dst_sec->entries, entry);
+    (*dst_sec->index)[entry->key] = entry;
+  }
+  return true;
+}
+
 void config_free(config_t* config) {
   if (!config) return;
 
   list_free(config->sections);
+  delete config->index;
+  if (config->keys) {
+    for (const char* key : *config->keys) osi_free((void*)key);
+    delete config->keys;
+  }
   osi_free(config);
 }
 
@@ -283,10 +367,8 @@ void config_set_string(config_t* config, const char* section, const char* key,
                        const char* value) {
   section_t* sec = section_find(config, section);
   if (!sec) {
-    sec = section_new(section);
-    if (sec)
-      list_append(config->sections, sec);
-    else {
+    sec = section_add(config, section);
+    if (!sec) {
       LOG_ERROR(LOG_TAG,"%s: Unable to allocate memory for section", __func__);
     }
   }
@@ -302,18 +384,18 @@ void config_set_string(config_t* config, const char* section, const char* key,
   }
 
   if (sec) {
-    for (const list_node_t* node = list_begin(sec->entries);
-         node != list_end(sec->entries); node = list_next(node)) {
-      entry_t* entry = static_cast<entry_t*>(list_node(node));
-      if (!strcmp(entry->key, key)) {
-        osi_free(entry->value);
-        entry->value = osi_strdup(value_no_newline.c_str());
-        return;
-      }
+    auto it = sec->index->find(key);
+    if (it != sec->index->end()) {
+      entry_t* entry = it->second;
+      osi_free(entry->value);
+      entry->value = osi_strdup(value_no_newline.c_str());
+      return;
     }
 
-    entry_t* entry = entry_new(key, value_no_newline.c_str());
+    entry_t* entry =
+        entry_new(key_intern(config, key), value_no_newline.c_str());
     list_append(sec->entries, entry);
+    (*sec->index)[entry->key] = entry;
   }
 }
 
@@ -324,6 +406,7 @@ bool config_remove_section(config_t* config, const char* section) {
   section_t* sec = section_find(config, section);
   if (!sec) return false;
 
+  config->index->erase(sec->name);
   return list_remove(config->sections, sec);
 }
 
@@ -333,9 +416,13 @@ bool config_remove_key(config_t* config, const char* section, const char* key) {
   CHECK(key != NULL);
 
   section_t* sec = section_find(config, section);
-  entry_t* entry = entry_find(config, section, key);
-  if (!sec || !entry) return false;
+  if (!sec) return false;
+
+  auto it = sec->index->find(key);
+  if (it == sec->index->end()) return false;
 
+  entry_t* entry = it->second;
+  sec->index->erase(it);
   return list_remove(sec->entries, entry);
 }
 
@@ -382,7 +469,7 @@ void config_sections_sort_by_entry_key(config_t* config, compare_func comp) {
       for (;list_next(q) && list_next(q) != p; q = list_next(q)) {
         entry_t* first = (entry_t*)list_node(q);
         entry_t* second = (entry_t*)list_node(list_next(q));
-        char* tmp_key;
+        const char* tmp_key;
         char* tmp_value;
         if (comp(first->key, second->key) > 0) {
           tmp_key = first->key;
@@ -397,6 +484,13 @@ void config_sections_sort_by_entry_key(config_t* config, compare_func comp) {
       p = q;
     }
 
+    // Keys and values were swapped between entries, so rebuild the index.
+    sec->index->clear();
+    for (const list_node_t* enode = list_begin(sec->entries);
+         enode != list_end(sec->entries); enode = list_next(enode)) {
+      entry_t* entry = (entry_t*)list_node(enode);
+      (*sec->index)[entry->key] = entry;
+    }
   }
 }
 #endif
@@ -699,9 +793,7 @@ static bool config_parse(FILE* fp, config_t* config) {
         strlcpy(comment, line_ptr, 1024);
 
         if(!section_find(config, comment)) {
-            section_t *sec = section_new(comment);
-            if (sec)
-                list_append(config->sections, sec);
+            section_add(config, comment);
         }
     } else if (*line_ptr == '[') {
       size_t len = strlen(line_ptr);
@@ -736,32 +828,49 @@ static section_t* section_new(const char* name) {
 
   section->name = osi_strdup(name);
   section->entries = list_new(entry_free);
+  section->index = new entry_index_t();
   return section;
 }
 
+// Creates a section called |name|, appends it to |config| and indexes it.
+static section_t* section_add(config_t* config, const char* name) {
+  section_t* sec = section_new(name);
+  if (!sec) return NULL;
+
+  list_append(config->sections, sec);
+  (*config->index)[sec->name] = sec;
+  return sec;
+}
+
 static void section_free(void* ptr) {
   if (!ptr) return;
 
   section_t* section = static_cast<section_t*>(ptr);
   osi_free(section->name);
   list_free(section->entries);
+  delete section->index;
   osi_free(section);
 }
 
 static section_t* section_find(const config_t* config, const char* section) {
-  for (const list_node_t* node = list_begin(config->sections);
-       node != list_end(config->sections); node = list_next(node)) {
-    section_t* sec = static_cast<section_t*>(list_node(node));
-    if (sec && !strcmp(sec->name, section)) return sec;
+  auto it = config->index->find(section);
+  return (it != config->index->end()) ? it->second : NULL;
 }
 
-  return NULL;
+// Returns the pooled copy of |key|, adding it to the pool on first use.
+static const char* key_intern(config_t* config, const char* key) {
+  auto it = config->keys->find(key);
+  if (it != config->keys->end()) return *it;
+
+  const char* interned = osi_strdup(key);
+  config->keys->insert(interned);
+  return interned;
 }
 
 static entry_t* entry_new(const char* key, const char* value) {
   entry_t* entry = static_cast<entry_t*>(osi_calloc(sizeof(entry_t)));
 
-  entry->key = osi_strdup(key);
+  entry->key = key;
   entry->value = osi_strdup(value);
   return entry;
 }
@@ -770,7 +879,6 @@ static void entry_free(void* ptr) {
   if (!ptr) return;
 
   entry_t* entry = static_cast<entry_t*>(ptr);
-  osi_free(entry->key);
   osi_free(entry->value);
   osi_free(entry);
 }
@@ -780,11 +888,6 @@ static entry_t* entry_find(const config_t* config, const char* section,
   section_t* sec = section_find(config, section);
   if (!sec) return NULL;
 
-  for (const list_node_t* node = list_begin(sec->entries);
-       node != list_end(sec->entries); node = list_next(node)) {
-    entry_t* entry = static_cast<entry_t*>(list_node(node));
-    if (!strcmp(entry->key, key)) return entry;
-  }
-
-  return NULL;
+  auto it = sec->index->find(key);
+  return (it != sec->index->end()) ? it->second : NULL;
 }
@@ -17,8 +17,14 @@
  ******************************************************************************/
 
 #include <base/logging.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <mutex>
 
 #include "osi/include/allocator.h"
@@ -28,7 +34,46 @@
 #include "osi/include/reactor.h"
 #include "osi/include/semaphore.h"
 
+// Cache line size used to keep the producer and consumer indices of a ring
+// queue from false sharing.
+#define RING_CACHE_LINE_SIZE 64
+
+// How long a producer blocked on a full ring queue parks on the enqueue
+// eventfd before retrying. Bounds the cost of a wakeup lost between several
+// producers racing for the same freed slot.
+#define RING_FULL_WAIT_MS 1
+
+typedef struct {
+  std::atomic<size_t> sequence;
+  void* data;
+} ring_slot_t;
+
+// Bounded array-backed queue. Producers claim slots using per-slot sequence
+// numbers (a CAS on |enqueue_pos| in MPSC mode, a plain store in SPSC mode);
+// the single consumer never contends with them.
+//
+// |count| is incremented by a producer as soon as it has claimed a slot and
+// before the slot is published, so it is never lower than the number of
+// published elements. |dequeue_fd| is written by the first producer to
+// publish after |signalled| was cleared, and is only cleared by the consumer
+// once the head slot is empty, so the queue pays for one eventfd write per
+// empty -> non-empty transition instead of one per element.
+typedef struct {
+  fixed_queue_ring_mode_t mode;
+  size_t mask;
+  ring_slot_t* slots;
+  int dequeue_fd;
+  int enqueue_fd;
+
+  alignas(RING_CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos;
+  alignas(RING_CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos;
+  alignas(RING_CACHE_LINE_SIZE) std::atomic<ssize_t> count;
+  std::atomic<bool> signalled;
+} ring_t;
+
 typedef struct fixed_queue_t {
+  ring_t* ring;
+
   list_t* list;
   semaphore_t* enqueue_sem;
   semaphore_t* dequeue_sem;
@@ -42,6 +87,13 @@ typedef struct fixed_queue_t {
 
 static void internal_dequeue_ready(void* context);
 
+static void ring_free(ring_t* ring);
+static bool ring_try_push(ring_t* ring, void* data);
+static void* ring_try_pop(ring_t* ring);
+static void* ring_peek(const ring_t* ring);
+static void ring_clear_signal(ring_t* ring);
+static void ring_wait_fd(int fd, int timeout_ms);
+
 fixed_queue_t* fixed_queue_new(size_t capacity) {
   fixed_queue_t* ret =
       static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
@@ -65,11 +117,57 @@ error:
   return NULL;
 }
 
+fixed_queue_t* fixed_queue_new_ring(size_t capacity,
+                                    fixed_queue_ring_mode_t mode) {
+  CHECK(capacity > 0);
+  CHECK(capacity <= FIXED_QUEUE_RING_MAX_CAPACITY);
+
+  size_t slots = 1;
+  while (slots < capacity) slots <<= 1;
+
+  fixed_queue_t* ret =
+      static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
+  ret->capacity = slots;
+
+  ring_t* ring = new ring_t;
+  ring->mode = mode;
+  ring->mask = slots - 1;
+  ring->slots = new ring_slot_t[slots];
+  for (size_t i = 0; i < slots; i++) {
+    ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+    ring->slots[i].data = NULL;
+  }
+  ring->enqueue_pos = 0;
+  ring->dequeue_pos = 0;
+  ring->count = 0;
+  ring->signalled = false;
+  ring->dequeue_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ring->enqueue_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ret->ring = ring;
+
+  if (ring->dequeue_fd == INVALID_FD || ring->enqueue_fd == INVALID_FD) {
+    fixed_queue_free(ret, NULL);
+    return NULL;
+  }
+
+  return ret;
+}
+
 void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
   fixed_queue_unregister_dequeue(queue);
 
+  if (queue->ring) {
+    void* data;
+    while ((data = ring_try_pop(queue->ring)) != NULL) {
+      if (free_cb) free_cb(data);
+    }
+    ring_free(queue->ring);
+    osi_free(queue);
+    return;
+  }
+
   if (free_cb)
     for (const list_node_t* node = list_begin(queue->list);
          node != list_end(queue->list); node = list_next(node))
@@ -85,8 +183,16 @@ void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
-  while (!fixed_queue_is_empty(queue)) {
+  for (;;) {
     void* data = fixed_queue_try_dequeue(queue);
+    if (data == NULL) {
+      // A producer has claimed a ring slot but not published it yet.
+      if (queue->ring && queue->ring->count.load() > 0) {
+        sched_yield();
+        continue;
+      }
+      break;
+    }
     if (free_cb != NULL) {
       free_cb(data);
     }
@@ -96,6 +202,8 @@ void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 bool fixed_queue_is_empty(fixed_queue_t* queue) {
   if (queue == NULL) return true;
 
+  if (queue->ring) return queue->ring->count.load() <= 0;
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list);
 }
@@ -103,6 +211,11 @@ bool fixed_queue_is_empty(fixed_queue_t* queue) {
 size_t fixed_queue_length(fixed_queue_t* queue) {
   if (queue == NULL) return 0;
 
+  if (queue->ring) {
+    ssize_t count = queue->ring->count.load();
+    return count > 0 ? count : 0;
+  }
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_length(queue->list);
 }
@@ -117,6 +230,19 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) {
+    bool waited = false;
+    while (!ring_try_push(queue->ring, data)) {
+      ring_wait_fd(queue->ring->enqueue_fd, RING_FULL_WAIT_MS);
+      waited = true;
+    }
+    if (waited) {
+      eventfd_t value;
+      eventfd_read(queue->ring->enqueue_fd, &value);
+    }
+    return;
+  }
+
   semaphore_wait(queue->enqueue_sem);
 
   {
@@ -130,6 +256,20 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_dequeue(fixed_queue_t* queue) {
   CHECK(queue != NULL);
 
+  if (queue->ring) {
+    ring_t* ring = queue->ring;
+    for (;;) {
+      void* data = ring_try_pop(ring);
+      if (data != NULL) return data;
+      // A producer has claimed a slot but not published it yet.
+      if (ring->count.load() > 0) {
+        sched_yield();
+        continue;
+      }
+      ring_wait_fd(ring->dequeue_fd, -1);
+    }
+  }
+
   semaphore_wait(queue->dequeue_sem);
 
   void* ret = NULL;
@@ -148,6 +288,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) return ring_try_push(queue->ring, data);
+
   if (!semaphore_try_wait(queue->enqueue_sem)) return false;
 
   {
@@ -162,6 +304,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_try_pop(queue->ring);
+
   if (!semaphore_try_wait(queue->dequeue_sem)) return NULL;
 
   void* ret = NULL;
@@ -179,6 +323,8 @@ void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
 void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_peek(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_front(queue->list);
 }
@@ -186,6 +332,8 @@ void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
 void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  CHECK(queue->ring == NULL) << "Not supported by ring queues";
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_back(queue->list);
 }
@@ -193,6 +341,8 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
   if (queue == NULL) return NULL;
 
+  CHECK(queue->ring == NULL) << "Not supported by ring queues";
+
   bool removed = false;
   {
     std::lock_guard<std::mutex> lock(*queue->mutex);
@@ -212,6 +362,7 @@ void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
 
 list_t* fixed_queue_get_list(fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL) << "Not supported by ring queues";
 
   // NOTE: Using the list in this way is not thread-safe.
   // Using this list in any context where threads can call other functions
@@ -221,11 +372,13 @@ list_t* fixed_queue_get_list(fixed_queue_t* queue) {
 
 int fixed_queue_get_dequeue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->dequeue_fd;
   return semaphore_get_fd(queue->dequeue_sem);
 }
 
 int fixed_queue_get_enqueue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->enqueue_fd;
   return semaphore_get_fd(queue->enqueue_sem);
 }
 
@@ -260,3 +413,97 @@ static void internal_dequeue_ready(void* context) {
   fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
   queue->dequeue_ready(queue, queue->dequeue_context);
 }
+
+static void ring_free(ring_t* ring) {
+  if (ring->dequeue_fd != INVALID_FD) close(ring->dequeue_fd);
+  if (ring->enqueue_fd != INVALID_FD) close(ring->enqueue_fd);
+  delete[] ring->slots;
+  delete ring;
+}
+
+static bool ring_try_push(ring_t* ring, void* data) {
+  size_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+  ring_slot_t* slot;
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff < 0) return false;  // Full
+    if (diff > 0) {
+      pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (ring->mode == FIXED_QUEUE_SPSC) {
+      ring->enqueue_pos.store(pos + 1, std::memory_order_relaxed);
+      break;
+    }
+    if (ring->enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed))
+      break;
+  }
+
+  ring->count.fetch_add(1);
+
+  slot->data = data;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  if (!ring->signalled.load() && !ring->signalled.exchange(true))
+    eventfd_write(ring->dequeue_fd, 1);
+  return true;
+}
+
+// Clears |dequeue_fd| once the head slot is empty, then checks the head
+// again. Clearing the fd before the flag means a producer that publishes in
+// between either sees the flag still set (and the re-check catches its
+// element) or signals after the clear. Must only be called from the consumer
+// thread.
+static void ring_clear_signal(ring_t* ring) {
+  eventfd_t value;
+  eventfd_read(ring->dequeue_fd, &value);
+  ring->signalled.store(false);
+  if (ring_peek(ring) != NULL && !ring->signalled.exchange(true))
+    eventfd_write(ring->dequeue_fd, 1);
+}
+
+// Must only be called from the consumer thread.
+static void* ring_try_pop(ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  ring_slot_t* slot = &ring->slots[pos & ring->mask];
+  size_t sequence = slot->sequence.load(std::memory_order_acquire);
+  if ((intptr_t)sequence - (intptr_t)(pos + 1) < 0) {
+    // A producer may have signalled after the pop that emptied the ring
+    // cleared the fd, for an element that pop took. Left readable, the fd
+    // would wake the consumer over and over with nothing to take.
+    ring_clear_signal(ring);
+    return NULL;
+  }
+
+  void* data = slot->data;
+  slot->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+  ring->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+
+  ssize_t previous = ring->count.fetch_sub(1);
+  if ((size_t)previous == ring->mask + 1) eventfd_write(ring->enqueue_fd, 1);
+
+  if (ring_peek(ring) == NULL) ring_clear_signal(ring);
+
+  return data;
+}
+
+// Must only be called from the consumer thread.
+static void* ring_peek(const ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  ring_slot_t* slot = &ring->slots[pos & ring->mask];
+  size_t sequence = slot->sequence.load(std::memory_order_acquire);
+  if ((intptr_t)sequence - (intptr_t)(pos + 1) < 0) return NULL;
+  return slot->data;
+}
+
+static void ring_wait_fd(int fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  int ret;
+  OSI_NO_INTR(ret = poll(&pfd, 1, timeout_ms));
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "osi/include/buffer_pool.h"
+
+class BufferPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    buffer_pool_trim();
+    buffer_pool_reset_stats();
+  }
+
+  void TearDown() override { buffer_pool_trim(); }
+};
+
+TEST_F(BufferPoolTest, test_free_null) { buffer_pool_free(NULL); }
+
+TEST_F(BufferPoolTest, test_alloc_is_aligned_and_writable) {
+  const size_t sizes[] = {1, 100, 300, 700, 4000, 4112, 8192, 70000};
+  for (size_t size : sizes) {
+    uint8_t* ptr = static_cast<uint8_t*>(buffer_pool_alloc(size));
+    ASSERT_TRUE(ptr != NULL);
+    EXPECT_EQ(0U,
+              reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t));
+    memset(ptr, 0xA5, size);
+    buffer_pool_free(ptr);
+  }
+}
+
+TEST_F(BufferPoolTest, test_calloc_zeroes_recycled_block) {
+  uint8_t* ptr = static_cast<uint8_t*>(buffer_pool_alloc(600));
+  memset(ptr, 0xFF, 600);
+  buffer_pool_free(ptr);
+
+  uint8_t* zeroed = static_cast<uint8_t*>(buffer_pool_calloc(600));
+  EXPECT_EQ(ptr, zeroed);
+  for (size_t i = 0; i < 600; i++) ASSERT_EQ(0, zeroed[i]);
+  buffer_pool_free(zeroed);
+}
+
+TEST_F(BufferPoolTest, test_recycles_on_same_thread) {
+  void* first = buffer_pool_alloc(256);
+  EXPECT_EQ(1U, buffer_pool_miss_count());
+  EXPECT_EQ(0U, buffer_pool_hit_count());
+  buffer_pool_free(first);
+
+  void* second = buffer_pool_alloc(200);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1U, buffer_pool_miss_count());
+  EXPECT_EQ(1U, buffer_pool_hit_count());
+  buffer_pool_free(second);
+}
+
+TEST_F(BufferPoolTest, test_oversize_is_not_pooled) {
+  void* ptr = buffer_pool_alloc(64 * 1024);
+  buffer_pool_free(ptr);
+  ptr = buffer_pool_alloc(64 * 1024);
+  buffer_pool_free(ptr);
+  EXPECT_EQ(2U, buffer_pool_miss_count());
+  EXPECT_EQ(0U, buffer_pool_hit_count());
+}
+
+TEST_F(BufferPoolTest, test_cross_thread_recycling) {
+  const size_t kBatches = 20;
+  const size_t kPerBatch = 64;
+
+  // The producer allocates, the consumer frees. Once the consumer's cache
+  // overflows into the shared depot the producer should start hitting.
+  for (size_t batch = 0; batch < kBatches; batch++) {
+    std::vector<void*> buffers;
+    for (size_t i = 0; i < kPerBatch; i++)
+      buffers.push_back(buffer_pool_alloc(4096));
+
+    std::thread consumer([&buffers]() {
+      for (void* ptr : buffers) buffer_pool_free(ptr);
+    });
+    consumer.join();
+  }
+
+  EXPECT_GT(buffer_pool_hit_count(), 0U);
+  EXPECT_LT(buffer_pool_miss_count(), kBatches * kPerBatch);
+}
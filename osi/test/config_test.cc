@@ -196,6 +196,101 @@ TEST_F(ConfigTest, config_section_end) {
   config_free(config);
 }
 
+TEST_F(ConfigTest, config_many_sections) {
+  config_t* config = config_new_empty();
+  char section[32];
+  char value[32];
+  for (int i = 0; i < 500; i++) {
+    snprintf(section, sizeof(section), "00:11:22:33:%02x:%02x", i >> 8,
+             i & 0xff);
+    snprintf(value, sizeof(value), "%d", i);
+    config_set_string(config, section, "Name", value);
+    config_set_int(config, section, "DevType", i % 3);
+  }
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(section, sizeof(section), "00:11:22:33:%02x:%02x", i >> 8,
+             i & 0xff);
+    snprintf(value, sizeof(value), "%d", i);
+    EXPECT_STREQ(value, config_get_string(config, section, "Name", NULL));
+    EXPECT_EQ(i % 3, config_get_int(config, section, "DevType", -1));
+  }
+  EXPECT_FALSE(config_has_section(config, "00:11:22:33:ff:ff"));
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_remove_and_readd) {
+  config_t* config = config_new(CONFIG_FILE);
+
+  EXPECT_TRUE(config_remove_key(config, "DID", "version"));
+  EXPECT_FALSE(config_has_key(config, "DID", "version"));
+  config_set_string(config, "DID", "version", "0x2222");
+  EXPECT_STREQ("0x2222", config_get_string(config, "DID", "version", NULL));
+
+  EXPECT_TRUE(config_remove_section(config, "DID"));
+  EXPECT_FALSE(config_has_key(config, "DID", "productId"));
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_TRUE(config_has_section(config, "DID"));
+  EXPECT_STREQ("0x1300", config_get_string(config, "DID", "productId", NULL));
+  EXPECT_FALSE(config_has_key(config, "DID", "version"));
+
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_preserves_order) {
+  config_t* config = config_new_empty();
+  config_set_string(config, "zebra", "b", "1");
+  config_set_string(config, "apple", "z", "2");
+  config_set_string(config, "zebra", "a", "3");
+  config_set_string(config, "mango", "m", "4");
+  EXPECT_TRUE(config_save(config, CONFIG_FILE));
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  const char* expected_sections[] = {"zebra", "apple", "mango"};
+  size_t index = 0;
+  for (const config_section_node_t* node = config_section_begin(config);
+       node != config_section_end(config); node = config_section_next(node)) {
+    ASSERT_LT(index, 3U);
+    EXPECT_STREQ(expected_sections[index++], config_section_name(node));
+  }
+  EXPECT_EQ(3U, index);
+  EXPECT_STREQ("3", config_get_string(config, "zebra", "a", NULL));
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_copy_section) {
+  config_t* src = config_new_empty();
+  config_t* dst = config_new_empty();
+  config_set_string(dst, "first", "a", "1");
+  config_set_string(dst, "second", "stale", "1");
+  config_set_string(dst, "third", "a", "1");
+  config_set_string(src, "second", "fresh", "2");
+  config_set_string(src, "fourth", "a", "4");
+
+  // Replaced in place.
+  EXPECT_TRUE(config_copy_section(dst, src, "second"));
+  EXPECT_FALSE(config_has_key(dst, "second", "stale"));
+  EXPECT_STREQ("2", config_get_string(dst, "second", "fresh", NULL));
+  // Appended.
+  EXPECT_TRUE(config_copy_section(dst, src, "fourth"));
+  // Removed.
+  EXPECT_FALSE(config_copy_section(dst, src, "third"));
+  EXPECT_FALSE(config_has_section(dst, "third"));
+
+  const char* expected_sections[] = {"first", "second", "fourth"};
+  size_t index = 0;
+  for (const config_section_node_t* node = config_section_begin(dst);
+       node != config_section_end(dst); node = config_section_next(node)) {
+    ASSERT_LT(index, 3U);
+    EXPECT_STREQ(expected_sections[index++], config_section_name(node));
+  }
+  EXPECT_EQ(3U, index);
+
+  config_free(src);
+  config_free(dst);
+}
+
 TEST_F(ConfigTest, config_save_basic) {
   config_t* config = config_new(CONFIG_FILE);
   EXPECT_TRUE(config_save(config, CONFIG_FILE));
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <sys/eventfd.h>
+
 #include <climits>
 
 #include "AllocationTestHarness.h"
@@ -348,3 +350,173 @@ TEST_F(FixedQueueTest, test_fixed_queue_register_dequeue) {
   thread_free(worker_thread);
   fixed_queue_free(queue, NULL);
 }
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_new_free) {
+  fixed_queue_t* queue = fixed_queue_new_ring(1, FIXED_QUEUE_SPSC);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ(1U, fixed_queue_capacity(queue));
+  fixed_queue_free(queue, NULL);
+
+  // Capacity is rounded up to a power of two
+  queue = fixed_queue_new_ring(TEST_QUEUE_SIZE, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ(16U, fixed_queue_capacity(queue));
+
+  test_queue_entry_free_counter = 0;
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  fixed_queue_free(queue, test_queue_entry_free_cb);
+  EXPECT_EQ(2, test_queue_entry_free_counter);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_enqueue_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_ring(4, FIXED_QUEUE_SPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_peek_first(queue));
+
+  EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+  EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING1));
+  EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING2));
+  EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING3));
+  EXPECT_FALSE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+  EXPECT_EQ(4U, fixed_queue_length(queue));
+
+  EXPECT_EQ(DUMMY_DATA_STRING, fixed_queue_try_peek_first(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING, fixed_queue_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_dequeue(queue));
+
+  // Wrap around the end of the ring
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING3, fixed_queue_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING, fixed_queue_dequeue(queue));
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_dequeue_fd) {
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+  int dequeue_fd = fixed_queue_get_dequeue_fd(queue);
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  // The fd stays readable until the last element is taken out
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_dequeue(queue));
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_dequeue(queue));
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_register_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  received_message_future = future_new();
+  ASSERT_TRUE(received_message_future != NULL);
+
+  thread_t* worker_thread = thread_new("test_fixed_queue_worker_thread");
+  ASSERT_TRUE(worker_thread != NULL);
+
+  fixed_queue_register_dequeue(queue, thread_get_reactor(worker_thread),
+                               fixed_queue_ready, NULL);
+
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  const char* msg = (const char*)future_await(received_message_future);
+  EXPECT_EQ(DUMMY_DATA_STRING, msg);
+
+  fixed_queue_unregister_dequeue(queue);
+  thread_free(worker_thread);
+  fixed_queue_free(queue, NULL);
+}
+
+static void* ring_producer(void* context) {
+  fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
+  for (uintptr_t i = 1; i <= 10000; i++) fixed_queue_enqueue(queue, (void*)i);
+  return NULL;
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_mpsc_blocking) {
+  const int kProducers = 4;
+  // Small enough that producers regularly block on a full ring
+  fixed_queue_t* queue = fixed_queue_new_ring(8, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  pthread_t producers[kProducers];
+  for (int i = 0; i < kProducers; i++)
+    pthread_create(&producers[i], NULL, ring_producer, queue);
+
+  uintptr_t sum = 0;
+  for (int i = 0; i < kProducers * 10000; i++)
+    sum += (uintptr_t)fixed_queue_dequeue(queue);
+
+  for (int i = 0; i < kProducers; i++) pthread_join(producers[i], NULL);
+
+  EXPECT_EQ((uintptr_t)kProducers * 10000 * 10001 / 2, sum);
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  fixed_queue_free(queue, NULL);
+}
+
+static uintptr_t ring_flushed_sum;
+
+static void ring_flush_cb(void* data) {
+  EXPECT_TRUE(data != NULL);
+  ring_flushed_sum += (uintptr_t)data;
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_flush_while_producing) {
+  const int kProducers = 4;
+  // Large enough that producers never block
+  fixed_queue_t* queue =
+      fixed_queue_new_ring(kProducers * 10000, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  ring_flushed_sum = 0;
+  pthread_t producers[kProducers];
+  for (int i = 0; i < kProducers; i++)
+    pthread_create(&producers[i], NULL, ring_producer, queue);
+
+  // Flushes race with producers between claiming and publishing a slot
+  for (int i = 0; i < 1000; i++) fixed_queue_flush(queue, ring_flush_cb);
+
+  for (int i = 0; i < kProducers; i++) pthread_join(producers[i], NULL);
+  fixed_queue_flush(queue, ring_flush_cb);
+
+  EXPECT_EQ((uintptr_t)kProducers * 10000 * 10001 / 2, ring_flushed_sum);
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_dequeue_fd_cleared_when_empty) {
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE, FIXED_QUEUE_MPSC);
+  ASSERT_TRUE(queue != NULL);
+  int dequeue_fd = fixed_queue_get_dequeue_fd(queue);
+
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  EXPECT_EQ(DUMMY_DATA_STRING, fixed_queue_try_dequeue(queue));
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  // A producer that published the element just taken can signal it after the
+  // consumer cleared the fd. The consumer it wakes finds nothing, and must not
+  // be woken again for it.
+  eventfd_write(dequeue_fd, 1);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  // It still wakes up for the next one
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_dequeue(queue));
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  fixed_queue_free(queue, NULL);
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "stack/btm/btm_ble_adv_cache.h"
+#include "stack/include/advertise_data_parser.h"
+
+using ::benchmark::State;
+
+// Advertisers in range, e.g. a shop floor full of beacons and tags.
+#define NUM_DEVICES 300
+// Devices whose data is incomplete at any time: the number of scan responses
+// and AUX_CHAIN_IND fragments in flight between reports of other devices.
+#define DEVICES_IN_FLIGHT 40
+// Times every device is seen in the recording.
+#define ROUNDS 4
+
+namespace {
+
+// Event_Type bits of the LE Extended Advertising Report event.
+#define EVT_SCANNABLE 0x0002
+#define EVT_SCAN_RESPONSE 0x0008
+#define EVT_LEGACY 0x0010
+#define EVT_MORE_DATA 0x0020
+
+// The list with linear search that btm_ble_gap.cc used before, kept to
+// compare against.
+class ListAdvertisingCache {
+ public:
+  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
+                                  std::vector<uint8_t> data) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) {
+      it->data = std::move(data);
+      return it->data;
+    }
+    if (items.size() > cache_max) items.pop_back();
+    items.emplace_front(addr_type, addr, std::move(data));
+    return items.front().data;
+  }
+
+  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
+                                     std::vector<uint8_t> data) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) {
+      it->data.insert(it->data.end(), data.begin(), data.end());
+      return it->data;
+    }
+    if (items.size() > cache_max) items.pop_back();
+    items.emplace_front(addr_type, addr, std::move(data));
+    return items.front().data;
+  }
+
+  void Clear(uint8_t addr_type, const RawAddress& addr) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) items.erase(it);
+  }
+
+ private:
+  struct Item {
+    uint8_t addr_type;
+    RawAddress addr;
+    std::vector<uint8_t> data;
+
+    Item(uint8_t addr_type, const RawAddress& addr, std::vector<uint8_t> data)
+        : addr_type(addr_type), addr(addr), data(data) {}
+  };
+
+  std::list<Item>::iterator Find(uint8_t addr_type, const RawAddress& addr) {
+    for (auto it = items.begin(); it != items.end(); it++)
+      if (it->addr_type == addr_type && it->addr == addr) return it;
+    return items.end();
+  }
+
+  const size_t cache_max = 7;
+  std::list<Item> items;
+};
+
+// Adapts ListAdvertisingCache to the AdvertisingCache interface, copying every
+// report into a temporary vector as btm_ble_process_adv_pkt_cont used to.
+struct ListCacheAdapter {
+  ListAdvertisingCache cache;
+
+  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
+                                  const uint8_t* data, size_t len,
+                                  uint64_t /* now_ms */) {
+    std::vector<uint8_t> tmp;
+    if (len != 0) tmp.insert(tmp.begin(), data, data + len);
+    return cache.Set(addr_type, addr, std::move(tmp));
+  }
+
+  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
+                                     const uint8_t* data, size_t len,
+                                     uint64_t /* now_ms */) {
+    std::vector<uint8_t> tmp;
+    if (len != 0) tmp.insert(tmp.begin(), data, data + len);
+    return cache.Append(addr_type, addr, std::move(tmp));
+  }
+
+  void Clear(uint8_t addr_type, const RawAddress& addr) {
+    cache.Clear(addr_type, addr);
+  }
+};
+
+struct Device {
+  RawAddress addr;
+  bool legacy;
+  // advertising data split as it goes over the air
+  std::vector<std::vector<uint8_t>> fragments;
+  size_t total_len;
+};
+
+uint32_t next_random(uint32_t* seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+std::vector<uint8_t> make_ad(uint32_t* seed, size_t len) {
+  std::vector<uint8_t> ad;
+  while (ad.size() + 2 < len) {
+    size_t field =
+        std::min<size_t>(len - ad.size() - 1, 2 + next_random(seed) % 25);
+    ad.push_back(field);
+    ad.push_back(0xff);  // manufacturer specific data
+    for (size_t i = 1; i < field; i++) ad.push_back(next_random(seed));
+  }
+  return ad;
+}
+
+Device make_device(uint32_t n, uint32_t* seed) {
+  Device device;
+  device.addr.address[0] = 0xc0 | (n >> 16);
+  device.addr.address[1] = n >> 8;
+  device.addr.address[2] = n;
+  for (int i = 3; i < 6; i++) device.addr.address[i] = next_random(seed);
+
+  // Two thirds are legacy beacons answering scan requests, the rest use
+  // extended advertising with data chained over several AUX PDUs.
+  device.legacy = (n % 3 != 0);
+  if (device.legacy) {
+    std::vector<uint8_t> adv = make_ad(seed, 20 + next_random(seed) % 11);
+    std::vector<uint8_t> rsp = make_ad(seed, 10 + next_random(seed) % 21);
+    device.total_len = adv.size() + rsp.size();
+    adv.resize(31, 0);  // legacy PDUs come zero padded
+    rsp.resize(31, 0);
+    device.fragments = {adv, rsp};
+  } else {
+    std::vector<uint8_t> ad = make_ad(seed, 300 + next_random(seed) % 400);
+    device.total_len = ad.size();
+    for (size_t pos = 0; pos < ad.size(); pos += 229) {
+      size_t end = std::min<size_t>(ad.size(), pos + 229);
+      device.fragments.emplace_back(ad.begin() + pos, ad.begin() + end);
+    }
+  }
+  return device;
+}
+
+// Serializes one report as the parameters of an LE Extended Advertising Report
+// event.
+std::vector<uint8_t> make_report(const Device& device, size_t fragment) {
+  uint16_t event_type;
+  if (device.legacy) {
+    event_type = EVT_LEGACY | EVT_SCANNABLE | 0x0001;
+    if (fragment == 1) event_type |= EVT_SCAN_RESPONSE;
+  } else {
+    event_type = 0x0001;
+    if (fragment + 1 < device.fragments.size()) event_type |= EVT_MORE_DATA;
+  }
+  const std::vector<uint8_t>& data = device.fragments[fragment];
+
+  std::vector<uint8_t> report = {
+      1,  // num_reports
+      static_cast<uint8_t>(event_type), static_cast<uint8_t>(event_type >> 8),
+      0x01,  // random address
+  };
+  for (int i = 5; i >= 0; i--) report.push_back(device.addr.address[i]);
+  const uint8_t tail[] = {
+      0x01, 0x02, 0x03,        // primary PHY, secondary PHY, SID
+      0x7f, 0xc4,              // TX power, RSSI
+      0x00, 0x00,              // periodic advertising interval
+      0x00, 0, 0, 0, 0, 0, 0,  // direct address
+  };
+  report.insert(report.end(), tail, tail + sizeof(tail));
+  report.push_back(data.size());
+  report.insert(report.end(), data.begin(), data.end());
+  return report;
+}
+
+// Produces the recording: reports of different devices interleave, with up
+// to DEVICES_IN_FLIGHT devices between their first and last report.
+std::vector<std::vector<uint8_t>> make_recording(
+    std::map<RawAddress, size_t>* expected_len) {
+  uint32_t seed = 42;
+  std::vector<Device> devices;
+  for (uint32_t i = 0; i < NUM_DEVICES; i++) {
+    devices.push_back(make_device(i, &seed));
+    (*expected_len)[devices.back().addr] = devices.back().total_len;
+  }
+
+  std::vector<std::vector<uint8_t>> events;
+  for (int round = 0; round < ROUNDS; round++) {
+    std::vector<std::pair<size_t, size_t>> in_flight;  // device, fragment
+    size_t next_device = 0;
+    while (next_device < devices.size() || !in_flight.empty()) {
+      if (next_device < devices.size() &&
+          in_flight.size() < DEVICES_IN_FLIGHT) {
+        in_flight.emplace_back(next_device++, 0);
+        continue;
+      }
+      size_t i = next_random(&seed) % in_flight.size();
+      auto& progress = in_flight[i];
+      const Device& device = devices[progress.first];
+      events.push_back(make_report(device, progress.second));
+      if (++progress.second == device.fragments.size()) {
+        in_flight[i] = in_flight.back();
+        in_flight.pop_back();
+      }
+    }
+  }
+  return events;
+}
+
+struct ReplayResult {
+  size_t reported = 0;
+  size_t corrupted = 0;
+};
+
+// Mirrors btm_ble_process_ext_adv_pkt and the caching part of
+// btm_ble_process_adv_pkt_cont during an active scan.
+template <typename Cache>
+void replay(Cache& cache, const std::vector<std::vector<uint8_t>>& events,
+            const std::map<RawAddress, size_t>& expected_len,
+            uint64_t* now_ms, ReplayResult* result) {
+  for (const std::vector<uint8_t>& event : events) {
+    const uint8_t* p = event.data() + 1;
+    uint16_t event_type = p[0] | (p[1] << 8);
+    uint8_t addr_type = p[2];
+    RawAddress bda;
+    for (int i = 0; i < 6; i++) bda.address[5 - i] = p[3 + i];
+    uint8_t data_len = p[23];
+    const uint8_t* data = p + 24;
+    (*now_ms)++;
+
+    bool legacy = event_type & EVT_LEGACY;
+    bool is_scannable = event_type & EVT_SCANNABLE;
+    bool is_scan_resp = event_type & EVT_SCAN_RESPONSE;
+    bool is_start = legacy && is_scannable && !is_scan_resp;
+
+    size_t len = data_len;
+    if (legacy)
+      len = AdvertiseDataParser::LengthWithoutTrailingZeros(data, data_len);
+
+    const std::vector<uint8_t>& adv_data =
+        is_start ? cache.Set(addr_type, bda, data, len, *now_ms)
+                 : cache.Append(addr_type, bda, data, len, *now_ms);
+
+    if (event_type & EVT_MORE_DATA) continue;
+    if (is_scannable && !is_scan_resp) continue;
+
+    result->reported++;
+    if (adv_data.size() != expected_len.at(bda)) result->corrupted++;
+    cache.Clear(addr_type, bda);
+  }
+}
+
+}  // namespace
+
+class BM_AdvertisingCache : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    expected_len_.clear();
+    events_ = make_recording(&expected_len_);
+  }
+
+  void TearDown(State& st) override {
+    events_.clear();
+    benchmark::Fixture::TearDown(st);
+  }
+
+  std::vector<std::vector<uint8_t>> events_;
+  std::map<RawAddress, size_t> expected_len_;
+};
+
+BENCHMARK_F(BM_AdvertisingCache, list_replay)(State& state) {
+  ReplayResult result;
+  uint64_t now_ms = 0;
+  for (auto _ : state) {
+    ListCacheAdapter cache;
+    result = ReplayResult();
+    replay(cache, events_, expected_len_, &now_ms, &result);
+  }
+  state.SetItemsProcessed(state.iterations() * events_.size());
+  state.counters["reported"] = result.reported;
+  state.counters["corrupted"] = result.corrupted;
+}
+
+BENCHMARK_F(BM_AdvertisingCache, hashed_replay)(State& state) {
+  AdvertisingCache cache;
+  ReplayResult result;
+  uint64_t now_ms = 0;
+  for (auto _ : state) {
+    result = ReplayResult();
+    replay(cache, events_, expected_len_, &now_ms, &result);
+  }
+  state.SetItemsProcessed(state.iterations() * events_.size());
+  state.counters["reported"] = result.reported;
+  state.counters["corrupted"] = result.corrupted;
+  state.counters["evictions"] = cache.evictions();
+  state.counters["timeouts"] = cache.timeouts();
+}
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "stack/crypto_toolbox/aes_backend.h"
+#include "stack/crypto_toolbox/crypto_toolbox.h"
+
+using ::benchmark::State;
+using crypto_toolbox::AesBackend;
+
+// Blocks per batch call; on the order of the number of bonded IRKs an RPA is
+// resolved against.
+#define BATCH_SIZE 64
+
+namespace {
+
+struct Blocks {
+  std::vector<Octet16> keys;
+  std::vector<Octet16> in;
+  std::vector<Octet16> out;
+
+  explicit Blocks(size_t n) : keys(n), in(n), out(n) {
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < OCTET16_LEN; j++) {
+        keys[i][j] = static_cast<uint8_t>(i * 31 + j * 7 + 1);
+        in[i][j] = static_cast<uint8_t>(i * 13 + j);
+      }
+  }
+};
+
+// One block at a time, as rpa_matches_irk and aes_cmac use it.
+void BM_AesSingle(State& state, const AesBackend* backend) {
+  Blocks blocks(BATCH_SIZE);
+  for (auto _ : state) {
+    for (size_t i = 0; i < BATCH_SIZE; i++)
+      backend->encrypt_batch(&blocks.keys[i], &blocks.in[i], &blocks.out[i],
+                             1);
+    benchmark::DoNotOptimize(blocks.out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+  state.SetBytesProcessed(state.iterations() * BATCH_SIZE * OCTET16_LEN);
+}
+
+// BATCH_SIZE blocks under BATCH_SIZE keys per call.
+void BM_AesBatch(State& state, const AesBackend* backend) {
+  Blocks blocks(BATCH_SIZE);
+  for (auto _ : state) {
+    backend->encrypt_batch(blocks.keys.data(), blocks.in.data(),
+                           blocks.out.data(), BATCH_SIZE);
+    benchmark::DoNotOptimize(blocks.out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+  state.SetBytesProcessed(state.iterations() * BATCH_SIZE * OCTET16_LEN);
+}
+
+// What callers of crypto_toolbox see, including the byte order conversion.
+void BM_Aes128Batch(State& state) {
+  Blocks blocks(BATCH_SIZE);
+  for (auto _ : state) {
+    crypto_toolbox::aes_128_batch(blocks.keys.data(), blocks.in.data(),
+                                  blocks.out.data(), BATCH_SIZE);
+    benchmark::DoNotOptimize(blocks.out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+  state.SetLabel(crypto_toolbox::aes_backend().name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (const AesBackend* backend : crypto_toolbox::aes_backends()) {
+    std::string name(backend->name);
+    ::benchmark::RegisterBenchmark(("BM_AesSingle/" + name).c_str(),
+                                   BM_AesSingle, backend);
+    ::benchmark::RegisterBenchmark(("BM_AesBatch/" + name).c_str(),
+                                   BM_AesBatch, backend);
+  }
+  ::benchmark::RegisterBenchmark("BM_Aes128Batch", BM_Aes128Batch);
+
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "stack/crc/crc.h"
+
+using ::benchmark::State;
+using crc::Crc16Backend;
+
+namespace {
+
+// The FCS over one I-frame of |state.range(0)| bytes; ERTM frames go up to
+// the 64 KB MPS.
+void BM_Crc16(State& state, const Crc16Backend* backend) {
+  std::vector<uint8_t> frame(state.range(0));
+  for (size_t i = 0; i < frame.size(); i++) frame[i] = i * 7 + 1;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(backend->update(0, frame.data(), frame.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (const Crc16Backend* backend : crc::crc16_backends()) {
+    std::string name(backend->name);
+    ::benchmark::RegisterBenchmark(("BM_Crc16/" + name).c_str(), BM_Crc16,
+                                   backend)
+        ->RangeMultiplier(4)
+        ->Range(1024, 64 * 1024);
+  }
+
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+using ::benchmark::State;
+
+// Simulated time per run, in microseconds.
+#define RUN_US (60 * 1000 * 1000)
+// ATT MTU and LE data length negotiated by the client.
+#define ATT_MTU 247
+#define LL_MAX_PAYLOAD 251
+// As gatt_sr_hold_notif packs them.
+#define MAX_MULTI_HANDLE_NOTIF 10
+#define MULTI_NOTIF_ATTR_HDR_LEN 4
+
+// Air time on the LE 1M PHY: each byte takes 8 us. A data packet carries a
+// preamble, access address, header, MIC and CRC around its payload. The
+// peer acknowledges it with an empty packet, and 150 us of inter frame space
+// goes before each of the two.
+#define US_PER_BYTE 8
+#define LL_PACKET_OVERHEAD (1 + 4 + 2 + 4 + 3)
+#define LL_EMPTY_PACKET (1 + 4 + 2 + 3)
+#define T_IFS_US 150
+
+namespace {
+
+uint32_t next_random(uint32_t* seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+struct Characteristic {
+  uint16_t handle;
+  uint32_t period_us;
+  uint16_t len;
+};
+
+// A fitness tracker streaming heart rate, motion and a few slower readings
+// from characteristics of its own.
+const std::vector<Characteristic> kCharacteristics = {
+    {0x0010, 10000, 20},   // accelerometer, 100 Hz
+    {0x0013, 10000, 20},   // gyroscope, 100 Hz
+    {0x0016, 20000, 12},   // magnetometer, 50 Hz
+    {0x0019, 40000, 8},    // heart rate, 25 Hz
+    {0x001c, 100000, 4},   // skin temperature, 10 Hz
+    {0x001f, 1000000, 1},  // battery level, 1 Hz
+};
+
+// Sends the notifications of kCharacteristics over one bearer, holding them
+// back for up to |budget_us| the way gatt_sr_hold_notif does.
+class BearerSimulation {
+ public:
+  explicit BearerSimulation(uint32_t budget_us) : budget_us_(budget_us) {}
+
+  void Run() {
+    uint32_t seed = 1;
+    std::vector<uint64_t> next(kCharacteristics.size());
+    for (size_t i = 0; i < next.size(); i++)
+      next[i] = next_random(&seed) % kCharacteristics[i].period_us;
+
+    while (true) {
+      size_t i = std::min_element(next.begin(), next.end()) - next.begin();
+      uint64_t now = next[i];
+      if (now >= RUN_US) break;
+
+      // The latency budget of the held notifications ran out before this one
+      if (!held_.empty() && now >= held_since_ + budget_us_)
+        Send(held_since_ + budget_us_);
+      Notify(now, kCharacteristics[i]);
+
+      // Sensors sample with some jitter
+      const uint32_t period = kCharacteristics[i].period_us;
+      next[i] = now + period - period / 20 + next_random(&seed) % (period / 10);
+    }
+    if (!held_.empty()) Send(held_since_ + budget_us_);
+  }
+
+  uint64_t notifications() const { return notifications_; }
+  uint64_t att_pdus() const { return att_pdus_; }
+  uint64_t ll_packets() const { return ll_packets_; }
+  uint64_t air_bytes() const { return air_us_ / US_PER_BYTE; }
+  double mean_delay_us() const {
+    return notifications_ ? (double)delay_us_ / notifications_ : 0;
+  }
+
+ private:
+  struct Held {
+    uint64_t queued_us;
+    uint16_t handle;
+    uint16_t len;
+  };
+
+  void Notify(uint64_t now, const Characteristic& charac) {
+    uint16_t attr_len = MULTI_NOTIF_ATTR_HDR_LEN + charac.len;
+    if (budget_us_ == 0) {
+      held_.push_back({now, charac.handle, charac.len});
+      Send(now);
+      return;
+    }
+
+    if (!held_.empty()) {
+      bool is_full = held_.size() == MAX_MULTI_HANDLE_NOTIF ||
+                     pdu_len_ + attr_len > ATT_MTU;
+      bool is_next = std::any_of(
+          held_.begin(), held_.end(),
+          [&charac](const Held& held) { return held.handle == charac.handle; });
+      if (is_full || is_next) Send(now);
+    }
+
+    if (held_.empty()) {
+      held_since_ = now;
+      pdu_len_ = 1;
+    }
+    held_.push_back({now, charac.handle, charac.len});
+    pdu_len_ += attr_len;
+  }
+
+  void Send(uint64_t now) {
+    // A single notification goes as a Handle Value Notification
+    uint16_t pdu_len = held_.size() == 1 ? 3 + held_[0].len : pdu_len_;
+    size_t sdu_len = 4 + pdu_len;  // with the L2CAP header
+    while (sdu_len > 0) {
+      size_t payload = std::min(sdu_len, (size_t)LL_MAX_PAYLOAD);
+      air_us_ += (LL_PACKET_OVERHEAD + payload + LL_EMPTY_PACKET) *
+                     US_PER_BYTE +
+                 2 * T_IFS_US;
+      sdu_len -= payload;
+      ll_packets_++;
+    }
+    att_pdus_++;
+
+    for (const Held& held : held_) delay_us_ += now - held.queued_us;
+    notifications_ += held_.size();
+    held_.clear();
+  }
+
+  uint32_t budget_us_;
+  std::vector<Held> held_;
+  uint64_t held_since_ = 0;
+  uint16_t pdu_len_ = 0;
+
+  uint64_t notifications_ = 0;
+  uint64_t att_pdus_ = 0;
+  uint64_t ll_packets_ = 0;
+  uint64_t air_us_ = 0;
+  uint64_t delay_us_ = 0;
+};
+
+// PDUs and air time per second, holding notifications back for up to
+// state.range(0) ms; 0 sends each on its own.
+void BM_Notifications(State& state) {
+  BearerSimulation* sim = nullptr;
+  for (auto _ : state) {
+    delete sim;
+    sim = new BearerSimulation(state.range(0) * 1000);
+    sim->Run();
+  }
+
+  double seconds = RUN_US / 1000000.0;
+  state.counters["notif_per_s"] = sim->notifications() / seconds;
+  state.counters["att_pdus_per_s"] = sim->att_pdus() / seconds;
+  state.counters["ll_packets_per_s"] = sim->ll_packets() / seconds;
+  state.counters["air_bytes_per_s"] = sim->air_bytes() / seconds;
+  state.counters["mean_delay_ms"] = sim->mean_delay_us() / 1000;
+  delete sim;
+}
+
+}  // namespace
+
+BENCHMARK(BM_Notifications)
+    ->Arg(0)
+    ->Arg(2)
+    ->Arg(5)
+    ->Arg(10)
+    ->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <list>
+#include <vector>
+
+#include "stack/gatt/gatt_sr_index.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+using bluetooth::Uuid;
+
+// Services hosted, and characteristics in each; with a value and a CCCD per
+// characteristic that is 640 attributes.
+#define NUM_SERVICES 40
+#define CHARS_PER_SERVICE 5
+// Characteristic declarations that fit a Read By Type response at the
+// default MTU.
+#define DECLS_PER_RSP 3
+
+namespace {
+
+const Uuid kPrimary = Uuid::From16Bit(0x2800);
+const Uuid kCharacteristic = Uuid::From16Bit(0x2803);
+const Uuid kCccd = Uuid::From16Bit(0x2902);
+
+// The parts of tGATT_ATTR, tGATT_SVC_DB and tGATT_SRV_LIST_ELEM the lookups
+// look at.
+struct Attr {
+  uint16_t handle;
+  Uuid uuid;
+};
+
+struct Db {
+  std::vector<Attr> attr_list;
+};
+
+struct Service {
+  uint16_t s_hdl;
+  uint16_t e_hdl;
+  Db* p_db;
+  Uuid uuid;
+};
+
+typedef std::list<Service> ServiceList;
+
+class Server {
+ public:
+  Server() : dbs_(NUM_SERVICES) {
+    uint16_t handle = 1;
+    for (size_t s = 0; s < NUM_SERVICES; s++) {
+      Db& db = dbs_[s];
+      uint16_t s_hdl = handle;
+      db.attr_list.push_back({handle++, kPrimary});
+      for (size_t c = 0; c < CHARS_PER_SERVICE; c++) {
+        db.attr_list.push_back({handle++, kCharacteristic});
+        db.attr_list.push_back(
+            {handle++, Uuid::From16Bit(0x2a00 + s * CHARS_PER_SERVICE + c)});
+        db.attr_list.push_back({handle++, kCccd});
+      }
+      // Services leave room to grow
+      handle += 4;
+      services_.push_back({s_hdl, (uint16_t)(handle - 1), &db,
+                           Uuid::From16Bit(0x1800 + s)});
+    }
+    index_.Build(services_,
+                 [](Service& service) -> const Uuid* { return &service.uuid; });
+  }
+
+  // gatt_sr_find_i_rcb_by_handle and find_attr_by_handle as they were
+  // before the index.
+  const Attr* ScanAttr(uint16_t handle) {
+    for (Service& service : services_) {
+      if (service.s_hdl <= handle && service.e_hdl >= handle) {
+        for (const Attr& attr : service.p_db->attr_list) {
+          if (attr.handle == handle) return &attr;
+          if (attr.handle > handle) return nullptr;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  // The handles a Read By Type response holds, at most |max|, the way
+  // gatts_process_read_by_type_req found them before the index.
+  size_t ScanByType(const Uuid& type, uint16_t s_hdl, uint16_t e_hdl,
+                    uint16_t* p_handles, size_t max) {
+    size_t n = 0;
+    for (Service& service : services_) {
+      if (service.s_hdl > e_hdl || service.e_hdl < s_hdl) continue;
+      for (const Attr& attr : service.p_db->attr_list) {
+        if (attr.handle >= s_hdl && attr.handle <= e_hdl && type == attr.uuid) {
+          p_handles[n++] = attr.handle;
+          if (n == max) return n;
+        }
+      }
+    }
+    return n;
+  }
+
+  const Service* ScanByUuid(const Uuid& uuid) {
+    for (Service& service : services_)
+      if (service.uuid == uuid) return &service;
+    return nullptr;
+  }
+
+  // The same with the index.
+  const Attr* FindAttr(uint16_t handle) {
+    ServiceList::iterator it = services_.end();
+    if (!index_.Find(handle, &it)) return nullptr;
+    const std::vector<Attr>& attrs = it->p_db->attr_list;
+    size_t i = handle - attrs[0].handle;
+    return i < attrs.size() ? &attrs[i] : nullptr;
+  }
+
+  size_t FindByType(const Uuid& type, uint16_t s_hdl, uint16_t e_hdl,
+                    uint16_t* p_handles, size_t max) {
+    auto range = index_.HandlesOfType(type, s_hdl, e_hdl);
+    size_t n = 0;
+    for (auto h = range.first; h != range.second && n < max; ++h) {
+      if (FindAttr(*h) != nullptr) p_handles[n++] = *h;
+    }
+    return n;
+  }
+
+  const Service* FindByUuid(const Uuid& uuid) {
+    const std::vector<ServiceList::iterator>* p_services =
+        index_.PrimaryServices(uuid);
+    return p_services == nullptr ? nullptr : &*p_services->front();
+  }
+
+  const ServiceList& services() const { return services_; }
+
+ private:
+  std::vector<Db> dbs_;
+  ServiceList services_;
+  GattSrIndex<ServiceList> index_;
+};
+
+// What a client discovering and reading the whole database asks for: each
+// service by UUID, its characteristics with Read By Type, then every
+// attribute with a Read Request and every CCCD in one Read By Type sweep.
+template <bool kIndexed>
+size_t discover_and_read(Server& server) {
+  size_t requests = 0;
+  uint16_t handles[DECLS_PER_RSP];
+
+  for (const Service& service : server.services()) {
+    const Service* p_found = kIndexed ? server.FindByUuid(service.uuid)
+                                      : server.ScanByUuid(service.uuid);
+    benchmark::DoNotOptimize(p_found);
+    requests++;
+
+    uint16_t s_hdl = service.s_hdl;
+    while (true) {
+      size_t n = kIndexed ? server.FindByType(kCharacteristic, s_hdl,
+                                              service.e_hdl, handles,
+                                              DECLS_PER_RSP)
+                          : server.ScanByType(kCharacteristic, s_hdl,
+                                              service.e_hdl, handles,
+                                              DECLS_PER_RSP);
+      requests++;
+      if (n == 0) break;
+      s_hdl = handles[n - 1] + 1;
+    }
+
+    for (uint16_t h = service.s_hdl; h <= service.e_hdl; h++) {
+      const Attr* p_attr = kIndexed ? server.FindAttr(h) : server.ScanAttr(h);
+      benchmark::DoNotOptimize(p_attr);
+      requests++;
+    }
+  }
+
+  uint16_t s_hdl = 1;
+  while (true) {
+    size_t n =
+        kIndexed
+            ? server.FindByType(kCccd, s_hdl, 0xffff, handles, DECLS_PER_RSP)
+            : server.ScanByType(kCccd, s_hdl, 0xffff, handles, DECLS_PER_RSP);
+    requests++;
+    if (n == 0) break;
+    s_hdl = handles[n - 1] + 1;
+  }
+  return requests;
+}
+
+template <bool kIndexed>
+void BM_FullDatabaseRead(State& state) {
+  Server server;
+  size_t requests = 0;
+  for (auto _ : state) {
+    requests += discover_and_read<kIndexed>(server);
+  }
+  state.SetItemsProcessed(requests);
+  state.counters["time_per_request"] =
+      Counter(requests, Counter::kIsRate | Counter::kInvert);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_FullDatabaseRead, false)
+    ->Name("BM_FullDatabaseRead/scan")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FullDatabaseRead, true)
+    ->Name("BM_FullDatabaseRead/index")
+    ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <list>
+#include <vector>
+
+#include "stack/btm/btm_handle_table.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// Slots of the link pools; MAX_ACL_CONNECTIONS on targets that allow 16 links.
+#define NUM_LINK_SLOTS 16
+// Links up at once.
+#define NUM_LINKS 15
+// Security records in the device database; BTM_SEC_MAX_DEVICE_RECORDS.
+#define NUM_DEV_RECS 100
+// ACL packets routed per iteration.
+#define NUM_PACKETS 1000000
+
+namespace {
+
+// Stand-ins for tL2C_LCB, tACL_CONN and tBTM_SEC_DEV_REC; the padding is
+// about their size, so that walking the pools touches as much memory as it
+// does in the stack.
+struct Lcb {
+  bool in_use;
+  uint16_t handle;
+  uint8_t rest[560];
+};
+
+struct AclConn {
+  bool in_use;
+  uint16_t hci_handle;
+  uint8_t rest[120];
+};
+
+struct DevRec {
+  uint16_t hci_handle;
+  uint16_t ble_hci_handle;
+  uint8_t rest[700];
+};
+
+typedef BtmHandleTable<DevRec> HandleTable;
+
+class Links {
+ public:
+  Links() : lcbs_(NUM_LINK_SLOTS), acls_(NUM_LINK_SLOTS) {
+    for (size_t n = 0; n < NUM_DEV_RECS; n++) {
+      dev_recs_.emplace_back();
+      dev_recs_.back().hci_handle = 0xffff;
+      dev_recs_.back().ble_hci_handle = 0xffff;
+    }
+
+    // Bonded devices come and go, so the connected ones are spread through
+    // the database, and handles are not given out in order.
+    auto dev_rec = dev_recs_.begin();
+    for (size_t n = 0; n < NUM_LINKS; n++) {
+      uint16_t handle = 0x0001 + n * 0x41;
+      handles_.push_back(handle);
+
+      lcbs_[n] = {true, handle, {}};
+      acls_[NUM_LINKS - 1 - n] = {true, handle, {}};
+      for (size_t i = 0; i < NUM_DEV_RECS / NUM_LINKS; i++) dev_rec++;
+      if (n % 2)
+        dev_rec->hci_handle = handle;
+      else
+        dev_rec->ble_hci_handle = handle;
+    }
+  }
+
+  // l2cu_find_lcb_by_handle, btm_handle_to_acl_index and
+  // btm_find_dev_by_handle as they were before the table.
+  Lcb* ScanLcb(uint16_t handle) {
+    for (Lcb& lcb : lcbs_)
+      if (lcb.in_use && lcb.handle == handle) return &lcb;
+    return nullptr;
+  }
+
+  size_t ScanAcl(uint16_t handle) {
+    size_t xx;
+    for (xx = 0; xx < acls_.size(); xx++)
+      if (acls_[xx].in_use && acls_[xx].hci_handle == handle) break;
+    return xx;
+  }
+
+  DevRec* ScanDevRec(uint16_t handle) {
+    for (DevRec& dev_rec : dev_recs_)
+      if (dev_rec.hci_handle == handle || dev_rec.ble_hci_handle == handle)
+        return &dev_rec;
+    return nullptr;
+  }
+
+  // The same lookups as they are now done.
+  Lcb* FindLcb(uint16_t handle) {
+    size_t xx = table_.Get(handle).lcb;
+    if (xx < lcbs_.size() && lcbs_[xx].in_use && lcbs_[xx].handle == handle)
+      return &lcbs_[xx];
+    Lcb* p_lcb = ScanLcb(handle);
+    if (p_lcb != nullptr) table_.SetLcb(handle, p_lcb - lcbs_.data());
+    return p_lcb;
+  }
+
+  size_t FindAcl(uint16_t handle) {
+    size_t xx = table_.Get(handle).acl;
+    if (xx < acls_.size() && acls_[xx].in_use &&
+        acls_[xx].hci_handle == handle)
+      return xx;
+    xx = ScanAcl(handle);
+    if (xx < acls_.size()) table_.SetAcl(handle, xx);
+    return xx;
+  }
+
+  DevRec* FindDevRec(uint16_t handle) {
+    DevRec* p_dev_rec = table_.Get(handle).p_dev_rec;
+    if (p_dev_rec != nullptr && (p_dev_rec->hci_handle == handle ||
+                                 p_dev_rec->ble_hci_handle == handle))
+      return p_dev_rec;
+    p_dev_rec = ScanDevRec(handle);
+    table_.SetDevRec(handle, p_dev_rec);
+    return p_dev_rec;
+  }
+
+  const std::vector<uint16_t>& handles() const { return handles_; }
+
+ private:
+  std::vector<Lcb> lcbs_;
+  std::vector<AclConn> acls_;
+  // The security records are an osi list; a linked list walks the same way.
+  std::list<DevRec> dev_recs_;
+  std::vector<uint16_t> handles_;
+  HandleTable table_;
+};
+
+uint32_t next_random(uint32_t* seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+// The handle of every packet, with its ACL header flags: links carrying
+// bursts of packets, e.g. A2DP media next to file transfers and LE traffic.
+std::vector<uint16_t> make_traffic(const std::vector<uint16_t>& handles) {
+  uint32_t seed = 1;
+  std::vector<uint16_t> packets;
+  packets.reserve(NUM_PACKETS);
+  while (packets.size() < NUM_PACKETS) {
+    uint16_t handle = handles[next_random(&seed) % handles.size()];
+    size_t burst = 1 + next_random(&seed) % 8;
+    for (size_t i = 0; i < burst && packets.size() < NUM_PACKETS; i++)
+      packets.push_back(handle | (i == 0 ? 0x2000 : 0x1000));
+  }
+  return packets;
+}
+
+// What l2c_rcv_acl_data, btm_sec and the ACL bookkeeping look up for each
+// inbound packet.
+void BM_RouteScan(State& state) {
+  Links links;
+  static const std::vector<uint16_t> packets = make_traffic(links.handles());
+
+  for (auto _ : state) {
+    for (uint16_t packet : packets) {
+      uint16_t handle = packet & 0x0fff;
+      benchmark::DoNotOptimize(links.ScanLcb(handle));
+      benchmark::DoNotOptimize(links.ScanAcl(handle));
+      benchmark::DoNotOptimize(links.ScanDevRec(handle));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * packets.size());
+  state.counters["time_per_packet"] = Counter(
+      state.iterations() * packets.size(), Counter::kIsRate | Counter::kInvert);
+}
+
+void BM_RouteTable(State& state) {
+  Links links;
+  static const std::vector<uint16_t> packets = make_traffic(links.handles());
+
+  for (auto _ : state) {
+    for (uint16_t packet : packets) {
+      uint16_t handle = packet & 0x0fff;
+      benchmark::DoNotOptimize(links.FindLcb(handle));
+      benchmark::DoNotOptimize(links.FindAcl(handle));
+      benchmark::DoNotOptimize(links.FindDevRec(handle));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * packets.size());
+  state.counters["time_per_packet"] = Counter(
+      state.iterations() * packets.size(), Counter::kIsRate | Counter::kInvert);
+}
+
+}  // namespace
+
+BENCHMARK(BM_RouteScan)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RouteTable)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
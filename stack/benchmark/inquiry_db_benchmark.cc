@@ -0,0 +1,274 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "stack/btm/btm_inq_db_index.h"
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// Advertisers in range during the storm; several times the database size, so
+// that most reports of a new device have to reuse an entry.
+#define NUM_DEVICES 4000
+// Reports replayed per iteration.
+#define NUM_REPORTS 20000
+// Entries of the responded address list; what fits in BT_DEFAULT_BUFFER_SIZE.
+#define BD_DB_SIZE 256
+#define HID_KEEP_MAX 4
+
+namespace {
+
+// Stand-in for tINQ_DB_ENT; the padding is about the size of tBTM_INQ_INFO, so
+// that walking the database touches as much memory as it does in the stack.
+struct Entry {
+  RawAddress addr;
+  uint32_t time_of_resp;
+  uint32_t inq_count;
+  bool in_use;
+  bool keep;
+  uint8_t inq_info[240];
+};
+
+struct BdEntry {
+  uint32_t inq_count;
+  RawAddress addr;
+  uint8_t device_type;
+};
+
+// btm_inq_db_find, btm_inq_find_bdaddr and btm_inq_db_new as they were before
+// the index, kept to compare against.
+class LinearInqDb {
+ public:
+  explicit LinearInqDb(size_t size) : db_(size), bd_db_(BD_DB_SIZE) {}
+
+  Entry* Find(const RawAddress& bda) {
+    for (Entry& e : db_)
+      if (e.in_use && e.addr == bda) return &e;
+    return nullptr;
+  }
+
+  bool FindBdaddr(const RawAddress& bda, uint8_t device_type) {
+    size_t xx;
+    for (xx = 0; xx < num_bd_; xx++) {
+      BdEntry& b = bd_db_[xx];
+      if (b.addr == bda && b.inq_count == inq_counter &&
+          b.device_type == device_type)
+        return true;
+    }
+    if (xx < bd_db_.size()) {
+      bd_db_[xx] = {inq_counter, bda, device_type};
+      num_bd_++;
+    }
+    return false;
+  }
+
+  Entry* New(const RawAddress& bda, bool keep) {
+    Entry* p_old = &db_[0];
+    uint32_t ot = 0xFFFFFFFF;
+    uint8_t keep_counter = 0;
+    for (Entry& e : db_) {
+      if (!e.in_use) return Init(&e, bda, keep && keep_counter < HID_KEEP_MAX);
+      if (e.keep) keep_counter++;
+      if (e.time_of_resp < ot && !e.keep) {
+        p_old = &e;
+        ot = e.time_of_resp;
+      }
+    }
+    return Init(p_old, bda, keep && keep_counter < HID_KEEP_MAX);
+  }
+
+  void Touch(Entry* p_ent, uint32_t time) { p_ent->time_of_resp = time; }
+
+  void NewInquiry() {
+    num_bd_ = 0;
+    inq_counter++;
+  }
+
+  uint32_t inq_counter = 1;
+
+ private:
+  static Entry* Init(Entry* p_ent, const RawAddress& bda, bool keep) {
+    memset(p_ent, 0, sizeof(Entry));
+    p_ent->addr = bda;
+    p_ent->in_use = true;
+    p_ent->keep = keep;
+    return p_ent;
+  }
+
+  std::vector<Entry> db_;
+  std::vector<BdEntry> bd_db_;
+  size_t num_bd_ = 0;
+};
+
+// The same operations as btm_inq.cc now does them.
+class IndexedInqDb {
+ public:
+  explicit IndexedInqDb(size_t size)
+      : db_(size), index_(size), bd_db_(BD_DB_SIZE) {}
+
+  Entry* Find(const RawAddress& bda) {
+    int slot = index_.Find(bda);
+    return slot == InqDbIndex::kNone ? nullptr : &db_[slot];
+  }
+
+  bool FindBdaddr(const RawAddress& bda, uint8_t device_type) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < RawAddress::kLength; i++)
+      key = (key << 8) | bda.address[i];
+    key = (key << 8) | device_type;
+
+    auto it = bd_index_.find(key);
+    if (it != bd_index_.end()) {
+      BdEntry& b = bd_db_[it->second];
+      if (b.inq_count == inq_counter) return true;
+      b.inq_count = inq_counter;
+      return false;
+    }
+    if (num_bd_ < bd_db_.size()) {
+      bd_db_[num_bd_] = {inq_counter, bda, device_type};
+      bd_index_[key] = num_bd_++;
+    }
+    return false;
+  }
+
+  Entry* New(const RawAddress& bda, bool keep) {
+    int slot = index_.FreeSlot();
+    if (slot == InqDbIndex::kNone) {
+      slot = index_.Oldest();
+      if (slot == InqDbIndex::kNone) slot = 0;
+      index_.Remove(slot);
+    }
+    Entry* p_ent = &db_[slot];
+    memset(p_ent, 0, sizeof(Entry));
+    p_ent->addr = bda;
+    p_ent->in_use = true;
+    p_ent->keep = keep && index_.keep_count() < HID_KEEP_MAX;
+    index_.Add(slot, bda, p_ent->keep);
+    return p_ent;
+  }
+
+  void Touch(Entry* p_ent, uint32_t time) {
+    p_ent->time_of_resp = time;
+    index_.Touch(p_ent - db_.data());
+  }
+
+  void NewInquiry() {
+    num_bd_ = 0;
+    bd_index_.clear();
+    inq_counter++;
+  }
+
+  uint32_t inq_counter = 1;
+
+ private:
+  std::vector<Entry> db_;
+  InqDbIndex index_;
+  std::vector<BdEntry> bd_db_;
+  std::unordered_map<uint64_t, uint16_t> bd_index_;
+  size_t num_bd_ = 0;
+};
+
+uint32_t next_random(uint32_t* seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+// Addresses in order of their reports: a few hundred devices advertising
+// every 100 ms or so, mixed with a long tail of devices seen once or twice,
+// e.g. phones walking past with rotating RPAs.
+std::vector<RawAddress> make_storm() {
+  uint32_t seed = 1;
+  std::vector<RawAddress> devices(NUM_DEVICES);
+  for (size_t n = 0; n < devices.size(); n++) {
+    devices[n].address[0] = 0x40 | (n >> 16);
+    devices[n].address[1] = n >> 8;
+    devices[n].address[2] = n;
+    for (int i = 3; i < 6; i++) devices[n].address[i] = next_random(&seed);
+  }
+
+  std::vector<RawAddress> reports;
+  for (size_t i = 0; i < NUM_REPORTS; i++) {
+    if (next_random(&seed) % 4 != 0)
+      reports.push_back(devices[next_random(&seed) % 300]);
+    else
+      reports.push_back(
+          devices[300 + next_random(&seed) % (NUM_DEVICES - 300)]);
+  }
+  return reports;
+}
+
+// The inquiry database part of btm_ble_process_adv_pkt_cont for every report;
+// a new inquiry starts every 1000 reports, as with back to back discovery.
+template <typename Db>
+void BM_DiscoveryStorm(State& state) {
+  static const std::vector<RawAddress> reports = make_storm();
+  Db db(state.range(0));
+  uint32_t now_ms = 0;
+  size_t new_entries = 0;
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < reports.size(); i++) {
+      const RawAddress& bda = reports[i];
+      if (i % 1000 == 0) db.NewInquiry();
+      now_ms++;
+
+      Entry* p_i = db.Find(bda);
+      bool seen = db.FindBdaddr(bda, 2 /* BT_DEVICE_TYPE_BLE */);
+      if (seen && p_i != nullptr) continue;
+      if (p_i == nullptr) {
+        p_i = db.New(bda, false);
+        new_entries++;
+      }
+      db.Touch(p_i, now_ms);
+      p_i->inq_count = db.inq_counter;
+      benchmark::DoNotOptimize(p_i);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * reports.size());
+  state.counters["time_per_report"] =
+      Counter(state.iterations() * reports.size(),
+              Counter::kIsRate | Counter::kInvert);
+  state.counters["new_entries"] =
+      Counter(new_entries, Counter::kAvgIterations);
+}
+
+}  // namespace
+
+// BTM_INQ_DB_SIZE is 40 by default; larger databases are where the linear
+// scans stop being cheap.
+BENCHMARK_TEMPLATE(BM_DiscoveryStorm, LinearInqDb)
+    ->Arg(40)
+    ->Arg(256)
+    ->Arg(1024);
+BENCHMARK_TEMPLATE(BM_DiscoveryStorm, IndexedInqDb)
+    ->Arg(40)
+    ->Arg(256)
+    ->Arg(1024);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "stack/btm/btm_rpa_cache.h"
+#include "stack/crypto_toolbox/crypto_toolbox.h"
+
+using ::benchmark::State;
+
+// Bonded LE devices with an IRK.
+#define NUM_IRKS 200
+// Distinct RPAs seen while scanning.
+#define NUM_RPAS 1000
+// One in this many RPAs belongs to a bonded device.
+#define BONDED_RPA_RATIO 10
+
+namespace {
+
+struct FakeRecord {
+  Octet16 irk;
+};
+
+// Same computation as rpa_matches_irk in btm_ble_addr.cc.
+bool rpa_matches_irk(const RawAddress& rpa, const Octet16& irk) {
+  uint8_t rand[3] = {rpa.address[2], rpa.address[1], rpa.address[0]};
+  Octet16 x = crypto_toolbox::aes_128(irk, &rand[0], 3);
+  uint8_t hash[3] = {rpa.address[5], rpa.address[4], rpa.address[3]};
+  return memcmp(x.data(), hash, 3) == 0;
+}
+
+RawAddress rpa_from_irk(const Octet16& irk, uint32_t seed) {
+  RawAddress rpa;
+  rpa.address[2] = seed & 0xff;
+  rpa.address[1] = (seed >> 8) & 0xff;
+  rpa.address[0] = ((seed >> 16) & 0x3f) | 0x40;  // resolvable private
+  uint8_t rand[3] = {rpa.address[2], rpa.address[1], rpa.address[0]};
+  Octet16 x = crypto_toolbox::aes_128(irk, &rand[0], 3);
+  rpa.address[5] = x[0];
+  rpa.address[4] = x[1];
+  rpa.address[3] = x[2];
+  return rpa;
+}
+
+FakeRecord* resolve_linear(std::vector<FakeRecord>& records,
+                           const RawAddress& rpa) {
+  for (FakeRecord& record : records)
+    if (rpa_matches_irk(rpa, record.irk)) return &record;
+  return nullptr;
+}
+
+// Same computation as btm_ble_match_random_bda in btm_ble_addr.cc.
+FakeRecord* resolve_batched(std::vector<FakeRecord>& records,
+                            const RawAddress& rpa) {
+  const size_t batch = 16;
+  Octet16 prand{0};
+  prand[0] = rpa.address[2];
+  prand[1] = rpa.address[1];
+  prand[2] = rpa.address[0];
+  uint8_t hash[3] = {rpa.address[5], rpa.address[4], rpa.address[3]};
+
+  Octet16 irks[batch], messages[batch], results[batch];
+  for (Octet16& message : messages) message = prand;
+  for (size_t first = 0; first < records.size(); first += batch) {
+    size_t n = std::min(records.size() - first, batch);
+    for (size_t i = 0; i < n; i++) irks[i] = records[first + i].irk;
+    crypto_toolbox::aes_128_batch(irks, messages, results, n);
+    for (size_t i = 0; i < n; i++)
+      if (memcmp(results[i].data(), hash, 3) == 0) return &records[first + i];
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+class BM_RpaResolution : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    records_.resize(NUM_IRKS);
+    for (int i = 0; i < NUM_IRKS; i++)
+      for (size_t j = 0; j < records_[i].irk.size(); j++)
+        records_[i].irk[j] = static_cast<uint8_t>(i * 31 + j * 7 + 1);
+
+    // Resolvable RPAs from unknown devices are produced with an IRK that is
+    // not in |records_|.
+    Octet16 unknown_irk;
+    unknown_irk.fill(0xee);
+    rpas_.clear();
+    for (int i = 0; i < NUM_RPAS; i++) {
+      const Octet16& irk = (i % BONDED_RPA_RATIO == 0)
+                               ? records_[(i * 7) % NUM_IRKS].irk
+                               : unknown_irk;
+      rpas_.push_back(rpa_from_irk(irk, i * 2654435761u));
+    }
+  }
+
+  void TearDown(State& st) override {
+    records_.clear();
+    rpas_.clear();
+    benchmark::Fixture::TearDown(st);
+  }
+
+  size_t resolve_all_cached(RpaCache<FakeRecord>& cache, uint64_t now_ms) {
+    size_t resolved = 0;
+    for (const RawAddress& rpa : rpas_) {
+      FakeRecord* record = nullptr;
+      switch (cache.Lookup(rpa, now_ms, &record)) {
+        case RpaCache<FakeRecord>::RESOLVED:
+          resolved++;
+          break;
+        case RpaCache<FakeRecord>::UNRESOLVABLE:
+          break;
+        case RpaCache<FakeRecord>::MISS:
+          record = resolve_linear(records_, rpa);
+          if (record) {
+            cache.AddResolved(rpa, record, now_ms);
+            resolved++;
+          } else {
+            cache.AddUnresolvable(rpa, now_ms);
+          }
+          break;
+      }
+    }
+    return resolved;
+  }
+
+  std::vector<FakeRecord> records_;
+  std::vector<RawAddress> rpas_;
+};
+
+// What every advertising report cost before: one AES per bonded IRK until a
+// match, i.e. NUM_IRKS for each unknown device.
+BENCHMARK_F(BM_RpaResolution, linear_scan)(State& state) {
+  size_t resolved = 0;
+  for (auto _ : state) {
+    resolved = 0;
+    for (const RawAddress& rpa : rpas_)
+      if (resolve_linear(records_, rpa)) resolved++;
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_RPAS);
+  state.counters["resolved"] = resolved;
+}
+
+// The same scan, trying the IRKs in batches.
+BENCHMARK_F(BM_RpaResolution, linear_scan_batched)(State& state) {
+  size_t resolved = 0;
+  for (auto _ : state) {
+    resolved = 0;
+    for (const RawAddress& rpa : rpas_)
+      if (resolve_batched(records_, rpa)) resolved++;
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_RPAS);
+  state.counters["resolved"] = resolved;
+}
+
+// First sighting of every RPA: linear scan plus cache insertion.
+BENCHMARK_F(BM_RpaResolution, cached_cold)(State& state) {
+  RpaCache<FakeRecord> cache(BTM_RPA_CACHE_SIZE, NUM_RPAS);
+  size_t resolved = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    cache.Clear();
+    state.ResumeTiming();
+    resolved = resolve_all_cached(cache, 0);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_RPAS);
+  state.counters["resolved"] = resolved;
+}
+
+// Repeated advertising reports from the same devices within one RPA rotation
+// interval, the common case while scanning. Uses the default cache sizes.
+BENCHMARK_F(BM_RpaResolution, cached_warm)(State& state) {
+  RpaCache<FakeRecord> cache;
+  resolve_all_cached(cache, 0);
+  size_t resolved = 0;
+  for (auto _ : state) resolved = resolve_all_cached(cache, 1);
+  state.SetItemsProcessed(state.iterations() * NUM_RPAS);
+  state.counters["resolved"] = resolved;
+  state.counters["hits"] = cache.hits();
+  state.counters["negative_hits"] = cache.negative_hits();
+  state.counters["misses"] = cache.misses();
+}
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
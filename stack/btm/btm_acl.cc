@@ -153,17 +153,23 @@ tACL_CONN* btm_bda_to_acl(const RawAddress& bda, tBT_TRANSPORT transport) {
  * Function         btm_handle_to_acl_index
  *
  * Description      This function returns the FIRST acl_db entry for the passed
- *                  hci_handle.
+ *                  hci_handle. The entry last found for the handle, in
+ *                  btm_handle_table, is tried first.
  *
  * Returns          index to the acl_db or MAX_L2CAP_LINKS.
  *
  ******************************************************************************/
 uint8_t btm_handle_to_acl_index(uint16_t hci_handle) {
-  tACL_CONN* p = &btm_cb.acl_db[0];
-  uint8_t xx;
-  BTM_TRACE_DEBUG("btm_handle_to_acl_index");
-  for (xx = 0; xx < MAX_L2CAP_LINKS; xx++, p++) {
+  tACL_CONN* p;
+  uint8_t xx = btm_handle_table.Get(hci_handle).acl;
+  if (xx < MAX_L2CAP_LINKS) {
+    p = &btm_cb.acl_db[xx];
+    if ((p->in_use) && (p->hci_handle == hci_handle)) return (xx);
+  }
+
+  for (xx = 0, p = &btm_cb.acl_db[0]; xx < MAX_L2CAP_LINKS; xx++, p++) {
     if ((p->in_use) && (p->hci_handle == hci_handle)) {
+      btm_handle_table.SetAcl(hci_handle, xx);
       break;
     }
   }
@@ -248,6 +254,7 @@ void btm_acl_created(const RawAddress& bda, DEV_CLASS dc, BD_NAME bdn,
     p->hci_handle = hci_handle;
     p->link_role = link_role;
     p->transport = transport;
+    btm_handle_table.SetAcl(hci_handle, p - btm_cb.acl_db);
     VLOG(1) << "Duplicate btm_acl_created: RemBdAddr: " << bda;
     uint16_t btm_def_link_policy_local = btm_cb.btm_def_link_policy;
     BTM_SetLinkPolicy(p->remote_addr, &btm_def_link_policy_local);
@@ -259,6 +266,7 @@ void btm_acl_created(const RawAddress& bda, DEV_CLASS dc, BD_NAME bdn,
     if (!p->in_use) {
       p->in_use = true;
       p->hci_handle = hci_handle;
+      btm_handle_table.SetAcl(hci_handle, xx);
       p->link_role = link_role;
       p->link_up_issued = false;
       p->remote_addr = bda;
@@ -411,6 +419,7 @@ void btm_acl_removed(const RawAddress& bda, tBT_TRANSPORT transport) {
   p = btm_bda_to_acl(bda, transport);
   if (p != (tACL_CONN*)NULL) {
     p->in_use = false;
+    btm_handle_table.ForgetAcl(p->hci_handle, p - btm_cb.acl_db);
 
     /* if the disconnected channel has a pending role switch, clear it now */
     btm_acl_report_role_change(HCI_ERR_NO_CONNECTION, &bda);
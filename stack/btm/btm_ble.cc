@@ -1433,6 +1433,7 @@ void btm_sec_save_le_key(const RawAddress& bd_addr, tBTM_LE_KEY_TYPE key_type,
         p_rec->ble.identity_addr = p_keys->pid_key.identity_addr;
         p_rec->ble.identity_addr_type = p_keys->pid_key.identity_addr_type;
         p_rec->ble.key_type |= BTM_LE_KEY_PID;
+        btm_ble_rpa_cache_update_dev(p_rec);
         BTM_TRACE_DEBUG(
             "%s: BTM_LE_KEY_PID key_type=0x%x save peer IRK, change bd_addr=%s "
             "to id_addr=%s id_addr_type=0x%x",
@@ -2027,6 +2028,7 @@ void btm_ble_connected(const RawAddress& bda, uint16_t handle, uint8_t enc_mode,
   /* update device information */
   p_dev_rec->device_type |= BT_DEVICE_TYPE_BLE;
   p_dev_rec->ble_hci_handle = handle;
+  btm_handle_table.SetDevRec(handle, p_dev_rec);
   p_dev_rec->ble.ble_addr_type = addr_type;
   /* update pseudo address */
   p_dev_rec->ble.pseudo_addr = bda;
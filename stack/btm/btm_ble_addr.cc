@@ -33,8 +33,14 @@
 #include "hcimsgs.h"
 
 #include "btm_ble_int.h"
+#include "btm_rpa_cache.h"
+#include "osi/include/time.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
+/* Outcome of previous btm_ble_resolve_random_addr calls. Only used on the btu
+ * thread. */
+static RpaCache<tBTM_SEC_DEV_REC> rpa_cache;
+
 /* This function generates Resolvable Private Address (RPA) from Identity
  * Resolving Key |irk| and |random|*/
 RawAddress generate_rpa_from_irk_and_rand(const Octet16& irk,
@@ -224,33 +230,59 @@ bool btm_ble_addr_resolvable(const RawAddress& rpa,
   return false;
 }
 
-/** This function match the random address to the appointed device record,
- * starting from calculating IRK. If the record index exceeds the maximum record
- * number, matching failed and send a callback. */
-static bool btm_ble_match_random_bda(void* data, void* context) {
-  RawAddress* random_bda = (RawAddress*)context;
-
-  tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
-
-
-  if (!(p_dev_rec->device_type & BT_DEVICE_TYPE_BLE) ||
-      !(p_dev_rec->ble.key_type & BTM_LE_KEY_PID)) {
-    BTM_TRACE_EVENT("%s not a LE paired device ,sec_flags = %02x device_type = %d", __func__,
-                  p_dev_rec->sec_flags, p_dev_rec->device_type);
-    return true;
-  }
+/* Number of IRKs tried per crypto_toolbox::aes_128_batch call when resolving
+ * a random address. */
+#define BTM_BLE_RESOLVE_BATCH 16
+
+/** This function matches the random address against the IRK of every LE
+ * device record in list order, and returns the first record that matches or
+ * nullptr. The IRKs are tried in batches so that hardware AES backends can
+ * pipeline them. */
+static tBTM_SEC_DEV_REC* btm_ble_match_random_bda(
+    const RawAddress& random_bda) {
+  /* prand is the 3 MSB of the address, the hash the 3 LSB */
+  Octet16 prand{0};
+  prand[0] = random_bda.address[2];
+  prand[1] = random_bda.address[1];
+  prand[2] = random_bda.address[0];
+  uint8_t hash[3] = {random_bda.address[5], random_bda.address[4],
+                     random_bda.address[3]};
+
+  Octet16 irks[BTM_BLE_RESOLVE_BATCH];
+  Octet16 messages[BTM_BLE_RESOLVE_BATCH];
+  Octet16 results[BTM_BLE_RESOLVE_BATCH];
+  tBTM_SEC_DEV_REC* candidates[BTM_BLE_RESOLVE_BATCH];
+  for (Octet16& message : messages) message = prand;
+
+  size_t n = 0;
+  list_node_t* node = list_begin(btm_cb.sec_dev_rec);
+  while (true) {
+    bool done = (node == list_end(btm_cb.sec_dev_rec));
+    if (!done) {
+      tBTM_SEC_DEV_REC* p_dev_rec =
+          static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+      node = list_next(node);
+      if (!(p_dev_rec->device_type & BT_DEVICE_TYPE_BLE) ||
+          !(p_dev_rec->ble.key_type & BTM_LE_KEY_PID))
+        continue;
+
+      candidates[n] = p_dev_rec;
+      irks[n] = p_dev_rec->ble.keys.irk;
+      if (++n < BTM_BLE_RESOLVE_BATCH) continue;
+    }
 
-  if (rpa_matches_irk(*random_bda, p_dev_rec->ble.keys.irk)) {
-    BTM_TRACE_EVENT("%s match is found ,sec_flags = %02x device_type = %d", __func__,
-                  p_dev_rec->sec_flags, p_dev_rec->device_type);
-    // if it was match, finish iteration, otherwise continue
-    return false;
+    crypto_toolbox::aes_128_batch(irks, messages, results, n);
+    for (size_t i = 0; i < n; i++) {
+      if (memcmp(results[i].data(), hash, sizeof(hash)) == 0) {
+        BTM_TRACE_EVENT("%s match is found ,sec_flags = %02x device_type = %d",
+                        __func__, candidates[i]->sec_flags,
+                        candidates[i]->device_type);
+        return candidates[i];
+      }
+    }
+    if (done) return nullptr;
+    n = 0;
   }
-
-  // not a match, continue iteration
-  BTM_TRACE_DEBUG("%s next iteration ,sec_flags = %02x device_type = %d", __func__,
-                  p_dev_rec->sec_flags, p_dev_rec->device_type);
-  return true;
 }
 
 /** This function is called to resolve a random address.
@@ -260,19 +292,53 @@ static bool btm_ble_match_random_bda(void* data, void* context) {
 tBTM_SEC_DEV_REC* btm_ble_resolve_random_addr(const RawAddress& random_bda) {
   BTM_TRACE_EVENT("%s", __func__);
 
+  tBTM_SEC_DEV_REC* p_dev_rec = nullptr;
+  uint64_t now_ms = time_get_os_boottime_ms();
+  switch (rpa_cache.Lookup(random_bda, now_ms, &p_dev_rec)) {
+    case RpaCache<tBTM_SEC_DEV_REC>::RESOLVED:
+      /* Records drop out of the cache when their keys are cleared, but check
+       * anyway rather than hand out a record that can no longer match. */
+      if ((p_dev_rec->device_type & BT_DEVICE_TYPE_BLE) &&
+          (p_dev_rec->ble.key_type & BTM_LE_KEY_PID))
+        return p_dev_rec;
+      rpa_cache.RemoveRecord(p_dev_rec);
+      p_dev_rec = nullptr;
+      break;
+    case RpaCache<tBTM_SEC_DEV_REC>::UNRESOLVABLE:
+      return nullptr;
+    case RpaCache<tBTM_SEC_DEV_REC>::MISS:
+      break;
+  }
+
   /* start to resolve random address */
   /* check for next security record */
 
-  list_node_t* n = list_foreach(btm_cb.sec_dev_rec, btm_ble_match_random_bda,
-                                (void*)&random_bda);
-  tBTM_SEC_DEV_REC* p_dev_rec = nullptr;
-  if (n != nullptr) p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+  p_dev_rec = btm_ble_match_random_bda(random_bda);
+
+  if (p_dev_rec != nullptr)
+    rpa_cache.AddResolved(random_bda, p_dev_rec, now_ms);
+  else
+    rpa_cache.AddUnresolvable(random_bda, now_ms);
 
   BTM_TRACE_EVENT("%s:  %sresolved", __func__,
                   (p_dev_rec == nullptr ? "not " : ""));
   return p_dev_rec;
 }
 
+/** Must be called before |p_dev_rec| is freed or its keys are cleared. */
+void btm_ble_rpa_cache_remove_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
+  rpa_cache.RemoveRecord(p_dev_rec);
+}
+
+/** Must be called when the IRK of |p_dev_rec| is set or replaced. */
+void btm_ble_rpa_cache_update_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
+  rpa_cache.RemoveRecord(p_dev_rec);
+  /* addresses that did not resolve before might match the new IRK */
+  rpa_cache.ClearUnresolvable();
+}
+
+void btm_ble_rpa_cache_clear(void) { rpa_cache.Clear(); }
+
 /*******************************************************************************
  *  address mapping between pseudo address and real connection address
  ******************************************************************************/
@@ -0,0 +1,260 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "raw_address.h"
+
+/* Number of devices whose advertising data can be waiting for a scan response
+ * or for chained extended advertising fragments at the same time. */
+#ifndef BTM_BLE_ADV_CACHE_SIZE
+#define BTM_BLE_ADV_CACHE_SIZE 128
+#endif
+
+/* Partial data older than this is dropped rather than completed. Scan
+ * responses and AUX_CHAIN_IND fragments follow within milliseconds, so this
+ * only has to cover a scan window missing the rest of the data. */
+#ifndef BTM_BLE_ADV_CACHE_TIMEOUT_MS
+#define BTM_BLE_ADV_CACHE_TIMEOUT_MS 5000
+#endif
+
+/* Bytes preallocated per cache entry: legacy advertising data plus its scan
+ * response. Entries that had to grow for extended advertising keep their
+ * capacity when reused. */
+#ifndef BTM_BLE_ADV_CACHE_DATA_RESERVE
+#define BTM_BLE_ADV_CACHE_DATA_RESERVE 62
+#endif
+
+/* Holds the advertising data of devices that are waiting for either a scan
+ * response or chained packets on the secondary channel.
+ *
+ * Entries are found through an open addressing hash table and evicted in least
+ * recently updated order. All storage is allocated up front, so that
+ * processing an advertising report does not allocate. Not thread safe; only
+ * used on the btu thread. */
+class AdvertisingCache {
+ public:
+  explicit AdvertisingCache(size_t capacity = BTM_BLE_ADV_CACHE_SIZE,
+                            uint64_t timeout_ms = BTM_BLE_ADV_CACHE_TIMEOUT_MS)
+      : entries_(capacity), timeout_ms_(timeout_ms) {
+    size_t buckets = 1;
+    while (buckets < capacity * 2) buckets <<= 1;
+    buckets_.assign(buckets, kNone);
+    mask_ = buckets - 1;
+
+    for (size_t i = 0; i < capacity; i++) {
+      entries_[i].data.reserve(BTM_BLE_ADV_CACHE_DATA_RESERVE);
+      entries_[i].next = (i + 1 < capacity) ? i + 1 : kNone;
+    }
+    free_ = capacity > 0 ? 0 : kNone;
+  }
+
+  AdvertisingCache(const AdvertisingCache&) = delete;
+  AdvertisingCache& operator=(const AdvertisingCache&) = delete;
+
+  /* Set the data to |data| for device |addr_type, addr|. The returned
+   * reference is valid until the next call that modifies the cache. */
+  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
+                                  const uint8_t* data, size_t len,
+                                  uint64_t now_ms) {
+    Entry& entry = Lookup(addr_type, addr, now_ms);
+    entry.data.assign(data, data + len);
+    return entry.data;
+  }
+
+  /* Append |data| for device |addr_type, addr| */
+  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
+                                     const uint8_t* data, size_t len,
+                                     uint64_t now_ms) {
+    Entry& entry = Lookup(addr_type, addr, now_ms);
+    entry.data.insert(entry.data.end(), data, data + len);
+    return entry.data;
+  }
+
+  /* Clear data for device |addr_type, addr| */
+  void Clear(uint8_t addr_type, const RawAddress& addr) {
+    size_t bucket = Find(Key(addr_type, addr));
+    if (bucket != kNone) Remove(bucket);
+  }
+
+  void ClearAll() {
+    while (head_ != kNone) Remove(Find(entries_[head_].key));
+  }
+
+  size_t Size() const { return size_; }
+  size_t Capacity() const { return entries_.size(); }
+
+  /* Reports continuing the data of a cached device. */
+  size_t hits() const { return hits_; }
+  /* Reports starting a new entry. */
+  size_t misses() const { return misses_; }
+  /* Entries dropped to make room before their data was complete. */
+  size_t evictions() const { return evictions_; }
+  /* Entries dropped because their data did not complete in time. */
+  size_t timeouts() const { return timeouts_; }
+
+ private:
+  static constexpr size_t kNone = SIZE_MAX;
+
+  struct Entry {
+    uint64_t key = 0;
+    uint64_t time_ms = 0;
+    std::vector<uint8_t> data;
+    /* neighbours in the recency list, or the next free entry */
+    size_t prev = kNone;
+    size_t next = kNone;
+  };
+
+  static uint64_t Key(uint8_t addr_type, const RawAddress& addr) {
+    uint64_t key = addr_type;
+    for (size_t i = 0; i < RawAddress::kLength; i++)
+      key = (key << 8) | addr.address[i];
+    return key;
+  }
+
+  size_t Home(uint64_t key) const {
+    /* Fibonacci hashing; the low bits of addresses are not well distributed
+     * for static random and public addresses from the same vendor. */
+    return ((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask_;
+  }
+
+  /* Returns the bucket holding |key|, or kNone. */
+  size_t Find(uint64_t key) const {
+    for (size_t b = Home(key); buckets_[b] != kNone; b = (b + 1) & mask_)
+      if (entries_[buckets_[b]].key == key) return b;
+    return kNone;
+  }
+
+  /* Returns the entry for the device, creating an empty one if it is not
+   * cached or its data is too old to be completed. The entry becomes the most
+   * recently updated one. */
+  Entry& Lookup(uint8_t addr_type, const RawAddress& addr, uint64_t now_ms) {
+    uint64_t key = Key(addr_type, addr);
+    size_t bucket = Find(key);
+    if (bucket != kNone) {
+      size_t index = buckets_[bucket];
+      if (now_ms - entries_[index].time_ms < timeout_ms_) {
+        hits_++;
+        Unlink(index);
+        PushFront(index);
+        entries_[index].time_ms = now_ms;
+        return entries_[index];
+      }
+      timeouts_++;
+      Remove(bucket);
+    }
+
+    misses_++;
+    if (free_ == kNone) {
+      /* make room: stale entries go first, then the least recently updated */
+      ExpireStale(now_ms);
+      if (free_ == kNone) {
+        evictions_++;
+        Remove(Find(entries_[tail_].key));
+      }
+    }
+
+    size_t index = free_;
+    free_ = entries_[index].next;
+    Entry& entry = entries_[index];
+    entry.key = key;
+    entry.time_ms = now_ms;
+    entry.data.clear();
+    PushFront(index);
+    size_++;
+
+    bucket = Home(key);
+    while (buckets_[bucket] != kNone) bucket = (bucket + 1) & mask_;
+    buckets_[bucket] = index;
+    return entry;
+  }
+
+  void ExpireStale(uint64_t now_ms) {
+    while (tail_ != kNone && now_ms - entries_[tail_].time_ms >= timeout_ms_) {
+      timeouts_++;
+      Remove(Find(entries_[tail_].key));
+    }
+  }
+
+  /* Frees the entry in |bucket|, keeping its data buffer for reuse. */
+  void Remove(size_t bucket) {
+    size_t index = buckets_[bucket];
+    Unlink(index);
+    entries_[index].data.clear();
+    entries_[index].next = free_;
+    free_ = index;
+    size_--;
+
+    /* backward shift deletion, so that lookups need no tombstones */
+    size_t hole = bucket;
+    for (size_t b = (bucket + 1) & mask_; buckets_[b] != kNone;
+         b = (b + 1) & mask_) {
+      size_t home = Home(entries_[buckets_[b]].key);
+      /* the entry can fill the hole unless its home lies in (hole, b] */
+      bool stays = (hole < b) ? (home > hole && home <= b)
+                              : (home > hole || home <= b);
+      if (stays) continue;
+      buckets_[hole] = buckets_[b];
+      hole = b;
+    }
+    buckets_[hole] = kNone;
+  }
+
+  void PushFront(size_t index) {
+    entries_[index].prev = kNone;
+    entries_[index].next = head_;
+    if (head_ != kNone) entries_[head_].prev = index;
+    head_ = index;
+    if (tail_ == kNone) tail_ = index;
+  }
+
+  void Unlink(size_t index) {
+    Entry& entry = entries_[index];
+    if (entry.prev != kNone)
+      entries_[entry.prev].next = entry.next;
+    else
+      head_ = entry.next;
+    if (entry.next != kNone)
+      entries_[entry.next].prev = entry.prev;
+    else
+      tail_ = entry.prev;
+    entry.prev = entry.next = kNone;
+  }
+
+  std::vector<Entry> entries_;
+  /* entry index per bucket, or kNone */
+  std::vector<size_t> buckets_;
+  size_t mask_ = 0;
+  const uint64_t timeout_ms_;
+
+  /* most and least recently updated entries */
+  size_t head_ = kNone;
+  size_t tail_ = kNone;
+  size_t free_ = kNone;
+  size_t size_ = 0;
+
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  size_t evictions_ = 0;
+  size_t timeouts_ = 0;
+};
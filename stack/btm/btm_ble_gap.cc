@@ -30,7 +30,6 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
-#include <list>
 #include <vector>
 
 #include "bt_types.h"
@@ -46,6 +45,7 @@
 #include "osi/include/time.h"
 
 #include "advertise_data_parser.h"
+#include "btm_ble_adv_cache.h"
 #include "btm_ble_int.h"
 #include "gatt_int.h"
 #include "gattdefs.h"
@@ -69,74 +69,6 @@
 
 namespace {
 
-class AdvertisingCache {
- public:
-  /* Set the data to |data| for device |addr_type, addr| */
-  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
-                                  std::vector<uint8_t> data) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      it->data = std::move(data);
-      return it->data;
-    }
-
-    if (items.size() > cache_max) {
-      items.pop_back();
-    }
-
-    items.emplace_front(addr_type, addr, std::move(data));
-    return items.front().data;
-  }
-
-  /* Append |data| for device |addr_type, addr| */
-  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
-                                     std::vector<uint8_t> data) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      it->data.insert(it->data.end(), data.begin(), data.end());
-      return it->data;
-    }
-
-    if (items.size() > cache_max) {
-      items.pop_back();
-    }
-
-    items.emplace_front(addr_type, addr, std::move(data));
-    return items.front().data;
-  }
-
-  /* Clear data for device |addr_type, addr| */
-  void Clear(uint8_t addr_type, const RawAddress& addr) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      items.erase(it);
-    }
-  }
-
- private:
-  struct Item {
-    uint8_t addr_type;
-    RawAddress addr;
-    std::vector<uint8_t> data;
-
-    Item(uint8_t addr_type, const RawAddress& addr, std::vector<uint8_t> data)
-        : addr_type(addr_type), addr(addr), data(data) {}
-  };
-
-  std::list<Item>::iterator Find(uint8_t addr_type, const RawAddress& addr) {
-    for (auto it = items.begin(); it != items.end(); it++) {
-      if (it->addr_type == addr_type && it->addr == addr) {
-        return it;
-      }
-    }
-    return items.end();
-  }
-
-  /* we keep maximum 7 devices in the cache */
-  const size_t cache_max = 7;
-  std::list<Item> items;
-};
-
 /* Devices in this cache are waiting for eiter scan response, or chained packets
  * on secondary channel */
 AdvertisingCache cache;
@@ -2638,7 +2570,7 @@ void btm_clear_all_pending_le_entry(void) {
     if ((p_ent->in_use) &&
         (p_ent->inq_info.results.device_type == BT_DEVICE_TYPE_BLE) &&
         !p_ent->scan_rsp)
-      p_ent->in_use = false;
+      btm_inq_db_remove(p_ent);
   }
 }
 
@@ -2821,24 +2753,23 @@ static void btm_ble_process_adv_pkt_cont(
   tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
   bool update = true;
 
-  std::vector<uint8_t> tmp;
-  if (data_len != 0) tmp.insert(tmp.begin(), data, data + data_len);
-
   bool is_scannable = ble_evt_type_is_scannable(evt_type);
   bool is_scan_resp = ble_evt_type_is_scan_resp(evt_type);
 
   bool is_start =
       ble_evt_type_is_legacy(evt_type) && is_scannable && !is_scan_resp;
 
+  size_t len = data_len;
   if (ble_evt_type_is_legacy(evt_type))
-    AdvertiseDataParser::RemoveTrailingZeros(tmp);
+    len = AdvertiseDataParser::LengthWithoutTrailingZeros(data, data_len);
 
   // We might have send scan request to this device before, but didn't get the
   // response. In such case make sure data is put at start, not appended to
   // already existing data.
+  uint64_t now_ms = time_get_os_boottime_ms();
   std::vector<uint8_t> const& adv_data =
-      is_start ? cache.Set(addr_type, bda, std::move(tmp))
-               : cache.Append(addr_type, bda, std::move(tmp));
+      is_start ? cache.Set(addr_type, bda, data, len, now_ms)
+               : cache.Append(addr_type, bda, data, len, now_ms);
 
   bool data_complete = (ble_evt_type_data_status(evt_type) != 0x01);
 
@@ -2902,7 +2833,7 @@ static void btm_ble_process_adv_pkt_cont(
     p_inq->inq_cmpl_info.num_resp++;
   }
 
-  p_i->time_of_resp = time_get_os_boottime_ms();
+  btm_inq_db_touch(p_i, now_ms);
 
   /* update the LE device information in inquiry database */
   btm_ble_update_inq_result(p_i, addr_type, bda, evt_type, primary_phy,
@@ -2958,6 +2889,25 @@ static void btm_ble_process_adv_pkt_cont(
   cache.Clear(addr_type, bda);
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_ble_adv_cache_dump
+ *
+ * Description      Dump the state of the cache holding advertising data that
+ *                  waits for a scan response or chained fragments.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_ble_adv_cache_dump(int fd) {
+  dprintf(fd, "\nLE advertising data cache:\n");
+  dprintf(fd, "  Devices waiting: %zu / %zu\n", cache.Size(),
+          cache.Capacity());
+  dprintf(fd, "  Hits: %zu  Misses: %zu\n", cache.hits(), cache.misses());
+  dprintf(fd, "  Evicted incomplete: %zu  Timed out: %zu\n",
+          cache.evictions(), cache.timeouts());
+}
+
 void btm_ble_process_phy_update_pkt(uint8_t len, uint8_t* data) {
   uint8_t status, tx_phy, rx_phy;
   uint16_t handle;
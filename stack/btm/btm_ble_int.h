@@ -146,6 +146,9 @@ extern void btm_gen_non_resolvable_private_addr(tBTM_BLE_ADDR_CBACK* p_cback,
                                                 void* p);
 extern tBTM_SEC_DEV_REC* btm_ble_resolve_random_addr(
     const RawAddress& random_bda);
+extern void btm_ble_rpa_cache_remove_dev(tBTM_SEC_DEV_REC* p_dev_rec);
+extern void btm_ble_rpa_cache_update_dev(tBTM_SEC_DEV_REC* p_dev_rec);
+extern void btm_ble_rpa_cache_clear(void);
 extern void btm_gen_resolve_paddr_low(const RawAddress& address);
 extern uint64_t btm_get_next_private_addrress_interval_ms();
 
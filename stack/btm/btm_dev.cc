@@ -62,6 +62,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <unordered_map>
+
 #include "bt_common.h"
 #include "bt_types.h"
 #include "btm_api.h"
@@ -73,6 +75,17 @@
 #include "l2c_api.h"
 #include "btif_util.h"
 #include "btif_storage.h"
+#include "btm_rpa_cache.h"
+
+/* Hints for btm_find_dev, keyed by BD address (bd_addr or ble.pseudo_addr);
+ * btm_find_dev_by_handle uses btm_handle_table the same way. Records are
+ * updated in place throughout the stack, so an entry is only trusted after
+ * checking that the record still carries the address or handle; otherwise the
+ * list is scanned and the entry refreshed. Records must be dropped with
+ * btm_dev_index_remove before they are freed. */
+static std::unordered_map<uint64_t, tBTM_SEC_DEV_REC*> dev_addr_index;
+
+static void btm_dev_index_remove(tBTM_SEC_DEV_REC* p_dev_rec);
 
 /*******************************************************************************
  *
@@ -359,6 +372,7 @@ void btm_sec_free_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
 
   /* Clear out any saved BLE keys */
   btm_sec_clear_ble_keys(p_dev_rec);
+  btm_dev_index_remove(p_dev_rec);
   list_remove(btm_cb.sec_dev_rec, p_dev_rec);
 }
 
@@ -410,6 +424,40 @@ bool btm_dev_support_switch(const RawAddress& bd_addr) {
   return (false);
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_dev_index_remove
+ *
+ * Description      Drop |p_dev_rec| from the address and handle indices and
+ *                  from the RPA cache. Must be called before the record is
+ *                  removed from btm_cb.sec_dev_rec, which frees it.
+ *
+ ******************************************************************************/
+static void btm_dev_index_remove(tBTM_SEC_DEV_REC* p_dev_rec) {
+  for (auto it = dev_addr_index.begin(); it != dev_addr_index.end();) {
+    if (it->second == p_dev_rec)
+      it = dev_addr_index.erase(it);
+    else
+      ++it;
+  }
+  btm_handle_table.ForgetDevRec(p_dev_rec);
+  btm_ble_rpa_cache_remove_dev(p_dev_rec);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_dev_index_clear
+ *
+ * Description      Forget every record and handle. Called when the device
+ *                  database is freed.
+ *
+ ******************************************************************************/
+void btm_dev_index_clear(void) {
+  dev_addr_index.clear();
+  btm_handle_table.Clear();
+  btm_ble_rpa_cache_clear();
+}
+
 bool is_handle_equal(void* data, void* context) {
   tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
   uint16_t* handle = static_cast<uint16_t*>(context);
@@ -431,22 +479,25 @@ bool is_handle_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle) {
-  list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_handle_equal, &handle);
-  if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_handle_table.Get(handle).p_dev_rec;
+  if (p_dev_rec != NULL &&
+      (p_dev_rec->hci_handle == handle || p_dev_rec->ble_hci_handle == handle))
+    return p_dev_rec;
 
-  return NULL;
+  list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_handle_equal, &handle);
+  p_dev_rec = n ? static_cast<tBTM_SEC_DEV_REC*>(list_node(n)) : NULL;
+  btm_handle_table.SetDevRec(handle, p_dev_rec);
+  return p_dev_rec;
 }
 
 bool is_address_equal(void* data, void* context) {
   tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
   const RawAddress* bd_addr = ((RawAddress*)context);
 
-  if (*bd_addr == RawAddress::kEmpty) return true;
   if (p_dev_rec->bd_addr == *bd_addr) return false;
   // If a LE random address is looking for device record
   if (p_dev_rec->ble.pseudo_addr == *bd_addr) return false;
 
-  if (btm_ble_addr_resolvable(*bd_addr, p_dev_rec)) return false;
   return true;
 }
 
@@ -461,11 +512,32 @@ bool is_address_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev(const RawAddress& bd_addr) {
+  if (bd_addr.IsEmpty()) return NULL;
+
+  uint64_t key = btm_rpa_cache_key(bd_addr);
+  auto it = dev_addr_index.find(key);
+  if (it != dev_addr_index.end()) {
+    tBTM_SEC_DEV_REC* p_dev_rec = it->second;
+    if (p_dev_rec->bd_addr == bd_addr || p_dev_rec->ble.pseudo_addr == bd_addr)
+      return p_dev_rec;
+    dev_addr_index.erase(it);
+  }
+
   list_node_t* n =
       list_foreach(btm_cb.sec_dev_rec, is_address_equal, (void*)&bd_addr);
-  if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+  if (n) {
+    tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+    dev_addr_index[key] = p_dev_rec;
+    return p_dev_rec;
+  }
+
+  /* Not a known address; try the bonded IRKs. The result is cached per RPA,
+   * so this costs at most one AES-128 per LE bonded device per RPA. */
+  if (!BTM_BLE_IS_RESOLVE_BDA(bd_addr)) return NULL;
 
-  return NULL;
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_ble_resolve_random_addr(bd_addr);
+  if (p_dev_rec) btm_ble_init_pseudo_addr(p_dev_rec, bd_addr);
+  return p_dev_rec;
 }
 
 /*******************************************************************************
@@ -508,6 +580,7 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
       p_target_rec->bond_type = temp_rec.bond_type;
 
       /* remove the combined record */
+      btm_dev_index_remove(p_dev_rec);
       list_remove(btm_cb.sec_dev_rec, p_dev_rec);
       //p_dev_rec gets freed in list_remove, we should not  access it further
       continue;
@@ -520,6 +593,7 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
         p_target_rec->device_type |= p_dev_rec->device_type;
 
         /* remove the combined record */
+        btm_dev_index_remove(p_dev_rec);
         list_remove(btm_cb.sec_dev_rec, p_dev_rec);
       }
     }
@@ -609,6 +683,7 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
 
   if (list_length(btm_cb.sec_dev_rec) > BTM_SEC_MAX_DEVICE_RECORDS) {
     p_dev_rec = btm_find_oldest_dev_rec();
+    btm_dev_index_remove(p_dev_rec);
     list_remove(btm_cb.sec_dev_rec, p_dev_rec);
   }
 
@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* What each HCI connection handle maps to in the stack: its L2CAP link, its
+ * ACL connection, its security record and its SCO connection. Handles are 12
+ * bits, so this is a flat array indexed by the handle, and looking a packet's
+ * link up costs the same however many links are up.
+ *
+ * Entries are set when a connection completes and forgotten when it goes
+ * away. Handles and records are still updated in place in many places of the
+ * stack, so an entry is only a hint: callers check that the slot it names
+ * still carries the handle, and look the handle up the slow way (then set
+ * the entry) if not. Not thread safe; only used on the btu thread. */
+template <typename DevRec>
+class BtmHandleTable {
+ public:
+  static constexpr size_t kSize = 0x1000;
+  static constexpr uint8_t kNone = 0xff;
+
+  struct Entry {
+    uint8_t lcb;  /* index in l2cb.lcb_pool */
+    uint8_t acl;  /* index in btm_cb.acl_db */
+    uint8_t sco;  /* index in btm_cb.sco_cb.sco_db */
+    DevRec* p_dev_rec;
+  };
+
+  BtmHandleTable() { Clear(); }
+
+  BtmHandleTable(const BtmHandleTable&) = delete;
+  BtmHandleTable& operator=(const BtmHandleTable&) = delete;
+
+  /* The entry for |handle|; the packet boundary and broadcast flags of an
+   * ACL header are ignored. */
+  const Entry& Get(uint16_t handle) const { return entries_[Slot(handle)]; }
+
+  void SetLcb(uint16_t handle, uint8_t lcb) {
+    entries_[Slot(handle)].lcb = lcb;
+  }
+  void SetAcl(uint16_t handle, uint8_t acl) {
+    entries_[Slot(handle)].acl = acl;
+  }
+  void SetSco(uint16_t handle, uint8_t sco) {
+    entries_[Slot(handle)].sco = sco;
+  }
+  void SetDevRec(uint16_t handle, DevRec* p_dev_rec) {
+    entries_[Slot(handle)].p_dev_rec = p_dev_rec;
+  }
+
+  /* Forget that |handle| maps to the given slot. The handle may have been
+   * given to another connection meanwhile, so an entry naming another slot
+   * is left alone. */
+  void ForgetLcb(uint16_t handle, uint8_t lcb) {
+    Forget(&entries_[Slot(handle)].lcb, lcb, kNone);
+  }
+  void ForgetAcl(uint16_t handle, uint8_t acl) {
+    Forget(&entries_[Slot(handle)].acl, acl, kNone);
+  }
+  void ForgetSco(uint16_t handle, uint8_t sco) {
+    Forget(&entries_[Slot(handle)].sco, sco, kNone);
+  }
+
+  /* Forget every handle mapping to |p_dev_rec|, which is about to be freed.
+   * Its handles may have changed since they were set, so all are looked at;
+   * records are not freed often. */
+  void ForgetDevRec(const DevRec* p_dev_rec) {
+    for (Entry& entry : entries_)
+      if (entry.p_dev_rec == p_dev_rec) entry.p_dev_rec = nullptr;
+  }
+
+  void Clear() {
+    for (Entry& entry : entries_) entry = {kNone, kNone, kNone, nullptr};
+  }
+
+ private:
+  static size_t Slot(uint16_t handle) { return handle & (kSize - 1); }
+
+  template <typename T>
+  static void Forget(T* field, T value, T none) {
+    if (*field == value) *field = none;
+  }
+
+  Entry entries_[kSize];
+};
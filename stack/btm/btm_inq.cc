@@ -31,6 +31,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "device/include/controller.h"
 #include "osi/include/osi.h"
 #include "osi/include/time.h"
@@ -39,6 +41,7 @@
 #include "bt_common.h"
 #include "bt_types.h"
 #include "btm_api.h"
+#include "btm_inq_db_index.h"
 #include "btm_int.h"
 #include "btu.h"
 #include "hcidefs.h"
@@ -57,6 +60,14 @@ using bluetooth::Uuid;
 /******************************************************************************/
 /*               L O C A L    D A T A    D E F I N I T I O N S                */
 /******************************************************************************/
+/* Address index and response order of btm_cb.btm_inq_vars.inq_db. Kept out
+ * of btm_cb, which is cleared with memset. */
+static InqDbIndex inq_db_index(BTM_INQ_DB_SIZE);
+
+/* Position in p_bd_db of each device (address and device type) seen during
+ * the current inquiry. */
+static std::unordered_map<uint64_t, uint16_t> inq_bd_index;
+
 static const LAP general_inq_lap = {0x9e, 0x8b, 0x33};
 static const LAP limited_inq_lap = {0x9e, 0x8b, 0x00};
 
@@ -1241,10 +1252,14 @@ void btm_inq_db_init(void) {
   btm_cb.btm_inq_vars.remote_name_timer =
       alarm_new("btm_inq.remote_name_timer");
   btm_cb.btm_inq_vars.no_inc_ssp = BTM_NO_SSP_ON_INQUIRY;
+  inq_db_index.Clear();
+  inq_bd_index.clear();
 }
 
 void btm_inq_db_free(void) {
   alarm_free(btm_cb.btm_inq_vars.remote_name_timer);
+  inq_db_index.Clear();
+  inq_bd_index.clear();
 }
 
 /*******************************************************************************
@@ -1317,13 +1332,12 @@ void btm_clr_inq_db(const RawAddress* p_bda) {
   BTM_TRACE_DEBUG("btm_clr_inq_db: inq_active:0x%x state:%d",
                   btm_cb.btm_inq_vars.inq_active, btm_cb.btm_inq_vars.state);
 #endif
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (p_ent->in_use) {
-      /* If this is the specified BD_ADDR or clearing all devices */
-      if (p_bda == NULL || (p_ent->inq_info.results.remote_bd_addr == *p_bda)) {
-        p_ent->in_use = false;
-      }
-    }
+  if (p_bda != NULL) {
+    p_ent = btm_inq_db_find(*p_bda);
+    if (p_ent != NULL) btm_inq_db_remove(p_ent);
+  } else {
+    for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) p_ent->in_use = false;
+    inq_db_index.Clear();
   }
 #if (BTM_INQ_DEBUG == TRUE)
   BTM_TRACE_DEBUG("inq_active:0x%x state:%d", btm_cb.btm_inq_vars.inq_active,
@@ -1347,6 +1361,7 @@ static void btm_clr_inq_result_flt(void) {
   osi_free_and_reset((void**)&p_inq->p_bd_db);
   p_inq->num_bd_entries = 0;
   p_inq->max_bd_entries = 0;
+  inq_bd_index.clear();
 }
 
 /*******************************************************************************
@@ -1361,24 +1376,33 @@ static void btm_clr_inq_result_flt(void) {
  ******************************************************************************/
 bool btm_inq_find_bdaddr(const RawAddress& p_bda, tBT_DEVICE_TYPE p_dev_type) {
   tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
-  tINQ_BDADDR* p_db = &p_inq->p_bd_db[0];
-  uint16_t xx;
+  tINQ_BDADDR* p_db;
+  uint64_t key = 0;
 
   /* Don't bother searching, database doesn't exist or periodic mode */
-  if ((p_inq->inq_active & BTM_PERIODIC_INQUIRY_ACTIVE) || !p_db)
+  if ((p_inq->inq_active & BTM_PERIODIC_INQUIRY_ACTIVE) || !p_inq->p_bd_db)
     return (false);
 
-  for (xx = 0; xx < p_inq->num_bd_entries; xx++, p_db++) {
-    if (p_db->bd_addr == p_bda && p_db->inq_count == p_inq->inq_counter &&
-        p_db->device_type == p_dev_type)
-      return (true);
+  for (size_t i = 0; i < RawAddress::kLength; i++)
+    key = (key << 8) | p_bda.address[i];
+  key = (key << 8) | p_dev_type;
+
+  auto it = inq_bd_index.find(key);
+  if (it != inq_bd_index.end()) {
+    p_db = &p_inq->p_bd_db[it->second];
+    if (p_db->inq_count == p_inq->inq_counter) return (true);
+
+    /* Seen in an earlier inquiry; reuse the entry for this one */
+    p_db->inq_count = p_inq->inq_counter;
+    return (false);
   }
 
-  if (xx < p_inq->max_bd_entries) {
+  if (p_inq->num_bd_entries < p_inq->max_bd_entries) {
+    p_db = &p_inq->p_bd_db[p_inq->num_bd_entries];
     p_db->inq_count = p_inq->inq_counter;
     p_db->bd_addr = p_bda;
     p_db->device_type = p_dev_type;
-    p_inq->num_bd_entries++;
+    inq_bd_index[key] = p_inq->num_bd_entries++;
   }
 
   /* If here, New Entry */
@@ -1396,16 +1420,10 @@ bool btm_inq_find_bdaddr(const RawAddress& p_bda, tBT_DEVICE_TYPE p_dev_type) {
  *
  ******************************************************************************/
 tINQ_DB_ENT* btm_inq_db_find(const RawAddress& p_bda) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (p_ent->in_use && p_ent->inq_info.results.remote_bd_addr == p_bda)
-      return (p_ent);
-  }
+  int slot = inq_db_index.Find(p_bda);
 
-  /* If here, not found */
-  return (NULL);
+  if (slot == InqDbIndex::kNone) return (NULL);
+  return (&btm_cb.btm_inq_vars.inq_db[slot]);
 }
 
 /*******************************************************************************
@@ -1420,53 +1438,58 @@ tINQ_DB_ENT* btm_inq_db_find(const RawAddress& p_bda) {
  *
  ******************************************************************************/
 tINQ_DB_ENT* btm_inq_db_new(const RawAddress& p_bda, bool keep) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-  tINQ_DB_ENT* p_old = btm_cb.btm_inq_vars.inq_db;
-  uint32_t ot = 0xFFFFFFFF;
-  uint8_t keep_counter = 0;
-
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (!p_ent->in_use) {
-      memset(p_ent, 0, sizeof(tINQ_DB_ENT));
-      p_ent->inq_info.results.remote_bd_addr = p_bda;
-      p_ent->in_use = true;
-      /* The keep flag is set as true only for the first 4 HID devices */
-      if (keep_counter < BTM_INQ_DB_HID_KEEP_MAX)
-        p_ent->keep = keep;
-      else
-        p_ent->keep = false;
-
-      return (p_ent);
-    }
-
-    if (p_ent->keep) {
-      keep_counter++;
-    }
+  tINQ_DB_ENT* p_ent;
+  int slot = inq_db_index.FreeSlot();
 
-    if (p_ent->time_of_resp < ot) {
-      if (p_ent->keep) {
-        LOG(INFO) << __func__ << ": keep "
-                  << p_ent->inq_info.results.remote_bd_addr;
-      } else {
-        p_old = p_ent;
-        ot = p_ent->time_of_resp;
-      }
-    }
+  if (slot == InqDbIndex::kNone) {
+    /* If here, no free entry found. Reuse the oldest one not kept. */
+    slot = inq_db_index.Oldest();
+    if (slot == InqDbIndex::kNone) slot = 0;
+    inq_db_index.Remove(slot);
   }
 
-  /* If here, no free entry found. Return the oldest. */
-
-  memset(p_old, 0, sizeof(tINQ_DB_ENT));
-  p_old->inq_info.results.remote_bd_addr = p_bda;
-  p_old->in_use = true;
+  p_ent = &btm_cb.btm_inq_vars.inq_db[slot];
+  memset(p_ent, 0, sizeof(tINQ_DB_ENT));
+  p_ent->inq_info.results.remote_bd_addr = p_bda;
+  p_ent->in_use = true;
   /* The keep flag is set as true only for the first 4 HID devices */
-  if (keep_counter < BTM_INQ_DB_HID_KEEP_MAX)
-    p_old->keep = keep;
+  if (inq_db_index.keep_count() < BTM_INQ_DB_HID_KEEP_MAX)
+    p_ent->keep = keep;
   else
-    p_old->keep = false;
+    p_ent->keep = false;
 
-  return (p_old);
+  inq_db_index.Add(slot, p_bda, p_ent->keep);
+  return (p_ent);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_remove
+ *
+ * Description      This function frees an entry of the inquiry database.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_inq_db_remove(tINQ_DB_ENT* p_ent) {
+  p_ent->in_use = false;
+  inq_db_index.Remove(p_ent - btm_cb.btm_inq_vars.inq_db);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_touch
+ *
+ * Description      This function records a response from the device of an
+ *                  inquiry database entry. Entries that responded least
+ *                  recently are the first to be reused.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_inq_db_touch(tINQ_DB_ENT* p_ent, uint32_t time_of_resp) {
+  p_ent->time_of_resp = time_of_resp;
+  inq_db_index.Touch(p_ent - btm_cb.btm_inq_vars.inq_db);
 }
 
 /*******************************************************************************
@@ -1887,7 +1910,7 @@ void btm_process_inq_results(uint8_t* p, uint8_t hci_evt_len,
       BTM_TRACE_WARNING ("btm_process_inq_results: Dev class: %02x-%02x-%02x",
                   p_cur->dev_class[0], p_cur->dev_class[1], p_cur->dev_class[2]);
 
-      p_i->time_of_resp = time_get_os_boottime_ms();
+      btm_inq_db_touch(p_i, time_get_os_boottime_ms());
 
       if (p_i->inq_count != p_inq->inq_counter)
         p_inq->inq_cmpl_info.num_resp++; /* A new response was found */
@@ -1972,6 +1995,22 @@ void btm_sort_inq_result(void) {
   }
 
   osi_free(p_tmp);
+
+  /* Entries moved, so index them again, in their order of response */
+  std::vector<uint16_t> slots;
+  for (uint16_t slot = 0; slot < BTM_INQ_DB_SIZE; slot++)
+    if (btm_cb.btm_inq_vars.inq_db[slot].in_use) slots.push_back(slot);
+  std::stable_sort(slots.begin(), slots.end(), [](uint16_t a, uint16_t b) {
+    return btm_cb.btm_inq_vars.inq_db[a].time_of_resp <
+           btm_cb.btm_inq_vars.inq_db[b].time_of_resp;
+  });
+
+  inq_db_index.Clear();
+  for (uint16_t slot : slots) {
+    p_ent = &btm_cb.btm_inq_vars.inq_db[slot];
+    inq_db_index.Add(slot, p_ent->inq_info.results.remote_bd_addr,
+                     p_ent->keep);
+  }
 }
 
 /*******************************************************************************
@@ -0,0 +1,164 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "raw_address.h"
+
+/* Address index and response order over the slots of the fixed size inquiry
+ * database, so that looking a device up and picking the entry to reuse do not
+ * scan the database. The entries themselves stay in btm_cb; this only tracks
+ * which slot holds which address, which slots are free and in which order
+ * they last responded.
+ *
+ * Slots marked keep (HID devices found through inquiry) are never chosen for
+ * reuse. Not thread safe; only used on the btu thread. */
+class InqDbIndex {
+ public:
+  static constexpr int kNone = -1;
+
+  explicit InqDbIndex(size_t size)
+      : slots_(size), free_((size + 63) / 64) {
+    index_.reserve(size);
+    Clear();
+  }
+
+  InqDbIndex(const InqDbIndex&) = delete;
+  InqDbIndex& operator=(const InqDbIndex&) = delete;
+
+  /* Returns the slot holding |bda|, or kNone. */
+  int Find(const RawAddress& bda) const {
+    auto it = index_.find(Key(bda));
+    return it == index_.end() ? kNone : it->second;
+  }
+
+  /* Returns the lowest free slot, or kNone if the database is full. Lowest
+   * first keeps the responses of an inquiry at the start of the database,
+   * which btm_sort_inq_result relies on. */
+  int FreeSlot() const {
+    for (size_t w = 0; w < free_.size(); w++)
+      if (free_[w]) return w * 64 + __builtin_ctzll(free_[w]);
+    return kNone;
+  }
+
+  /* Returns the slot that responded least recently and is not kept, or kNone
+   * if every slot in use is kept. */
+  int Oldest() const {
+    for (int slot = tail_; slot != kNone; slot = slots_[slot].prev)
+      if (!slots_[slot].keep) return slot;
+    return kNone;
+  }
+
+  /* Records |bda| in the free slot |slot|, as the most recent response. */
+  void Add(int slot, const RawAddress& bda, bool keep) {
+    Slot& s = slots_[slot];
+    s.key = Key(bda);
+    s.keep = keep;
+    s.in_use = true;
+    free_[slot / 64] &= ~(1ULL << (slot % 64));
+    if (keep) keep_count_++;
+    index_[s.key] = slot;
+    PushFront(slot);
+  }
+
+  /* Frees |slot|; does nothing if it is not in use. */
+  void Remove(int slot) {
+    Slot& s = slots_[slot];
+    if (!s.in_use) return;
+    auto it = index_.find(s.key);
+    if (it != index_.end() && it->second == slot) index_.erase(it);
+    if (s.keep) keep_count_--;
+    s.in_use = false;
+    s.keep = false;
+    free_[slot / 64] |= 1ULL << (slot % 64);
+    Unlink(slot);
+  }
+
+  /* Makes |slot| the most recent response. */
+  void Touch(int slot) {
+    if (!slots_[slot].in_use || head_ == slot) return;
+    Unlink(slot);
+    PushFront(slot);
+  }
+
+  void Clear() {
+    index_.clear();
+    for (Slot& s : slots_) s = Slot();
+    for (size_t w = 0; w < free_.size(); w++) {
+      size_t bits = slots_.size() - w * 64;
+      free_[w] = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+    }
+    head_ = tail_ = kNone;
+    keep_count_ = 0;
+  }
+
+  size_t Size() const { return slots_.size(); }
+  size_t keep_count() const { return keep_count_; }
+
+ private:
+  struct Slot {
+    uint64_t key = 0;
+    bool in_use = false;
+    bool keep = false;
+    /* neighbours in response order, most recent first */
+    int prev = kNone;
+    int next = kNone;
+  };
+
+  static uint64_t Key(const RawAddress& bda) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < RawAddress::kLength; i++)
+      key = (key << 8) | bda.address[i];
+    return key;
+  }
+
+  void PushFront(int slot) {
+    slots_[slot].prev = kNone;
+    slots_[slot].next = head_;
+    if (head_ != kNone) slots_[head_].prev = slot;
+    head_ = slot;
+    if (tail_ == kNone) tail_ = slot;
+  }
+
+  void Unlink(int slot) {
+    Slot& s = slots_[slot];
+    if (s.prev != kNone)
+      slots_[s.prev].next = s.next;
+    else if (head_ == slot)
+      head_ = s.next;
+    if (s.next != kNone)
+      slots_[s.next].prev = s.prev;
+    else if (tail_ == slot)
+      tail_ = s.prev;
+    s.prev = s.next = kNone;
+  }
+
+  std::vector<Slot> slots_;
+  std::unordered_map<uint64_t, int> index_;
+  /* one bit per slot, set when the slot is free */
+  std::vector<uint64_t> free_;
+  int head_ = kNone;
+  int tail_ = kNone;
+  size_t keep_count_ = 0;
+};
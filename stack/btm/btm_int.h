@@ -38,12 +38,16 @@
 #include "device/include/esco_parameters.h"
 
 #include "btm_ble_int.h"
+#include "btm_handle_table.h"
 #include "btm_int_types.h"
 #include "l2cdefs.h"
 #include "smp_api.h"
 
 extern tBTM_CB btm_cb;
 
+/* Links, ACL and SCO connections and security records by HCI handle */
+extern BtmHandleTable<tBTM_SEC_DEV_REC> btm_handle_table;
+
 /* Internal functions provided by btm_main.cc
  *******************************************
 */
@@ -222,6 +226,7 @@ extern void btm_sec_free_dev(tBTM_SEC_DEV_REC* p_dev_rec);
 extern tBTM_SEC_DEV_REC* btm_find_dev(const RawAddress& bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_or_alloc_dev(const RawAddress& bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle);
+extern void btm_dev_index_clear(void);
 extern tBTM_BOND_TYPE btm_get_bond_type_dev(const RawAddress& bd_addr);
 extern bool btm_set_bond_type_dev(const RawAddress& bd_addr,
                                   tBTM_BOND_TYPE bond_type);
@@ -294,6 +299,8 @@ extern tL2CAP_LE_RESULT_CODE btm_ble_start_sec_check(
     tBTM_SEC_CALLBACK* p_callback, void* p_ref_data);
 
 extern tINQ_DB_ENT* btm_inq_db_new(const RawAddress& p_bda, bool keep);
+extern void btm_inq_db_remove(tINQ_DB_ENT* p_ent);
+extern void btm_inq_db_touch(tINQ_DB_ENT* p_ent, uint32_t time_of_resp);
 
 extern void btm_rem_oob_req(uint8_t* p);
 extern void btm_read_local_oob_complete(uint8_t* p);
@@ -36,6 +36,7 @@
 /* Global BTM control block structure
 */
 tBTM_CB btm_cb;
+BtmHandleTable<tBTM_SEC_DEV_REC> btm_handle_table;
 
 
 /*******************************************************************************
@@ -55,6 +56,7 @@ void btm_init(void) {
    * function */
   char rpa_offload_prop[PROPERTY_VALUE_MAX] = "false";
   memset(&btm_cb, 0, sizeof(tBTM_CB));
+  btm_handle_table.Clear();
   btm_cb.page_queue = fixed_queue_new(SIZE_MAX);
   btm_cb.sec_pending_q = fixed_queue_new(SIZE_MAX);
   btm_cb.sec_collision_timer = alarm_new("btm.sec_collision_timer");
@@ -101,6 +103,7 @@ void btm_free(void) {
 
   btm_inq_db_free();
 
+  btm_dev_index_clear();
   list_free(btm_cb.sec_dev_rec);
   btm_cb.sec_dev_rec = NULL;
 
@@ -0,0 +1,143 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/lru.h"
+#include "raw_address.h"
+
+/* Number of resolved RPAs remembered. Sized for a few hundred bonded LE
+ * devices advertising concurrently. */
+#ifndef BTM_RPA_CACHE_SIZE
+#define BTM_RPA_CACHE_SIZE 256
+#endif
+
+/* Number of RPAs remembered as not resolving against any bonded IRK. Busy RF
+ * environments are dominated by unknown devices, so this is larger. */
+#ifndef BTM_RPA_NEGATIVE_CACHE_SIZE
+#define BTM_RPA_NEGATIVE_CACHE_SIZE 1024
+#endif
+
+/* Entries older than this are re-resolved. Matches the 15 minute RPA rotation
+ * interval recommended by the Core specification, after which a peer is
+ * expected to stop using the address anyway. */
+#ifndef BTM_RPA_CACHE_TIMEOUT_MS
+#define BTM_RPA_CACHE_TIMEOUT_MS (15 * 60 * 1000)
+#endif
+
+/* Packs a Bluetooth address into the 48 low bits of an integer key. */
+inline uint64_t btm_rpa_cache_key(const RawAddress& bda) {
+  uint64_t key = 0;
+  for (size_t i = 0; i < RawAddress::kLength; i++)
+    key = (key << 8) | bda.address[i];
+  return key;
+}
+
+/* Remembers the outcome of resolving random private addresses against the
+ * IRKs in the security database, so that each RPA costs at most one AES-128
+ * per bonded device per rotation interval instead of one per lookup.
+ *
+ * |Record| is the security record type; the cache only stores pointers to it
+ * and relies on its owner calling RemoveRecord before a record is freed or
+ * its IRK changes, and ClearUnresolvable whenever an IRK is added. */
+template <typename Record>
+class RpaCache {
+ public:
+  enum Result { MISS, RESOLVED, UNRESOLVABLE };
+
+  RpaCache(size_t size = BTM_RPA_CACHE_SIZE,
+           size_t negative_size = BTM_RPA_NEGATIVE_CACHE_SIZE,
+           uint64_t timeout_ms = BTM_RPA_CACHE_TIMEOUT_MS)
+      : resolved_(size),
+        unresolvable_(negative_size),
+        timeout_ms_(timeout_ms) {}
+
+  /* Looks up |rpa|. On RESOLVED, |*p_record| is set to the matching record. */
+  Result Lookup(const RawAddress& rpa, uint64_t now_ms, Record** p_record) {
+    uint64_t key = btm_rpa_cache_key(rpa);
+
+    ResolvedEntry* entry = resolved_.Get(key);
+    if (entry != nullptr) {
+      if (now_ms - entry->time_ms < timeout_ms_) {
+        *p_record = entry->record;
+        hits_++;
+        return RESOLVED;
+      }
+      resolved_.Remove(key);
+    }
+
+    uint64_t* time_ms = unresolvable_.Get(key);
+    if (time_ms != nullptr) {
+      if (now_ms - *time_ms < timeout_ms_) {
+        negative_hits_++;
+        return UNRESOLVABLE;
+      }
+      unresolvable_.Remove(key);
+    }
+
+    misses_++;
+    return MISS;
+  }
+
+  void AddResolved(const RawAddress& rpa, Record* record, uint64_t now_ms) {
+    uint64_t key = btm_rpa_cache_key(rpa);
+    unresolvable_.Remove(key);
+    resolved_.Put(key, ResolvedEntry{record, now_ms});
+  }
+
+  void AddUnresolvable(const RawAddress& rpa, uint64_t now_ms) {
+    unresolvable_.Put(btm_rpa_cache_key(rpa), now_ms);
+  }
+
+  /* Forgets every RPA resolved to |record|. */
+  void RemoveRecord(const Record* record) {
+    resolved_.RemoveIf(
+        [record](uint64_t /* key */, const ResolvedEntry& entry) {
+          return entry.record == record;
+        });
+  }
+
+  /* Forgets every RPA that failed to resolve; needed once a new IRK might
+   * resolve them. */
+  void ClearUnresolvable() { unresolvable_.Clear(); }
+
+  void Clear() {
+    resolved_.Clear();
+    unresolvable_.Clear();
+  }
+
+  size_t hits() const { return hits_; }
+  size_t negative_hits() const { return negative_hits_; }
+  size_t misses() const { return misses_; }
+
+ private:
+  struct ResolvedEntry {
+    Record* record;
+    uint64_t time_ms;
+  };
+
+  bluetooth::common::LruCache<uint64_t, ResolvedEntry> resolved_;
+  bluetooth::common::LruCache<uint64_t, uint64_t> unresolvable_;
+  const uint64_t timeout_ms_;
+  size_t hits_ = 0;
+  size_t negative_hits_ = 0;
+  size_t misses_ = 0;
+};
@@ -1023,6 +1023,7 @@ void btm_sco_connected(uint8_t hci_status, const RawAddress* bda,
 
       p->state = SCO_ST_CONNECTED;
       p->hci_handle = hci_handle;
+      btm_handle_table.SetSco(hci_handle, xx);
 
       if (!btm_cb.sco_cb.esco_supported) {
         p->esco.data.link_type = BTM_LINK_TYPE_SCO;
@@ -1057,18 +1058,27 @@ void btm_sco_connected(uint8_t hci_status, const RawAddress* bda,
  * Function         btm_find_scb_by_handle
  *
  * Description      Look through all active SCO connection for a match based on
- *                  the HCI handle.
+ *                  the HCI handle. The connection last found for the handle,
+ *                  in btm_handle_table, is tried first.
  *
  * Returns          index to matched SCO connection CB, or BTM_MAX_SCO_LINKS if
  *                  no match.
  *
  ******************************************************************************/
 uint16_t btm_find_scb_by_handle(uint16_t handle) {
-  int xx;
-  tSCO_CONN* p = &btm_cb.sco_cb.sco_db[0];
+  int xx = btm_handle_table.Get(handle).sco;
+  tSCO_CONN* p;
 
-  for (xx = 0; xx < BTM_MAX_SCO_LINKS; xx++, p++) {
+  if (xx < BTM_MAX_SCO_LINKS) {
+    p = &btm_cb.sco_cb.sco_db[xx];
+    if ((p->state == SCO_ST_CONNECTED) && (p->hci_handle == handle))
+      return (xx);
+  }
+
+  for (xx = 0, p = &btm_cb.sco_cb.sco_db[0]; xx < BTM_MAX_SCO_LINKS;
+       xx++, p++) {
     if ((p->state == SCO_ST_CONNECTED) && (p->hci_handle == handle)) {
+      btm_handle_table.SetSco(handle, xx);
       return (xx);
     }
   }
@@ -1178,6 +1188,7 @@ void btm_sco_removed(uint16_t hci_handle, uint8_t reason) {
         (p->hci_handle == hci_handle)) {
       btm_sco_flush_sco_data(xx);
 
+      btm_handle_table.ForgetSco(hci_handle, xx);
       p->state = SCO_ST_UNUSED;
       p->hci_handle = BTM_INVALID_HCI_HANDLE;
       p->rem_bd_known = false;
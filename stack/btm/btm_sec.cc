@@ -4651,6 +4651,7 @@ void btm_sec_connected(const RawAddress& bda, uint16_t handle, uint8_t status,
   }
 
   p_dev_rec->hci_handle = handle;
+  btm_handle_table.SetDevRec(handle, p_dev_rec);
 
   /* role may not be correct here, it will be updated by l2cap, but we need to
    */
@@ -6276,6 +6277,7 @@ void btm_sec_clear_ble_keys(tBTM_SEC_DEV_REC* p_dev_rec) {
   BTM_TRACE_DEBUG("%s() Clearing BLE Keys", __func__);
   p_dev_rec->ble.key_type = BTM_LE_KEY_NONE;
   memset(&p_dev_rec->ble.keys, 0, sizeof(tBTM_SEC_BLE_KEYS));
+  btm_ble_rpa_cache_remove_dev(p_dev_rec);
 
 #if (BLE_PRIVACY_SPT == TRUE)
   btm_ble_resolving_list_remove_dev(p_dev_rec);
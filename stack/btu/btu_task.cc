@@ -35,6 +35,7 @@
 #include "osi/include/osi.h"
 #include "osi/include/thread.h"
 #include "stack/btm/btm_int.h"
+#include "stack/include/bt_hdr_chain.h"
 #include "stack/include/btu.h"
 #include "stack/l2cap/l2c_int.h"
 
@@ -57,6 +58,11 @@ void btu_hci_msg_process(BT_HDR* p_msg) {
       l2c_rcv_acl_data(p_msg);
       break;
 
+    case BT_EVT_TO_BTU_HCI_ACL_CHAIN:
+      /* Acl Data that was reassembled without copying */
+      l2c_rcv_acl_chain(BtHdrChain::Unwrap(p_msg));
+      break;
+
     case BT_EVT_TO_BTU_L2C_SEG_XMIT:
       /* L2CAP segment transmit complete */
       l2c_link_segments_xmitted(p_msg);
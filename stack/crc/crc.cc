@@ -0,0 +1,354 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  Frame check sequences of L2CAP and RFCOMM, and the runtime selection
+ *  between the CRC-16 implementations.
+ *
+ ******************************************************************************/
+
+#include "stack/crc/crc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRC16_BACKEND_PCLMUL
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define CRC16_BACKEND_PMULL
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_PMULL
+#define HWCAP_PMULL (1 << 4)
+#endif
+#endif
+
+namespace crc {
+
+namespace {
+
+/* x^16 + x^15 + x^2 + 1, bits reflected */
+#define CRC16_POLY 0xa001
+
+/* Look-up table for the CRC-16 calculation */
+const uint16_t crc16_table[256] = {
+    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601,
+    0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440, 0xcc01, 0x0cc0,
+    0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81,
+    0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841, 0xd801, 0x18c0, 0x1980, 0xd941,
+    0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01,
+    0x1dc0, 0x1c80, 0xdc41, 0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0,
+    0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081,
+    0x1040, 0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
+    0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441, 0x3c00,
+    0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0,
+    0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840, 0x2800, 0xe8c1, 0xe981,
+    0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41,
+    0x2d00, 0xedc1, 0xec81, 0x2c40, 0xe401, 0x24c0, 0x2580, 0xe541, 0x2700,
+    0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0,
+    0x2080, 0xe041, 0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281,
+    0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01,
+    0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840, 0x7800, 0xb8c1,
+    0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80,
+    0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40, 0xb401, 0x74c0, 0x7580, 0xb541,
+    0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101,
+    0x71c0, 0x7080, 0xb041, 0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0,
+    0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481,
+    0x5440, 0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
+    0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841, 0x8801,
+    0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1,
+    0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41, 0x4400, 0x84c1, 0x8581,
+    0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341,
+    0x4100, 0x81c1, 0x8081, 0x4040,
+};
+
+/* Reversed CRC Table , 8-bit, poly=0x07
+ * (GSM 07.10 TS 101 369 V6.3.0) */
+const uint8_t crc8_table[] = {
+    0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED,
+    0x7C, 0x09, 0x98, 0xEA, 0x7B, 0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A,
+    0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67, 0x38,
+    0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D, 0x36, 0xA7, 0xD5, 0x44,
+    0x31, 0xA0, 0xD2, 0x43, 0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0,
+    0x51, 0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
+
+    0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05, 0x7E, 0xEF, 0x9D,
+    0x0C, 0x79, 0xE8, 0x9A, 0x0B, 0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA,
+    0x88, 0x19, 0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17, 0x48,
+    0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D, 0x46, 0xD7, 0xA5, 0x34,
+    0x41, 0xD0, 0xA2, 0x33, 0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0,
+    0x21, 0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
+
+    0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95, 0xEE, 0x7F, 0x0D,
+    0x9C, 0xE9, 0x78, 0x0A, 0x9B, 0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A,
+    0x18, 0x89, 0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87, 0xD8,
+    0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD, 0xD6, 0x47, 0x35, 0xA4,
+    0xD1, 0x40, 0x32, 0xA3, 0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20,
+    0xB1, 0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
+
+    0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5, 0x9E, 0x0F, 0x7D,
+    0xEC, 0x99, 0x08, 0x7A, 0xEB, 0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A,
+    0x68, 0xF9, 0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7, 0xA8,
+    0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD, 0xA6, 0x37, 0x45, 0xD4,
+    0xA1, 0x30, 0x42, 0xD3, 0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50,
+    0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF,
+};
+
+uint16_t reference_update(uint16_t crc, const uint8_t* p, size_t len) {
+  while (len--) crc = (crc >> 8) ^ crc16_table[(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+/*******************************************************************************
+ *  Slice-by-8 backend
+ *
+ *  Table k gives the CRC of a byte followed by k zero bytes, so that eight
+ *  bytes are folded in with eight independent lookups rather than a chain of
+ *  eight dependent ones.
+ ******************************************************************************/
+
+struct SliceTables {
+  uint16_t t[8][256];
+};
+
+constexpr SliceTables make_slice_tables() {
+  SliceTables tables{};
+  for (int i = 0; i < 256; i++) {
+    uint16_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ CRC16_POLY : crc >> 1;
+    tables.t[0][i] = crc;
+  }
+  for (int k = 1; k < 8; k++)
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = tables.t[k - 1][i];
+      tables.t[k][i] = (crc >> 8) ^ tables.t[0][crc & 0xff];
+    }
+  return tables;
+}
+
+constexpr SliceTables slice_tables = make_slice_tables();
+
+uint16_t slice8_update(uint16_t crc, const uint8_t* p, size_t len) {
+  const uint16_t(*t)[256] = slice_tables.t;
+  for (; len >= 8; len -= 8, p += 8) {
+    uint16_t head = crc ^ (p[0] | p[1] << 8);
+    crc = t[7][head & 0xff] ^ t[6][head >> 8] ^ t[5][p[2]] ^ t[4][p[3]] ^
+          t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+  }
+  while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+/*******************************************************************************
+ *  Carry-less multiplication backends
+ *
+ *  The message is folded 128 bits at a time into 128 bit accumulators that
+ *  stay congruent to it modulo the polynomial: the two halves of an
+ *  accumulator are multiplied by x^n mod P for the distance n they move, and
+ *  the next block is added. The last accumulator is then reduced to 16 bits
+ *  with the tables.
+ *
+ *  Bits are reflected, so bit i of a 64 bit operand is the coefficient of
+ *  x^(63 - i), and the product of two such operands comes out multiplied by
+ *  x, which the constants make up for.
+ ******************************************************************************/
+
+/* Accumulators folded in parallel, to hide the latency of the multiplies. */
+#define CLMUL_LANES 4
+/* Shorter messages are left to the tables. */
+#define CLMUL_MIN_LEN (2 * CLMUL_LANES * 16)
+
+/* x^n mod P, reflected into the top 16 bits of a 64 bit operand. */
+constexpr uint64_t xpow_mod(int n) {
+  uint32_t r = 1;
+  for (int i = 0; i < n; i++) {
+    r <<= 1;
+    if (r & 0x10000) r ^= 0x18005;
+  }
+  uint64_t reflected = 0;
+  for (int j = 0; j < 16; j++)
+    if (r & (1u << j)) reflected |= 1ULL << (63 - j);
+  return reflected;
+}
+
+/* Constants to move an accumulator |bits| further along the message: for
+ * its first half, which is x^64 ahead of the second, then for the second. */
+#define FOLD_CONSTANTS(bits) xpow_mod((bits) + 63), xpow_mod((bits)-1)
+
+const uint64_t fold_by_lanes[2] = {FOLD_CONSTANTS(CLMUL_LANES * 128)};
+const uint64_t fold_by_1[2] = {FOLD_CONSTANTS(128)};
+const uint64_t fold_by_2[2] = {FOLD_CONSTANTS(256)};
+const uint64_t fold_by_3[2] = {FOLD_CONSTANTS(384)};
+
+#if defined(CRC16_BACKEND_PCLMUL)
+
+#define PCLMUL_TARGET __attribute__((target("pclmul,sse2")))
+
+PCLMUL_TARGET inline __m128i pclmul_constants(const uint64_t* k) {
+  return _mm_set_epi64x(k[1], k[0]);
+}
+
+PCLMUL_TARGET inline __m128i pclmul_fold(__m128i x, __m128i k, __m128i next) {
+  __m128i first = _mm_clmulepi64_si128(x, k, 0x00);
+  __m128i second = _mm_clmulepi64_si128(x, k, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(first, second), next);
+}
+
+PCLMUL_TARGET uint16_t pclmul_update(uint16_t crc, const uint8_t* p,
+                                     size_t len) {
+  if (len < CLMUL_MIN_LEN) return slice8_update(crc, p, len);
+
+  __m128i x[CLMUL_LANES];
+  for (int i = 0; i < CLMUL_LANES; i++)
+    x[i] = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+  x[0] = _mm_xor_si128(x[0], _mm_cvtsi32_si128(crc));
+  p += CLMUL_LANES * 16;
+  len -= CLMUL_LANES * 16;
+
+  __m128i k = pclmul_constants(fold_by_lanes);
+  for (; len >= CLMUL_LANES * 16; len -= CLMUL_LANES * 16) {
+    for (int i = 0; i < CLMUL_LANES; i++)
+      x[i] = pclmul_fold(x[i], k, _mm_loadu_si128((const __m128i*)p + i));
+    p += CLMUL_LANES * 16;
+  }
+
+  __m128i acc = x[3];
+  acc = pclmul_fold(x[2], pclmul_constants(fold_by_1), acc);
+  acc = pclmul_fold(x[1], pclmul_constants(fold_by_2), acc);
+  acc = pclmul_fold(x[0], pclmul_constants(fold_by_3), acc);
+
+  k = pclmul_constants(fold_by_1);
+  for (; len >= 16; len -= 16, p += 16)
+    acc = pclmul_fold(acc, k, _mm_loadu_si128((const __m128i*)p));
+
+  uint8_t bytes[16];
+  _mm_storeu_si128((__m128i*)bytes, acc);
+  return slice8_update(slice8_update(0, bytes, sizeof(bytes)), p, len);
+}
+
+bool pclmul_supported() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  return (ecx & bit_PCLMUL) != 0;
+}
+
+#endif  // CRC16_BACKEND_PCLMUL
+
+#if defined(CRC16_BACKEND_PMULL)
+
+#if defined(__clang__)
+#define PMULL_TARGET __attribute__((target("crypto")))
+#else
+#define PMULL_TARGET __attribute__((target("+crypto")))
+#endif
+
+PMULL_TARGET inline uint64x2_t pmull_fold(uint64x2_t x, const uint64_t* k,
+                                          uint64x2_t next) {
+  poly128_t first = vmull_p64(vgetq_lane_u64(x, 0), k[0]);
+  poly128_t second = vmull_p64(vgetq_lane_u64(x, 1), k[1]);
+  return veorq_u64(veorq_u64(vreinterpretq_u64_p128(first),
+                             vreinterpretq_u64_p128(second)),
+                   next);
+}
+
+PMULL_TARGET inline uint64x2_t pmull_load(const uint8_t* p) {
+  return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+PMULL_TARGET uint16_t pmull_update(uint16_t crc, const uint8_t* p,
+                                   size_t len) {
+  if (len < CLMUL_MIN_LEN) return slice8_update(crc, p, len);
+
+  uint64x2_t x[CLMUL_LANES];
+  for (int i = 0; i < CLMUL_LANES; i++) x[i] = pmull_load(p + 16 * i);
+  x[0] = veorq_u64(x[0], vcombine_u64(vcreate_u64(crc), vcreate_u64(0)));
+  p += CLMUL_LANES * 16;
+  len -= CLMUL_LANES * 16;
+
+  for (; len >= CLMUL_LANES * 16; len -= CLMUL_LANES * 16) {
+    for (int i = 0; i < CLMUL_LANES; i++)
+      x[i] = pmull_fold(x[i], fold_by_lanes, pmull_load(p + 16 * i));
+    p += CLMUL_LANES * 16;
+  }
+
+  uint64x2_t acc = x[3];
+  acc = pmull_fold(x[2], fold_by_1, acc);
+  acc = pmull_fold(x[1], fold_by_2, acc);
+  acc = pmull_fold(x[0], fold_by_3, acc);
+
+  for (; len >= 16; len -= 16, p += 16)
+    acc = pmull_fold(acc, fold_by_1, pmull_load(p));
+
+  uint8_t bytes[16];
+  vst1q_u8(bytes, vreinterpretq_u8_u64(acc));
+  return slice8_update(slice8_update(0, bytes, sizeof(bytes)), p, len);
+}
+
+bool pmull_supported() { return (getauxval(AT_HWCAP) & HWCAP_PMULL) != 0; }
+
+#endif  // CRC16_BACKEND_PMULL
+
+const Crc16Backend crc16_backend_slice8 = {"slice8", slice8_update};
+#if defined(CRC16_BACKEND_PCLMUL)
+const Crc16Backend crc16_backend_pclmul = {"pclmul", pclmul_update};
+#endif
+#if defined(CRC16_BACKEND_PMULL)
+const Crc16Backend crc16_backend_pmull = {"pmull", pmull_update};
+#endif
+
+}  // namespace
+
+const Crc16Backend crc16_backend_reference = {"reference", reference_update};
+
+/* Ordered so that the preferred backend comes last. */
+const std::vector<const Crc16Backend*>& crc16_backends() {
+  static const std::vector<const Crc16Backend*> backends = [] {
+    std::vector<const Crc16Backend*> list = {&crc16_backend_reference,
+                                             &crc16_backend_slice8};
+#if defined(CRC16_BACKEND_PCLMUL)
+    if (pclmul_supported()) list.push_back(&crc16_backend_pclmul);
+#endif
+#if defined(CRC16_BACKEND_PMULL)
+    if (pmull_supported()) list.push_back(&crc16_backend_pmull);
+#endif
+    return list;
+  }();
+  return backends;
+}
+
+const Crc16Backend& crc16_backend() {
+  static const Crc16Backend* backend = crc16_backends().back();
+  return *backend;
+}
+
+uint16_t crc16(uint16_t crc, const uint8_t* p, size_t len) {
+  static const crc16_fn update = crc16_backend().update;
+  return update(crc, p, len);
+}
+
+uint8_t crc8(uint8_t crc, const uint8_t* p, size_t len) {
+  while (len--) crc = crc8_table[crc ^ *p++];
+  return crc;
+}
+
+}  // namespace crc
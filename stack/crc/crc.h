@@ -0,0 +1,56 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace crc {
+
+/* Returns |crc| updated with the |len| bytes at |p|, for the CRC-16 with
+ * polynomial x^16 + x^15 + x^2 + 1 and bits reflected, i.e. the L2CAP FCS. */
+typedef uint16_t (*crc16_fn)(uint16_t crc, const uint8_t* p, size_t len);
+
+typedef struct {
+  const char* name;
+  crc16_fn update;
+} Crc16Backend;
+
+/* The byte at a time table driven implementation. Always available. */
+extern const Crc16Backend crc16_backend_reference;
+
+/* Every backend that can run on this CPU, starting with
+ * crc16_backend_reference. */
+const std::vector<const Crc16Backend*>& crc16_backends();
+
+/* The backend used by crc16: carry-less multiplication when the CPU has it,
+ * otherwise slice-by-8 tables. Selected once, on first use. */
+const Crc16Backend& crc16_backend();
+
+/* Returns |crc| updated with the |len| bytes at |p|; see crc16_fn. */
+uint16_t crc16(uint16_t crc, const uint8_t* p, size_t len);
+
+/* Returns |crc| updated with the |len| bytes at |p|, for the CRC-8 with
+ * polynomial x^8 + x^2 + x + 1 and bits reflected of GSM 07.10, i.e. the
+ * RFCOMM FCS. */
+uint8_t crc8(uint8_t crc, const uint8_t* p, size_t len);
+
+}  // namespace crc
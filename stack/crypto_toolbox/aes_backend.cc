@@ -0,0 +1,533 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  AES-128 block encryption backends used by crypto_toolbox, and the runtime
+ *  selection between them.
+ *
+ ******************************************************************************/
+
+#include "stack/crypto_toolbox/aes_backend.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "stack/crypto_toolbox/aes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AES_BACKEND_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define AES_BACKEND_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+
+namespace crypto_toolbox {
+
+namespace {
+
+#define AES_128_ROUNDS 10
+
+const uint8_t aes_rcon[AES_128_ROUNDS] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                          0x20, 0x40, 0x80, 0x1b, 0x36};
+
+void reference_encrypt_batch(const Octet16* keys, const Octet16* in,
+                             Octet16* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    aes_context ctx;
+    aes_set_key(keys[i].data(), OCTET16_LEN, &ctx);
+    aes_encrypt(in[i].data(), out[i].data(), &ctx);
+  }
+}
+
+/*******************************************************************************
+ *  Bitsliced backend
+ *
+ *  The table driven implementation indexes its S-box with key dependent bytes,
+ *  which leaks the key through cache timing. This one computes the S-box as a
+ *  boolean circuit over bit planes instead, and the rest of the round with
+ *  plain byte arithmetic, so that it runs in constant time.
+ ******************************************************************************/
+
+/* Bytes substituted by one evaluation of the S-box circuit: one uint64_t per
+ * bit plane. */
+#define BITSLICE_BYTES 64
+/* Blocks encrypted together. Each round substitutes their state and the
+ * RotWord of their round key, computed on the fly: 20 bytes per block. */
+#define BITSLICE_BLOCKS (BITSLICE_BYTES / (OCTET16_LEN + 4))
+
+/* Transposes the 8x8 bit matrix in |x|, whose byte i is row i. */
+inline uint64_t transpose_8x8(uint64_t x) {
+  uint64_t t;
+  t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+/* AES S-box on bit planes, |q[i]| holding bit i of every byte. This is the
+ * 113 gate circuit by Boyar and Peralta. */
+void bitsliced_sbox(uint64_t* q) {
+  uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+  uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+  uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+  uint64_t y20, y21;
+  uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+  uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+  uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+  uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+  uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+  uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+  uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+  uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+  uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+  uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+  x0 = q[7];
+  x1 = q[6];
+  x2 = q[5];
+  x3 = q[4];
+  x4 = q[3];
+  x5 = q[2];
+  x6 = q[1];
+  x7 = q[0];
+
+  /* top linear transformation */
+  y14 = x3 ^ x5;
+  y13 = x0 ^ x6;
+  y9 = x0 ^ x3;
+  y8 = x0 ^ x5;
+  t0 = x1 ^ x2;
+  y1 = t0 ^ x7;
+  y4 = y1 ^ x3;
+  y12 = y13 ^ y14;
+  y2 = y1 ^ x0;
+  y5 = y1 ^ x6;
+  y3 = y5 ^ y8;
+  t1 = x4 ^ y12;
+  y15 = t1 ^ x5;
+  y20 = t1 ^ x1;
+  y6 = y15 ^ x7;
+  y10 = y15 ^ t0;
+  y11 = y20 ^ y9;
+  y7 = x7 ^ y11;
+  y17 = y10 ^ y11;
+  y19 = y10 ^ y8;
+  y16 = t0 ^ y11;
+  y21 = y13 ^ y16;
+  y18 = x0 ^ y16;
+
+  /* non-linear section */
+  t2 = y12 & y15;
+  t3 = y3 & y6;
+  t4 = t3 ^ t2;
+  t5 = y4 & x7;
+  t6 = t5 ^ t2;
+  t7 = y13 & y16;
+  t8 = y5 & y1;
+  t9 = t8 ^ t7;
+  t10 = y2 & y7;
+  t11 = t10 ^ t7;
+  t12 = y9 & y11;
+  t13 = y14 & y17;
+  t14 = t13 ^ t12;
+  t15 = y8 & y10;
+  t16 = t15 ^ t12;
+  t17 = t4 ^ t14;
+  t18 = t6 ^ t16;
+  t19 = t9 ^ t14;
+  t20 = t11 ^ t16;
+  t21 = t17 ^ y20;
+  t22 = t18 ^ y19;
+  t23 = t19 ^ y21;
+  t24 = t20 ^ y18;
+
+  t25 = t21 ^ t22;
+  t26 = t21 & t23;
+  t27 = t24 ^ t26;
+  t28 = t25 & t27;
+  t29 = t28 ^ t22;
+  t30 = t23 ^ t24;
+  t31 = t22 ^ t26;
+  t32 = t31 & t30;
+  t33 = t32 ^ t24;
+  t34 = t23 ^ t33;
+  t35 = t27 ^ t33;
+  t36 = t24 & t35;
+  t37 = t36 ^ t34;
+  t38 = t27 ^ t36;
+  t39 = t29 & t38;
+  t40 = t25 ^ t39;
+
+  t41 = t40 ^ t37;
+  t42 = t29 ^ t33;
+  t43 = t29 ^ t40;
+  t44 = t33 ^ t37;
+  t45 = t42 ^ t41;
+  z0 = t44 & y15;
+  z1 = t37 & y6;
+  z2 = t33 & x7;
+  z3 = t43 & y16;
+  z4 = t40 & y1;
+  z5 = t29 & y7;
+  z6 = t42 & y11;
+  z7 = t45 & y17;
+  z8 = t41 & y10;
+  z9 = t44 & y12;
+  z10 = t37 & y3;
+  z11 = t33 & y4;
+  z12 = t43 & y13;
+  z13 = t40 & y5;
+  z14 = t29 & y2;
+  z15 = t42 & y9;
+  z16 = t45 & y14;
+  z17 = t41 & y8;
+
+  /* bottom linear transformation */
+  t46 = z15 ^ z16;
+  t47 = z10 ^ z11;
+  t48 = z5 ^ z13;
+  t49 = z9 ^ z10;
+  t50 = z2 ^ z12;
+  t51 = z2 ^ z5;
+  t52 = z7 ^ z8;
+  t53 = z0 ^ z3;
+  t54 = z6 ^ z7;
+  t55 = z16 ^ z17;
+  t56 = z12 ^ t48;
+  t57 = t50 ^ t53;
+  t58 = z4 ^ t46;
+  t59 = z3 ^ t54;
+  t60 = t46 ^ t57;
+  t61 = z14 ^ t57;
+  t62 = t52 ^ t58;
+  t63 = t49 ^ t58;
+  t64 = z4 ^ t59;
+  t65 = t61 ^ t62;
+  t66 = z1 ^ t63;
+  s0 = t59 ^ t63;
+  s6 = t56 ^ ~t62;
+  s7 = t48 ^ ~t60;
+  t67 = t64 ^ t65;
+  s3 = t53 ^ t66;
+  s4 = t51 ^ t66;
+  s5 = t47 ^ t65;
+  s1 = t64 ^ ~s3;
+  s2 = t55 ^ ~t67;
+
+  q[7] = s0;
+  q[6] = s1;
+  q[5] = s2;
+  q[4] = s3;
+  q[3] = s4;
+  q[2] = s5;
+  q[1] = s6;
+  q[0] = s7;
+}
+
+/* Applies the S-box to the |len| bytes at |bytes|, |len| being at most
+ * BITSLICE_BYTES. */
+void bitsliced_sub_bytes(uint8_t* bytes, size_t len) {
+  uint64_t q[8] = {0};
+  size_t groups = (len + 7) / 8;
+
+  for (size_t g = 0; g < groups; g++) {
+    uint64_t x = 0;
+    for (size_t r = 0; r < 8 && 8 * g + r < len; r++)
+      x |= (uint64_t)bytes[8 * g + r] << (8 * r);
+    x = transpose_8x8(x);
+    for (int k = 0; k < 8; k++) q[k] |= ((x >> (8 * k)) & 0xff) << (8 * g);
+  }
+
+  bitsliced_sbox(q);
+
+  for (size_t g = 0; g < groups; g++) {
+    uint64_t x = 0;
+    for (int k = 0; k < 8; k++) x |= ((q[k] >> (8 * g)) & 0xff) << (8 * k);
+    x = transpose_8x8(x);
+    for (size_t r = 0; r < 8 && 8 * g + r < len; r++)
+      bytes[8 * g + r] = (uint8_t)(x >> (8 * r));
+  }
+}
+
+/* Multiplication by x in GF(2^8), without a data dependent branch. */
+inline uint8_t xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ (0x1b & -(x >> 7)));
+}
+
+void shift_rows(uint8_t* s) {
+  uint8_t t;
+
+  t = s[1];
+  s[1] = s[5];
+  s[5] = s[9];
+  s[9] = s[13];
+  s[13] = t;
+
+  t = s[2];
+  s[2] = s[10];
+  s[10] = t;
+  t = s[6];
+  s[6] = s[14];
+  s[14] = t;
+
+  t = s[15];
+  s[15] = s[11];
+  s[11] = s[7];
+  s[7] = s[3];
+  s[3] = t;
+}
+
+void mix_columns(uint8_t* s) {
+  for (int c = 0; c < 4; c++) {
+    uint8_t* col = s + 4 * c;
+    uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+    uint8_t t = a0 ^ a1 ^ a2 ^ a3;
+    col[0] = a0 ^ t ^ xtime(a0 ^ a1);
+    col[1] = a1 ^ t ^ xtime(a1 ^ a2);
+    col[2] = a2 ^ t ^ xtime(a2 ^ a3);
+    col[3] = a3 ^ t ^ xtime(a3 ^ a0);
+  }
+}
+
+void bitsliced_encrypt_batch(const Octet16* keys, const Octet16* in,
+                             Octet16* out, size_t n) {
+  uint8_t bytes[BITSLICE_BYTES];
+  uint8_t round_keys[BITSLICE_BLOCKS][OCTET16_LEN];
+
+  for (size_t first = 0; first < n; first += BITSLICE_BLOCKS) {
+    size_t count = std::min<size_t>(n - first, BITSLICE_BLOCKS);
+    /* states of the blocks, followed by one key schedule word per block */
+    uint8_t* words = bytes + count * OCTET16_LEN;
+
+    for (size_t b = 0; b < count; b++) {
+      memcpy(round_keys[b], keys[first + b].data(), OCTET16_LEN);
+      for (int j = 0; j < OCTET16_LEN; j++)
+        bytes[b * OCTET16_LEN + j] = in[first + b][j] ^ round_keys[b][j];
+    }
+
+    for (int r = 1; r <= AES_128_ROUNDS; r++) {
+      for (size_t b = 0; b < count; b++) {
+        const uint8_t* last = round_keys[b] + 12;
+        words[4 * b] = last[1];
+        words[4 * b + 1] = last[2];
+        words[4 * b + 2] = last[3];
+        words[4 * b + 3] = last[0];
+      }
+
+      bitsliced_sub_bytes(bytes, count * (OCTET16_LEN + 4));
+
+      for (size_t b = 0; b < count; b++) {
+        uint8_t* rk = round_keys[b];
+        rk[0] ^= words[4 * b] ^ aes_rcon[r - 1];
+        for (int j = 1; j < 4; j++) rk[j] ^= words[4 * b + j];
+        for (int j = 4; j < OCTET16_LEN; j++) rk[j] ^= rk[j - 4];
+
+        uint8_t* s = bytes + b * OCTET16_LEN;
+        shift_rows(s);
+        if (r != AES_128_ROUNDS) mix_columns(s);
+        for (int j = 0; j < OCTET16_LEN; j++) s[j] ^= rk[j];
+      }
+    }
+
+    for (size_t b = 0; b < count; b++)
+      memcpy(out[first + b].data(), bytes + b * OCTET16_LEN, OCTET16_LEN);
+  }
+}
+
+/*******************************************************************************
+ *  AES-NI backend
+ ******************************************************************************/
+#if defined(AES_BACKEND_AESNI)
+
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+/* Blocks kept in flight together, to hide the latency of aesenc. */
+#define AESNI_BLOCKS 4
+
+AESNI_TARGET inline __m128i aesni_key_step(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+/* aeskeygenassist takes the round constant as an immediate. */
+#define AESNI_EXPAND(rk, i, rcon) \
+  rk[i] = aesni_key_step(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+AESNI_TARGET void aesni_expand_key(const Octet16& key, __m128i* rk) {
+  rk[0] = _mm_loadu_si128((const __m128i*)key.data());
+  AESNI_EXPAND(rk, 1, 0x01);
+  AESNI_EXPAND(rk, 2, 0x02);
+  AESNI_EXPAND(rk, 3, 0x04);
+  AESNI_EXPAND(rk, 4, 0x08);
+  AESNI_EXPAND(rk, 5, 0x10);
+  AESNI_EXPAND(rk, 6, 0x20);
+  AESNI_EXPAND(rk, 7, 0x40);
+  AESNI_EXPAND(rk, 8, 0x80);
+  AESNI_EXPAND(rk, 9, 0x1b);
+  AESNI_EXPAND(rk, 10, 0x36);
+}
+
+AESNI_TARGET void aesni_encrypt_batch(const Octet16* keys, const Octet16* in,
+                                      Octet16* out, size_t n) {
+  __m128i rk[AESNI_BLOCKS][AES_128_ROUNDS + 1];
+  __m128i s[AESNI_BLOCKS];
+
+  for (size_t first = 0; first < n; first += AESNI_BLOCKS) {
+    size_t count = std::min<size_t>(n - first, AESNI_BLOCKS);
+
+    for (size_t b = 0; b < count; b++) {
+      aesni_expand_key(keys[first + b], rk[b]);
+      s[b] = _mm_xor_si128(
+          _mm_loadu_si128((const __m128i*)in[first + b].data()), rk[b][0]);
+    }
+    for (int r = 1; r < AES_128_ROUNDS; r++)
+      for (size_t b = 0; b < count; b++)
+        s[b] = _mm_aesenc_si128(s[b], rk[b][r]);
+    for (size_t b = 0; b < count; b++) {
+      s[b] = _mm_aesenclast_si128(s[b], rk[b][AES_128_ROUNDS]);
+      _mm_storeu_si128((__m128i*)out[first + b].data(), s[b]);
+    }
+  }
+}
+
+bool aesni_supported() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  return (ecx & bit_AES) != 0;
+}
+
+#endif  // AES_BACKEND_AESNI
+
+/*******************************************************************************
+ *  ARMv8 Cryptography Extensions backend
+ ******************************************************************************/
+#if defined(AES_BACKEND_ARMV8)
+
+#if defined(__clang__)
+#define ARMV8_AES_TARGET __attribute__((target("crypto")))
+#else
+#define ARMV8_AES_TARGET __attribute__((target("+crypto")))
+#endif
+
+/* Blocks kept in flight together, to hide the latency of aese/aesmc. */
+#define ARMV8_BLOCKS 4
+
+/* SubWord, using aese with a zero round key. ShiftRows has no effect since
+ * every column holds the same word. */
+ARMV8_AES_TARGET inline uint32_t armv8_sub_word(uint32_t w) {
+  uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(w));
+  v = vaeseq_u8(v, vdupq_n_u8(0));
+  return vgetq_lane_u32(vreinterpretq_u32_u8(v), 0);
+}
+
+ARMV8_AES_TARGET void armv8_expand_key(const Octet16& key, uint8x16_t* rk) {
+  uint32_t w[(AES_128_ROUNDS + 1) * 4];
+  memcpy(w, key.data(), OCTET16_LEN);
+  for (int i = 4; i < (AES_128_ROUNDS + 1) * 4; i++) {
+    uint32_t t = w[i - 1];
+    /* words are little endian, so RotWord is a rotation right by a byte */
+    if (i % 4 == 0)
+      t = armv8_sub_word((t >> 8) | (t << 24)) ^ aes_rcon[i / 4 - 1];
+    w[i] = w[i - 4] ^ t;
+  }
+  for (int r = 0; r <= AES_128_ROUNDS; r++)
+    rk[r] = vreinterpretq_u8_u32(vld1q_u32(w + 4 * r));
+}
+
+ARMV8_AES_TARGET void armv8_encrypt_batch(const Octet16* keys,
+                                          const Octet16* in, Octet16* out,
+                                          size_t n) {
+  uint8x16_t rk[ARMV8_BLOCKS][AES_128_ROUNDS + 1];
+  uint8x16_t s[ARMV8_BLOCKS];
+
+  for (size_t first = 0; first < n; first += ARMV8_BLOCKS) {
+    size_t count = std::min<size_t>(n - first, ARMV8_BLOCKS);
+
+    for (size_t b = 0; b < count; b++) {
+      armv8_expand_key(keys[first + b], rk[b]);
+      s[b] = vld1q_u8(in[first + b].data());
+    }
+    /* aese adds the round key before SubBytes, so the last key is added
+     * separately */
+    for (int r = 0; r < AES_128_ROUNDS - 1; r++)
+      for (size_t b = 0; b < count; b++)
+        s[b] = vaesmcq_u8(vaeseq_u8(s[b], rk[b][r]));
+    for (size_t b = 0; b < count; b++) {
+      s[b] = vaeseq_u8(s[b], rk[b][AES_128_ROUNDS - 1]);
+      s[b] = veorq_u8(s[b], rk[b][AES_128_ROUNDS]);
+      vst1q_u8(out[first + b].data(), s[b]);
+    }
+  }
+}
+
+bool armv8_supported() { return (getauxval(AT_HWCAP) & HWCAP_AES) != 0; }
+
+#endif  // AES_BACKEND_ARMV8
+
+const AesBackend aes_backend_bitsliced = {"bitsliced",
+                                          bitsliced_encrypt_batch};
+#if defined(AES_BACKEND_AESNI)
+const AesBackend aes_backend_aesni = {"aesni", aesni_encrypt_batch};
+#endif
+#if defined(AES_BACKEND_ARMV8)
+const AesBackend aes_backend_armv8 = {"armv8", armv8_encrypt_batch};
+#endif
+
+}  // namespace
+
+const AesBackend aes_backend_reference = {"reference",
+                                          reference_encrypt_batch};
+
+/* Ordered so that the preferred backend comes last. */
+const std::vector<const AesBackend*>& aes_backends() {
+  static const std::vector<const AesBackend*> backends = [] {
+    std::vector<const AesBackend*> list = {&aes_backend_reference,
+                                           &aes_backend_bitsliced};
+#if defined(AES_BACKEND_AESNI)
+    if (aesni_supported()) list.push_back(&aes_backend_aesni);
+#endif
+#if defined(AES_BACKEND_ARMV8)
+    if (armv8_supported()) list.push_back(&aes_backend_armv8);
+#endif
+    return list;
+  }();
+  return backends;
+}
+
+const AesBackend& aes_backend() {
+  static const AesBackend* backend = aes_backends().back();
+  return *backend;
+}
+
+}  // namespace crypto_toolbox
@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "stack/include/bt_types.h"
+
+namespace crypto_toolbox {
+
+/* Encrypts |in[i]| under |keys[i]| into |out[i]| for every i < |n| with
+ * AES-128. Keys and blocks use the FIPS-197 byte order of aes.h (most
+ * significant byte first), not the little endian order of aes_128. |out| may
+ * alias |in|. */
+typedef void (*aes_128_batch_fn)(const Octet16* keys, const Octet16* in,
+                                 Octet16* out, size_t n);
+
+typedef struct {
+  const char* name;
+  aes_128_batch_fn encrypt_batch;
+} AesBackend;
+
+/* The table driven implementation in aes.cc. Always available. */
+extern const AesBackend aes_backend_reference;
+
+/* Every backend that can run on this CPU, starting with
+ * aes_backend_reference. */
+const std::vector<const AesBackend*>& aes_backends();
+
+/* The backend used by aes_128 and aes_128_batch: the AES instructions of the
+ * CPU when it has them, otherwise a constant time bitsliced implementation.
+ * Selected once, on first use. */
+const AesBackend& aes_backend();
+
+}  // namespace crypto_toolbox
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "stack/crypto_toolbox/aes.h"
+#include "stack/crypto_toolbox/aes_backend.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
 #include <base/logging.h>
@@ -58,23 +59,39 @@ static void xor_128(Octet16* a, const Octet16& b) {
 }
 }  // namespace
 
+/* Blocks reversed into FIPS-197 byte order per call to the backend. */
+#define AES_BATCH_CHUNK 16
+
 /* This function computes AES_128(key, message) */
 Octet16 aes_128(const Octet16& key, const Octet16& message) {
-  Octet16 key_reversed;
-  Octet16 message_reversed;
   Octet16 output;
-
-  std::reverse_copy(key.begin(), key.end(), key_reversed.begin());
-  std::reverse_copy(message.begin(), message.end(), message_reversed.begin());
-
-  aes_context ctx;
-  aes_set_key(key_reversed.data(), key_reversed.size(), &ctx);
-  aes_encrypt(message_reversed.data(), output.data(), &ctx);
-
-  std::reverse(output.begin(), output.end());
+  aes_128_batch(&key, &message, &output, 1);
   return output;
 }
 
+void aes_128_batch(const Octet16* keys, const Octet16* messages,
+                   Octet16* out, size_t n) {
+  const AesBackend& backend = aes_backend();
+  Octet16 keys_reversed[AES_BATCH_CHUNK];
+  Octet16 blocks[AES_BATCH_CHUNK];
+
+  for (size_t first = 0; first < n; first += AES_BATCH_CHUNK) {
+    size_t count = std::min<size_t>(n - first, AES_BATCH_CHUNK);
+    for (size_t i = 0; i < count; i++) {
+      std::reverse_copy(keys[first + i].begin(), keys[first + i].end(),
+                        keys_reversed[i].begin());
+      std::reverse_copy(messages[first + i].begin(), messages[first + i].end(),
+                        blocks[i].begin());
+    }
+
+    backend.encrypt_batch(keys_reversed, blocks, blocks, count);
+
+    for (size_t i = 0; i < count; i++)
+      std::reverse_copy(blocks[i].begin(), blocks[i].end(),
+                        out[first + i].begin());
+  }
+}
+
 /** utility function to padding the given text to be a 128 bits data. The
  * parameter dest is input and output parameter, it must point to a
  * OCTET16_LEN memory space; where include length bytes valid data. */
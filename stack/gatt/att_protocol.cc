@@ -332,14 +332,14 @@ BT_HDR* attp_build_value_cmd(uint16_t payload_size, uint8_t op_code,
  * Returns          None.
  *
  ******************************************************************************/
-BT_HDR* attp_build_multi_ntf_cmd(uint16_t payload_size, tGATT_MULTI_NOTIF multi_ntf) {
+BT_HDR* attp_build_multi_ntf_cmd(uint16_t payload_size,
+                                 const tGATT_MULTI_NOTIF& multi_ntf) {
   uint8_t *p;
   BT_HDR* p_buf =
       (BT_HDR*)osi_malloc(sizeof(BT_HDR) + payload_size + L2CAP_MIN_OFFSET);
   uint16_t len = 0;
   uint16_t handle = -1;
   uint16_t hdl_len_bytes = 4;
-  std::vector<uint8_t> value;
 
   p = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
   UINT8_TO_STREAM(p, GATT_MULTI_HANDLE_VALUE_NOTIF);
@@ -355,11 +355,8 @@ BT_HDR* attp_build_multi_ntf_cmd(uint16_t payload_size, tGATT_MULTI_NOTIF multi_
     if ((payload_size - p_buf->len) >= (len+ hdl_len_bytes)) {
       UINT16_TO_STREAM(p, handle);
       UINT16_TO_STREAM(p, len);
-      value = multi_ntf.values[i];
-      for (uint8_t j=0; j<len; j++) {
-        *p = value[j];
-        p++;
-      }
+      memcpy(p, multi_ntf.values[i].data(), len);
+      p += len;
       p_buf->len += hdl_len_bytes + len;
     }
     else {
@@ -130,13 +130,20 @@ static bool is_gatt_attr_type(const Uuid& uuid) {
   return false;
 }
 
-/** Update the the last service info for the service list info */
+/** Update the the last service info and the index for the service list info
+ */
 static void gatt_update_last_srv_info() {
   gatt_cb.last_service_handle = 0;
 
   for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
     gatt_cb.last_service_handle = el.s_hdl;
   }
+
+  gatt_sr_index.Build(*gatt_cb.srv_list_info,
+                      [](tGATT_SRV_LIST_ELEM& el) -> const Uuid* {
+                        if (el.type != GATT_UUID_PRI_SERVICE) return nullptr;
+                        return gatts_get_service_uuid(el.p_db);
+                      });
 }
 
 /*******************************************************************************
@@ -432,6 +439,9 @@ tGATT_STATUS GATTS_HandleValueIndication(uint16_t conn_id, uint16_t attr_handle,
 
   if (!GATT_HANDLE_IS_VALID(attr_handle)) return GATT_ILLEGAL_PARAMETER;
 
+  /* held notifications go out ahead of the indication */
+  gatt_sr_flush_multi_notif(*p_tcb);
+
   tGATT_VALUE indication;
   indication.conn_id = conn_id;
   indication.handle = attr_handle;
@@ -556,6 +566,12 @@ tGATT_STATUS GATTS_HandleValueNotification(uint16_t conn_id,
     }
   }
 
+  if (gatt_cb.multi_notif_coalesce_ms > 0 &&
+      (btif_storage_get_cl_supp_feat(p_tcb->peer_bda) &
+       CL_MULTI_NOTIF_SUPPORTED) &&
+      gatt_sr_hold_notif(*p_tcb, lcid, &notif))
+    return GATT_SUCCESS;
+
   tGATT_STATUS cmd_sent;
   tGATT_SR_MSG gatt_sr_msg;
   gatt_sr_msg.attr_value = notif;
@@ -625,6 +641,9 @@ tGATT_STATUS GATTS_MultiHandleValueNotifications(uint16_t conn_id,
     return GATT_REQ_NOT_SUPPORTED;
   }
 
+  /* held notifications go out ahead of these */
+  gatt_sr_flush_multi_notif(*p_tcb);
+
   multi_ntf.auth_req = GATT_AUTH_REQ_NONE;
   multi_ntf.conn_id = conn_id;
   multi_ntf.num_attr = num_attr;
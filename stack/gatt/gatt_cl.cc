@@ -24,6 +24,7 @@
 
 #include "bt_target.h"
 
+#include <stddef.h>
 #include <string.h>
 #include "bt_common.h"
 #include "bt_utils.h"
@@ -632,6 +633,21 @@ void gatt_process_prep_write_rsp(tGATT_TCB& tcb, tGATT_CLCB* p_clcb,
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         gatt_clear_notif_value
+ *
+ * Description      Clears the fields of a notified value. The value buffer is
+ *                  left alone, as only the received length of it is read.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void gatt_clear_notif_value(tGATT_VALUE* p_value) {
+  memset(p_value, 0, offsetof(tGATT_VALUE, value));
+  p_value->read_sub_type = 0;
+}
+
 /*******************************************************************************
  *
  * Function         gatt_process_notification
@@ -643,7 +659,8 @@ void gatt_process_prep_write_rsp(tGATT_TCB& tcb, tGATT_CLCB* p_clcb,
  ******************************************************************************/
 void gatt_process_notification(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
                                uint16_t len, uint8_t* p_data) {
-  tGATT_VALUE value;
+  tGATT_CL_COMPLETE gatt_cl_complete;
+  tGATT_VALUE& value = gatt_cl_complete.att_value;
   tGATT_REG* p_reg;
   uint16_t conn_id;
   tGATT_STATUS encrypt_status;
@@ -662,7 +679,7 @@ void gatt_process_notification(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
     return;
   }
 
-  memset(&value, 0, sizeof(value));
+  gatt_clear_notif_value(&value);
   STREAM_TO_UINT16(value.handle, p);
   value.len = len - 2;
   memcpy(value.value, p, value.len);
@@ -708,8 +725,6 @@ void gatt_process_notification(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
   }
 
   encrypt_status = gatt_get_link_encrypt_status(tcb);
-  tGATT_CL_COMPLETE gatt_cl_complete;
-  gatt_cl_complete.att_value = value;
 
   if (tcb.is_eatt_supported) {
     p_eatt_bcb = gatt_find_eatt_bcb_by_cid(&tcb, lcid);
@@ -745,7 +760,8 @@ void gatt_process_notification(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
  ******************************************************************************/
 void gatt_process_multi_notification(tGATT_TCB& tcb, uint16_t lcid,
                                      uint16_t len, uint8_t* p_data) {
-  tGATT_VALUE value;
+  tGATT_CL_COMPLETE gatt_cl_complete;
+  tGATT_VALUE& value = gatt_cl_complete.att_value;
   tGATT_REG* p_reg;
   uint16_t conn_id;
   tGATT_STATUS encrypt_status;
@@ -763,7 +779,7 @@ void gatt_process_multi_notification(tGATT_TCB& tcb, uint16_t lcid,
   }
 
   while (len > hdl_length_bytes) {
-    memset(&value, 0, sizeof(value));
+    gatt_clear_notif_value(&value);
     STREAM_TO_UINT16(value.handle, p);
     if (!GATT_HANDLE_IS_VALID(value.handle)) {
       LOG(ERROR) << " Handle is invalid";
@@ -780,8 +796,6 @@ void gatt_process_multi_notification(tGATT_TCB& tcb, uint16_t lcid,
     p += value.len;
 
     encrypt_status = gatt_get_link_encrypt_status(tcb);
-    tGATT_CL_COMPLETE gatt_cl_complete;
-    gatt_cl_complete.att_value = value;
 
     if (tcb.is_eatt_supported) {
       p_eatt_bcb = gatt_find_eatt_bcb_by_cid(&tcb, lcid);
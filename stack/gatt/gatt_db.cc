@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "btm_int.h"
 #include "gatt_int.h"
 #include "l2c_api.h"
@@ -261,9 +262,14 @@ tGATT_STATUS gatts_db_read_attr_value_by_type(
   uint16_t len = 0;
   uint8_t* p = (uint8_t*)(p_rsp + 1) + p_rsp->len + L2CAP_MIN_OFFSET;
 
-  if (p_db) {
-    for (tGATT_ATTR& attr : p_db->attr_list) {
-      if (attr.handle >= s_handle && type == attr.uuid) {
+  if (p_db && !p_db->attr_list.empty()) {
+    uint16_t first = std::max(s_handle, p_db->attr_list.front().handle);
+    uint16_t last = std::min(e_handle, p_db->attr_list.back().handle);
+    auto handles = gatt_sr_index.HandlesOfType(type, first, last);
+    for (auto it = handles.first; it != handles.second; ++it) {
+      tGATT_ATTR* p_attr = find_attr_by_handle(p_db, *it);
+      if (p_attr != nullptr) {
+        tGATT_ATTR& attr = *p_attr;
         if (*p_len <= 2) {
           status = GATT_NO_RESOURCES;
           break;
@@ -411,14 +417,15 @@ uint16_t gatts_add_char_descr(tGATT_SVC_DB& db, tGATT_PERM perm,
 /* Service Attribute Database Query Utility Functions */
 /******************************************************************************/
 tGATT_ATTR* find_attr_by_handle(tGATT_SVC_DB* p_db, uint16_t handle) {
-  if (!p_db) return nullptr;
+  if (!p_db || p_db->attr_list.empty()) return nullptr;
 
-  for (auto& attr : p_db->attr_list) {
-    if (attr.handle == handle) return &attr;
-    if (attr.handle > handle) return nullptr;
-  }
+  /* attributes are given consecutive handles, see allocate_attr_in_db */
+  uint16_t first = p_db->attr_list[0].handle;
+  if (handle < first || (size_t)(handle - first) >= p_db->attr_list.size())
+    return nullptr;
 
-  return nullptr;
+  tGATT_ATTR& attr = p_db->attr_list[handle - first];
+  return attr.handle == handle ? &attr : nullptr;
 }
 
 /*******************************************************************************
@@ -24,6 +24,8 @@
 #include "btm_ble_api.h"
 #include "btu.h"
 #include "gatt_api.h"
+#include "gatt_multi_notif.h"
+#include "gatt_sr_index.h"
 #include "osi/include/fixed_queue.h"
 
 #include <base/strings/stringprintf.h>
@@ -252,6 +254,7 @@ typedef struct {
   uint16_t lcid;
   BT_HDR* p_msg;
 } tGATT_PEND_SRVC_DISC_RSP;
+
 typedef struct hdl_list_elem {
   tGATTS_HNDL_RANGE asgn_range; /* assigned handle range */
   tGATT_SVC_DB svc_db;
@@ -303,6 +306,12 @@ typedef struct {
   std::queue<tGATT_CMD_Q> cl_cmd_q;
   alarm_t* ind_ack_timer; /* local app confirm to indication timer */
 
+  /* notifications held back to be sent together */
+  GattMultiNotifQueue<tGATT_MULTI_NOTIF, GATT_MAX_MULTI_HANDLE_NOTIF>
+      multi_notif_q;
+  alarm_t* multi_notif_timer; /* latency budget of the held notifications */
+  std::unordered_set<uint16_t> congested_cids; /* bearers L2CAP congested */
+
   bool in_use;
   uint8_t tcb_idx;
 
@@ -491,6 +500,8 @@ typedef struct {
 
   bool eatt_enabled;
   std::vector<RawAddress> eatt_devices_list;
+  /* how long notifications may be held back, 0 if they are not */
+  uint64_t multi_notif_coalesce_ms;
   tGATT_EBCB eatt_bcb[GATT_MAX_EATT_CHANNELS]; /* EATT Bearer control block */
   std::vector<tGATT_CONN> gatt_conn_list;
 } tGATT_CB;
@@ -499,6 +510,8 @@ typedef struct {
 
 /* Global GATT data */
 extern tGATT_CB gatt_cb;
+/* Lookups over gatt_cb.srv_list_info */
+extern GattSrIndex<std::list<tGATT_SRV_LIST_ELEM>> gatt_sr_index;
 
 #if (GATT_CONFORMANCE_TESTING == TRUE)
 extern void gatt_set_err_rsp(bool enable, uint8_t req_op_code,
@@ -538,7 +551,8 @@ extern BT_HDR* attp_build_sr_msg(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
 extern tGATT_STATUS attp_send_sr_msg(tGATT_TCB& tcb, uint16_t lcid, BT_HDR* p_msg);
 extern tGATT_STATUS attp_send_msg_to_l2cap(tGATT_TCB& tcb, uint16_t lcid, BT_HDR* p_toL2CAP);
 
-extern BT_HDR* attp_build_multi_ntf_cmd(uint16_t payload_size, tGATT_MULTI_NOTIF multi_ntf);
+extern BT_HDR* attp_build_multi_ntf_cmd(uint16_t payload_size,
+                                        const tGATT_MULTI_NOTIF& multi_ntf);
 
 
 /* utility functions */
@@ -602,6 +616,11 @@ extern void gatt_sr_send_req_callback(uint16_t conn_id, uint32_t trans_id,
                                       uint8_t op_code, tGATTS_DATA* p_req_data);
 extern uint32_t gatt_sr_enqueue_cmd(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
                                     uint16_t handle);
+extern bool gatt_sr_hold_notif(tGATT_TCB& tcb, uint16_t lcid,
+                               tGATT_VALUE* p_notif);
+extern tGATT_STATUS gatt_sr_send_multi_notif(tGATT_TCB& tcb, uint16_t lcid);
+extern void gatt_sr_flush_multi_notif(tGATT_TCB& tcb);
+extern void gatt_multi_notif_timeout(void* data);
 extern bool gatt_cancel_open(tGATT_IF gatt_if, const RawAddress& bda);
 extern void gatt_notify_phy_updated(uint8_t status, uint16_t handle,
                                     uint8_t tx_phy, uint8_t rx_phy);
@@ -690,6 +709,7 @@ extern tGATT_STATUS gatts_read_attr_perm_check(tGATT_SVC_DB* p_db, bool is_long,
                                                tGATT_SEC_FLAG sec_flag,
                                                uint8_t key_size);
 extern bluetooth::Uuid* gatts_get_service_uuid(tGATT_SVC_DB* p_db);
+extern tGATT_ATTR* find_attr_by_handle(tGATT_SVC_DB* p_db, uint16_t handle);
 extern void gatt_free_pending_ind(tGATT_TCB* p_tcb, uint16_t lcid);
 
 extern bool gatt_profile_sr_is_eatt_supported(uint16_t conn_id, uint16_t handle);
@@ -49,6 +49,11 @@ using base::StringPrintf;
  */
 #define GATT_MIN_BR_MTU_SIZE 48
 
+/* How long notifications may be held back, in ms, overriding
+ * GATT_MULTI_NOTIF_COALESCE_MS */
+#define GATT_MULTI_NOTIF_COALESCE_PROPERTY \
+  "persist.bluetooth.gatt_multi_notif_coalesce_ms"
+
 /******************************************************************************/
 /*            L O C A L    F U N C T I O N     P R O T O T Y P E S            */
 /******************************************************************************/
@@ -118,6 +123,7 @@ static const tL2CAP_COC_APPL_INFO eatt_dyn_info = {gatt_l2cif_eatt_connect_ind_c
                                                   };
 
 tGATT_CB gatt_cb;
+GattSrIndex<std::list<tGATT_SRV_LIST_ELEM>> gatt_sr_index;
 
 /*******************************************************************************
  *
@@ -163,6 +169,10 @@ void gatt_init(void) {
     gatt_cb.eatt_enabled = false;
   }
 
+  int32_t coalesce_ms = osi_property_get_int32(
+      GATT_MULTI_NOTIF_COALESCE_PROPERTY, GATT_MULTI_NOTIF_COALESCE_MS);
+  gatt_cb.multi_notif_coalesce_ms = coalesce_ms > 0 ? coalesce_ms : 0;
+
   L2CA_RegisterFixedChannel(L2CAP_ATT_CID, &fixed_reg);
 
   /* Now, register with L2CAP for ATT PSM over BR/EDR */
@@ -232,6 +242,11 @@ void gatt_free(void) {
     alarm_free(gatt_cb.tcb[i].ind_ack_timer);
     gatt_cb.tcb[i].ind_ack_timer = NULL;
 
+    alarm_cancel(gatt_cb.tcb[i].multi_notif_timer);
+    alarm_free(gatt_cb.tcb[i].multi_notif_timer);
+    gatt_cb.tcb[i].multi_notif_timer = NULL;
+    gatt_cb.tcb[i].multi_notif_q.Clear();
+
     fixed_queue_free(gatt_cb.tcb[i].sr_cmd.multi_rsp_q, NULL);
     gatt_cb.tcb[i].sr_cmd.multi_rsp_q = NULL;
   }
@@ -258,6 +273,7 @@ void gatt_free(void) {
     gatt_cb.hdl_list_info = nullptr;
   }
 
+  gatt_sr_index.Clear();
   if (gatt_cb.srv_list_info != nullptr) {
     gatt_cb.srv_list_info->clear();
     delete(gatt_cb.srv_list_info);
@@ -578,6 +594,9 @@ bool gatt_act_connect(tGATT_REG* p_reg, const RawAddress& bd_addr,
                     p_reg->gatt_if)) {
     LOG(ERROR) << "gatt_connect failed";
     fixed_queue_free(p_tcb->pending_ind_q, NULL);
+    alarm_free(p_tcb->conf_timer);
+    alarm_free(p_tcb->ind_ack_timer);
+    alarm_free(p_tcb->multi_notif_timer);
     *p_tcb = tGATT_TCB();
     return false;
   }
@@ -691,6 +710,14 @@ static void gatt_channel_congestion(tGATT_TCB* p_tcb, bool congested, uint16_t l
   tGATT_REG* p_reg = NULL;
   uint16_t conn_id;
 
+  /* notifications aren't held back on a congested bearer */
+  if (p_tcb != NULL) {
+    if (congested)
+      p_tcb->congested_cids.insert(lcid);
+    else
+      p_tcb->congested_cids.erase(lcid);
+  }
+
   /* if uncongested, check to see if there is any more pending data */
   if (p_tcb != NULL && !congested) {
     gatt_cl_send_next_cmd_inq(*p_tcb, lcid);
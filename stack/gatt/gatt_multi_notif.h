@@ -0,0 +1,132 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <list>
+#include <utility>
+
+/* handle and length ahead of each value of a Multiple Handle Value
+ * Notification */
+#define GATT_MULTI_NOTIF_ATTR_HDR_LEN 4
+
+/* The notifications the GATT server holds back to send them together in
+ * Multiple Handle Value Notifications, one PDU in the making per bearer.
+ *
+ * |MultiNotif| is tGATT_MULTI_NOTIF: conn_id, num_attr, auth_req, and the
+ * handles, lens and values of up to |kMaxAttr| notifications. When to send
+ * them, and how, is left to the caller. Not thread safe; only used on the btu
+ * thread. */
+template <typename MultiNotif, uint8_t kMaxAttr>
+class GattMultiNotifQueue {
+ public:
+  /* Holds |notif|, a tGATT_VALUE, back on bearer |lcid|, whose PDUs take up
+   * to |payload_size| bytes. The notifications held on the bearer are sent
+   * first with |send(lcid)| if |notif| would not fit their PDU, is a newer
+   * value of one of them or comes from another app, or if the bearer
+   * |is_busy|: congested or out of credits. |send| takes them with Take()
+   * and returns whether they went out.
+   *
+   * Returns true if |notif| is held, false if it is to be sent on its own
+   * now: the bearer is busy, sending the held ones failed, or it is too long
+   * to share a PDU. */
+  template <typename Value, typename SendFn>
+  bool Hold(uint16_t lcid, uint16_t payload_size, bool is_busy,
+            const Value& notif, SendFn send) {
+    uint16_t attr_len = GATT_MULTI_NOTIF_ATTR_HDR_LEN + notif.len;
+
+    auto it = Find(lcid);
+    if (it != pending_.end()) {
+      MultiNotif& multi_ntf = it->multi_ntf;
+      uint16_t* handles_end = multi_ntf.handles + multi_ntf.num_attr;
+      bool is_full = multi_ntf.num_attr == kMaxAttr ||
+                     it->len + attr_len > payload_size;
+      bool is_next =
+          multi_ntf.conn_id != notif.conn_id ||
+          std::find(multi_ntf.handles, handles_end, notif.handle) !=
+              handles_end;
+      if (is_full || is_next || is_busy) {
+        if (!send(lcid)) return false;
+        it = pending_.end();
+      }
+    }
+
+    if (is_busy || 1 + attr_len > payload_size) return false;
+
+    if (it == pending_.end()) {
+      pending_.emplace_back();
+      it = std::prev(pending_.end());
+      it->lcid = lcid;
+      it->len = 1;
+      it->multi_ntf.conn_id = notif.conn_id;
+      it->multi_ntf.num_attr = 0;
+      it->multi_ntf.auth_req = 0;
+    }
+
+    MultiNotif& multi_ntf = it->multi_ntf;
+    multi_ntf.handles[multi_ntf.num_attr] = notif.handle;
+    multi_ntf.lens[multi_ntf.num_attr] = notif.len;
+    multi_ntf.values.emplace_back(notif.value, notif.value + notif.len);
+    multi_ntf.num_attr++;
+    it->len += attr_len;
+    return true;
+  }
+
+  /* Moves the notifications held on bearer |lcid| to |*p_multi_ntf| and
+   * returns true, or returns false if there are none. */
+  bool Take(uint16_t lcid, MultiNotif* p_multi_ntf) {
+    auto it = Find(lcid);
+    if (it == pending_.end()) return false;
+    *p_multi_ntf = std::move(it->multi_ntf);
+    pending_.erase(it);
+    return true;
+  }
+
+  /* Sends the notifications held on every bearer with |send(lcid)|, which
+   * takes them with Take(), in the order the bearers were first held on. */
+  template <typename SendFn>
+  void Flush(SendFn send) {
+    while (!pending_.empty()) {
+      uint16_t lcid = pending_.front().lcid;
+      send(lcid);
+      if (!pending_.empty() && pending_.front().lcid == lcid)
+        pending_.pop_front();
+    }
+  }
+
+  bool Empty() const { return pending_.empty(); }
+  void Clear() { pending_.clear(); }
+
+ private:
+  struct Pending {
+    uint16_t lcid;
+    uint16_t len; /* of the PDU built so far */
+    MultiNotif multi_ntf;
+  };
+
+  typename std::list<Pending>::iterator Find(uint16_t lcid) {
+    return std::find_if(
+        pending_.begin(), pending_.end(),
+        [lcid](const Pending& pending) { return pending.lcid == lcid; });
+  }
+
+  std::list<Pending> pending_;
+};
@@ -28,6 +28,7 @@
 
 #include <log/log.h>
 #include <string.h>
+#include <algorithm>
 
 #include "gatt_int.h"
 #include "l2c_api.h"
@@ -594,14 +595,15 @@ static tGATT_STATUS gatt_build_primary_service_rsp(
 
   uint8_t* p = (uint8_t*)(p_msg + 1) + L2CAP_MIN_OFFSET;
 
-  for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
+  /* Adds |el| to the response; returns false once the response is full. */
+  auto add_service = [&](tGATT_SRV_LIST_ELEM& el) {
     if (el.s_hdl < s_hdl || el.s_hdl > e_hdl ||
         el.type != GATT_UUID_PRI_SERVICE) {
-      continue;
+      return true;
     }
 
     Uuid* p_uuid = gatts_get_service_uuid(el.p_db);
-    if (!p_uuid) continue;
+    if (!p_uuid) return true;
 
     if (op_code == GATT_REQ_READ_BY_GRP_TYPE)
       handle_len = 4 + gatt_build_uuid_to_stream_len(*p_uuid);
@@ -620,10 +622,10 @@ static tGATT_STATUS gatt_build_primary_service_rsp(
 
     if (p_msg->len + p_msg->offset > payload_size ||
         handle_len != p_msg->offset) {
-      break;
+      return false;
     }
 
-    if (op_code == GATT_REQ_FIND_TYPE_VALUE && value != *p_uuid) continue;
+    if (op_code == GATT_REQ_FIND_TYPE_VALUE && value != *p_uuid) return true;
 
     UINT16_TO_STREAM(p, el.s_hdl);
 
@@ -641,6 +643,19 @@ static tGATT_STATUS gatt_build_primary_service_rsp(
 
     status = GATT_SUCCESS;
     p_msg->len += p_msg->offset;
+    return true;
+  };
+
+  if (op_code == GATT_REQ_FIND_TYPE_VALUE) {
+    /* only the services with the UUID asked for */
+    const auto* p_services = gatt_sr_index.PrimaryServices(value);
+    if (p_services != nullptr) {
+      for (auto it : *p_services)
+        if (!add_service(*it)) break;
+    }
+  } else {
+    for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info)
+      if (!add_service(el)) break;
   }
   p_msg->offset = L2CAP_MIN_OFFSET;
 
@@ -991,24 +1006,33 @@ void gatts_process_read_by_type_req(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_co
   uint16_t buf_len = payload_size - 2;
 
   reason = GATT_NOT_FOUND;
-  for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
-    if (el.s_hdl <= e_hdl && el.e_hdl >= s_hdl) {
-      uint8_t sec_flag, key_size;
-      gatt_sr_get_sec_info(tcb.peer_bda, tcb.transport, &sec_flag, &key_size);
-
-      tGATT_STATUS ret = gatts_db_read_attr_value_by_type(
-          tcb, lcid, el.p_db, op_code, p_msg, s_hdl, e_hdl, uuid, &buf_len, sec_flag,
-          key_size, 0, &err_hdl);
-      if (ret != GATT_NOT_FOUND) {
-        reason = ret;
-        if (ret == GATT_NO_RESOURCES) reason = GATT_SUCCESS;
-      }
+  /* visit only the services holding attributes of the type */
+  auto handles = gatt_sr_index.HandlesOfType(uuid, s_hdl, e_hdl);
+  for (auto h = handles.first; h != handles.second;) {
+    auto srv_it = gatt_sr_find_i_rcb_by_handle(*h);
+    if (srv_it == gatt_cb.srv_list_info->end()) {
+      LOG(ERROR) << __func__ << ": no service holds indexed handle "
+                 << loghex(*h);
+      ++h;
+      continue;
+    }
+    tGATT_SRV_LIST_ELEM& el = *srv_it;
+    uint8_t sec_flag, key_size;
+    gatt_sr_get_sec_info(tcb.peer_bda, tcb.transport, &sec_flag, &key_size);
+
+    tGATT_STATUS ret = gatts_db_read_attr_value_by_type(
+        tcb, lcid, el.p_db, op_code, p_msg, s_hdl, e_hdl, uuid, &buf_len,
+        sec_flag, key_size, 0, &err_hdl);
+    if (ret != GATT_NOT_FOUND) {
+      reason = ret;
+      if (ret == GATT_NO_RESOURCES) reason = GATT_SUCCESS;
+    }
 
-      if (ret != GATT_SUCCESS && ret != GATT_NOT_FOUND) {
-        s_hdl = err_hdl;
-        break;
-      }
+    if (ret != GATT_SUCCESS && ret != GATT_NOT_FOUND) {
+      s_hdl = err_hdl;
+      break;
     }
+    h = std::upper_bound(h, handles.second, el.e_hdl);
   }
   *p = (uint8_t)p_msg->offset;
   p_msg->offset = L2CAP_MIN_OFFSET;
@@ -1222,32 +1246,29 @@ void gatts_process_attribute_req(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_code,
 #endif
 
   if (GATT_HANDLE_IS_VALID(handle)) {
-    for (auto& el : *gatt_cb.srv_list_info) {
-      if (el.s_hdl <= handle && el.e_hdl >= handle) {
-        for (const auto& attr : el.p_db->attr_list) {
-          if (attr.handle == handle) {
-            switch (op_code) {
-              case GATT_REQ_READ: /* read char/char descriptor value */
-              case GATT_REQ_READ_BLOB:
-                gatts_process_read_req(tcb, lcid, el, op_code, handle, len, p);
-                break;
-
-              case GATT_REQ_WRITE: /* write char/char descriptor value */
-              case GATT_CMD_WRITE:
-              case GATT_SIGN_CMD_WRITE:
-              case GATT_REQ_PREPARE_WRITE:
-                gatts_process_write_req(tcb, lcid, el, handle, op_code, len, p,
-                                        attr.gatt_type);
-                break;
-              default:
-                break;
-            }
-            status = GATT_SUCCESS;
-            break;
-          }
-        }
-        break;
+    auto it = gatt_sr_find_i_rcb_by_handle(handle);
+    const tGATT_ATTR* p_attr = nullptr;
+    if (it != gatt_cb.srv_list_info->end())
+      p_attr = find_attr_by_handle(it->p_db, handle);
+    if (p_attr != nullptr) {
+      tGATT_SRV_LIST_ELEM& el = *it;
+      switch (op_code) {
+        case GATT_REQ_READ: /* read char/char descriptor value */
+        case GATT_REQ_READ_BLOB:
+          gatts_process_read_req(tcb, lcid, el, op_code, handle, len, p);
+          break;
+
+        case GATT_REQ_WRITE: /* write char/char descriptor value */
+        case GATT_CMD_WRITE:
+        case GATT_SIGN_CMD_WRITE:
+        case GATT_REQ_PREPARE_WRITE:
+          gatts_process_write_req(tcb, lcid, el, handle, op_code, len, p,
+                                  p_attr->gatt_type);
+          break;
+        default:
+          break;
       }
+      status = GATT_SUCCESS;
     }
   }
 
@@ -1489,3 +1510,160 @@ void gatt_server_handle_client_req(tGATT_TCB& tcb, uint16_t lcid, uint8_t op_cod
     }
   }
 }
+
+/* Whether the bearer is congested or out of credits. Notifications aren't
+ * held back then, so that they queue up and report it as they do unheld. */
+static bool gatt_sr_is_bearer_busy(tGATT_TCB& tcb, uint16_t lcid) {
+  if (tcb.congested_cids.count(lcid)) return true;
+
+  tGATT_EBCB* p_eatt_bcb = gatt_find_eatt_bcb_by_cid(&tcb, lcid);
+  return p_eatt_bcb && p_eatt_bcb->no_credits;
+}
+
+/* Queues held value |i| to be sent on its own once the EATT bearer has
+ * credits again, as GATTS_HandleValueNotification does. */
+static void gatt_sr_enq_held_notif(tGATT_TCB& tcb, uint16_t lcid,
+                                   const tGATT_MULTI_NOTIF& multi_ntf,
+                                   uint8_t i) {
+  tGATT_VALUE notif;
+  notif.conn_id = multi_ntf.conn_id;
+  notif.handle = multi_ntf.handles[i];
+  notif.offset = 0;
+  notif.len = multi_ntf.lens[i];
+  notif.auth_req = GATT_AUTH_REQ_NONE;
+  memcpy(notif.value, multi_ntf.values[i].data(), notif.len);
+  gatt_notif_enq(&tcb, lcid, &notif);
+
+  /* gatt_send_pending_notif takes one entry off per notification sent */
+  tGATT_EBCB* p_eatt_bcb = gatt_find_eatt_bcb_by_cid(&tcb, lcid);
+  if (p_eatt_bcb) p_eatt_bcb->notif_no_credits_apps.push_back(notif.conn_id);
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_hold_notif
+ *
+ * Description      This function holds a notification back to send it along
+ *                  with the next ones of the bearer in a Multiple Handle Value
+ *                  Notification. The held notifications are sent once the
+ *                  PDU is full, or gatt_cb.multi_notif_coalesce_ms after the
+ *                  first of them. The client must support Multiple Handle
+ *                  Value Notifications.
+ *
+ *                  Nothing is held while the bearer is congested or out of
+ *                  credits, or if sending the held notifications failed.
+ *
+ * Returns          true if the notification is held, false if it is to be
+ *                  sent on its own now.
+ *
+ ******************************************************************************/
+bool gatt_sr_hold_notif(tGATT_TCB& tcb, uint16_t lcid, tGATT_VALUE* p_notif) {
+  bool held = tcb.multi_notif_q.Hold(
+      lcid, gatt_get_payload_size(&tcb, lcid),
+      gatt_sr_is_bearer_busy(tcb, lcid), *p_notif, [&tcb](uint16_t cid) {
+        return gatt_sr_send_multi_notif(tcb, cid) == GATT_SUCCESS;
+      });
+  if (held && !alarm_is_scheduled(tcb.multi_notif_timer))
+    alarm_set_on_mloop(tcb.multi_notif_timer, gatt_cb.multi_notif_coalesce_ms,
+                       gatt_multi_notif_timeout, &tcb);
+  return held;
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_send_multi_notif
+ *
+ * Description      This function sends the notifications held back for a
+ *                  bearer. A single notification, or ones the Multiple Handle
+ *                  Value Notification can't be built for, are sent as Handle
+ *                  Value Notifications. What the bearer has no credits for is
+ *                  queued to be sent on its own once it has.
+ *
+ * Returns          GATT_SUCCESS if all were sent, GATT_NO_CREDITS if some had
+ *                  to be queued, otherwise the first other status.
+ *
+ ******************************************************************************/
+tGATT_STATUS gatt_sr_send_multi_notif(tGATT_TCB& tcb, uint16_t lcid) {
+  tGATT_MULTI_NOTIF multi_ntf;
+  if (!tcb.multi_notif_q.Take(lcid, &multi_ntf)) return GATT_SUCCESS;
+  if (tcb.multi_notif_q.Empty()) alarm_cancel(tcb.multi_notif_timer);
+
+  VLOG(1) << __func__ << " lcid:" << loghex(lcid)
+          << " num_attr:" << +multi_ntf.num_attr;
+
+  BT_HDR* p_buf = NULL;
+  if (multi_ntf.num_attr > 1)
+    p_buf = attp_build_multi_ntf_cmd(gatt_get_payload_size(&tcb, lcid),
+                                     multi_ntf);
+
+  tGATT_STATUS status = GATT_SUCCESS;
+  if (p_buf != NULL) {
+    status = attp_send_sr_msg(tcb, lcid, p_buf);
+    if (status == GATT_NO_CREDITS) {
+      for (uint8_t i = 0; i < multi_ntf.num_attr; i++)
+        gatt_sr_enq_held_notif(tcb, lcid, multi_ntf, i);
+    }
+  } else {
+    for (uint8_t i = 0; i < multi_ntf.num_attr; i++) {
+      if (status == GATT_NO_CREDITS) {
+        gatt_sr_enq_held_notif(tcb, lcid, multi_ntf, i);
+        continue;
+      }
+
+      tGATT_SR_MSG gatt_sr_msg;
+      tGATT_VALUE& notif = gatt_sr_msg.attr_value;
+      notif.conn_id = multi_ntf.conn_id;
+      notif.handle = multi_ntf.handles[i];
+      notif.offset = 0;
+      notif.len = multi_ntf.lens[i];
+      notif.auth_req = GATT_AUTH_REQ_NONE;
+      memcpy(notif.value, multi_ntf.values[i].data(), notif.len);
+      p_buf =
+          attp_build_sr_msg(tcb, lcid, GATT_HANDLE_VALUE_NOTIF, &gatt_sr_msg);
+
+      tGATT_STATUS sent = p_buf != NULL ? attp_send_sr_msg(tcb, lcid, p_buf)
+                                        : GATT_NO_RESOURCES;
+      if (sent == GATT_NO_CREDITS)
+        gatt_sr_enq_held_notif(tcb, lcid, multi_ntf, i);
+      if (status == GATT_SUCCESS || sent == GATT_NO_CREDITS) status = sent;
+    }
+  }
+
+  if (status != GATT_SUCCESS && status != GATT_CONGESTED &&
+      status != GATT_NO_CREDITS)
+    LOG(ERROR) << __func__ << " failed to send notifications, status:"
+               << loghex(status);
+  return status;
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_flush_multi_notif
+ *
+ * Description      This function sends the notifications held back for all
+ *                  bearers of the link.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void gatt_sr_flush_multi_notif(tGATT_TCB& tcb) {
+  tcb.multi_notif_q.Flush(
+      [&tcb](uint16_t lcid) { gatt_sr_send_multi_notif(tcb, lcid); });
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_multi_notif_timeout
+ *
+ * Description      Called when the latency budget of the held notifications
+ *                  runs out.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void gatt_multi_notif_timeout(void* data) {
+  tGATT_TCB* p_tcb = (tGATT_TCB*)data;
+
+  if (!p_tcb->in_use) return;
+  gatt_sr_flush_multi_notif(*p_tcb);
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bluetooth/uuid.h>
+
+/* Lookups over the services published by the GATT server, so that requests
+ * against a large database do not walk the service list and every attribute
+ * list in it:
+ *  - the service owning a handle, by binary search over the service ranges;
+ *  - the handles of the attributes of a type, in order, for Read By Type;
+ *  - the primary services with a given UUID, for Find By Type Value.
+ *
+ * |List| is the std::list of services. Its elements have s_hdl and e_hdl, and
+ * p_db, whose attr_list holds the attributes, with handle and uuid, in handle
+ * order. The attribute lists do not change while a service runs, so the
+ * index is only built again when a service is started or stopped. Not thread
+ * safe; only used on the btu thread. */
+template <typename List>
+class GattSrIndex {
+ public:
+  typedef typename List::iterator Iterator;
+  typedef std::vector<uint16_t>::const_iterator HandleIterator;
+
+  GattSrIndex() = default;
+  GattSrIndex(const GattSrIndex&) = delete;
+  GattSrIndex& operator=(const GattSrIndex&) = delete;
+
+  /* Indexes |services|. |service_uuid(service)| returns the UUID of a primary
+   * service, or nullptr for any other. */
+  template <typename ServiceUuidFn>
+  void Build(List& services, ServiceUuidFn service_uuid) {
+    Clear();
+    for (Iterator it = services.begin(); it != services.end(); ++it) {
+      ranges_.push_back({it->s_hdl, it->e_hdl, it});
+      const bluetooth::Uuid* p_uuid = service_uuid(*it);
+      if (p_uuid != nullptr) primary_[*p_uuid].push_back(it);
+      if (it->p_db == nullptr) continue;
+      for (const auto& attr : it->p_db->attr_list)
+        types_[attr.uuid].push_back(attr.handle);
+    }
+
+    auto by_start = [](const Range& a, const Range& b) {
+      return a.s_hdl < b.s_hdl;
+    };
+    std::sort(ranges_.begin(), ranges_.end(), by_start);
+    for (auto& type : types_) std::sort(type.second.begin(), type.second.end());
+    for (auto& uuid : primary_)
+      std::sort(uuid.second.begin(), uuid.second.end(),
+                [](Iterator a, Iterator b) { return a->s_hdl < b->s_hdl; });
+  }
+
+  /* Sets |*p_it| to the service whose range holds |handle| and returns true,
+   * or returns false and leaves |*p_it| alone. */
+  bool Find(uint16_t handle, Iterator* p_it) const {
+    auto range = std::upper_bound(
+        ranges_.begin(), ranges_.end(), handle,
+        [](uint16_t h, const Range& r) { return h < r.s_hdl; });
+    if (range == ranges_.begin()) return false;
+    --range;
+    if (handle > range->e_hdl) return false;
+    *p_it = range->service;
+    return true;
+  }
+
+  /* The handles of the attributes of |type| from |s_hdl| to |e_hdl|, in
+   * order. */
+  std::pair<HandleIterator, HandleIterator> HandlesOfType(
+      const bluetooth::Uuid& type, uint16_t s_hdl, uint16_t e_hdl) const {
+    auto it = types_.find(type);
+    if (it == types_.end() || s_hdl > e_hdl)
+      return {empty_.end(), empty_.end()};
+    const std::vector<uint16_t>& handles = it->second;
+    return {std::lower_bound(handles.begin(), handles.end(), s_hdl),
+            std::upper_bound(handles.begin(), handles.end(), e_hdl)};
+  }
+
+  /* The primary services with |uuid|, by starting handle, or nullptr. */
+  const std::vector<Iterator>* PrimaryServices(
+      const bluetooth::Uuid& uuid) const {
+    auto it = primary_.find(uuid);
+    return it == primary_.end() ? nullptr : &it->second;
+  }
+
+  void Clear() {
+    ranges_.clear();
+    types_.clear();
+    primary_.clear();
+  }
+
+ private:
+  struct Range {
+    uint16_t s_hdl;
+    uint16_t e_hdl;
+    Iterator service;
+  };
+
+  /* std::hash<Uuid> builds a std::string on every call. */
+  struct UuidHash {
+    size_t operator()(const bluetooth::Uuid& uuid) const {
+      uint64_t words[2];
+      memcpy(words, uuid.To128BitBE().data(), sizeof(words));
+      return words[0] ^ (words[1] * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+
+  std::vector<Range> ranges_;
+  std::unordered_map<bluetooth::Uuid, std::vector<uint16_t>, UuidHash> types_;
+  std::unordered_map<bluetooth::Uuid, std::vector<Iterator>, UuidHash>
+      primary_;
+  const std::vector<uint16_t> empty_;
+};
@@ -497,6 +497,7 @@ tGATT_TCB* gatt_allocate_tcb_by_bdaddr(const RawAddress& bda,
     p_tcb->pending_ind_q = fixed_queue_new(SIZE_MAX);
     p_tcb->conf_timer = alarm_new("gatt.conf_timer");
     p_tcb->ind_ack_timer = alarm_new("gatt.ind_ack_timer");
+    p_tcb->multi_notif_timer = alarm_new("gatt.multi_notif_timer");
     p_tcb->in_use = true;
     p_tcb->tcb_idx = i;
     p_tcb->transport = transport;
@@ -856,14 +857,8 @@ void gatt_ind_ack_eatt_timeout(void* data) {
  ******************************************************************************/
 std::list<tGATT_SRV_LIST_ELEM>::iterator gatt_sr_find_i_rcb_by_handle(
     uint16_t handle) {
-  auto it = gatt_cb.srv_list_info->begin();
-
-  for (; it != gatt_cb.srv_list_info->end(); it++) {
-    if (it->s_hdl <= handle && it->e_hdl >= handle) {
-      return it;
-    }
-  }
-
+  auto it = gatt_cb.srv_list_info->end();
+  gatt_sr_index.Find(handle, &it);
   return it;
 }
 
@@ -1534,6 +1529,11 @@ void gatt_cleanup_upon_disc(const RawAddress& bda, uint16_t reason,
   alarm_free(p_tcb->ind_ack_timer);
   p_tcb->ind_ack_timer = NULL;
 
+  alarm_cancel(p_tcb->multi_notif_timer);
+  alarm_free(p_tcb->multi_notif_timer);
+  p_tcb->multi_notif_timer = NULL;
+  p_tcb->multi_notif_q.Clear();
+
   alarm_cancel(p_tcb->conf_timer);
   alarm_free(p_tcb->conf_timer);
   p_tcb->conf_timer = NULL;
@@ -45,9 +45,16 @@ class AdvertiseDataParser {
 
  public:
   static void RemoveTrailingZeros(std::vector<uint8_t>& ad) {
+    ad.resize(LengthWithoutTrailingZeros(ad.data(), ad.size()));
+  }
+
+  /**
+   * Returns the length |ad| would have after RemoveTrailingZeros, for callers
+   * that copy the data anyway.
+   */
+  static size_t LengthWithoutTrailingZeros(const uint8_t* ad, size_t ad_len) {
     size_t position = 0;
 
-    size_t ad_len = ad.size();
     while (position < ad_len) {
       uint8_t len = ad[position];
 
@@ -57,16 +64,16 @@ class AdvertiseDataParser {
       // end of the packet. Otherwise i.e. gluing scan response to advertise
       // data will result in data with zero padding in the middle.
       if (len == 0) {
-        ad.erase(ad.begin() + position, ad.end());
-        return;
+        return position;
       }
 
       if (position + len >= ad_len) {
-        return;
+        return ad_len;
       }
 
       position += len + 1;
     }
+    return ad_len;
   }
 
   /**
@@ -0,0 +1,206 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "bt_types.h"
+#include "osi/include/allocator.h"
+
+/* A packet held as the list of buffers it arrived in, read as one run of
+ * bytes: the data of each BT_HDR, from its offset, follows that of the
+ * previous one.
+ *
+ * It lets ACL fragments be put together without copying them into one
+ * buffer. Headers can be read across buffer boundaries, and the data is only
+ * copied out when a consumer needs it in one piece. The chain owns its
+ * buffers and frees them with |allocator|. */
+class BtHdrChain {
+ public:
+  explicit BtHdrChain(const allocator_t* allocator) : allocator_(allocator) {}
+
+  ~BtHdrChain() {
+    for (size_t i = first_; i < buffers_.size(); i++)
+      allocator_->free(buffers_[i]);
+  }
+
+  BtHdrChain(const BtHdrChain&) = delete;
+  BtHdrChain& operator=(const BtHdrChain&) = delete;
+
+  /* Adds the |len| bytes of |buffer| at its offset to the end. */
+  void Append(BT_HDR* buffer) {
+    buffers_.push_back(buffer);
+    len_ += buffer->len;
+  }
+
+  /* Makes room for |num_buffers| buffers without reallocating. */
+  void Reserve(size_t num_buffers) { buffers_.reserve(num_buffers); }
+
+  size_t Len() const { return len_; }
+  size_t NumBuffers() const { return buffers_.size() - first_; }
+
+  /* Copies the |len| bytes |pos| bytes in to |dest|. Returns false if they
+   * run past the end. */
+  bool Read(size_t pos, void* dest, size_t len) const {
+    if (pos > len_ || len > len_ - pos) return false;
+
+    uint8_t* out = static_cast<uint8_t*>(dest);
+    for (size_t i = first_; len != 0; i++) {
+      const BT_HDR* buffer = buffers_[i];
+      if (pos >= buffer->len) {
+        pos -= buffer->len;
+        continue;
+      }
+      size_t n = std::min<size_t>(len, buffer->len - pos);
+      memcpy(out, buffer->data + buffer->offset + pos, n);
+      out += n;
+      len -= n;
+      pos = 0;
+    }
+    return true;
+  }
+
+  /* Reads the little endian uint16_t |pos| bytes in. */
+  bool ReadUint16(size_t pos, uint16_t* value) const {
+    uint8_t bytes[2];
+    if (!Read(pos, bytes, sizeof(bytes))) return false;
+    *value = bytes[0] | (bytes[1] << 8);
+    return true;
+  }
+
+  /* Drops |len| bytes from the front, freeing the buffers emptied. */
+  void TrimFront(size_t len) {
+    len = std::min(len, len_);
+    len_ -= len;
+    while (len != 0) {
+      BT_HDR* buffer = buffers_[first_];
+      if (len < buffer->len) {
+        buffer->offset += len;
+        buffer->len -= len;
+        return;
+      }
+      len -= buffer->len;
+      allocator_->free(buffer);
+      buffers_[first_++] = nullptr;
+    }
+  }
+
+  /* Drops |len| bytes from the end, freeing the buffers emptied. */
+  void TrimBack(size_t len) {
+    len = std::min(len, len_);
+    len_ -= len;
+    while (len != 0) {
+      BT_HDR* buffer = buffers_.back();
+      if (len < buffer->len) {
+        buffer->len -= len;
+        return;
+      }
+      len -= buffer->len;
+      allocator_->free(buffer);
+      buffers_.pop_back();
+    }
+  }
+
+  /* Calls |fn(const uint8_t* data, size_t len)| for each buffer in order. */
+  template <typename Fn>
+  void ForEachSpan(Fn fn) const {
+    for (size_t i = first_; i < buffers_.size(); i++)
+      fn(buffers_[i]->data + buffers_[i]->offset, buffers_[i]->len);
+  }
+
+  /* Copies all the bytes to |dest|. */
+  void CopyTo(uint8_t* dest) const {
+    ForEachSpan([&dest](const uint8_t* data, size_t len) {
+      memcpy(dest, data, len);
+      dest += len;
+    });
+  }
+
+  /* Copies all the bytes to |dest| and frees the buffers as they are copied,
+   * leaving the chain empty. */
+  void MoveTo(uint8_t* dest) {
+    for (size_t i = first_; i < buffers_.size(); i++) {
+      memcpy(dest, buffers_[i]->data + buffers_[i]->offset, buffers_[i]->len);
+      dest += buffers_[i]->len;
+      allocator_->free(buffers_[i]);
+    }
+    buffers_.clear();
+    first_ = 0;
+    len_ = 0;
+  }
+
+  /* Returns all the bytes in one BT_HDR, leaving the chain empty. A single
+   * buffer is handed over as it is; otherwise they are copied into a new one
+   * allocated with |allocator|. Returns NULL and leaves the chain alone if it
+   * is empty or holds more than |max_len| bytes. */
+  BT_HDR* Flatten(size_t max_len = UINT16_MAX) {
+    if (NumBuffers() == 0 || len_ > std::min<size_t>(max_len, UINT16_MAX))
+      return NULL;
+
+    BT_HDR* flat;
+    if (NumBuffers() == 1) {
+      flat = buffers_[first_];
+    } else {
+      flat = static_cast<BT_HDR*>(allocator_->alloc(BT_HDR_SIZE + len_));
+      *flat = *buffers_[first_];
+      flat->offset = 0;
+      flat->len = len_;
+      CopyTo(flat->data);
+      for (size_t i = first_; i < buffers_.size(); i++)
+        allocator_->free(buffers_[i]);
+    }
+    buffers_.clear();
+    first_ = 0;
+    len_ = 0;
+    return flat;
+  }
+
+  /* Passes |chain| where a BT_HDR is expected: returns a BT_HDR with |event|
+   * that holds it. */
+  static BT_HDR* Wrap(BtHdrChain* chain, uint16_t event) {
+    BT_HDR* carrier = static_cast<BT_HDR*>(
+        chain->allocator_->alloc(BT_HDR_SIZE + sizeof(chain)));
+    carrier->event = event;
+    carrier->len = sizeof(chain);
+    carrier->offset = 0;
+    carrier->layer_specific = 0;
+    memcpy(carrier->data, &chain, sizeof(chain));
+    return carrier;
+  }
+
+  /* Takes the chain out of a |carrier| made by Wrap, and frees the carrier. */
+  static BtHdrChain* Unwrap(BT_HDR* carrier) {
+    BtHdrChain* chain;
+    memcpy(&chain, carrier->data, sizeof(chain));
+    chain->allocator_->free(carrier);
+    return chain;
+  }
+
+ private:
+  const allocator_t* allocator_;
+  std::vector<BT_HDR*> buffers_;
+  /* buffers_[0, first_) were trimmed off */
+  size_t first_ = 0;
+  size_t len_ = 0;
+};
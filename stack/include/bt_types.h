@@ -92,6 +92,8 @@
 #define BT_EVT_BTSIM 0x1B00
 /* Insight Script Engine event */
 #define BT_EVT_BTISE 0x1C00
+/* ACL Data from HCI, as a BtHdrChain */
+#define BT_EVT_TO_BTU_HCI_ACL_CHAIN 0x1D00
 
 /* To LM                            */
 /************************************/
@@ -1430,4 +1430,16 @@ void BTM_BlePeriodicSyncSetInfo(RawAddress addr, uint16_t service_data,
 void BTM_BlePeriodicSyncTxParameters(RawAddress addr, uint8_t mode,
                                      uint16_t skip, uint16_t timeout, StartSyncCb syncCb);
 
+/*******************************************************************************
+ *
+ * Function         btm_ble_adv_cache_dump
+ *
+ * Description      Dump the state of the advertising data reassembly cache to
+ *                  |fd|, for dumpsys.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void btm_ble_adv_cache_dump(int fd);
+
 #endif
@@ -66,6 +66,7 @@
 /* Attribute Profile Attribute UUID */
 #define GATT_UUID_GATT_SRV_CHGD 0x2A05
 #define GATT_UUID_GATT_CL_SUPP_FEATURES 0x2B29
+#define GATT_UUID_DATABASE_HASH 0x2B2A
 #define GATT_UUID_GATT_SR_SUPP_FEATURES 0x2B3A
 
 /* Link Loss Service */
@@ -1564,4 +1564,16 @@ extern bool L2CA_isMediaChannel(uint16_t handle, uint16_t channel_id, bool is_lo
 extern void L2CA_AdjustConnectionIntervals(uint16_t* min_interval,
                                            uint16_t* max_interval,
                                            uint16_t floor_interval);
+
+/*******************************************************************************
+**
+** Function         l2c_sched_dump
+**
+** Description      Dump the channel scheduler state and the transmit queue
+**                  delay histograms of the channels in use.
+**
+** Returns          void
+**
+*******************************************************************************/
+extern void l2c_sched_dump(int fd);
 #endif /* L2C_API_H */
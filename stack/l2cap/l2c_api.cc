@@ -33,6 +33,7 @@
 #include "bt_common.h"
 #include "bt_types.h"
 #include "btm_api.h"
+#include "btm_int.h"
 #include "btu.h"
 #include "device/include/controller.h"
 #include "hcidefs.h"
@@ -1707,6 +1708,7 @@ uint16_t L2CA_LocalLoopbackReq(uint16_t psm, uint16_t handle,
 
   p_lcb->link_state = LST_CONNECTED;
   p_lcb->handle = handle;
+  btm_handle_table.SetLcb(handle, p_lcb - l2cb.lcb_pool);
 
   /* Allocate a channel control block */
   p_ccb = l2cu_allocate_ccb(p_lcb, 0);
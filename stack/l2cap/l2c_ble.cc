@@ -303,6 +303,7 @@ void l2cble_conn_comp(uint16_t handle, uint8_t role, const RawAddress& bda,
 
   /* Save the handle */
   p_lcb->handle = handle;
+  btm_handle_table.SetLcb(handle, p_lcb - l2cb.lcb_pool);
 
   /* Connected OK. Change state to connected, we were scanning so we are master
    */
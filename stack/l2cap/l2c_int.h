@@ -37,6 +37,8 @@
 #include "osi/include/fixed_queue.h"
 #include "osi/include/list.h"
 
+class BtHdrChain;
+
 #define L2CAP_MIN_MTU 48 /* Minimum acceptable MTU is 48 bytes */
 
 #define MAX_ACTIVE_AVDT_CONN 5
@@ -706,6 +708,7 @@ extern void l2c_lcb_timer_timeout(void* data);
 extern void l2c_fcrb_ack_timer_timeout(void* data);
 extern uint8_t l2c_data_write(uint16_t cid, BT_HDR* p_data, uint16_t flag);
 extern void l2c_rcv_acl_data(BT_HDR* p_msg);
+extern void l2c_rcv_acl_chain(BtHdrChain* p_chain);
 extern void l2c_process_held_packets(bool timed_out);
 extern void l2c_rcfg_timer_timeout(void* data);
 
@@ -942,6 +945,7 @@ extern void l2c_enqueue_peer_data(tL2C_CCB* p_ccb, BT_HDR* p_buf);
 */
 extern void l2c_fcr_cleanup(tL2C_CCB* p_ccb);
 extern void l2c_fcr_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf);
+extern void l2c_fcr_proc_chain(tL2C_CCB* p_ccb, BtHdrChain* p_chain);
 extern void l2c_fcr_proc_tout(tL2C_CCB* p_ccb);
 extern void l2c_fcr_proc_ack_tout(tL2C_CCB* p_ccb);
 extern void l2c_fcr_send_S_frame(tL2C_CCB* p_ccb, uint16_t function_code,
@@ -953,6 +957,7 @@ extern BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
                                              uint16_t max_packet_length);
 extern void l2c_fcr_start_timer(tL2C_CCB* p_ccb);
 extern void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf);
+extern void l2c_lcc_proc_chain(tL2C_CCB* p_ccb, BtHdrChain* p_chain);
 extern BT_HDR* l2c_lcc_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
                                              uint16_t max_packet_length);
 
@@ -972,6 +977,19 @@ extern void l2c_fcr_buffer_l2cap_coc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf);
 extern void l2c_fcr_monitor_rx_buffer(void* p_ccb);
 extern void l2c_fcr_start_rx_buffer_mon_timer(tL2C_CCB* p_ccb);
 
+/* Functions provided by l2c_sched.cc
+ ***********************************
+*/
+extern void l2c_sched_init(void);
+extern bool l2c_sched_drr_enabled(void);
+extern void l2c_sched_enqueued(tL2C_CCB* p_ccb);
+extern void l2c_sched_backlogged(tL2C_CCB* p_ccb);
+extern void l2c_sched_ccb_released(tL2C_CCB* p_ccb);
+extern void l2c_sched_lcb_released(tL2C_LCB* p_lcb);
+extern tL2C_CCB* l2c_sched_next_channel(tL2C_LCB* p_lcb);
+extern size_t l2c_sched_pull_start(tL2C_CCB* p_ccb);
+extern void l2c_sched_pulled(tL2C_CCB* p_ccb, size_t queued, BT_HDR* p_buf);
+
 /* Functions provided by l2c_ble.cc
  ***********************************
 */
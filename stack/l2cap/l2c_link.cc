@@ -209,6 +209,7 @@ bool l2c_link_hci_conn_comp(uint8_t status, uint16_t handle,
 
   /* Save the handle */
   p_lcb->handle = handle;
+  btm_handle_table.SetLcb(handle, p_lcb - l2cb.lcb_pool);
 
   if (ci.status == HCI_SUCCESS) {
     /* Connected OK. Change state to connected */
@@ -535,6 +536,7 @@ bool l2c_link_hci_disc_comp(uint16_t handle, uint8_t reason) {
      }
       if (l2cu_create_conn(p_lcb, transport)) {
         lcb_is_free = false; /* still using this lcb */
+        btm_handle_table.ForgetLcb(p_lcb->handle, p_lcb - l2cb.lcb_pool);
         p_lcb->handle = HCI_INVALID_HANDLE;
         p_lcb->link_role = HCI_ROLE_MASTER; /* reset to default role */
       }
@@ -29,6 +29,7 @@
 #include <string.h>
 
 #include "bt_common.h"
+#include "bt_hdr_chain.h"
 #include "bt_target.h"
 #include "btm_int.h"
 #include "btu.h"
@@ -55,6 +56,38 @@ static void process_l2cap_cmd(tL2C_LCB* p_lcb, uint8_t* p, uint16_t pkt_len);
 /******************************************************************************/
 tL2C_CB l2cb;
 
+/*******************************************************************************
+ *
+ * Function         l2c_lcc_use_credit
+ *
+ * Description      This function accounts for the credit used by a PDU
+ *                  received on an LE CoC or ECFC channel, and returns credits
+ *                  to the peer when it is running low.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void l2c_lcc_use_credit(tL2C_CCB* p_ccb) {
+  /* The remote device has one less credit left */
+  --p_ccb->remote_credit_count;
+  // Got a pkt, valid send out credits to the peer device
+
+  /* If the credits left on the remote device are getting low, send some */
+  if (p_ccb->remote_credit_count <= L2CAP_LE_CREDIT_THRESHOLD) {
+    if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ECFC_MODE) {
+      if (!alarm_is_scheduled(p_ccb->rx_buf.l2c_coc_credit_mon_timer)) {
+        l2c_fcr_start_rx_buffer_mon_timer(p_ccb);
+      }
+    } else {
+      uint16_t credits = L2CAP_LE_CREDIT_DEFAULT - p_ccb->remote_credit_count;
+      p_ccb->remote_credit_count = L2CAP_LE_CREDIT_DEFAULT;
+
+      /* Return back credits */
+      l2c_csm_execute(p_ccb, L2CEVT_L2CA_SEND_FLOW_CONTROL_CREDIT, &credits);
+    }
+  }
+}
+
 /*******************************************************************************
  *
  * Function         l2c_rcv_acl_data
@@ -237,25 +270,7 @@ void l2c_rcv_acl_data(BT_HDR* p_msg) {
           return;
         }
         l2c_lcc_proc_pdu(p_ccb, p_msg);
-
-        /* The remote device has one less credit left */
-        --p_ccb->remote_credit_count;
-        // Got a pkt, valid send out credits to the peer device
-
-        /* If the credits left on the remote device are getting low, send some */
-        if (p_ccb->remote_credit_count <= L2CAP_LE_CREDIT_THRESHOLD) {
-          if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ECFC_MODE) {
-            if (!alarm_is_scheduled(p_ccb->rx_buf.l2c_coc_credit_mon_timer)) {
-              l2c_fcr_start_rx_buffer_mon_timer(p_ccb);
-            }
-          } else {
-            uint16_t credits = L2CAP_LE_CREDIT_DEFAULT - p_ccb->remote_credit_count;
-            p_ccb->remote_credit_count = L2CAP_LE_CREDIT_DEFAULT;
-
-            /* Return back credits */
-            l2c_csm_execute(p_ccb, L2CEVT_L2CA_SEND_FLOW_CONTROL_CREDIT, &credits);
-          }
-        }
+        l2c_lcc_use_credit(p_ccb);
       } else {
         /* Basic mode packets go straight to the state machine */
         if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_BASIC_MODE)
@@ -273,6 +288,86 @@ void l2c_rcv_acl_data(BT_HDR* p_msg) {
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         l2c_rcv_acl_chain
+ *
+ * Description      This function is called from the HCI Interface when an ACL
+ *                  data packet that came in several fragments is received as
+ *                  a chain of them. Data for LE CoC and ECFC channels is
+ *                  copied straight from the fragments into the SDU. eRTM
+ *                  frames have their FCS checked across the fragments and are
+ *                  then flattened, as are streaming frames. Anything else is
+ *                  flattened and processed as by l2c_rcv_acl_data.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_rcv_acl_chain(BtHdrChain* p_chain) {
+  uint8_t hdr[HCI_DATA_PREAMBLE_SIZE + L2CAP_PKT_OVERHEAD];
+  uint8_t* p = hdr;
+  uint16_t handle, hci_len, l2cap_len, rcv_cid;
+  tL2C_LCB* p_lcb = NULL;
+  tL2C_CCB* p_ccb = NULL;
+
+  /* The headers may be split across fragments */
+  if (p_chain->Read(0, hdr, sizeof(hdr))) {
+    STREAM_TO_UINT16(handle, p);
+    STREAM_TO_UINT16(hci_len, p);
+    STREAM_TO_UINT16(l2cap_len, p);
+    STREAM_TO_UINT16(rcv_cid, p);
+
+    if (HCID_GET_EVENT(handle) != L2CAP_PKT_CONTINUE &&
+        l2cap_len == hci_len - L2CAP_PKT_OVERHEAD &&
+        rcv_cid >= L2CAP_BASE_APPL_CID) {
+      p_lcb = l2cu_find_lcb_by_handle(HCID_GET_HANDLE(handle));
+      if (p_lcb != NULL) p_ccb = l2cu_find_ccb_by_cid(p_lcb, rcv_cid);
+    }
+  }
+
+  if (p_ccb != NULL && (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ECFC_MODE ||
+                        p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_LE_COC_MODE)) {
+    if (p_lcb->transport == BT_TRANSPORT_LE &&
+        p_lcb->link_state != LST_DISCONNECTING)
+      l2cble_notify_le_connection(p_lcb->remote_bd_addr);
+
+    /* if credits are exhausted, discard and free pdu memory before
+       sending l2cap disconnect */
+    if (p_ccb->remote_credit_count == 0) {
+      delete p_chain;
+      l2cu_disconnect_chnl(p_ccb);
+      return;
+    }
+    p_chain->TrimFront(sizeof(hdr));
+    l2c_lcc_proc_chain(p_ccb, p_chain);
+    l2c_lcc_use_credit(p_ccb);
+    return;
+  }
+
+  if (p_ccb != NULL && (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE ||
+                        p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_STREAM_MODE)) {
+    /* eRTM or streaming mode, so we need to validate states first */
+    if ((p_ccb->chnl_state == CST_OPEN) || (p_ccb->chnl_state == CST_CONFIG)) {
+      /* The FCS covers the L2CAP header, so it is kept */
+      p_chain->TrimFront(HCI_DATA_PREAMBLE_SIZE);
+      l2c_fcr_proc_chain(p_ccb, p_chain);
+    } else {
+      delete p_chain;
+    }
+    return;
+  }
+
+  BT_HDR* p_msg = p_chain->Flatten(BT_DEFAULT_BUFFER_SIZE - BT_HDR_SIZE);
+  if (p_msg == NULL) {
+    L2CAP_TRACE_WARNING("L2CAP - dropped ACL packet of %zu bytes",
+                        p_chain->Len());
+    delete p_chain;
+    return;
+  }
+  delete p_chain;
+  l2c_rcv_acl_data(p_msg);
+}
+
 /*******************************************************************************
  *
  * Function         process_l2cap_cmd
@@ -1189,6 +1284,8 @@ void l2c_init(void) {
 
   l2cb.receive_hold_timer = alarm_new("l2c.receive_hold_timer");
 
+  l2c_sched_init();
+
   l2cb.cert_failure =
     stack_config_get_interface()->get_pts_l2cap_le_insuff_enc_result();
   if (l2cb.cert_failure) {
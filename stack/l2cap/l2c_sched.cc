@@ -0,0 +1,410 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the L2CAP channel scheduler: which channel of a link
+ *  sends next, and how long buffers wait in the channel transmit queues.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+
+#include <base/bind.h>
+#include <base/strings/stringprintf.h>
+
+#include "bt_common.h"
+#include "bt_types.h"
+#include "l2c_api.h"
+#include "l2c_int.h"
+#include "btu.h"
+#include "l2c_sched.h"
+#include "l2cdefs.h"
+#include "osi/include/properties.h"
+#include "osi/include/time.h"
+
+/* Set to 1 to schedule the dynamic channels of a link by deficit round robin
+ * rather than by priority group. */
+#define L2CAP_DRR_PROPERTY "persist.bluetooth.l2capdrr"
+/* Weights and latency targets by PSM, overriding the defaults below, as
+ * "psm:weight[:target_ms],...", e.g. "0x0019:4:10,0x0003:1". */
+#define L2CAP_DRR_WEIGHTS_PROPERTY "persist.bluetooth.l2capdrrweights"
+
+/* Bytes a channel of weight 1 may send each round. */
+#ifndef L2CAP_DRR_QUANTUM
+#define L2CAP_DRR_QUANTUM 1024
+#endif
+
+#define L2CAP_DRR_MAX_WEIGHTS 8
+
+/* How long a dump waits for the btu thread to read the scheduler state. */
+#define L2CAP_SCHED_DUMP_WAIT_MS 1000
+
+typedef struct {
+  uint16_t psm;
+  uint8_t weight;
+  uint16_t target_ms;
+} tL2C_DRR_WEIGHT;
+
+/* A2DP media is given most of a busy link, and is served out of turn almost
+ * at once: its rate is set by the codec, so this only costs other channels
+ * latency. Everything else shares the rest. */
+static const tL2C_DRR_WEIGHT l2c_drr_default_weights[] = {
+    {BT_PSM_AVDTP, 4, 2},
+    {BT_PSM_AVCTP, 2, 0},
+};
+
+static bool l2c_drr_enabled;
+static tL2C_DRR_WEIGHT l2c_drr_weights[L2CAP_DRR_MAX_WEIGHTS];
+static size_t l2c_drr_num_weights;
+
+static std::unique_ptr<L2cDrrScheduler> l2c_drr[MAX_L2CAP_LINKS];
+static L2cQueueDelay l2c_queue_delay[MAX_L2CAP_CHANNELS];
+
+static size_t ccb_index(tL2C_CCB* p_ccb) { return p_ccb - l2cb.ccb_pool; }
+static size_t lcb_index(tL2C_LCB* p_lcb) { return p_lcb - l2cb.lcb_pool; }
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_parse_weights
+ *
+ * Description      Read the weights and latency targets from |str|, as
+ *                  "psm:weight[:target_ms],...". Malformed entries are
+ *                  skipped.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void l2c_sched_parse_weights(const char* str) {
+  while (*str != '\0' && l2c_drr_num_weights < L2CAP_DRR_MAX_WEIGHTS) {
+    char* end;
+    unsigned long psm = strtoul(str, &end, 0);
+    unsigned long weight = 0;
+    unsigned long target_ms = 0;
+    bool ok = end != str && *end == ':';
+    if (ok) {
+      str = end + 1;
+      weight = strtoul(str, &end, 0);
+      ok = end != str && weight > 0 && weight <= UINT8_MAX;
+    }
+    if (ok && *end == ':') {
+      str = end + 1;
+      target_ms = strtoul(str, &end, 0);
+      ok = end != str && target_ms <= UINT16_MAX;
+    }
+    if (ok && psm <= UINT16_MAX) {
+      l2c_drr_weights[l2c_drr_num_weights++] = {
+          (uint16_t)psm, (uint8_t)weight, (uint16_t)target_ms};
+    } else {
+      L2CAP_TRACE_WARNING("%s: ignoring malformed weight in %s", __func__,
+                          str);
+    }
+
+    const char* next = strchr(end, ',');
+    if (next == NULL) break;
+    str = next + 1;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_init
+ *
+ * Description      Read the scheduler configuration. Called from l2c_init.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_init(void) {
+  l2c_drr_enabled = osi_property_get_int32(L2CAP_DRR_PROPERTY, 0) != 0;
+
+  l2c_drr_num_weights = 0;
+  char weights[PROPERTY_VALUE_MAX] = "";
+  osi_property_get(L2CAP_DRR_WEIGHTS_PROPERTY, weights, "");
+  l2c_sched_parse_weights(weights);
+  for (const tL2C_DRR_WEIGHT& weight : l2c_drr_default_weights) {
+    if (l2c_drr_num_weights < L2CAP_DRR_MAX_WEIGHTS)
+      l2c_drr_weights[l2c_drr_num_weights++] = weight;
+  }
+
+  for (auto& drr : l2c_drr) drr.reset();
+  for (L2cQueueDelay& delay : l2c_queue_delay) delay.Reset();
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_drr_enabled
+ *
+ * Returns          true if dynamic channels are scheduled by deficit round
+ *                  robin.
+ *
+ ******************************************************************************/
+bool l2c_sched_drr_enabled(void) { return l2c_drr_enabled; }
+
+/* The scheduler of |p_lcb|, set up on first use. */
+static L2cDrrScheduler* l2c_sched_drr(tL2C_LCB* p_lcb) {
+  std::unique_ptr<L2cDrrScheduler>& drr = l2c_drr[lcb_index(p_lcb)];
+  if (!drr) drr.reset(new L2cDrrScheduler(MAX_L2CAP_CHANNELS));
+  return drr.get();
+}
+
+/* Sets the quantum and latency target of |p_ccb| from the weight of its PSM;
+ * the first entry for a PSM wins, so configured ones come before defaults. */
+static void l2c_sched_configure(L2cDrrScheduler* drr, tL2C_CCB* p_ccb) {
+  uint16_t psm = p_ccb->p_rcb != NULL ? p_ccb->p_rcb->real_psm : 0;
+  uint32_t weight = 1;
+  uint32_t target_ms = 0;
+  for (size_t i = 0; i < l2c_drr_num_weights; i++) {
+    if (l2c_drr_weights[i].psm == psm) {
+      weight = l2c_drr_weights[i].weight;
+      target_ms = l2c_drr_weights[i].target_ms;
+      break;
+    }
+  }
+  drr->Configure(ccb_index(p_ccb), weight * L2CAP_DRR_QUANTUM, target_ms);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_enqueued
+ *
+ * Description      A buffer was added to the transmit queue of |p_ccb|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_enqueued(tL2C_CCB* p_ccb) {
+  l2c_queue_delay[ccb_index(p_ccb)].Enqueued(time_get_os_boottime_ms());
+  l2c_sched_backlogged(p_ccb);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_backlogged
+ *
+ * Description      |p_ccb| has something to send: a buffer in its transmit
+ *                  queue, or I-frames queued for retransmission.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_backlogged(tL2C_CCB* p_ccb) {
+  if (!l2c_drr_enabled || p_ccb->p_lcb == NULL) return;
+  if (p_ccb->local_cid < L2CAP_BASE_APPL_CID) return;
+
+  size_t xx = ccb_index(p_ccb);
+  L2cDrrScheduler* drr = l2c_sched_drr(p_ccb->p_lcb);
+  if (drr->Active(xx)) return;
+  l2c_sched_configure(drr, p_ccb);
+  drr->Backlogged(xx);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_ccb_released
+ *
+ * Description      |p_ccb| is being released; forget its queue.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_ccb_released(tL2C_CCB* p_ccb) {
+  size_t xx = ccb_index(p_ccb);
+  l2c_queue_delay[xx].Reset();
+  if (p_ccb->p_lcb != NULL && l2c_drr[lcb_index(p_ccb->p_lcb)])
+    l2c_drr[lcb_index(p_ccb->p_lcb)]->Remove(xx);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_lcb_released
+ *
+ * Description      |p_lcb| is being released; forget its scheduler.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_lcb_released(tL2C_LCB* p_lcb) {
+  l2c_drr[lcb_index(p_lcb)].reset();
+}
+
+/* Whether |p_ccb| has data and may send it now; the same checks as
+ * l2cu_get_next_channel_in_rr and l2cu_get_next_buffer_to_send make. */
+static L2cDrrScheduler::State l2c_sched_state(tL2C_CCB* p_ccb) {
+  if (!p_ccb->in_use || p_ccb->xmit_hold_q == NULL)
+    return L2cDrrScheduler::kEmpty;
+
+  bool fcr = p_ccb->p_lcb->transport != BT_TRANSPORT_LE &&
+             p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_BASIC_MODE &&
+             p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_ECFC_MODE;
+  bool retransmit = fcr && !fixed_queue_is_empty(p_ccb->fcrb.retrans_q);
+  if (fixed_queue_is_empty(p_ccb->xmit_hold_q) && !retransmit)
+    return L2cDrrScheduler::kEmpty;
+
+  if (p_ccb->chnl_state != CST_OPEN) return L2cDrrScheduler::kBlocked;
+
+  if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE ||
+      p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ECFC_MODE) {
+    if (p_ccb->peer_conn_cfg.credits == 0) return L2cDrrScheduler::kBlocked;
+  } else if (fcr) {
+    if (p_ccb->fcrb.wait_ack || p_ccb->fcrb.remote_busy)
+      return L2cDrrScheduler::kBlocked;
+    if (!retransmit && p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE &&
+        l2c_fcr_is_flow_controlled(p_ccb))
+      return L2cDrrScheduler::kBlocked;
+  }
+  return L2cDrrScheduler::kReady;
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_next_channel
+ *
+ * Description      Pick the dynamic channel of |p_lcb| to send from next, by
+ *                  deficit round robin over the channels with data.
+ *
+ * Returns          pointer to CCB or NULL
+ *
+ ******************************************************************************/
+tL2C_CCB* l2c_sched_next_channel(tL2C_LCB* p_lcb) {
+  L2cDrrScheduler* drr = l2c_sched_drr(p_lcb);
+  uint64_t now_ms = time_get_os_boottime_ms();
+  int xx = drr->Next(
+      [](size_t ch) { return l2c_sched_state(&l2cb.ccb_pool[ch]); },
+      [now_ms](size_t ch) { return l2c_queue_delay[ch].HeadWait(now_ms); });
+  return xx < 0 ? NULL : &l2cb.ccb_pool[xx];
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_pull_start
+ *
+ * Description      A buffer is about to be taken for sending from |p_ccb|.
+ *
+ * Returns          the number of buffers queued, to pass to l2c_sched_pulled
+ *
+ ******************************************************************************/
+size_t l2c_sched_pull_start(tL2C_CCB* p_ccb) {
+  size_t queued = fixed_queue_length(p_ccb->xmit_hold_q);
+  l2c_queue_delay[ccb_index(p_ccb)].Sync(queued);
+  return queued;
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_pulled
+ *
+ * Description      |p_buf| was taken for sending from |p_ccb|, which had
+ *                  |queued| buffers before.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_pulled(tL2C_CCB* p_ccb, size_t queued, BT_HDR* p_buf) {
+  size_t xx = ccb_index(p_ccb);
+  size_t left = fixed_queue_length(p_ccb->xmit_hold_q);
+  if (left < queued)
+    l2c_queue_delay[xx].Sent(queued - left, time_get_os_boottime_ms());
+
+  if (!l2c_drr_enabled || p_ccb->local_cid < L2CAP_BASE_APPL_CID) return;
+  l2c_sched_drr(p_ccb->p_lcb)
+      ->Sent(xx, p_buf->len,
+             l2c_sched_state(p_ccb) != L2cDrrScheduler::kEmpty);
+}
+
+/* Formats the scheduler state and the queue delays of the channels in use.
+ * Runs on the btu thread, which owns them. */
+static void l2c_sched_format(std::shared_ptr<std::promise<std::string>> dump) {
+  std::string out;
+  base::StringAppendF(
+      &out, "\nL2CAP channel scheduler: %s\n",
+      l2c_drr_enabled ? "deficit round robin" : "priority round robin");
+  if (l2c_drr_enabled) {
+    out += "  Weights (psm:weight:target_ms):";
+    for (size_t i = 0; i < l2c_drr_num_weights; i++)
+      base::StringAppendF(&out, " 0x%04x:%u:%u", l2c_drr_weights[i].psm,
+                          l2c_drr_weights[i].weight,
+                          l2c_drr_weights[i].target_ms);
+    out += "\n";
+  }
+
+  out += "  Queue delay histograms, ms:";
+  for (size_t b = 0; b + 1 < L2CAP_DELAY_BUCKETS; b++)
+    base::StringAppendF(&out, " <%u", L2cQueueDelay::BucketLimitMs(b));
+  out += " more\n";
+
+  for (size_t xx = 0; xx < MAX_L2CAP_CHANNELS; xx++) {
+    tL2C_CCB* p_ccb = &l2cb.ccb_pool[xx];
+    if (!p_ccb->in_use || p_ccb->p_lcb == NULL) continue;
+
+    const L2cQueueDelay& delay = l2c_queue_delay[xx];
+    base::StringAppendF(
+        &out, "  handle 0x%04x cid 0x%04x psm 0x%04x queued %zu",
+        p_ccb->p_lcb->handle, p_ccb->local_cid,
+        p_ccb->p_rcb != NULL ? p_ccb->p_rcb->real_psm : 0,
+        p_ccb->xmit_hold_q ? fixed_queue_length(p_ccb->xmit_hold_q) : 0);
+    const std::unique_ptr<L2cDrrScheduler>& drr =
+        l2c_drr[lcb_index(p_ccb->p_lcb)];
+    if (drr && drr->Active(xx))
+      base::StringAppendF(&out, " quantum %u deficit %d", drr->Quantum(xx),
+                          drr->Deficit(xx));
+    base::StringAppendF(&out, " max %llu\n    ",
+                        (unsigned long long)delay.MaxMs());
+    for (size_t b = 0; b < L2CAP_DELAY_BUCKETS; b++)
+      base::StringAppendF(&out, " %u", delay.Histogram()[b]);
+    out += "\n";
+  }
+  dump->set_value(std::move(out));
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_sched_dump
+ *
+ * Description      Dump the scheduler state and the queue delays of the
+ *                  channels in use. They are read on the btu thread, so that
+ *                  channels and links are not released under the dump.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2c_sched_dump(int fd) {
+  base::MessageLoop* btu_message_loop = get_message_loop();
+  if (!btu_message_loop || !btu_message_loop->task_runner().get()) {
+    dprintf(fd, "\nL2CAP channel scheduler: stack not running\n");
+    return;
+  }
+
+  auto dump = std::make_shared<std::promise<std::string>>();
+  std::future<std::string> formatted = dump->get_future();
+  btu_message_loop->task_runner()->PostTask(
+      FROM_HERE, base::Bind(&l2c_sched_format, dump));
+  if (formatted.wait_for(std::chrono::milliseconds(L2CAP_SCHED_DUMP_WAIT_MS)) !=
+      std::future_status::ready) {
+    dprintf(fd, "\nL2CAP channel scheduler: btu thread busy\n");
+    return;
+  }
+  dprintf(fd, "%s", formatted.get().c_str());
+}
@@ -0,0 +1,247 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+/* Buckets of the queue delay histograms: below 1 ms, then below 2, 4, ...
+ * 1024 ms, then the rest. */
+#define L2CAP_DELAY_BUCKETS 12
+
+/* Buffers of a channel whose enqueue time is kept. Once it is exceeded,
+ * buffers are not timed again until the untimed ones have left the queue. */
+#ifndef L2CAP_DELAY_TRACKED
+#define L2CAP_DELAY_TRACKED 64
+#endif
+
+/* How long the buffers of a channel's transmit queue wait before they are
+ * sent, as a histogram.
+ *
+ * Buffers leave the queue in many places (segmentation, flushes, channel
+ * reconfiguration), so rather than being told about each one, the owner
+ * passes the queue length around each pull: buffers gone before it were
+ * dropped, and those gone during it were sent. */
+class L2cQueueDelay {
+ public:
+  L2cQueueDelay() { Reset(); }
+
+  /* A buffer was put at the end of the queue at |now_ms|. Timed buffers
+   * always come before the others. */
+  void Enqueued(uint64_t now_ms) {
+    if (count_ < L2CAP_DELAY_TRACKED && untracked_ == 0) {
+      times_[(first_ + count_) % L2CAP_DELAY_TRACKED] = now_ms;
+      count_++;
+    } else {
+      untracked_++;
+    }
+  }
+
+  /* The queue holds |queued| buffers; forget the oldest of those tracked if
+   * it holds fewer. */
+  void Sync(size_t queued) {
+    if (queued >= count_ + untracked_) return;
+    size_t gone = count_ + untracked_ - queued;
+    size_t timed = gone < count_ ? gone : count_;
+    Drop(timed);
+    untracked_ -= gone - timed < untracked_ ? gone - timed : untracked_;
+  }
+
+  /* The |sent| oldest buffers left the queue at |now_ms|. */
+  void Sent(size_t sent, uint64_t now_ms) {
+    for (; sent > 0 && count_ > 0; sent--) {
+      uint64_t delay = now_ms - times_[first_];
+      histogram_[Bucket(delay)]++;
+      if (delay > max_ms_) max_ms_ = delay;
+      Drop(1);
+    }
+    if (sent > untracked_) sent = untracked_;
+    untracked_ -= sent;
+  }
+
+  /* How long the oldest buffer has been waiting, or 0 if none is timed. */
+  uint64_t HeadWait(uint64_t now_ms) const {
+    return count_ == 0 ? 0 : now_ms - times_[first_];
+  }
+
+  const uint32_t* Histogram() const { return histogram_; }
+  uint64_t MaxMs() const { return max_ms_; }
+
+  /* Upper bound in ms of |bucket|, or 0 for the last one. */
+  static uint32_t BucketLimitMs(size_t bucket) {
+    return bucket + 1 < L2CAP_DELAY_BUCKETS ? 1u << bucket : 0;
+  }
+
+  void Reset() {
+    first_ = 0;
+    count_ = 0;
+    untracked_ = 0;
+    max_ms_ = 0;
+    for (uint32_t& n : histogram_) n = 0;
+  }
+
+ private:
+  static size_t Bucket(uint64_t delay_ms) {
+    size_t bucket = 0;
+    while (bucket + 1 < L2CAP_DELAY_BUCKETS && delay_ms >= (1u << bucket))
+      bucket++;
+    return bucket;
+  }
+
+  void Drop(size_t n) {
+    first_ = (first_ + n) % L2CAP_DELAY_TRACKED;
+    count_ -= n;
+  }
+
+  uint64_t times_[L2CAP_DELAY_TRACKED];
+  size_t first_;
+  size_t count_;
+  size_t untracked_;
+  uint64_t max_ms_;
+  uint32_t histogram_[L2CAP_DELAY_BUCKETS];
+};
+
+/* Deficit round robin over the channels of a link, by bytes.
+ *
+ * Each channel with data is on a list, and is given |quantum| bytes of
+ * credit whenever it comes round; it is served while it has credit left, and
+ * the bytes it sends are taken off afterwards. Over time channels get link
+ * bandwidth in proportion to their quanta, however large their packets.
+ *
+ * A channel may also have a latency target: once its oldest buffer has
+ * waited that long it is served ahead of the round, still paying for what it
+ * sends. Audio channels use it to ride out bursts of bulk traffic.
+ *
+ * Channels are numbered by the owner. Only channels with data are looked at,
+ * so picking one does not depend on how many channels the link has. Not
+ * thread safe. */
+class L2cDrrScheduler {
+ public:
+  enum State { kEmpty, kBlocked, kReady };
+
+  explicit L2cDrrScheduler(size_t num_channels) : channels_(num_channels) {}
+
+  L2cDrrScheduler(const L2cDrrScheduler&) = delete;
+  L2cDrrScheduler& operator=(const L2cDrrScheduler&) = delete;
+
+  /* Sets how many bytes |channel| may send each round, and its latency
+   * target, 0 for none. */
+  void Configure(size_t channel, uint32_t quantum, uint32_t target_ms) {
+    channels_[channel].quantum = quantum > 0 ? quantum : 1;
+    channels_[channel].target_ms = target_ms;
+  }
+
+  /* |channel| has data to send. */
+  void Backlogged(size_t channel) {
+    Channel& c = channels_[channel];
+    if (c.active) return;
+    c.active = true;
+    c.deficit = 0;
+    active_.push_back(channel);
+  }
+
+  /* Forgets |channel|, e.g. when it is released. */
+  void Remove(size_t channel) {
+    Channel& c = channels_[channel];
+    if (!c.active) return;
+    c.active = false;
+    for (auto it = active_.begin(); it != active_.end(); ++it) {
+      if (*it == channel) {
+        active_.erase(it);
+        break;
+      }
+    }
+  }
+
+  /* Returns the channel to send from next, or -1 if none can send.
+   * |state(channel)| tells whether a channel has data and may send it; those
+   * without data are taken off the list. |wait_ms(channel)| is how long the
+   * oldest buffer of a channel has waited. */
+  template <typename StateFn, typename WaitFn>
+  int Next(StateFn state, WaitFn wait_ms) {
+    int late = -1;
+    uint64_t most_late = 0;
+    size_t ready = 0;
+    for (size_t i = 0; i < active_.size();) {
+      size_t channel = active_[i];
+      const Channel& c = channels_[channel];
+      State s = state(channel);
+      if (s == kEmpty) {
+        Remove(channel);
+        continue;
+      }
+      i++;
+      if (s != kReady) continue;
+      ready++;
+      if (c.target_ms == 0) continue;
+      uint64_t wait = wait_ms(channel);
+      if (wait >= c.target_ms && wait - c.target_ms >= most_late) {
+        late = channel;
+        most_late = wait - c.target_ms;
+      }
+    }
+    if (late >= 0) return late;
+    if (ready == 0) return -1;
+
+    // A channel is either served, or topped up and sent to the back. Deficits
+    // are at most one packet below zero, so this goes round a few times at
+    // most before a ready channel has credit.
+    while (true) {
+      size_t channel = active_.front();
+      Channel& c = channels_[channel];
+      if (c.deficit > 0 && state(channel) == kReady) return channel;
+      if (c.deficit <= 0) c.deficit += c.quantum;
+      active_.pop_front();
+      active_.push_back(channel);
+    }
+  }
+
+  /* |channel| sent |bytes|; |backlogged| is whether it still has data. */
+  void Sent(size_t channel, size_t bytes, bool backlogged) {
+    Channel& c = channels_[channel];
+    c.deficit -= bytes;
+    if (!backlogged) Remove(channel);
+  }
+
+  bool Active(size_t channel) const { return channels_[channel].active; }
+  int32_t Deficit(size_t channel) const { return channels_[channel].deficit; }
+  uint32_t Quantum(size_t channel) const { return channels_[channel].quantum; }
+  uint32_t TargetMs(size_t channel) const {
+    return channels_[channel].target_ms;
+  }
+
+  void Clear() {
+    for (Channel& c : channels_) c = Channel();
+    active_.clear();
+  }
+
+ private:
+  struct Channel {
+    uint32_t quantum = 1;
+    uint32_t target_ms = 0;
+    int32_t deficit = 0;
+    bool active = false;
+  };
+
+  std::vector<Channel> channels_;
+  std::deque<size_t> active_;
+};
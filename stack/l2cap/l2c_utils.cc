@@ -150,6 +150,8 @@ void l2cu_release_lcb(tL2C_LCB* p_lcb) {
 
   p_lcb->in_use = false;
   p_lcb->is_bonding = false;
+  btm_handle_table.ForgetLcb(p_lcb->handle, p_lcb - l2cb.lcb_pool);
+  l2c_sched_lcb_released(p_lcb);
 
   /* Stop the timers */
   alarm_cancel(p_lcb->l2c_lcb_timer);
@@ -1741,6 +1743,7 @@ void l2cu_release_ccb(tL2C_CCB* p_ccb) {
   /* Cancel the timer */
   alarm_cancel(p_ccb->l2c_ccb_timer);
 
+  l2c_sched_ccb_released(p_ccb);
   fixed_queue_free(p_ccb->xmit_hold_q, osi_free);
   p_ccb->xmit_hold_q = NULL;
 
@@ -3325,17 +3328,25 @@ void l2cu_send_peer_ble_credit_based_disconn_req(tL2C_CCB* p_ccb) {
  * Function         l2cu_find_lcb_by_handle
  *
  * Description      Look through all active LCBs for a match based on the
- *                  HCI handle.
+ *                  HCI handle. The LCB last found for the handle, in
+ *                  btm_handle_table, is tried first.
  *
  * Returns          pointer to matched LCB, or NULL if no match
  *
  ******************************************************************************/
 tL2C_LCB* l2cu_find_lcb_by_handle(uint16_t handle) {
-  int xx;
-  tL2C_LCB* p_lcb = &l2cb.lcb_pool[0];
+  int xx = btm_handle_table.Get(handle).lcb;
+  tL2C_LCB* p_lcb;
 
-  for (xx = 0; xx < MAX_L2CAP_LINKS; xx++, p_lcb++) {
+  if (xx < MAX_L2CAP_LINKS) {
+    p_lcb = &l2cb.lcb_pool[xx];
+    if ((p_lcb->in_use) && (p_lcb->handle == handle)) return (p_lcb);
+  }
+
+  for (xx = 0, p_lcb = &l2cb.lcb_pool[0]; xx < MAX_L2CAP_LINKS;
+       xx++, p_lcb++) {
     if ((p_lcb->in_use) && (p_lcb->handle == handle)) {
+      btm_handle_table.SetLcb(handle, xx);
       return (p_lcb);
     }
   }
@@ -3552,6 +3563,7 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
                                      tL2C_TX_COMPLETE_CB_INFO* p_cbi) {
   tL2C_CCB* p_ccb;
   BT_HDR* p_buf;
+  size_t queued;
 
 /* Highest priority are fixed channels */
 #if (L2CAP_NUM_FIXED_CHNLS > 0)
@@ -3577,19 +3589,23 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
           continue;
       }
 
+      queued = l2c_sched_pull_start(p_ccb);
       p_buf = l2c_fcr_get_next_xmit_sdu_seg(p_ccb, 0);
       if (p_buf != NULL) {
+        l2c_sched_pulled(p_ccb, queued, p_buf);
         l2cu_check_channel_congestion(p_ccb);
         l2cu_set_acl_hci_header(p_buf, p_ccb);
         return (p_buf);
       }
     } else {
       if (!fixed_queue_is_empty(p_ccb->xmit_hold_q)) {
+        queued = l2c_sched_pull_start(p_ccb);
         p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_ccb->xmit_hold_q);
         if (NULL == p_buf) {
           L2CAP_TRACE_ERROR("%s: No data to be sent", __func__);
           return (NULL);
         }
+        l2c_sched_pulled(p_ccb, queued, p_buf);
 
         /* Prepare callback info for TX completion */
         p_cbi->cb = l2cb.fixed_reg[xx].pL2CA_FixedTxComplete_Cb;
@@ -3604,16 +3620,22 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
   }
 #endif
 
+  if (l2c_sched_drr_enabled()) {
+    p_ccb = l2c_sched_next_channel(p_lcb);
+  } else {
 #if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* get next serving channel in round-robin */
-  p_ccb = l2cu_get_next_channel_in_rr(p_lcb);
+    /* get next serving channel in round-robin */
+    p_ccb = l2cu_get_next_channel_in_rr(p_lcb);
 #else
-  p_ccb = l2cu_get_next_channel(p_lcb);
+    p_ccb = l2cu_get_next_channel(p_lcb);
 #endif
+  }
 
   /* Return if no buffer */
   if (p_ccb == NULL) return (NULL);
 
+  queued = l2c_sched_pull_start(p_ccb);
+
   if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ECFC_MODE) {
     if (p_ccb->peer_conn_cfg.credits == 0) {
       L2CAP_TRACE_DEBUG("%s No credits to send packets", __func__);
@@ -3648,6 +3670,8 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
     }
   }
 
+  l2c_sched_pulled(p_ccb, queued, p_buf);
+
   if (p_ccb->p_rcb && p_ccb->p_rcb->api.pL2CA_TxComplete_Cb &&
       (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_ERTM_MODE))
     (*p_ccb->p_rcb->api.pL2CA_TxComplete_Cb)(p_ccb->local_cid, 1);
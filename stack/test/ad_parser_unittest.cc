@@ -176,3 +176,16 @@ TEST(AdvertiseDataParserTest, RemoveTrailingZerosMalformed) {
 
   EXPECT_TRUE(AdvertiseDataParser::IsValid(glued));
 }
+
+TEST(AdvertiseDataParserTest, LengthWithoutTrailingZeros) {
+  const uint8_t padded[] = {0x02, 0x01, 0x02, 0x03, 0x09, 0x50, 0x6f,
+                            0x00, 0x00, 0x00, 0x00};
+  EXPECT_EQ(7U, AdvertiseDataParser::LengthWithoutTrailingZeros(
+                    padded, sizeof(padded)));
+
+  const uint8_t unpadded[] = {0x02, 0x01, 0x02, 0x03, 0x09, 0x50, 0x6f};
+  EXPECT_EQ(sizeof(unpadded), AdvertiseDataParser::LengthWithoutTrailingZeros(
+                                  unpadded, sizeof(unpadded)));
+
+  EXPECT_EQ(0U, AdvertiseDataParser::LengthWithoutTrailingZeros(nullptr, 0));
+}
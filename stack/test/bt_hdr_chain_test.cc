@@ -0,0 +1,136 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "bt_hdr_chain.h"
+
+namespace {
+
+const allocator_t plain_allocator = {malloc, free};
+
+// A buffer holding |values|, |offset| bytes in.
+BT_HDR* make_buffer(std::vector<uint8_t> values, uint16_t offset = 0) {
+  BT_HDR* buffer =
+      static_cast<BT_HDR*>(malloc(BT_HDR_SIZE + offset + values.size()));
+  buffer->event = 0x1100;
+  buffer->offset = offset;
+  buffer->len = values.size();
+  buffer->layer_specific = 7;
+  memcpy(buffer->data + offset, values.data(), values.size());
+  return buffer;
+}
+
+// 0, 1, ..., 9 in buffers of 3, 1 and 6 bytes.
+BtHdrChain* make_chain() {
+  BtHdrChain* chain = new BtHdrChain(&plain_allocator);
+  chain->Append(make_buffer({0, 1, 2}, 4));
+  chain->Append(make_buffer({3}));
+  chain->Append(make_buffer({4, 5, 6, 7, 8, 9}, 2));
+  return chain;
+}
+
+std::vector<uint8_t> contents(const BtHdrChain& chain) {
+  std::vector<uint8_t> bytes(chain.Len());
+  chain.CopyTo(bytes.data());
+  return bytes;
+}
+
+}  // namespace
+
+TEST(BtHdrChainTest, reads_across_buffers) {
+  BtHdrChain* chain = make_chain();
+  EXPECT_EQ(10U, chain->Len());
+  EXPECT_EQ(3U, chain->NumBuffers());
+
+  uint8_t bytes[4];
+  ASSERT_TRUE(chain->Read(2, bytes, sizeof(bytes)));
+  EXPECT_EQ(2, bytes[0]);
+  EXPECT_EQ(5, bytes[3]);
+
+  uint16_t value;
+  ASSERT_TRUE(chain->ReadUint16(3, &value));
+  EXPECT_EQ(0x0403, value);
+
+  EXPECT_FALSE(chain->Read(8, bytes, 3));
+  EXPECT_FALSE(chain->ReadUint16(9, &value));
+  EXPECT_TRUE(chain->Read(10, bytes, 0));
+
+  std::vector<uint8_t> expected = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  EXPECT_EQ(expected, contents(*chain));
+
+  std::vector<uint8_t> moved(10);
+  chain->MoveTo(moved.data());
+  EXPECT_EQ(expected, moved);
+  EXPECT_EQ(0U, chain->Len());
+  EXPECT_EQ(0U, chain->NumBuffers());
+  delete chain;
+}
+
+TEST(BtHdrChainTest, trims_both_ends) {
+  BtHdrChain* chain = make_chain();
+
+  chain->TrimFront(4);
+  EXPECT_EQ(6U, chain->Len());
+  EXPECT_EQ(1U, chain->NumBuffers());
+  chain->TrimFront(1);
+  chain->TrimBack(2);
+
+  std::vector<uint8_t> expected = {5, 6, 7};
+  EXPECT_EQ(expected, contents(*chain));
+
+  chain->TrimBack(10);
+  EXPECT_EQ(0U, chain->Len());
+  EXPECT_EQ(0U, chain->NumBuffers());
+  delete chain;
+}
+
+TEST(BtHdrChainTest, flattens_on_demand) {
+  BtHdrChain* chain = make_chain();
+  EXPECT_EQ(nullptr, chain->Flatten(9));
+  EXPECT_EQ(10U, chain->Len());
+
+  BT_HDR* flat = chain->Flatten();
+  ASSERT_NE(nullptr, flat);
+  EXPECT_EQ(0U, chain->Len());
+  EXPECT_EQ(0x1100, flat->event);
+  EXPECT_EQ(7, flat->layer_specific);
+  EXPECT_EQ(10, flat->len);
+  for (int i = 0; i < 10; i++) EXPECT_EQ(i, flat->data[flat->offset + i]);
+  free(flat);
+
+  // A single buffer is handed over as it is
+  BT_HDR* buffer = make_buffer({1, 2, 3}, 8);
+  chain->Append(buffer);
+  EXPECT_EQ(buffer, chain->Flatten());
+  EXPECT_EQ(nullptr, chain->Flatten());
+  free(buffer);
+  delete chain;
+}
+
+TEST(BtHdrChainTest, passes_through_bt_hdr) {
+  BtHdrChain* chain = make_chain();
+  BT_HDR* carrier = BtHdrChain::Wrap(chain, 0x1D00);
+  EXPECT_EQ(0x1D00, carrier->event);
+  EXPECT_EQ(chain, BtHdrChain::Unwrap(carrier));
+  delete chain;
+}
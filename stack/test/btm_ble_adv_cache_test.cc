@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "stack/btm/btm_ble_adv_cache.h"
+
+namespace {
+
+RawAddress address(uint32_t n) {
+  RawAddress addr;
+  addr.address[0] = 0xc0;
+  addr.address[1] = 0x00;
+  addr.address[2] = n >> 24;
+  addr.address[3] = n >> 16;
+  addr.address[4] = n >> 8;
+  addr.address[5] = n;
+  return addr;
+}
+
+const uint8_t kAdv[] = {0x02, 0x01, 0x06};
+const uint8_t kScanRsp[] = {0x03, 0x09, 'a', 'b'};
+
+}  // namespace
+
+TEST(AdvertisingCacheTest, set_and_append) {
+  AdvertisingCache cache(4, 1000);
+  RawAddress addr = address(1);
+
+  std::vector<uint8_t> data = cache.Set(0, addr, kAdv, sizeof(kAdv), 0);
+  EXPECT_EQ(std::vector<uint8_t>(kAdv, kAdv + sizeof(kAdv)), data);
+
+  data = cache.Append(0, addr, kScanRsp, sizeof(kScanRsp), 10);
+  std::vector<uint8_t> expected(kAdv, kAdv + sizeof(kAdv));
+  expected.insert(expected.end(), kScanRsp, kScanRsp + sizeof(kScanRsp));
+  EXPECT_EQ(expected, data);
+
+  // Set restarts the data, and the address type is part of the key.
+  data = cache.Set(0, addr, kScanRsp, sizeof(kScanRsp), 20);
+  EXPECT_EQ(sizeof(kScanRsp), data.size());
+  data = cache.Append(1, addr, kAdv, sizeof(kAdv), 20);
+  EXPECT_EQ(sizeof(kAdv), data.size());
+  EXPECT_EQ(2U, cache.Size());
+
+  cache.Clear(0, addr);
+  EXPECT_EQ(1U, cache.Size());
+  data = cache.Append(0, addr, kAdv, sizeof(kAdv), 30);
+  EXPECT_EQ(sizeof(kAdv), data.size());
+
+  EXPECT_EQ(2U, cache.hits());
+  EXPECT_EQ(3U, cache.misses());
+}
+
+TEST(AdvertisingCacheTest, evicts_least_recently_updated) {
+  AdvertisingCache cache(3, 1000);
+  for (uint32_t i = 0; i < 3; i++)
+    cache.Set(0, address(i), kAdv, sizeof(kAdv), i);
+
+  // 0 is updated, so 1 is the one to go.
+  cache.Append(0, address(0), kScanRsp, sizeof(kScanRsp), 3);
+  cache.Set(0, address(3), kAdv, sizeof(kAdv), 4);
+  EXPECT_EQ(1U, cache.evictions());
+  EXPECT_EQ(3U, cache.Size());
+
+  EXPECT_EQ(sizeof(kScanRsp),
+            cache.Append(0, address(1), kScanRsp, sizeof(kScanRsp), 5).size());
+  EXPECT_EQ(sizeof(kAdv) + 2 * sizeof(kScanRsp),
+            cache.Append(0, address(0), kScanRsp, sizeof(kScanRsp), 6).size());
+}
+
+TEST(AdvertisingCacheTest, expires_stale_data) {
+  AdvertisingCache cache(2, 100);
+  cache.Set(0, address(1), kAdv, sizeof(kAdv), 0);
+  cache.Set(0, address(2), kAdv, sizeof(kAdv), 50);
+
+  // Continuing after the timeout starts over.
+  std::vector<uint8_t> data =
+      cache.Append(0, address(1), kScanRsp, sizeof(kScanRsp), 100);
+  EXPECT_EQ(sizeof(kScanRsp), data.size());
+  EXPECT_EQ(1U, cache.timeouts());
+
+  // Stale entries make room before live ones are evicted.
+  cache.Set(0, address(3), kAdv, sizeof(kAdv), 160);
+  EXPECT_EQ(2U, cache.timeouts());
+  EXPECT_EQ(0U, cache.evictions());
+  EXPECT_EQ(2U, cache.Size());
+}
+
+TEST(AdvertisingCacheTest, many_devices) {
+  AdvertisingCache cache(128, 1000);
+  for (uint32_t i = 0; i < 128; i++)
+    cache.Set(0, address(i * 7919), kAdv, sizeof(kAdv), 0);
+  for (uint32_t i = 0; i < 128; i += 2) cache.Clear(0, address(i * 7919));
+  EXPECT_EQ(64U, cache.Size());
+
+  // Removal must not break the probe chains of the remaining devices.
+  for (uint32_t i = 1; i < 128; i += 2)
+    EXPECT_EQ(sizeof(kAdv) + sizeof(kScanRsp),
+              cache
+                  .Append(0, address(i * 7919), kScanRsp, sizeof(kScanRsp), 1)
+                  .size());
+  EXPECT_EQ(0U, cache.evictions());
+
+  cache.ClearAll();
+  EXPECT_EQ(0U, cache.Size());
+}
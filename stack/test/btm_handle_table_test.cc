@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "stack/btm/btm_handle_table.h"
+
+namespace {
+
+struct DevRec {
+  uint16_t hci_handle;
+};
+
+typedef BtmHandleTable<DevRec> HandleTable;
+
+}  // namespace
+
+TEST(BtmHandleTableTest, starts_empty) {
+  HandleTable table;
+  for (uint16_t handle : {0x0000, 0x0001, 0x0eff, 0x0fff}) {
+    const HandleTable::Entry& entry = table.Get(handle);
+    EXPECT_EQ(HandleTable::kNone, entry.lcb);
+    EXPECT_EQ(HandleTable::kNone, entry.acl);
+    EXPECT_EQ(HandleTable::kNone, entry.sco);
+    EXPECT_EQ(nullptr, entry.p_dev_rec);
+  }
+}
+
+TEST(BtmHandleTableTest, maps_handles_to_slots) {
+  HandleTable table;
+  DevRec dev_rec = {0x0042};
+  table.SetLcb(0x0042, 3);
+  table.SetAcl(0x0042, 5);
+  table.SetDevRec(0x0042, &dev_rec);
+  table.SetSco(0x0101, 1);
+
+  const HandleTable::Entry& entry = table.Get(0x0042);
+  EXPECT_EQ(3, entry.lcb);
+  EXPECT_EQ(5, entry.acl);
+  EXPECT_EQ(HandleTable::kNone, entry.sco);
+  EXPECT_EQ(&dev_rec, entry.p_dev_rec);
+  EXPECT_EQ(1, table.Get(0x0101).sco);
+
+  // The flags of an ACL header do not take part
+  EXPECT_EQ(3, table.Get(0x2042).lcb);
+  EXPECT_EQ(3, table.Get(0x3042).lcb);
+  EXPECT_EQ(HandleTable::kNone, table.Get(0x0043).lcb);
+}
+
+TEST(BtmHandleTableTest, keeps_a_handle_given_out_again) {
+  HandleTable table;
+  table.SetLcb(0x0001, 0);
+  table.SetAcl(0x0001, 0);
+  table.SetSco(0x0002, 0);
+
+  // The handle went to another link before the first was released
+  table.SetLcb(0x0001, 4);
+  table.SetAcl(0x0001, 2);
+  table.ForgetLcb(0x0001, 0);
+  table.ForgetAcl(0x0001, 0);
+  EXPECT_EQ(4, table.Get(0x0001).lcb);
+  EXPECT_EQ(2, table.Get(0x0001).acl);
+
+  table.ForgetLcb(0x0001, 4);
+  table.ForgetAcl(0x0001, 2);
+  table.ForgetSco(0x0002, 0);
+  EXPECT_EQ(HandleTable::kNone, table.Get(0x0001).lcb);
+  EXPECT_EQ(HandleTable::kNone, table.Get(0x0001).acl);
+  EXPECT_EQ(HandleTable::kNone, table.Get(0x0002).sco);
+}
+
+TEST(BtmHandleTableTest, forgets_freed_records) {
+  HandleTable table;
+  DevRec first = {0x0001};
+  DevRec second = {0x0002};
+  table.SetDevRec(0x0001, &first);
+  table.SetDevRec(0x0080, &first);
+  table.SetDevRec(0x0002, &second);
+
+  table.ForgetDevRec(&first);
+  EXPECT_EQ(nullptr, table.Get(0x0001).p_dev_rec);
+  EXPECT_EQ(nullptr, table.Get(0x0080).p_dev_rec);
+  EXPECT_EQ(&second, table.Get(0x0002).p_dev_rec);
+
+  table.Clear();
+  EXPECT_EQ(nullptr, table.Get(0x0002).p_dev_rec);
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "stack/btm/btm_inq_db_index.h"
+
+namespace {
+
+RawAddress address(uint32_t n) {
+  RawAddress addr;
+  addr.address[0] = 0x00;
+  addr.address[1] = 0x11;
+  addr.address[2] = n >> 24;
+  addr.address[3] = n >> 16;
+  addr.address[4] = n >> 8;
+  addr.address[5] = n;
+  return addr;
+}
+
+}  // namespace
+
+TEST(InqDbIndexTest, find_and_remove) {
+  InqDbIndex index(4);
+  EXPECT_EQ(0, index.FreeSlot());
+  index.Add(0, address(1), false);
+  index.Add(1, address(2), false);
+  EXPECT_EQ(2, index.FreeSlot());
+  EXPECT_EQ(1, index.Find(address(2)));
+  EXPECT_EQ(InqDbIndex::kNone, index.Find(address(3)));
+
+  // The lowest free slot is handed out first.
+  index.Remove(0);
+  EXPECT_EQ(InqDbIndex::kNone, index.Find(address(1)));
+  EXPECT_EQ(0, index.FreeSlot());
+
+  index.Clear();
+  EXPECT_EQ(InqDbIndex::kNone, index.Find(address(2)));
+  EXPECT_EQ(InqDbIndex::kNone, index.Oldest());
+}
+
+TEST(InqDbIndexTest, oldest_skips_kept_entries) {
+  InqDbIndex index(3);
+  index.Add(0, address(0), true);
+  index.Add(1, address(1), false);
+  index.Add(2, address(2), false);
+  EXPECT_EQ(InqDbIndex::kNone, index.FreeSlot());
+  EXPECT_EQ(1U, index.keep_count());
+
+  // 0 is kept and 1 responded again, so 2 is the one to reuse.
+  EXPECT_EQ(1, index.Oldest());
+  index.Touch(1);
+  EXPECT_EQ(2, index.Oldest());
+
+  index.Remove(2);
+  index.Remove(1);
+  EXPECT_EQ(InqDbIndex::kNone, index.Oldest());
+  index.Remove(0);
+  EXPECT_EQ(0U, index.keep_count());
+}
+
+TEST(InqDbIndexTest, many_slots) {
+  InqDbIndex index(200);
+  for (int i = 0; i < 200; i++) index.Add(i, address(i * 7919), false);
+  EXPECT_EQ(InqDbIndex::kNone, index.FreeSlot());
+  for (int i = 0; i < 200; i++) EXPECT_EQ(i, index.Find(address(i * 7919)));
+
+  index.Remove(130);
+  EXPECT_EQ(130, index.FreeSlot());
+  EXPECT_EQ(0, index.Oldest());
+}
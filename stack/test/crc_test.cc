@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "stack/crc/crc.h"
+
+using crc::Crc16Backend;
+
+namespace {
+
+const uint8_t kCheck[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+std::vector<uint8_t> make_data(size_t len) {
+  std::vector<uint8_t> data(len);
+  uint32_t seed = 1;
+  for (uint8_t& b : data) {
+    seed = seed * 1103515245 + 12345;
+    b = seed >> 16;
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST(CrcTest, crc16_check_value) {
+  for (const Crc16Backend* backend : crc::crc16_backends()) {
+    SCOPED_TRACE(backend->name);
+    EXPECT_EQ(0xbb3d, backend->update(0, kCheck, sizeof(kCheck)));
+  }
+  EXPECT_EQ(0xbb3d, crc::crc16(0, kCheck, sizeof(kCheck)));
+}
+
+TEST(CrcTest, crc16_backends_match_reference) {
+  std::vector<uint8_t> data = make_data(4096 + 64);
+
+  // Every length around the thresholds of the faster paths, at every
+  // alignment, from any running CRC
+  for (const Crc16Backend* backend : crc::crc16_backends()) {
+    SCOPED_TRACE(backend->name);
+    for (size_t offset = 0; offset < 16; offset++) {
+      for (size_t len = 0; len <= 300; len++) {
+        uint16_t crc = len * 0x9e37;
+        ASSERT_EQ(crc::crc16_backend_reference.update(crc, &data[offset], len),
+                  backend->update(crc, &data[offset], len))
+            << "offset " << offset << " len " << len;
+      }
+    }
+    EXPECT_EQ(crc::crc16_backend_reference.update(0, data.data(), 4096),
+              backend->update(0, data.data(), 4096));
+  }
+}
+
+TEST(CrcTest, crc16_updates_in_pieces) {
+  std::vector<uint8_t> data = make_data(1000);
+  uint16_t whole = crc::crc16(0, data.data(), data.size());
+  for (size_t split : {1, 7, 128, 500, 999}) {
+    uint16_t crc = crc::crc16(0, data.data(), split);
+    EXPECT_EQ(whole, crc::crc16(crc, &data[split], data.size() - split));
+  }
+}
+
+TEST(CrcTest, crc8_rfcomm_fcs) {
+  EXPECT_EQ(0xd0, crc::crc8(0xff, kCheck, sizeof(kCheck)));
+
+  // SABM and UA on DLCI 0: address, control and length are covered
+  const uint8_t sabm[] = {0x03, 0x3f, 0x01};
+  const uint8_t ua[] = {0x03, 0x73, 0x01};
+  EXPECT_EQ(0x1c, 0xff - crc::crc8(0xff, sabm, sizeof(sabm)));
+  EXPECT_EQ(0xd7, 0xff - crc::crc8(0xff, ua, sizeof(ua)));
+}
@@ -20,6 +20,7 @@
 #include <gtest/gtest.h>
 
 #include "stack/crypto_toolbox/aes.h"
+#include "stack/crypto_toolbox/aes_backend.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
 #include <base/logging.h>
@@ -397,4 +398,88 @@ TEST(CryptoToolboxTest, bt_spec_example_d_12_test) {
   EXPECT_EQ(expected_ltk, ltk);
 }
 
+// FIPS-197 Appendix B and C.1, run through every backend usable on this CPU.
+TEST(CryptoToolboxTest, aes_backends_fips_197_test) {
+  Octet16 keys[] = {
+      {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+       0x09, 0xcf, 0x4f, 0x3c},
+      {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+       0x0c, 0x0d, 0x0e, 0x0f}};
+  Octet16 plaintexts[] = {
+      {0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2,
+       0xe0, 0x37, 0x07, 0x34},
+      {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+       0xcc, 0xdd, 0xee, 0xff}};
+  Octet16 ciphertexts[] = {
+      {0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97,
+       0x19, 0x6a, 0x0b, 0x32},
+      {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80,
+       0x70, 0xb4, 0xc5, 0x5a}};
+
+  for (const AesBackend* backend : aes_backends()) {
+    SCOPED_TRACE(backend->name);
+    Octet16 output[2];
+    backend->encrypt_batch(keys, plaintexts, output, 2);
+    EXPECT_EQ(ciphertexts[0], output[0]);
+    EXPECT_EQ(ciphertexts[1], output[1]);
+
+    // encrypting in place
+    output[0] = plaintexts[1];
+    backend->encrypt_batch(&keys[1], &output[0], &output[0], 1);
+    EXPECT_EQ(ciphertexts[1], output[0]);
+  }
+}
+
+// Every backend must agree with the reference implementation, including on
+// batch sizes that do not fill their internal groups of blocks.
+TEST(CryptoToolboxTest, aes_backends_match_reference_test) {
+  const size_t n = 67;
+  std::vector<Octet16> keys(n), plaintexts(n), expected(n);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < OCTET16_LEN; j++) {
+      seed = seed * 1103515245 + 12345;
+      keys[i][j] = seed >> 16;
+      seed = seed * 1103515245 + 12345;
+      plaintexts[i][j] = seed >> 16;
+    }
+  }
+  aes_backend_reference.encrypt_batch(keys.data(), plaintexts.data(),
+                                      expected.data(), n);
+
+  for (const AesBackend* backend : aes_backends()) {
+    SCOPED_TRACE(backend->name);
+    for (size_t count : {0, 1, 3, 4, 5, 16, 17, 67}) {
+      std::vector<Octet16> output(n);
+      backend->encrypt_batch(keys.data(), plaintexts.data(), output.data(),
+                             count);
+      for (size_t i = 0; i < count; i++) EXPECT_EQ(expected[i], output[i]);
+    }
+  }
+}
+
+// aes_128_batch must give the same results as aes_128 one block at a time,
+// which also covers the selected backend against BT Spec D.1.
+TEST(CryptoToolboxTest, aes_128_batch_test) {
+  const size_t n = 40;
+  std::vector<Octet16> keys(n), messages(n), output(n);
+  for (size_t i = 0; i < n; i++) {
+    keys[i].fill(i);
+    keys[i][0] = 0xa5;
+    messages[i].fill(0);
+    messages[i][i % OCTET16_LEN] = i;
+  }
+
+  aes_128_batch(keys.data(), messages.data(), output.data(), n);
+  for (size_t i = 0; i < n; i++)
+    EXPECT_EQ(aes_128(keys[i], messages[i]), output[i]);
+
+  Octet16 k{0x3c, 0x4f, 0xcf, 0x09, 0x88, 0x15, 0xf7, 0xab,
+            0xa6, 0xd2, 0xae, 0x28, 0x16, 0x15, 0x7e, 0x2b};
+  Octet16 m{0};
+  Octet16 expected{0x6f, 0x54, 0x1b, 0xb9, 0x47, 0xf0, 0x42, 0x3e,
+                   0xb3, 0x99, 0xb8, 0x1a, 0x0c, 0x6b, 0xf7, 0x7d};
+  EXPECT_EQ(expected, aes_128(k, m));
+}
+
 }  // namespace crypto_toolbox
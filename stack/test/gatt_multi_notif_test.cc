@@ -0,0 +1,211 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "stack/gatt/gatt_multi_notif.h"
+
+namespace {
+
+const uint8_t kMaxAttr = 4;
+const uint16_t kPayloadSize = 64;
+const uint16_t kBearer = 0x0040;
+const uint16_t kOtherBearer = 0x0041;
+const uint16_t kConnId = 0x0105;
+
+// The parts of tGATT_MULTI_NOTIF and tGATT_VALUE the queue looks at.
+struct MultiNotif {
+  uint16_t conn_id;
+  uint8_t num_attr;
+  uint16_t handles[kMaxAttr];
+  uint16_t lens[kMaxAttr];
+  std::vector<std::vector<uint8_t>> values;
+  uint8_t auth_req;
+};
+
+struct Value {
+  uint16_t conn_id;
+  uint16_t handle;
+  uint16_t len;
+  uint8_t value[kPayloadSize];
+};
+
+Value make_value(uint16_t handle, uint16_t len, uint16_t conn_id = kConnId) {
+  Value value;
+  value.conn_id = conn_id;
+  value.handle = handle;
+  value.len = len;
+  memset(value.value, handle & 0xff, len);
+  return value;
+}
+
+class GattMultiNotifQueueTest : public ::testing::Test {
+ protected:
+  // Takes the notifications of |lcid| as gatt_sr_send_multi_notif does, and
+  // returns whether the bearer took them.
+  bool Send(uint16_t lcid) {
+    MultiNotif multi_ntf;
+    EXPECT_TRUE(queue_.Take(lcid, &multi_ntf));
+    sent_lcids_.push_back(lcid);
+    sent_.push_back(std::move(multi_ntf));
+    return send_ok_;
+  }
+
+  bool Hold(uint16_t lcid, const Value& value, bool is_busy = false) {
+    return queue_.Hold(lcid, kPayloadSize, is_busy, value,
+                       [this](uint16_t cid) { return Send(cid); });
+  }
+
+  // What the latency budget running out does.
+  void Timeout() {
+    queue_.Flush([this](uint16_t lcid) { Send(lcid); });
+  }
+
+  std::vector<uint16_t> SentHandles(size_t i) const {
+    return std::vector<uint16_t>(sent_[i].handles,
+                                 sent_[i].handles + sent_[i].num_attr);
+  }
+
+  GattMultiNotifQueue<MultiNotif, kMaxAttr> queue_;
+  std::vector<uint16_t> sent_lcids_;
+  std::vector<MultiNotif> sent_;
+  bool send_ok_ = true;
+};
+
+TEST_F(GattMultiNotifQueueTest, holds_until_timeout) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x13, 5)));
+  EXPECT_TRUE(sent_.empty());
+  EXPECT_FALSE(queue_.Empty());
+
+  Timeout();
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_TRUE(queue_.Empty());
+  EXPECT_EQ(sent_[0].conn_id, kConnId);
+  EXPECT_EQ(SentHandles(0), std::vector<uint16_t>({0x10, 0x13}));
+  EXPECT_EQ(sent_[0].lens[1], 5);
+  EXPECT_EQ(sent_[0].values[1], std::vector<uint8_t>(5, 0x13));
+}
+
+TEST_F(GattMultiNotifQueueTest, timeout_sends_all_bearers_in_order) {
+  EXPECT_TRUE(Hold(kOtherBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kOtherBearer, make_value(0x13, 2)));
+
+  Timeout();
+  EXPECT_EQ(sent_lcids_, std::vector<uint16_t>({kOtherBearer, kBearer}));
+  EXPECT_EQ(SentHandles(0), std::vector<uint16_t>({0x10, 0x13}));
+  EXPECT_TRUE(queue_.Empty());
+}
+
+TEST_F(GattMultiNotifQueueTest, sends_when_attributes_run_out) {
+  for (uint16_t handle = 0x10; handle < 0x10 + kMaxAttr; handle++)
+    EXPECT_TRUE(Hold(kBearer, make_value(handle, 1)));
+  EXPECT_TRUE(sent_.empty());
+
+  EXPECT_TRUE(Hold(kBearer, make_value(0x20, 1)));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_EQ(sent_[0].num_attr, kMaxAttr);
+
+  Timeout();
+  EXPECT_EQ(SentHandles(1), std::vector<uint16_t>({0x20}));
+}
+
+TEST_F(GattMultiNotifQueueTest, sends_when_pdu_is_full) {
+  // 1 + 2 * (4 + 27) bytes fill the PDU up to 63
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 27)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x13, 27)));
+  EXPECT_TRUE(sent_.empty());
+
+  EXPECT_TRUE(Hold(kBearer, make_value(0x16, 1)));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_EQ(SentHandles(0), std::vector<uint16_t>({0x10, 0x13}));
+}
+
+TEST_F(GattMultiNotifQueueTest, sends_before_newer_value_of_held_handle) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x13, 2)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 3)));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_EQ(SentHandles(0), std::vector<uint16_t>({0x10, 0x13}));
+
+  Timeout();
+  EXPECT_EQ(SentHandles(1), std::vector<uint16_t>({0x10}));
+  EXPECT_EQ(sent_[1].lens[0], 3);
+}
+
+TEST_F(GattMultiNotifQueueTest, sends_before_notification_of_another_app) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kBearer, make_value(0x13, 2, kConnId + 1)));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_EQ(sent_[0].conn_id, kConnId);
+
+  Timeout();
+  EXPECT_EQ(sent_[1].conn_id, kConnId + 1);
+}
+
+TEST_F(GattMultiNotifQueueTest, holds_bearers_apart) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(Hold(kOtherBearer, make_value(0x10, 2)));
+  EXPECT_TRUE(sent_.empty());
+}
+
+TEST_F(GattMultiNotifQueueTest, does_not_hold_value_too_long_to_share) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_FALSE(Hold(kBearer, make_value(0x13, kPayloadSize - 4)));
+  // The held ones go first
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_TRUE(queue_.Empty());
+}
+
+TEST_F(GattMultiNotifQueueTest, does_not_hold_on_busy_bearer) {
+  EXPECT_FALSE(Hold(kBearer, make_value(0x10, 2), true));
+  EXPECT_TRUE(sent_.empty());
+  EXPECT_TRUE(queue_.Empty());
+
+  // Held before the bearer ran out of credits, they go first
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  EXPECT_FALSE(Hold(kBearer, make_value(0x13, 2), true));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_EQ(SentHandles(0), std::vector<uint16_t>({0x10}));
+  EXPECT_TRUE(queue_.Empty());
+}
+
+TEST_F(GattMultiNotifQueueTest, does_not_hold_when_sending_fails) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  // The bearer has no credits left for the held ones
+  send_ok_ = false;
+  EXPECT_FALSE(Hold(kBearer, make_value(0x10, 2)));
+  ASSERT_EQ(sent_.size(), 1u);
+  EXPECT_TRUE(queue_.Empty());
+}
+
+TEST_F(GattMultiNotifQueueTest, clear_drops_held_notifications) {
+  EXPECT_TRUE(Hold(kBearer, make_value(0x10, 2)));
+  queue_.Clear();
+  EXPECT_TRUE(queue_.Empty());
+  Timeout();
+  EXPECT_TRUE(sent_.empty());
+}
+
+}  // namespace
@@ -0,0 +1,153 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <vector>
+
+#include "stack/gatt/gatt_sr_index.h"
+
+using bluetooth::Uuid;
+
+namespace {
+
+const Uuid kPrimary = Uuid::From16Bit(0x2800);
+const Uuid kCharacteristic = Uuid::From16Bit(0x2803);
+const Uuid kCccd = Uuid::From16Bit(0x2902);
+const Uuid kBattery = Uuid::From16Bit(0x180f);
+const Uuid kHeartRate = Uuid::From16Bit(0x180d);
+
+// The parts of tGATT_ATTR, tGATT_SVC_DB and tGATT_SRV_LIST_ELEM the index
+// looks at.
+struct Attr {
+  uint16_t handle;
+  Uuid uuid;
+};
+
+struct Db {
+  std::vector<Attr> attr_list;
+};
+
+struct Service {
+  uint16_t s_hdl;
+  uint16_t e_hdl;
+  Db* p_db;
+  bool is_primary;
+  Uuid uuid;
+};
+
+typedef std::list<Service> ServiceList;
+
+// A service at |s_hdl| with |num_chars| characteristics, each with a value
+// and a CCCD.
+Db make_db(uint16_t s_hdl, size_t num_chars) {
+  Db db;
+  uint16_t handle = s_hdl;
+  db.attr_list.push_back({handle++, kPrimary});
+  for (size_t i = 0; i < num_chars; i++) {
+    db.attr_list.push_back({handle++, kCharacteristic});
+    db.attr_list.push_back({handle++, Uuid::From16Bit(0x2a00 + i)});
+    db.attr_list.push_back({handle++, kCccd});
+  }
+  return db;
+}
+
+class GattSrIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Handle ranges leave room for more attributes than are used, and the
+    // list is not in handle order
+    dbs_.push_back(make_db(40, 2));
+    dbs_.push_back(make_db(1, 1));
+    dbs_.push_back(make_db(60, 3));
+    services_.push_back({40, 50, &dbs_[0], true, kBattery});
+    services_.push_back({1, 10, &dbs_[1], false, kHeartRate});
+    services_.push_back({60, 80, &dbs_[2], true, kBattery});
+    Build();
+  }
+
+  void Build() {
+    index_.Build(services_, [](Service& s) -> const Uuid* {
+      return s.is_primary ? &s.uuid : nullptr;
+    });
+  }
+
+  uint16_t FindStart(uint16_t handle) {
+    ServiceList::iterator it = services_.end();
+    index_.Find(handle, &it);
+    return it == services_.end() ? 0 : it->s_hdl;
+  }
+
+  std::vector<uint16_t> Handles(const Uuid& type, uint16_t s, uint16_t e) {
+    auto range = index_.HandlesOfType(type, s, e);
+    return std::vector<uint16_t>(range.first, range.second);
+  }
+
+  std::vector<Db> dbs_;
+  ServiceList services_;
+  GattSrIndex<ServiceList> index_;
+};
+
+}  // namespace
+
+TEST_F(GattSrIndexTest, finds_service_by_handle) {
+  EXPECT_EQ(1, FindStart(1));
+  EXPECT_EQ(1, FindStart(10));
+  EXPECT_EQ(0, FindStart(11));
+  EXPECT_EQ(0, FindStart(39));
+  EXPECT_EQ(40, FindStart(40));
+  EXPECT_EQ(40, FindStart(50));
+  EXPECT_EQ(60, FindStart(75));
+  EXPECT_EQ(0, FindStart(81));
+  EXPECT_EQ(0, FindStart(0xffff));
+}
+
+TEST_F(GattSrIndexTest, lists_handles_of_type_in_range) {
+  EXPECT_EQ(std::vector<uint16_t>({4, 43, 46, 63, 66, 69}),
+            Handles(kCccd, 1, 0xffff));
+  EXPECT_EQ(std::vector<uint16_t>({43, 46}), Handles(kCccd, 5, 62));
+  EXPECT_EQ(std::vector<uint16_t>({46, 63}), Handles(kCccd, 46, 63));
+  EXPECT_EQ(std::vector<uint16_t>(), Handles(kCccd, 47, 62));
+  EXPECT_EQ(std::vector<uint16_t>(), Handles(kCccd, 63, 46));
+  EXPECT_EQ(std::vector<uint16_t>(), Handles(kBattery, 1, 0xffff));
+}
+
+TEST_F(GattSrIndexTest, lists_primary_services_by_uuid) {
+  const std::vector<ServiceList::iterator>* p_services =
+      index_.PrimaryServices(kBattery);
+  ASSERT_NE(nullptr, p_services);
+  ASSERT_EQ(2U, p_services->size());
+  EXPECT_EQ(40, (*p_services)[0]->s_hdl);
+  EXPECT_EQ(60, (*p_services)[1]->s_hdl);
+
+  // Secondary services are not found this way
+  EXPECT_EQ(nullptr, index_.PrimaryServices(kHeartRate));
+}
+
+TEST_F(GattSrIndexTest, follows_services_stopped) {
+  services_.pop_front();
+  Build();
+  EXPECT_EQ(0, FindStart(45));
+  EXPECT_EQ(std::vector<uint16_t>({4, 63, 66, 69}), Handles(kCccd, 1, 0xffff));
+  ASSERT_EQ(1U, index_.PrimaryServices(kBattery)->size());
+
+  index_.Clear();
+  EXPECT_EQ(0, FindStart(1));
+  EXPECT_EQ(std::vector<uint16_t>(), Handles(kCccd, 1, 0xffff));
+}
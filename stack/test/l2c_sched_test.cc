@@ -0,0 +1,172 @@
+/******************************************************************************
+ *
+ *  Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <vector>
+
+#include "stack/l2cap/l2c_sched.h"
+
+namespace {
+
+// Channels with queues of packet lengths, sent as the scheduler picks them.
+class Link {
+ public:
+  explicit Link(size_t num_channels)
+      : drr_(num_channels), queues_(num_channels), blocked_(num_channels),
+        sent_(num_channels) {}
+
+  void Queue(size_t channel, size_t len, size_t count) {
+    for (size_t i = 0; i < count; i++) queues_[channel].push_back(len);
+    drr_.Backlogged(channel);
+  }
+
+  // Sends one packet; returns its channel, or -1.
+  int Send() {
+    int channel = drr_.Next(
+        [this](size_t ch) {
+          if (queues_[ch].empty()) return L2cDrrScheduler::kEmpty;
+          return blocked_[ch] ? L2cDrrScheduler::kBlocked
+                              : L2cDrrScheduler::kReady;
+        },
+        [this](size_t ch) { return wait_ms_[ch]; });
+    if (channel < 0) return channel;
+    size_t len = queues_[channel].front();
+    queues_[channel].pop_front();
+    sent_[channel] += len;
+    drr_.Sent(channel, len, !queues_[channel].empty());
+    return channel;
+  }
+
+  L2cDrrScheduler drr_;
+  std::vector<std::deque<size_t>> queues_;
+  std::vector<bool> blocked_;
+  std::vector<size_t> sent_;
+  uint64_t wait_ms_[8] = {};
+};
+
+}  // namespace
+
+TEST(L2cDrrSchedulerTest, shares_bytes_by_weight) {
+  Link link(3);
+  link.drr_.Configure(0, 4000, 0);
+  link.drr_.Configure(1, 1000, 0);
+  link.drr_.Configure(2, 1000, 0);
+  // Large packets on 1 do not buy it more than its share
+  link.Queue(0, 600, 10000);
+  link.Queue(1, 1000, 10000);
+  link.Queue(2, 50, 100000);
+
+  for (int i = 0; i < 20000; i++) link.Send();
+  double total = link.sent_[0] + link.sent_[1] + link.sent_[2];
+  EXPECT_NEAR(4.0 / 6, link.sent_[0] / total, 0.01);
+  EXPECT_NEAR(1.0 / 6, link.sent_[1] / total, 0.01);
+  EXPECT_NEAR(1.0 / 6, link.sent_[2] / total, 0.01);
+}
+
+TEST(L2cDrrSchedulerTest, skips_blocked_and_drops_empty_channels) {
+  Link link(3);
+  for (size_t ch = 0; ch < 3; ch++) link.drr_.Configure(ch, 1000, 0);
+  link.Queue(0, 100, 2);
+  link.Queue(1, 100, 2);
+  link.blocked_[1] = true;
+
+  EXPECT_EQ(0, link.Send());
+  EXPECT_EQ(0, link.Send());
+  EXPECT_FALSE(link.drr_.Active(0));
+  EXPECT_EQ(-1, link.Send());
+  EXPECT_TRUE(link.drr_.Active(1));
+
+  link.blocked_[1] = false;
+  EXPECT_EQ(1, link.Send());
+  EXPECT_EQ(1, link.Send());
+  EXPECT_EQ(-1, link.Send());
+
+  // A channel emptied behind the scheduler's back is dropped as well
+  link.Queue(2, 100, 1);
+  link.queues_[2].clear();
+  EXPECT_EQ(-1, link.Send());
+  EXPECT_FALSE(link.drr_.Active(2));
+}
+
+TEST(L2cDrrSchedulerTest, serves_late_channel_first) {
+  Link link(2);
+  link.drr_.Configure(0, 1000, 20);
+  link.drr_.Configure(1, 100000, 0);
+  link.Queue(1, 1000, 100);
+  link.Queue(0, 500, 2);
+
+  link.wait_ms_[0] = 19;
+  EXPECT_EQ(1, link.Send());
+  link.wait_ms_[0] = 20;
+  EXPECT_EQ(0, link.Send());
+  EXPECT_EQ(0, link.Send());
+  EXPECT_EQ(1, link.Send());
+}
+
+TEST(L2cQueueDelayTest, records_delays) {
+  L2cQueueDelay delay;
+  delay.Enqueued(100);
+  delay.Enqueued(101);
+  delay.Enqueued(150);
+  EXPECT_EQ(10U, delay.HeadWait(110));
+
+  delay.Sent(2, 102);  // 2 and 1 ms
+  EXPECT_EQ(50U, delay.HeadWait(200));
+  delay.Sent(1, 1250);  // 1100 ms
+
+  const uint32_t* histogram = delay.Histogram();
+  EXPECT_EQ(0U, histogram[0]);
+  EXPECT_EQ(1U, histogram[1]);
+  EXPECT_EQ(1U, histogram[2]);
+  EXPECT_EQ(1U, histogram[L2CAP_DELAY_BUCKETS - 1]);
+  EXPECT_EQ(1100U, delay.MaxMs());
+  EXPECT_EQ(0U, delay.HeadWait(2000));
+}
+
+TEST(L2cQueueDelayTest, drops_buffers_gone_unsent) {
+  L2cQueueDelay delay;
+  for (int i = 0; i < 4; i++) delay.Enqueued(i * 10);
+
+  // Two were flushed from the head
+  delay.Sync(2);
+  EXPECT_EQ(80U, delay.HeadWait(100));
+  delay.Sync(2);
+  EXPECT_EQ(80U, delay.HeadWait(100));
+  delay.Sent(2, 100);
+  uint32_t total = 0;
+  for (size_t b = 0; b < L2CAP_DELAY_BUCKETS; b++)
+    total += delay.Histogram()[b];
+  EXPECT_EQ(2U, total);
+}
+
+TEST(L2cQueueDelayTest, times_buffers_after_overflow_in_order) {
+  L2cQueueDelay delay;
+  for (int i = 0; i < L2CAP_DELAY_TRACKED + 2; i++) delay.Enqueued(0);
+  delay.Sent(1, 1);
+  // Behind two untimed buffers, so not timed either
+  delay.Enqueued(1000);
+  delay.Sent(L2CAP_DELAY_TRACKED - 1, 1);
+  EXPECT_EQ(0U, delay.HeadWait(1001));
+  delay.Sent(3, 1001);
+
+  delay.Enqueued(2000);
+  EXPECT_EQ(5U, delay.HeadWait(2005));
+  EXPECT_EQ(1U, delay.MaxMs());
+}
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+This script converts compressed btsnoop logs, as written by the Bluetooth
+stack when persist.bluetooth.btsnoopcompress is set, back into a valid
+btsnoop log file which can be viewed using standard tools like Wireshark.
+
+A compressed btsnoop log can be described as:
+
+file_header
+repeated {
+  block_header
+  deflate {
+    repeated {
+      btsnoop record_header
+      record_data
+    }
+  }
+}
+
+where the block_header gives the time span of the block, so that the blocks
+outside of the time asked for are skipped without being inflated. See
+hci/include/btsnoop_compressed.h.
+"""
+
+
+import argparse
+import struct
+import sys
+import zlib
+
+
+BTSNOOPZ_MAGIC = b'btsnoopz'
+BTSNOOPZ_VERSION = 1
+FILE_HEADER = '>8sII'
+BLOCK_HEADER = '>IIIQQ'
+RECORD_HEADER = '>IIIIQ'
+BTSNOOP_FILE_HEADER = b'btsnoop\x00\x00\x00\x00\x01\x00\x00\x03\xea'
+
+
+def read_blocks(path):
+  """
+  Yields (block_header, compressed_data) for each block of the compressed
+  log at |path|. A block cut short, as the last one may be, is left out.
+  """
+  with open(path, 'rb') as f:
+    data = f.read()
+
+  magic, version, _ = struct.unpack_from(FILE_HEADER, data)
+  if magic != BTSNOOPZ_MAGIC or version != BTSNOOPZ_VERSION:
+    sys.stderr.write('%s: not a compressed btsnoop log\n' % path)
+    sys.exit(1)
+
+  offset = struct.calcsize(FILE_HEADER)
+  header_size = struct.calcsize(BLOCK_HEADER)
+  while offset + header_size <= len(data):
+    header = struct.unpack_from(BLOCK_HEADER, data, offset)
+    offset += header_size
+    compressed_len = header[0]
+    if offset + compressed_len > len(data):
+      sys.stderr.write('%s: last block cut short, left out\n' % path)
+      return
+    yield header, data[offset:offset + compressed_len]
+    offset += compressed_len
+
+
+def convert(paths, out, start, end):
+  """
+  Writes the records of the compressed logs at |paths|, in that order, to
+  |out| as a btsnoop log. Only the records from |start| to |end| seconds
+  after the first one are kept, when given.
+  """
+  out.write(BTSNOOP_FILE_HEADER)
+  first_timestamp = None
+  for path in paths:
+    for header, compressed in read_blocks(path):
+      _, length, _, block_first, block_last = header
+      if first_timestamp is None:
+        first_timestamp = block_first
+      from_us = None if start is None else first_timestamp + int(start * 1e6)
+      to_us = None if end is None else first_timestamp + int(end * 1e6)
+      if from_us is not None and block_last < from_us:
+        continue
+      if to_us is not None and block_first > to_us:
+        continue
+
+      records = zlib.decompress(compressed)
+      if len(records) != length:
+        sys.stderr.write('%s: block of the wrong length\n' % path)
+        sys.exit(1)
+
+      offset = 0
+      record_header_size = struct.calcsize(RECORD_HEADER)
+      while offset < len(records):
+        _, captured, _, _, timestamp = struct.unpack_from(
+            RECORD_HEADER, records, offset)
+        end_offset = offset + record_header_size + captured
+        if ((from_us is None or timestamp >= from_us) and
+            (to_us is None or timestamp <= to_us)):
+          out.write(records[offset:end_offset])
+        offset = end_offset
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Converts compressed btsnoop logs to btsnoop.')
+  parser.add_argument('logs', nargs='+',
+                      help='compressed logs, oldest (.last) first')
+  parser.add_argument('-o', '--output', help='btsnoop log written (stdout)')
+  parser.add_argument('--start', type=float,
+                      help='seconds after the first packet to start at')
+  parser.add_argument('--end', type=float,
+                      help='seconds after the first packet to stop at')
+  args = parser.parse_args()
+
+  if args.output:
+    with open(args.output, 'wb') as out:
+      convert(args.logs, out, args.start, args.end)
+  else:
+    convert(args.logs, sys.stdout.buffer, args.start, args.end)
+
+
+if __name__ == '__main__':
+  main()